@@ -0,0 +1,124 @@
+#include <benchmark/benchmark.h>
+#include <blobstore/implementations/onblocks/datatreestore/DataTreeStore.h>
+#include <blobstore/implementations/onblocks/datatreestore/DataTree.h>
+#include <blobstore/implementations/onblocks/datanodestore/DataNodeStore.h>
+#include <blockstore/implementations/inmemory/InMemoryBlockStore2.h>
+#include <blockstore/implementations/low2highlevel/LowToHighLevelBlockStore.h>
+#include <cpp-utils/data/DataFixture.h>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using blobstore::onblocks::datatreestore::DataTreeStore;
+using blobstore::onblocks::datatreestore::DataTree;
+using blobstore::onblocks::datanodestore::DataNodeStore;
+using blockstore::inmemory::InMemoryBlockStore2;
+using blockstore::lowtohighlevel::LowToHighLevelBlockStore;
+using cpputils::Data;
+using cpputils::DataFixture;
+using cpputils::unique_ref;
+using cpputils::make_unique_ref;
+
+namespace {
+
+constexpr uint64_t TREE_SIZE = 16 * 1024 * 1024;
+
+unique_ref<DataTreeStore> createTreeStore(uint64_t blockSize) {
+    return make_unique_ref<DataTreeStore>(
+        make_unique_ref<DataNodeStore>(
+            make_unique_ref<LowToHighLevelBlockStore>(make_unique_ref<InMemoryBlockStore2>()),
+            blockSize));
+}
+
+// Arguments: physical block size, number of bytes per read/write call
+void BM_DataTree_WriteBytes(benchmark::State &state) {
+    const uint64_t blockSize = state.range(0);
+    const uint64_t count = state.range(1);
+    auto treeStore = createTreeStore(blockSize);
+    auto tree = treeStore->createNewTree();
+    tree->resizeNumBytes(TREE_SIZE);
+    const Data data = DataFixture::generate(count);
+    uint64_t offset = 0;
+    for (auto _ : state) {
+        tree->writeBytes(data.data(), offset, count);
+        offset = (offset + count) % TREE_SIZE;
+    }
+    state.SetBytesProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_DataTree_WriteBytes)->ArgsProduct({{4 * 1024, 32 * 1024, 64 * 1024}, {4 * 1024, 1024 * 1024}});
+
+void BM_DataTree_ReadBytes(benchmark::State &state) {
+    const uint64_t blockSize = state.range(0);
+    const uint64_t count = state.range(1);
+    auto treeStore = createTreeStore(blockSize);
+    auto tree = treeStore->createNewTree();
+    tree->resizeNumBytes(TREE_SIZE);
+    Data target(count);
+    uint64_t offset = 0;
+    for (auto _ : state) {
+        tree->readBytes(target.data(), offset, count);
+        offset = (offset + count) % TREE_SIZE;
+    }
+    state.SetBytesProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_DataTree_ReadBytes)->ArgsProduct({{4 * 1024, 32 * 1024, 64 * 1024}, {4 * 1024, 1024 * 1024}});
+
+// Random writes of 4KB by several threads to one tree, like a database or VM image doing concurrent pwrite() calls.
+// All threads share the tree, thread 0 sets it up before the benchmark loop, which the other threads only enter once setup is done.
+// With more threads, this shows how well writes to different leaves run in parallel.
+struct SharedTree final {
+    unique_ref<DataTreeStore> treeStore;
+    unique_ref<DataTree> tree;
+};
+
+void BM_DataTree_ParallelRandomWrites(benchmark::State &state) {
+    static std::unique_ptr<SharedTree> shared;
+    const uint64_t count = 4 * 1024;
+    if (state.thread_index() == 0) {
+        auto treeStore = createTreeStore(32 * 1024);
+        auto tree = treeStore->createNewTree();
+        tree->resizeNumBytes(TREE_SIZE);
+        shared = std::make_unique<SharedTree>(SharedTree{std::move(treeStore), std::move(tree)});
+    }
+    const Data data = DataFixture::generate(count, state.thread_index());
+    std::vector<uint64_t> offsets;
+    {
+        const Data randomness = DataFixture::generate(1024 * sizeof(uint64_t), 1000 + state.thread_index());
+        for (size_t i = 0; i < 1024; ++i) {
+            uint64_t value = 0;
+            std::memcpy(&value, randomness.dataOffset(i * sizeof(uint64_t)), sizeof(uint64_t));
+            offsets.push_back((value % (TREE_SIZE / count)) * count);
+        }
+    }
+    size_t index = 0;
+    for (auto _ : state) {
+        shared->tree->writeBytes(data.data(), offsets[index], count);
+        index = (index + 1) % offsets.size();
+    }
+    state.SetBytesProcessed(state.iterations() * count);
+    if (state.thread_index() == 0) {
+        shared.reset();
+    }
+}
+BENCHMARK(BM_DataTree_ParallelRandomWrites)->ThreadRange(1, 16)->UseRealTime();
+
+// Growing a tree by appending, like writing a new file sequentially
+void BM_DataTree_Append(benchmark::State &state) {
+    const uint64_t blockSize = state.range(0);
+    const uint64_t count = 64 * 1024;
+    auto treeStore = createTreeStore(blockSize);
+    const Data data = DataFixture::generate(count);
+    auto tree = treeStore->createNewTree();
+    for (auto _ : state) {
+        if (tree->numBytes() >= TREE_SIZE) {
+            state.PauseTiming();
+            tree = treeStore->createNewTree();
+            state.ResumeTiming();
+        }
+        tree->writeBytes(data.data(), tree->numBytes(), count);
+    }
+    state.SetBytesProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_DataTree_Append)->Arg(4 * 1024)->Arg(32 * 1024)->Arg(64 * 1024);
+
+}
@@ -0,0 +1,214 @@
+#include <benchmark/benchmark.h>
+#include <blockstore/implementations/inmemory/InMemoryBlockStore2.h>
+#include <blockstore/implementations/encrypted/EncryptedBlockStore2.h>
+#include <blockstore/implementations/integrity/IntegrityBlockStore2.h>
+#include <blockstore/implementations/caching/CachingBlockStore2.h>
+#include <blockstore/implementations/ondisk/OnDiskBlockStore2.h>
+#include <cpp-utils/crypto/symmetric/ciphers.h>
+#include <cpp-utils/data/DataFixture.h>
+#include <cpp-utils/tempfile/TempDir.h>
+#include <cpp-utils/tempfile/TempFile.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+using blockstore::BlockId;
+using blockstore::BlockStore2;
+using blockstore::inmemory::InMemoryBlockStore2;
+using blockstore::encrypted::EncryptedBlockStore2;
+using blockstore::integrity::IntegrityBlockStore2;
+using blockstore::caching::CachingBlockStore2;
+using blockstore::ondisk::OnDiskBlockStore2;
+using cpputils::Data;
+using cpputils::DataFixture;
+using cpputils::TempDir;
+using cpputils::TempFile;
+using cpputils::unique_ref;
+using cpputils::make_unique_ref;
+
+namespace {
+
+// Each layer is benchmarked on top of an InMemoryBlockStore2 so that only the layer itself is measured.
+
+struct InMemory final {
+    unique_ref<BlockStore2> blockStore = make_unique_ref<InMemoryBlockStore2>();
+};
+
+template<class Cipher>
+struct Encrypted final {
+    unique_ref<BlockStore2> blockStore = make_unique_ref<EncryptedBlockStore2<Cipher>>(
+        make_unique_ref<InMemoryBlockStore2>(),
+        Cipher::EncryptionKey::CreateKey(cpputils::Random::PseudoRandom(), Cipher::KEYSIZE));
+};
+
+struct Integrity final {
+    TempFile integrityFile{false};
+    unique_ref<BlockStore2> blockStore = make_unique_ref<IntegrityBlockStore2>(
+        make_unique_ref<InMemoryBlockStore2>(), integrityFile.path(), 0x12345678, false, false, [] {});
+};
+
+struct Caching final {
+    unique_ref<BlockStore2> blockStore = make_unique_ref<CachingBlockStore2>(make_unique_ref<InMemoryBlockStore2>());
+};
+
+struct OnDisk final {
+    TempDir baseDir;
+    unique_ref<BlockStore2> blockStore = make_unique_ref<OnDiskBlockStore2>(baseDir.path());
+};
+
+template<class Store>
+void BM_BlockStore2_Create(benchmark::State &state) {
+    Store store;
+    const Data data = DataFixture::generate(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(store.blockStore->create(data));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+template<class Store>
+void BM_BlockStore2_Store(benchmark::State &state) {
+    Store store;
+    const Data data = DataFixture::generate(state.range(0));
+    const BlockId blockId = store.blockStore->create(data);
+    for (auto _ : state) {
+        store.blockStore->store(blockId, data);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+// Stores a batch of 256 blocks per iteration, either block by block or with one storeMany() call.
+// Comparing the two shows how well the batch path scales with the number of cores.
+template<class Store, bool Batched>
+void BM_BlockStore2_StoreBatch(benchmark::State &state) {
+    constexpr size_t NUM_BLOCKS = 256;
+    Store store;
+    const Data data = DataFixture::generate(state.range(0));
+    std::vector<BlockId> blockIds;
+    for (size_t i = 0; i < NUM_BLOCKS; ++i) {
+        blockIds.push_back(store.blockStore->create(data));
+    }
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::vector<std::pair<BlockId, Data>> blocks;
+        for (const BlockId &blockId : blockIds) {
+            blocks.emplace_back(blockId, data.copy());
+        }
+        state.ResumeTiming();
+        if (Batched) {
+            store.blockStore->storeMany(std::move(blocks));
+        } else {
+            for (const auto &block : blocks) {
+                store.blockStore->store(block.first, block.second);
+            }
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * NUM_BLOCKS * state.range(0));
+}
+
+template<class Store>
+void BM_BlockStore2_Load(benchmark::State &state) {
+    Store store;
+    const BlockId blockId = store.blockStore->create(DataFixture::generate(state.range(0)));
+    for (auto _ : state) {
+        auto loaded = store.blockStore->load(blockId);
+        benchmark::DoNotOptimize(loaded);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+// All threads load blocks from one shared store, each thread its own set of blocks.
+// With more threads, this shows how much the threads contend on locks inside the store.
+template<class Store>
+void BM_BlockStore2_ParallelLoad(benchmark::State &state) {
+    constexpr size_t NUM_BLOCKS_PER_THREAD = 64;
+    static std::unique_ptr<Store> store;
+    static std::vector<std::vector<BlockId>> blockIds;
+    if (state.thread_index() == 0) {
+        store = std::make_unique<Store>();
+        const Data data = DataFixture::generate(state.range(0));
+        blockIds.assign(state.threads(), {});
+        for (auto &threadBlockIds : blockIds) {
+            for (size_t i = 0; i < NUM_BLOCKS_PER_THREAD; ++i) {
+                threadBlockIds.push_back(store->blockStore->create(data));
+            }
+        }
+    }
+    size_t index = 0;
+    for (auto _ : state) {
+        auto loaded = store->blockStore->load(blockIds[state.thread_index()][index]);
+        benchmark::DoNotOptimize(loaded);
+        index = (index + 1) % NUM_BLOCKS_PER_THREAD;
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+    if (state.thread_index() == 0) {
+        store.reset();
+    }
+}
+
+template<class Store>
+void BM_BlockStore2_Remove(benchmark::State &state) {
+    Store store;
+    const Data data = DataFixture::generate(state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        const BlockId blockId = store.blockStore->create(data);
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(store.blockStore->remove(blockId));
+    }
+}
+
+}
+
+#define REGISTER_BLOCKSTORE2_BENCHMARKS(Store)                                                \
+    BENCHMARK_TEMPLATE(BM_BlockStore2_Create, Store)->Arg(4 * 1024)->Arg(32 * 1024);          \
+    BENCHMARK_TEMPLATE(BM_BlockStore2_Store, Store)->Arg(4 * 1024)->Arg(32 * 1024);           \
+    BENCHMARK_TEMPLATE(BM_BlockStore2_Load, Store)->Arg(4 * 1024)->Arg(32 * 1024);            \
+    BENCHMARK_TEMPLATE(BM_BlockStore2_Remove, Store)->Arg(32 * 1024);                         \
+
+#define REGISTER_STOREBATCH_BENCHMARKS(Store)                                                 \
+    BENCHMARK_TEMPLATE(BM_BlockStore2_StoreBatch, Store, false)->Arg(32 * 1024)->UseRealTime(); \
+    BENCHMARK_TEMPLATE(BM_BlockStore2_StoreBatch, Store, true)->Arg(32 * 1024)->UseRealTime();  \
+
+#define REGISTER_PARALLELLOAD_BENCHMARKS(Store)                                               \
+    BENCHMARK_TEMPLATE(BM_BlockStore2_ParallelLoad, Store)->Arg(32 * 1024)->ThreadRange(1, 64)->UseRealTime(); \
+
+// Ciphers only differ in the cost of encrypting/decrypting, so one block size is enough for them.
+#define REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(Cipher)                                     \
+    BENCHMARK_TEMPLATE(BM_BlockStore2_Store, Encrypted<cpputils::Cipher>)->Arg(32 * 1024);    \
+    BENCHMARK_TEMPLATE(BM_BlockStore2_Load, Encrypted<cpputils::Cipher>)->Arg(32 * 1024);     \
+
+REGISTER_BLOCKSTORE2_BENCHMARKS(InMemory)
+REGISTER_BLOCKSTORE2_BENCHMARKS(Integrity)
+REGISTER_BLOCKSTORE2_BENCHMARKS(Caching)
+REGISTER_BLOCKSTORE2_BENCHMARKS(OnDisk)
+
+REGISTER_PARALLELLOAD_BENCHMARKS(Integrity)
+REGISTER_PARALLELLOAD_BENCHMARKS(Caching)
+
+REGISTER_STOREBATCH_BENCHMARKS(Encrypted<cpputils::AES256_GCM>)
+REGISTER_STOREBATCH_BENCHMARKS(Integrity)
+REGISTER_STOREBATCH_BENCHMARKS(OnDisk)
+
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(AES256_GCM)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(AES256_CFB)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(AES128_GCM)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(AES128_CFB)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(Twofish256_GCM)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(Twofish256_CFB)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(Twofish128_GCM)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(Twofish128_CFB)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(Serpent256_GCM)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(Serpent256_CFB)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(Serpent128_GCM)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(Serpent128_CFB)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(Cast256_GCM)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(Cast256_CFB)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(Mars448_GCM)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(Mars448_CFB)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(Mars256_GCM)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(Mars256_CFB)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(Mars128_GCM)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(Mars128_CFB)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(ChaCha20_Poly1305)
+REGISTER_ENCRYPTED_BLOCKSTORE2_BENCHMARKS(XChaCha20_Poly1305)
@@ -0,0 +1,74 @@
+#include <benchmark/benchmark.h>
+#include <blockstore/implementations/integrity/KnownBlockVersions.h>
+#include <cpp-utils/tempfile/TempFile.h>
+#include <memory>
+#include <vector>
+
+using blockstore::BlockId;
+using blockstore::integrity::KnownBlockVersions;
+using cpputils::TempFile;
+
+namespace {
+
+constexpr uint32_t MY_CLIENT_ID = 0x12345678;
+constexpr size_t NUM_BLOCKS_PER_THREAD = 1024;
+
+// All threads share one KnownBlockVersions, each thread works on its own set of blocks like parallel FUSE threads would.
+// Thread 0 sets it up before the benchmark loop, which the other threads only enter once setup is done.
+// With more threads, this shows how much the threads contend on locks inside KnownBlockVersions.
+struct SharedKnownBlockVersions final {
+    TempFile stateFile{false};
+    KnownBlockVersions knownBlockVersions{stateFile.path(), MY_CLIENT_ID};
+    std::vector<std::vector<BlockId>> blockIds;
+};
+
+std::unique_ptr<SharedKnownBlockVersions> setUp(const benchmark::State &state) {
+    auto shared = std::make_unique<SharedKnownBlockVersions>();
+    shared->blockIds.assign(state.threads(), {});
+    for (auto &threadBlockIds : shared->blockIds) {
+        for (size_t i = 0; i < NUM_BLOCKS_PER_THREAD; ++i) {
+            threadBlockIds.push_back(BlockId::Random());
+            shared->knownBlockVersions.incrementVersion(threadBlockIds.back());
+        }
+    }
+    return shared;
+}
+
+// What IntegrityBlockStore2::store() does for each block
+void BM_KnownBlockVersions_IncrementVersion(benchmark::State &state) {
+    static std::unique_ptr<SharedKnownBlockVersions> shared;
+    if (state.thread_index() == 0) {
+        shared = setUp(state);
+    }
+    size_t index = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(shared->knownBlockVersions.incrementVersion(shared->blockIds[state.thread_index()][index]));
+        index = (index + 1) % NUM_BLOCKS_PER_THREAD;
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        shared.reset();
+    }
+}
+
+// What IntegrityBlockStore2::load() does for each block. Most loads see a version that is already known.
+void BM_KnownBlockVersions_CheckAndUpdateVersion(benchmark::State &state) {
+    static std::unique_ptr<SharedKnownBlockVersions> shared;
+    if (state.thread_index() == 0) {
+        shared = setUp(state);
+    }
+    size_t index = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(shared->knownBlockVersions.checkAndUpdateVersion(MY_CLIENT_ID, shared->blockIds[state.thread_index()][index], 1));
+        index = (index + 1) % NUM_BLOCKS_PER_THREAD;
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        shared.reset();
+    }
+}
+
+}
+
+BENCHMARK(BM_KnownBlockVersions_IncrementVersion)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK(BM_KnownBlockVersions_CheckAndUpdateVersion)->ThreadRange(1, 64)->UseRealTime();
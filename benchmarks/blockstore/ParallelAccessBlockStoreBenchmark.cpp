@@ -0,0 +1,91 @@
+#include <benchmark/benchmark.h>
+#include <blockstore/implementations/inmemory/InMemoryBlockStore2.h>
+#include <blockstore/implementations/low2highlevel/LowToHighLevelBlockStore.h>
+#include <blockstore/implementations/parallelaccess/ParallelAccessBlockStore.h>
+#include <cpp-utils/data/DataFixture.h>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using blockstore::BlockId;
+using blockstore::BlockStore2;
+using blockstore::inmemory::InMemoryBlockStore2;
+using blockstore::lowtohighlevel::LowToHighLevelBlockStore;
+using blockstore::parallelaccess::ParallelAccessBlockStore;
+using cpputils::Data;
+using cpputils::DataFixture;
+using cpputils::unique_ref;
+using cpputils::make_unique_ref;
+
+namespace {
+
+// Adds a fixed latency to each load, like a base directory on a network file system or a cold disk would.
+// This shows whether loads of different blocks wait for each other, independent of the number of cores.
+class SlowLoadingBlockStore2 final : public BlockStore2 {
+public:
+    explicit SlowLoadingBlockStore2(std::chrono::microseconds loadLatency)
+        : _baseBlockStore(), _loadLatency(loadLatency) {}
+
+    bool tryCreate(const BlockId &blockId, const Data &data) override {
+        return _baseBlockStore.tryCreate(blockId, data);
+    }
+    bool remove(const BlockId &blockId) override {
+        return _baseBlockStore.remove(blockId);
+    }
+    boost::optional<Data> load(const BlockId &blockId) const override {
+        std::this_thread::sleep_for(_loadLatency);
+        return _baseBlockStore.load(blockId);
+    }
+    void store(const BlockId &blockId, const Data &data) override {
+        _baseBlockStore.store(blockId, data);
+    }
+    uint64_t numBlocks() const override {
+        return _baseBlockStore.numBlocks();
+    }
+    uint64_t estimateNumFreeBytes() const override {
+        return _baseBlockStore.estimateNumFreeBytes();
+    }
+    uint64_t blockSizeFromPhysicalBlockSize(uint64_t blockSize) const override {
+        return _baseBlockStore.blockSizeFromPhysicalBlockSize(blockSize);
+    }
+    void forEachBlock(std::function<void (const BlockId &)> callback) const override {
+        _baseBlockStore.forEachBlock(std::move(callback));
+    }
+
+private:
+    InMemoryBlockStore2 _baseBlockStore;
+    std::chrono::microseconds _loadLatency;
+};
+
+// All threads load blocks through one shared ParallelAccessBlockStore, each thread its own set of blocks.
+// Argument: load latency of the base store in microseconds
+void BM_ParallelAccessBlockStore_ParallelLoad(benchmark::State &state) {
+    constexpr size_t NUM_BLOCKS_PER_THREAD = 64;
+    static std::unique_ptr<ParallelAccessBlockStore> blockStore;
+    static std::vector<std::vector<BlockId>> blockIds;
+    if (state.thread_index() == 0) {
+        blockStore = std::make_unique<ParallelAccessBlockStore>(make_unique_ref<LowToHighLevelBlockStore>(
+            make_unique_ref<SlowLoadingBlockStore2>(std::chrono::microseconds(state.range(0)))));
+        const Data data = DataFixture::generate(32 * 1024);
+        blockIds.assign(state.threads(), {});
+        for (auto &threadBlockIds : blockIds) {
+            for (size_t i = 0; i < NUM_BLOCKS_PER_THREAD; ++i) {
+                threadBlockIds.push_back(blockStore->create(data)->blockId());
+            }
+        }
+    }
+    size_t index = 0;
+    for (auto _ : state) {
+        auto loaded = blockStore->load(blockIds[state.thread_index()][index]);
+        benchmark::DoNotOptimize(loaded);
+        index = (index + 1) % NUM_BLOCKS_PER_THREAD;
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        blockStore.reset();
+    }
+}
+BENCHMARK(BM_ParallelAccessBlockStore_ParallelLoad)->Arg(0)->Arg(200)->ThreadRange(1, 16)->UseRealTime();
+
+}
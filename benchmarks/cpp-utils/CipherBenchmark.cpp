@@ -0,0 +1,84 @@
+#include <benchmark/benchmark.h>
+#include <cpp-utils/crypto/symmetric/ciphers.h>
+#include <cpp-utils/data/DataFixture.h>
+
+using cpputils::Data;
+using cpputils::DataFixture;
+
+namespace {
+
+template<class Cipher>
+typename Cipher::EncryptionKey createKey() {
+    return Cipher::EncryptionKey::CreateKey(cpputils::Random::PseudoRandom(), Cipher::KEYSIZE);
+}
+
+// Argument for all benchmarks: block size
+
+template<class Cipher>
+void BM_Cipher_Encrypt(benchmark::State &state) {
+    const auto key = createKey<Cipher>();
+    const Data plaintext = DataFixture::generate(state.range(0));
+    for (auto _ : state) {
+        Data ciphertext = Cipher::encrypt(static_cast<const CryptoPP::byte*>(plaintext.data()), plaintext.size(), key);
+        benchmark::DoNotOptimize(ciphertext.data());
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+template<class Cipher>
+void BM_Cipher_Decrypt(benchmark::State &state) {
+    const auto key = createKey<Cipher>();
+    const Data plaintext = DataFixture::generate(state.range(0));
+    const Data ciphertext = Cipher::encrypt(static_cast<const CryptoPP::byte*>(plaintext.data()), plaintext.size(), key);
+    for (auto _ : state) {
+        auto decrypted = Cipher::decrypt(static_cast<const CryptoPP::byte*>(ciphertext.data()), ciphertext.size(), key);
+        benchmark::DoNotOptimize(decrypted);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+// Alternates between two keys, so the cipher context has to be keyed again for each block.
+// This is the cost every block had before cipher contexts were cached per thread.
+template<class Cipher>
+void BM_Cipher_Encrypt_RekeyEachBlock(benchmark::State &state) {
+    const auto key1 = createKey<Cipher>();
+    const auto key2 = createKey<Cipher>();
+    const Data plaintext = DataFixture::generate(state.range(0));
+    bool useFirstKey = true;
+    for (auto _ : state) {
+        Data ciphertext = Cipher::encrypt(static_cast<const CryptoPP::byte*>(plaintext.data()), plaintext.size(), useFirstKey ? key1 : key2);
+        benchmark::DoNotOptimize(ciphertext.data());
+        useFirstKey = !useFirstKey;
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+}
+
+#define REGISTER_CIPHER_BENCHMARKS(Cipher)                                                                  \
+    BENCHMARK_TEMPLATE(BM_Cipher_Encrypt, cpputils::Cipher)->Arg(4 * 1024)->Arg(32 * 1024);                 \
+    BENCHMARK_TEMPLATE(BM_Cipher_Decrypt, cpputils::Cipher)->Arg(4 * 1024)->Arg(32 * 1024);                 \
+    BENCHMARK_TEMPLATE(BM_Cipher_Encrypt_RekeyEachBlock, cpputils::Cipher)->Arg(4 * 1024)->Arg(32 * 1024);  \
+
+REGISTER_CIPHER_BENCHMARKS(AES256_GCM)
+REGISTER_CIPHER_BENCHMARKS(AES256_CFB)
+REGISTER_CIPHER_BENCHMARKS(AES128_GCM)
+REGISTER_CIPHER_BENCHMARKS(AES128_CFB)
+REGISTER_CIPHER_BENCHMARKS(Twofish256_GCM)
+REGISTER_CIPHER_BENCHMARKS(Twofish256_CFB)
+REGISTER_CIPHER_BENCHMARKS(Twofish128_GCM)
+REGISTER_CIPHER_BENCHMARKS(Twofish128_CFB)
+REGISTER_CIPHER_BENCHMARKS(Serpent256_GCM)
+REGISTER_CIPHER_BENCHMARKS(Serpent256_CFB)
+REGISTER_CIPHER_BENCHMARKS(Serpent128_GCM)
+REGISTER_CIPHER_BENCHMARKS(Serpent128_CFB)
+REGISTER_CIPHER_BENCHMARKS(Cast256_GCM)
+REGISTER_CIPHER_BENCHMARKS(Cast256_CFB)
+REGISTER_CIPHER_BENCHMARKS(Mars448_GCM)
+REGISTER_CIPHER_BENCHMARKS(Mars448_CFB)
+REGISTER_CIPHER_BENCHMARKS(Mars256_GCM)
+REGISTER_CIPHER_BENCHMARKS(Mars256_CFB)
+REGISTER_CIPHER_BENCHMARKS(Mars128_GCM)
+REGISTER_CIPHER_BENCHMARKS(Mars128_CFB)
+REGISTER_CIPHER_BENCHMARKS(ChaCha20_Poly1305)
+REGISTER_CIPHER_BENCHMARKS(XChaCha20_Poly1305)
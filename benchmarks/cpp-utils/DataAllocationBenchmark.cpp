@@ -0,0 +1,56 @@
+#include <benchmark/benchmark.h>
+#include <cpp-utils/data/Data.h>
+
+using cpputils::Data;
+using cpputils::DefaultAllocator;
+using cpputils::PooledAllocator;
+using cpputils::make_unique_ref;
+
+namespace {
+
+// Reports the allocator counters per iteration
+void setPoolCounters(benchmark::State &state, const PooledAllocator::Statistics &before) {
+    const PooledAllocator::Statistics after = PooledAllocator::statistics();
+    state.counters["poolHits"] = benchmark::Counter(static_cast<double>(after.numPoolHits - before.numPoolHits), benchmark::Counter::kAvgIterations);
+    state.counters["poolMisses"] = benchmark::Counter(static_cast<double>(after.numPoolMisses - before.numPoolMisses), benchmark::Counter::kAvgIterations);
+    state.counters["unpooledAllocations"] = benchmark::Counter(static_cast<double>(after.numUnpooledAllocations - before.numUnpooledAllocations), benchmark::Counter::kAvgIterations);
+}
+
+// Allocation as it happened before Data had a shared allocator: one heap allocated DefaultAllocator per Data object
+void BM_Data_AllocateWithOwnedDefaultAllocator(benchmark::State &state) {
+    const size_t size = state.range(0);
+    for (auto _ : state) {
+        Data data(size, make_unique_ref<DefaultAllocator>());
+        benchmark::DoNotOptimize(data.data());
+    }
+}
+BENCHMARK(BM_Data_AllocateWithOwnedDefaultAllocator)->Arg(64)->Arg(4 * 1024)->Arg(32 * 1024)->Arg(64 * 1024);
+
+void BM_Data_AllocateWithPooledAllocator(benchmark::State &state) {
+    const size_t size = state.range(0);
+    const PooledAllocator::Statistics before = PooledAllocator::statistics();
+    for (auto _ : state) {
+        Data data(size);
+        benchmark::DoNotOptimize(data.data());
+    }
+    setPoolCounters(state, before);
+}
+BENCHMARK(BM_Data_AllocateWithPooledAllocator)->Arg(64)->Arg(4 * 1024)->Arg(32 * 1024)->Arg(64 * 1024);
+
+// Loading a block allocates a few block sized buffers that are alive at the same time (file content, decrypted data, ...)
+void BM_Data_AllocateSeveralBuffersWithPooledAllocator(benchmark::State &state) {
+    const size_t size = state.range(0);
+    const PooledAllocator::Statistics before = PooledAllocator::statistics();
+    for (auto _ : state) {
+        Data first(size + 16);
+        Data second(size);
+        Data third(size - 16);
+        benchmark::DoNotOptimize(first.data());
+        benchmark::DoNotOptimize(second.data());
+        benchmark::DoNotOptimize(third.data());
+    }
+    setPoolCounters(state, before);
+}
+BENCHMARK(BM_Data_AllocateSeveralBuffersWithPooledAllocator)->Arg(32 * 1024);
+
+}
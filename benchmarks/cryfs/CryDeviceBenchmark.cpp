@@ -0,0 +1,113 @@
+#include <benchmark/benchmark.h>
+#include <cryfs/impl/filesystem/CryDevice.h>
+#include <cryfs/impl/config/CryPresetPasswordBasedKeyProvider.h>
+#include <blockstore/implementations/ondisk/OnDiskBlockStore2.h>
+#include <cpp-utils/crypto/kdf/Scrypt.h>
+#include <cpp-utils/data/DataFixture.h>
+#include <cpp-utils/tempfile/TempDir.h>
+#include <cpp-utils/tempfile/TempFile.h>
+#include <fspp/fs_interface/File.h>
+#include <fspp/fs_interface/Dir.h>
+#include <fspp/fs_interface/OpenFile.h>
+#include <string>
+
+using cryfs::CryDevice;
+using cryfs::CryConfig;
+using cryfs::CryConfigFile;
+using cryfs::LocalStateDir;
+using blockstore::ondisk::OnDiskBlockStore2;
+using cpputils::Data;
+using cpputils::DataFixture;
+using cpputils::TempDir;
+using cpputils::TempFile;
+using cpputils::unique_ref;
+using cpputils::make_unique_ref;
+
+namespace {
+
+constexpr fspp::mode_t MODE = fspp::mode_t().addUserReadFlag().addUserWriteFlag();
+constexpr uint64_t FILE_SIZE = 16 * 1024 * 1024;
+
+// A file system with the default cipher and block size, stored in a temporary directory
+class TempFilesystem final {
+public:
+    TempFilesystem()
+        : _baseDir(), _localStateDir(), _configFile(false), _device(nullptr) {
+        _device = std::make_unique<CryDevice>(
+            _createConfigFile(), make_unique_ref<OnDiskBlockStore2>(_baseDir.path()), LocalStateDir(_localStateDir.path()),
+            0x12345678, false, false, [] {}, boost::none);
+        _device->setContext(fspp::Context { fspp::relatime() });
+    }
+
+    CryDevice &device() {
+        return *_device;
+    }
+
+    unique_ref<fspp::OpenFile> createAndOpenFile(const std::string &name) {
+        return _device->LoadDir("/").value()->createAndOpenFile(name, MODE, fspp::uid_t(0), fspp::gid_t(0));
+    }
+
+private:
+    std::shared_ptr<CryConfigFile> _createConfigFile() {
+        CryConfig config;
+        config.SetCipher("aes-256-gcm");
+        config.SetEncryptionKey(cpputils::AES256_GCM::EncryptionKey::CreateKey(cpputils::Random::PseudoRandom(), cpputils::AES256_GCM::KEYSIZE).ToString());
+        config.SetBlocksizeBytes(16 * 1024);
+        cryfs::CryPresetPasswordBasedKeyProvider keyProvider("mypassword", make_unique_ref<cpputils::SCrypt>(cpputils::SCrypt::TestSettings));
+        return CryConfigFile::create(_configFile.path(), std::move(config), &keyProvider);
+    }
+
+    TempDir _baseDir;
+    TempDir _localStateDir;
+    TempFile _configFile;
+    std::unique_ptr<CryDevice> _device;
+};
+
+void BM_CryDevice_CreateFile(benchmark::State &state) {
+    TempFilesystem fs;
+    uint64_t index = 0;
+    for (auto _ : state) {
+        fs.createAndOpenFile("file_" + std::to_string(index++));
+    }
+}
+BENCHMARK(BM_CryDevice_CreateFile);
+
+void BM_CryDevice_LoadFile(benchmark::State &state) {
+    TempFilesystem fs;
+    fs.createAndOpenFile("file");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fs.device().LoadFile("/file"));
+    }
+}
+BENCHMARK(BM_CryDevice_LoadFile);
+
+// Argument: number of bytes per write call
+void BM_CryDevice_SequentialWrite(benchmark::State &state) {
+    TempFilesystem fs;
+    auto file = fs.createAndOpenFile("file");
+    const Data data = DataFixture::generate(state.range(0));
+    uint64_t offset = 0;
+    for (auto _ : state) {
+        file->write(data.data(), fspp::num_bytes_t(data.size()), fspp::num_bytes_t(offset));
+        offset = (offset + data.size()) % FILE_SIZE;
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CryDevice_SequentialWrite)->Arg(4 * 1024)->Arg(128 * 1024);
+
+// Argument: number of bytes per read call
+void BM_CryDevice_SequentialRead(benchmark::State &state) {
+    TempFilesystem fs;
+    auto file = fs.createAndOpenFile("file");
+    file->truncate(fspp::num_bytes_t(FILE_SIZE));
+    Data target(state.range(0));
+    uint64_t offset = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(file->read(target.data(), fspp::num_bytes_t(target.size()), fspp::num_bytes_t(offset)));
+        offset = (offset + target.size()) % FILE_SIZE;
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CryDevice_SequentialRead)->Arg(4 * 1024)->Arg(128 * 1024);
+
+}
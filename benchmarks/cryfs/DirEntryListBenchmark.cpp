@@ -0,0 +1,112 @@
+#include <benchmark/benchmark.h>
+#include <cryfs/impl/filesystem/fsblobstore/utils/DirEntryList.h>
+#include <cpp-utils/system/time.h>
+#include <string>
+#include <vector>
+
+using blockstore::BlockId;
+using cryfs::fsblobstore::DirEntryList;
+using cpputils::Data;
+
+namespace {
+
+constexpr fspp::mode_t MODE = fspp::mode_t().addFileFlag().addUserReadFlag().addUserWriteFlag();
+
+struct Entry final {
+    std::string name;
+    BlockId blockId;
+};
+
+std::vector<Entry> createEntries(size_t numEntries) {
+    std::vector<Entry> result;
+    result.reserve(numEntries);
+    for (size_t i = 0; i < numEntries; ++i) {
+        result.push_back(Entry{"entry_" + std::to_string(i), BlockId::Random()});
+    }
+    return result;
+}
+
+void addEntries(DirEntryList *list, const std::vector<Entry> &entries) {
+    const timespec now = cpputils::time::now();
+    for (const Entry &entry : entries) {
+        list->add(entry.name, entry.blockId, fspp::Dir::EntryType::FILE, MODE, fspp::uid_t(1000), fspp::gid_t(1000), now, now);
+    }
+}
+
+// Argument for all benchmarks: number of entries in the directory
+
+void BM_DirEntryList_Add(benchmark::State &state) {
+    const auto entries = createEntries(state.range(0));
+    for (auto _ : state) {
+        DirEntryList list;
+        addEntries(&list, entries);
+        benchmark::DoNotOptimize(list.size());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DirEntryList_Add)->Arg(10)->Arg(1000)->Arg(100000);
+
+void BM_DirEntryList_GetByName(benchmark::State &state) {
+    const auto entries = createEntries(state.range(0));
+    DirEntryList list;
+    addEntries(&list, entries);
+    size_t index = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(list.get(entries[index].name));
+        index = (index + 1) % entries.size();
+    }
+}
+BENCHMARK(BM_DirEntryList_GetByName)->Arg(10)->Arg(1000)->Arg(100000);
+
+void BM_DirEntryList_GetByBlockId(benchmark::State &state) {
+    const auto entries = createEntries(state.range(0));
+    DirEntryList list;
+    addEntries(&list, entries);
+    size_t index = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(list.get(entries[index].blockId));
+        index = (index + 1) % entries.size();
+    }
+}
+BENCHMARK(BM_DirEntryList_GetByBlockId)->Arg(10)->Arg(1000)->Arg(100000);
+
+void BM_DirEntryList_RemoveAndAdd(benchmark::State &state) {
+    const auto entries = createEntries(state.range(0));
+    DirEntryList list;
+    addEntries(&list, entries);
+    const timespec now = cpputils::time::now();
+    size_t index = 0;
+    for (auto _ : state) {
+        const Entry &entry = entries[index];
+        list.remove(entry.blockId);
+        list.add(entry.name, entry.blockId, fspp::Dir::EntryType::FILE, MODE, fspp::uid_t(1000), fspp::gid_t(1000), now, now);
+        index = (index + 1) % entries.size();
+    }
+}
+BENCHMARK(BM_DirEntryList_RemoveAndAdd)->Arg(10)->Arg(1000)->Arg(100000);
+
+void BM_DirEntryList_Serialize(benchmark::State &state) {
+    DirEntryList list;
+    addEntries(&list, createEntries(state.range(0)));
+    for (auto _ : state) {
+        Data serialized = list.serialize();
+        benchmark::DoNotOptimize(serialized.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DirEntryList_Serialize)->Arg(10)->Arg(1000)->Arg(100000);
+
+void BM_DirEntryList_Deserialize(benchmark::State &state) {
+    DirEntryList list;
+    addEntries(&list, createEntries(state.range(0)));
+    const Data serialized = list.serialize();
+    for (auto _ : state) {
+        DirEntryList deserialized;
+        deserialized.deserializeFrom(serialized.data(), serialized.size());
+        benchmark::DoNotOptimize(deserialized.size());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DirEntryList_Deserialize)->Arg(10)->Arg(1000)->Arg(100000);
+
+}
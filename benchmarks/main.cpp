@@ -0,0 +1,27 @@
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <vector>
+
+// Same as BENCHMARK_MAIN(), but results are printed as JSON unless a different format is requested,
+// so they can be stored and compared between releases.
+int main(int argc, char **argv) {
+    std::vector<char*> args(argv, argv + argc);
+    bool formatSpecified = false;
+    for (int i = 1; i < argc; ++i) {
+        if (0 == std::strncmp(argv[i], "--benchmark_format", std::strlen("--benchmark_format"))) {
+            formatSpecified = true;
+        }
+    }
+    char jsonFormat[] = "--benchmark_format=json";
+    if (!formatSpecified) {
+        args.push_back(jsonFormat);
+    }
+    int numArgs = static_cast<int>(args.size());
+
+    benchmark::Initialize(&numArgs, args.data());
+    if (benchmark::ReportUnrecognizedArguments(numArgs, args.data())) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
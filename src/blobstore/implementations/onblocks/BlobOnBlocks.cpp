@@ -40,6 +40,10 @@ void BlobOnBlocks::read(void *target, uint64_t offset, uint64_t count) const {
   return _datatree->readBytes(target, offset, count);
 }
 
+void BlobOnBlocks::prefetch(uint64_t offset, uint64_t count) const {
+  _datatree->prefetchBytes(offset, count);
+}
+
 uint64_t BlobOnBlocks::tryRead(void *target, uint64_t offset, uint64_t count) const {
   return _datatree->tryReadBytes(target, offset, count);
 }
@@ -30,6 +30,7 @@ public:
 
   cpputils::Data readAll() const override;
   void read(void *target, uint64_t offset, uint64_t size) const override;
+  void prefetch(uint64_t offset, uint64_t size) const override;
   uint64_t tryRead(void *target, uint64_t offset, uint64_t size) const override;
   void write(const void *source, uint64_t offset, uint64_t size) override;
 
@@ -23,7 +23,8 @@ namespace onblocks {
 namespace datanodestore {
 
 DataNodeStore::DataNodeStore(unique_ref<BlockStore> blockstore, uint64_t physicalBlocksizeBytes)
-: _blockstore(std::move(blockstore)), _layout(_blockstore->blockSizeFromPhysicalBlockSize(physicalBlocksizeBytes)) {
+: _blockstore(std::move(blockstore)), _layout(_blockstore->blockSizeFromPhysicalBlockSize(physicalBlocksizeBytes)),
+  _loadThreadPool(cpputils::ThreadPool::defaultNumThreads(), "nodeLoader") {
 }
 
 DataNodeStore::~DataNodeStore() {
@@ -64,6 +65,30 @@ optional<unique_ref<DataNode>> DataNodeStore::load(const BlockId &blockId) {
   }
 }
 
+vector<optional<unique_ref<DataNode>>> DataNodeStore::loadMany(const vector<BlockId> &blockIds) {
+  // Loading a node means reading, integrity checking and decrypting it, so loading them in parallel
+  // makes better use of multiple cores and of the I/O queue depth.
+  vector<std::future<optional<unique_ref<DataNode>>>> futures;
+  futures.reserve(blockIds.size());
+  for (size_t i = 1; i < blockIds.size(); ++i) {
+    const BlockId blockId = blockIds[i];
+    futures.push_back(_loadThreadPool.run([this, blockId] {
+      return load(blockId);
+    }));
+  }
+
+  vector<optional<unique_ref<DataNode>>> result;
+  result.reserve(blockIds.size());
+  if (!blockIds.empty()) {
+    // Load the first node in the calling thread while the others are loaded in the thread pool
+    result.push_back(load(blockIds[0]));
+  }
+  for (auto &future : futures) {
+    result.push_back(future.get());
+  }
+  return result;
+}
+
 unique_ref<DataNode> DataNodeStore::createNewNodeAsCopyFrom(const DataNode &source) {
   ASSERT(source.node().layout().blocksizeBytes() == _layout.blocksizeBytes(), "Source node has wrong layout. Is it from the same DataNodeStore?");
   auto newBlock = blockstore::utils::copyToNewBlock(_blockstore.get(), source.node().block());
@@ -98,9 +123,7 @@ void DataNodeStore::removeSubtree(unique_ref<DataNode> node) {
 
   auto inner = dynamic_pointer_move<DataInnerNode>(node);
   ASSERT(inner != none, "Is neither a leaf nor an inner node");
-  for (uint32_t i = 0; i < (*inner)->numChildren(); ++i) {
-    removeSubtree((*inner)->depth()-1, (*inner)->readChild(i).blockId());
-  }
+  _removeChildren(**inner);
   remove(std::move(*inner));
 }
 
@@ -114,13 +137,27 @@ void DataNodeStore::removeSubtree(uint8_t depth, const BlockId &blockId) {
     auto inner = dynamic_pointer_move<DataInnerNode>(*node);
     ASSERT(inner != none, "Is not an inner node, but depth was not zero");
     ASSERT((*inner)->depth() == depth, "Wrong depth given");
-    for (uint32_t i = 0; i < (*inner)->numChildren(); ++i) {
-      removeSubtree(depth-1, (*inner)->readChild(i).blockId());
-    }
+    _removeChildren(**inner);
     remove(std::move(*inner));
   }
 }
 
+void DataNodeStore::_removeChildren(const DataInnerNode &node) {
+  if (node.depth() == 1) {
+    // The children are leaves, i.e. we don't have to load them. Remove them in one batch, so the block store can remove them in parallel.
+    vector<BlockId> leaves;
+    leaves.reserve(node.numChildren());
+    for (uint32_t i = 0; i < node.numChildren(); ++i) {
+      leaves.push_back(node.readChild(i).blockId());
+    }
+    _blockstore->removeMany(leaves);
+  } else {
+    for (uint32_t i = 0; i < node.numChildren(); ++i) {
+      removeSubtree(node.depth()-1, node.readChild(i).blockId());
+    }
+  }
+}
+
 uint64_t DataNodeStore::numNodes() const {
   return _blockstore->numBlocks();
 }
@@ -4,6 +4,7 @@
 
 #include <memory>
 #include <cpp-utils/macros.h>
+#include <cpp-utils/thread/ThreadPool.h>
 #include "DataNodeView.h"
 #include <blockstore/utils/BlockId.h>
 
@@ -30,6 +31,8 @@ public:
 
   boost::optional<cpputils::unique_ref<DataNode>> load(const blockstore::BlockId &blockId);
   static cpputils::unique_ref<DataNode> load(cpputils::unique_ref<blockstore::Block> block);
+  // Loads the given nodes in parallel. The result has the same order as the given block ids.
+  std::vector<boost::optional<cpputils::unique_ref<DataNode>>> loadMany(const std::vector<blockstore::BlockId> &blockIds);
 
   cpputils::unique_ref<DataLeafNode> createNewLeafNode(cpputils::Data data);
   cpputils::unique_ref<DataInnerNode> createNewInnerNode(uint8_t depth, const std::vector<blockstore::BlockId> &children);
@@ -54,9 +57,11 @@ public:
   void forEachNode(std::function<void (const blockstore::BlockId& nodeId)> callback) const;
 
 private:
+  void _removeChildren(const DataInnerNode &node);
 
   cpputils::unique_ref<blockstore::BlockStore> _blockstore;
   const DataNodeLayout _layout;
+  cpputils::ThreadPool _loadThreadPool;
 
   DISALLOW_COPY_AND_ASSIGN(DataNodeStore);
 };
@@ -10,6 +10,7 @@
 #include <cpp-utils/pointer/cast.h>
 #include <cpp-utils/pointer/optional_ownership_ptr.h>
 #include <cmath>
+#include <limits>
 #include <cpp-utils/assert/assert.h>
 #include "impl/LeafTraverser.h"
 #include <boost/thread.hpp>
@@ -40,7 +41,7 @@ namespace onblocks {
 namespace datatreestore {
 
 DataTree::DataTree(DataNodeStore *nodeStore, unique_ref<DataNode> rootNode)
-  : _treeStructureMutex(), _nodeStore(nodeStore), _rootNode(std::move(rootNode)), _blockId(_rootNode->blockId()), _sizeCache() {
+  : _treeStructureMutex(), _leafRangeLocks(), _nodeStore(nodeStore), _rootNode(std::move(rootNode)), _blockId(_rootNode->blockId()), _sizeCache() {
 }
 
 DataTree::~DataTree() {
@@ -54,6 +55,8 @@ void DataTree::flush() const {
   // By grabbing a lock, we ensure that all modifying functions don't run currently and are therefore flushed.
   // It's only a shared lock, because this doesn't modify the tree structure.
   shared_lock<shared_mutex> lock(_treeStructureMutex);
+  // Writes that don't change the structure only hold the shared lock, wait for them to finish as well.
+  auto leafLock = _leafRangeLocks.lockShared(0, std::numeric_limits<uint32_t>::max());
   // We also have to flush the root node
   _rootNode->flush();
 }
@@ -267,6 +270,27 @@ Data DataTree::readAllBytes() const {
   return result;
 }
 
+void DataTree::prefetchBytes(uint64_t offset, uint64_t count) const {
+  shared_lock<shared_mutex> lock(_treeStructureMutex);
+
+  const uint64_t _size = _numBytes();
+  if (offset >= _size || count == 0) {
+    return;
+  }
+  count = std::min(count, _size - offset);
+  auto leafLock = _leafRangeLocks.lockShared(_firstLeafIndex(offset), _endLeafIndex(offset, count));
+
+  // The traversal already loads sibling leaves in parallel. Leaves it didn't load yet are loaded by node().
+  auto onExistingLeaf = [] (uint64_t /*indexOfFirstLeafByte*/, LeafHandle leaf, uint32_t /*leafDataOffset*/, uint32_t /*leafDataSize*/) {
+    leaf.node();
+  };
+  auto onCreateLeaf = [] (uint64_t /*beginByte*/, uint32_t /*count*/) -> Data {
+    ASSERT(false, "Prefetching shouldn't create new leaves.");
+  };
+
+  _traverseLeavesByByteIndices(offset, count, true, onExistingLeaf, onCreateLeaf);
+}
+
 uint64_t DataTree::tryReadBytes(void *target, uint64_t offset, uint64_t count) const {
   shared_lock<shared_mutex> lock(_treeStructureMutex);
   auto result = _tryReadBytes(target, offset, count);
@@ -281,7 +305,18 @@ uint64_t DataTree::_tryReadBytes(void *target, uint64_t offset, uint64_t count)
   return realCount;
 }
 
+uint32_t DataTree::_firstLeafIndex(uint64_t offset) const {
+  return offset / maxBytesPerLeaf();
+}
+
+uint32_t DataTree::_endLeafIndex(uint64_t offset, uint64_t count) const {
+  return utils::ceilDivision(offset + count, maxBytesPerLeaf());
+}
+
 void DataTree::_doReadBytes(void *target, uint64_t offset, uint64_t count) const {
+  // Other threads might be writing to other leaves, see writeBytes()
+  auto leafLock = _leafRangeLocks.lockShared(_firstLeafIndex(offset), _endLeafIndex(offset, count));
+
   auto onExistingLeaf = [target, offset, count] (uint64_t indexOfFirstLeafByte, LeafHandle leaf, uint32_t leafDataOffset, uint32_t leafDataSize) {
     ASSERT(indexOfFirstLeafByte+leafDataOffset>=offset && indexOfFirstLeafByte-offset+leafDataOffset <= count && indexOfFirstLeafByte-offset+leafDataOffset+leafDataSize <= count, "Writing to target out of bounds");
     //TODO Simplify formula, make it easier to understand
@@ -295,8 +330,26 @@ void DataTree::_doReadBytes(void *target, uint64_t offset, uint64_t count) const
 }
 
 void DataTree::writeBytes(const void *source, uint64_t offset, uint64_t count) {
+  {
+    shared_lock<shared_mutex> lock(_treeStructureMutex);
+    // Only use the size if it's known already. Computing it would load the right border of the tree.
+    const optional<SizeCache> size = _sizeCache.getIfCached();
+    if (size != none && offset + count <= size->numBytes) {
+      // Overwriting existing data doesn't change the tree structure. We only need to lock the leaves we write to,
+      // and writes to other leaves of this tree (e.g. concurrent pwrite() calls to a large file) can run in parallel.
+      auto leafLock = _leafRangeLocks.lockExclusive(_firstLeafIndex(offset), _endLeafIndex(offset, count));
+      _doWriteBytes(source, offset, count);
+      return;
+    }
+  }
+
+  // The write grows the tree. Nobody else can access the tree while we have this lock, so we don't need leaf locks.
+  // The tree might have grown since we checked above, but a write that doesn't need to grow it works under this lock as well.
   unique_lock<shared_mutex> lock(_treeStructureMutex);
+  _doWriteBytes(source, offset, count);
+}
 
+void DataTree::_doWriteBytes(const void *source, uint64_t offset, uint64_t count) {
   auto onExistingLeaf = [source, offset, count] (uint64_t indexOfFirstLeafByte, LeafHandle leaf, uint32_t leafDataOffset, uint32_t leafDataSize) {
     ASSERT(indexOfFirstLeafByte+leafDataOffset>=offset && indexOfFirstLeafByte-offset+leafDataOffset <= count && indexOfFirstLeafByte-offset+leafDataOffset+leafDataSize <= count, "Reading from source out of bounds");
     if (leafDataOffset == 0 && leafDataSize == leaf.nodeStore()->layout().maxBytesPerLeaf()) {
@@ -317,6 +370,8 @@ void DataTree::writeBytes(const void *source, uint64_t offset, uint64_t count) {
     return result;
   };
 
+  // Not a read-only traversal, even if the tree doesn't grow, because read-only traversals prefetch leaves that we'd only overwrite.
+  // If the write doesn't grow the tree, the traversal doesn't change any inner node and can run in parallel to other traversals.
   _traverseLeavesByByteIndices(offset, count, false, onExistingLeaf, onCreateLeaf);
 }
 
@@ -11,6 +11,7 @@
 #include <blockstore/utils/BlockId.h>
 #include "LeafHandle.h"
 #include "impl/CachedValue.h"
+#include "impl/LeafRangeLocks.h"
 
 namespace blobstore {
 namespace onblocks {
@@ -35,6 +36,9 @@ public:
   uint64_t tryReadBytes(void *target, uint64_t offset, uint64_t count) const;
   void readBytes(void *target, uint64_t offset, uint64_t count) const;
   cpputils::Data readAllBytes() const;
+  // Loads the leaves of the given byte range (as far as it exists) without copying their data anywhere,
+  // so that they're in the block cache when they're read.
+  void prefetchBytes(uint64_t offset, uint64_t count) const;
 
   void writeBytes(const void *source, uint64_t offset, uint64_t count);
 
@@ -54,8 +58,10 @@ public:
 private:
   // This mutex must protect the tree structure, i.e. which nodes exist and how they're connected.
   // Also protects total number of bytes (i.e. number of leaves + size of last leaf).
-  // It also protects the data in leaf nodes, because writing bytes might grow the blob and change the structure.
+  // Operations that change the structure (i.e. growing or shrinking the tree) hold it exclusively. All others hold it shared
+  // and protect the data in the leaves they access with _leafRangeLocks.
   mutable boost::shared_mutex _treeStructureMutex;
+  mutable LeafRangeLocks _leafRangeLocks;
 
   datanodestore::DataNodeStore *_nodeStore;
   cpputils::unique_ref<datanodestore::DataNode> _rootNode;
@@ -83,6 +89,9 @@ private:
 
   uint64_t _tryReadBytes(void *target, uint64_t offset, uint64_t count) const;
   void _doReadBytes(void *target, uint64_t offset, uint64_t count) const;
+  void _doWriteBytes(const void *source, uint64_t offset, uint64_t count);
+  uint32_t _firstLeafIndex(uint64_t offset) const;
+  uint32_t _endLeafIndex(uint64_t offset, uint64_t count) const;
   uint64_t _numBytes() const;
 
   DISALLOW_COPY_AND_ASSIGN(DataTree);
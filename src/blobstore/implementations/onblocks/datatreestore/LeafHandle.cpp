@@ -4,6 +4,7 @@
 
 using cpputils::WithOwnership;
 using cpputils::WithoutOwnership;
+using cpputils::unique_ref;
 using boost::none;
 using cpputils::dynamic_pointer_move;
 using blobstore::onblocks::datanodestore::DataLeafNode;
@@ -23,6 +24,11 @@ namespace blobstore {
                       _leaf(WithoutOwnership<DataLeafNode>(node)) {
             }
 
+            LeafHandle::LeafHandle(DataNodeStore *nodeStore, unique_ref<DataLeafNode> node)
+                    : _nodeStore(nodeStore), _blockId(node->blockId()),
+                      _leaf(WithOwnership(std::move(node))) {
+            }
+
             DataLeafNode *LeafHandle::node() {
                 if (_leaf.get() == nullptr) {
                     auto loaded = _nodeStore->load(_blockId);
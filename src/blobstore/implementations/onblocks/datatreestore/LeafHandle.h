@@ -18,6 +18,7 @@ namespace blobstore {
             public:
                 LeafHandle(datanodestore::DataNodeStore *nodeStore, const blockstore::BlockId &blockId);
                 LeafHandle(datanodestore::DataNodeStore *nodeStore, datanodestore::DataLeafNode *node);
+                LeafHandle(datanodestore::DataNodeStore *nodeStore, cpputils::unique_ref<datanodestore::DataLeafNode> node);
                 LeafHandle(LeafHandle &&rhs) = default;
 
                 const blockstore::BlockId &blockId() {
@@ -24,6 +24,11 @@ public:
     return *_cache;
   }
 
+  boost::optional<T> getIfCached() {
+    boost::shared_lock<boost::shared_mutex> readLock(_mutex);
+    return _cache;
+  }
+
   void update(std::function<void (boost::optional<T>*)> func) {
     boost::unique_lock<boost::shared_mutex> writeLock(_mutex);
     func(&_cache);
@@ -0,0 +1,67 @@
+#include "LeafRangeLocks.h"
+#include <cpp-utils/assert/assert.h>
+#include <algorithm>
+
+namespace blobstore {
+namespace onblocks {
+namespace datatreestore {
+
+LeafRangeLocks::Lock::Lock(LeafRangeLocks *locks, std::list<Range>::iterator range)
+: _locks(locks), _range(range) {
+}
+
+LeafRangeLocks::Lock::Lock(Lock &&rhs) noexcept
+: _locks(rhs._locks), _range(rhs._range) {
+  rhs._locks = nullptr;
+}
+
+LeafRangeLocks::Lock::~Lock() {
+  if (_locks != nullptr) {
+    _locks->_unlock(_range);
+  }
+}
+
+LeafRangeLocks::LeafRangeLocks()
+: _mutex(), _unlocked(), _lockedRanges() {
+}
+
+LeafRangeLocks::Lock LeafRangeLocks::lockShared(uint32_t begin, uint32_t end) {
+  return _lock(Range{begin, end, false});
+}
+
+LeafRangeLocks::Lock LeafRangeLocks::lockExclusive(uint32_t begin, uint32_t end) {
+  return _lock(Range{begin, end, true});
+}
+
+LeafRangeLocks::Lock LeafRangeLocks::_lock(Range range) {
+  ASSERT(range.begin <= range.end, "Invalid range");
+  std::unique_lock<std::mutex> lock(_mutex);
+  _unlocked.wait(lock, [this, &range] {
+    return !_conflictsWithLockedRange(range);
+  });
+  _lockedRanges.push_front(range);
+  return Lock(this, _lockedRanges.begin());
+}
+
+void LeafRangeLocks::_unlock(std::list<Range>::iterator range) {
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _lockedRanges.erase(range);
+  }
+  _unlocked.notify_all();
+}
+
+bool LeafRangeLocks::_conflictsWithLockedRange(const Range &range) const {
+  if (range.begin == range.end) {
+    // Empty ranges don't access any leaves
+    return false;
+  }
+  return std::any_of(_lockedRanges.begin(), _lockedRanges.end(), [&range] (const Range &locked) {
+    const bool overlaps = locked.begin < range.end && range.begin < locked.end;
+    return overlaps && (locked.exclusive || range.exclusive);
+  });
+}
+
+}
+}
+}
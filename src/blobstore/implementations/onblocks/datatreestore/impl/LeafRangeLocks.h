@@ -0,0 +1,66 @@
+#pragma once
+#ifndef MESSMER_BLOBSTORE_IMPLEMENTATIONS_ONBLOCKS_IMPL_LEAFRANGELOCKS_H_
+#define MESSMER_BLOBSTORE_IMPLEMENTATIONS_ONBLOCKS_IMPL_LEAFRANGELOCKS_H_
+
+#include <cpp-utils/macros.h>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <mutex>
+
+namespace blobstore {
+namespace onblocks {
+namespace datatreestore {
+
+// Locks ranges of leaves of a tree. Reads lock the leaves they read shared, and writes that don't change the tree
+// structure lock the leaves they write exclusively, so accesses to different leaves of the same tree run in parallel.
+// Changes of the tree structure don't need these, they hold the tree structure lock exclusively.
+class LeafRangeLocks final {
+private:
+  struct Range final {
+    uint32_t begin;
+    uint32_t end;
+    bool exclusive;
+  };
+
+public:
+  // Releases the range when destructed
+  class Lock final {
+  public:
+    Lock(Lock &&rhs) noexcept;
+    ~Lock();
+
+  private:
+    Lock(LeafRangeLocks *locks, std::list<Range>::iterator range);
+    friend class LeafRangeLocks;
+
+    LeafRangeLocks *_locks;
+    std::list<Range>::iterator _range;
+
+    DISALLOW_COPY_AND_ASSIGN(Lock);
+  };
+
+  LeafRangeLocks();
+
+  // Lock leaves [begin, end). Blocks until no other lock on an overlapping range conflicts.
+  Lock lockShared(uint32_t begin, uint32_t end);
+  Lock lockExclusive(uint32_t begin, uint32_t end);
+
+private:
+  Lock _lock(Range range);
+  void _unlock(std::list<Range>::iterator range);
+  bool _conflictsWithLockedRange(const Range &range) const;
+
+  std::mutex _mutex;
+  std::condition_variable _unlocked;
+  // There are only as many locked ranges as there are threads accessing the tree, so a list is fast enough.
+  std::list<Range> _lockedRanges;
+
+  DISALLOW_COPY_AND_ASSIGN(LeafRangeLocks);
+};
+
+}
+}
+}
+
+#endif
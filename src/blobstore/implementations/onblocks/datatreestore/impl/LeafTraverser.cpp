@@ -20,6 +20,8 @@ namespace blobstore {
     namespace onblocks {
         namespace datatreestore {
 
+            constexpr uint32_t LeafTraverser::MAX_PREFETCHED_LEAVES;
+
             LeafTraverser::LeafTraverser(DataNodeStore *nodeStore, bool readOnlyTraversal)
                 : _nodeStore(nodeStore), _readOnlyTraversal(readOnlyTraversal) {
             }
@@ -114,8 +116,6 @@ namespace blobstore {
             void LeafTraverser::_traverseExistingSubtree(DataInnerNode *root, uint32_t beginIndex, uint32_t endIndex, uint32_t leafOffset, bool isLeftBorderOfTraversal, bool isRightBorderNode, bool growLastLeaf, function<void (uint32_t index, bool isRightBorderLeaf, LeafHandle leaf)> onExistingLeaf, function<Data (uint32_t index)> onCreateLeaf, function<void (DataInnerNode *node)> onBacktrackFromSubtree) {
                 ASSERT(beginIndex <= endIndex, "Invalid parameters");
 
-                //TODO Call callbacks for different leaves in parallel.
-
                 uint32_t leavesPerChild = _maxLeavesForTreeDepth(root->depth()-1);
                 uint32_t beginChild = beginIndex/leavesPerChild;
                 uint32_t endChild = utils::ceilDivision(endIndex, leavesPerChild);
@@ -138,14 +138,30 @@ namespace blobstore {
                 }
 
                 // Traverse existing children
-                for (uint32_t childIndex = beginChild; childIndex < std::min(endChild, numChildren); ++childIndex) {
-                    auto childBlockId = root->readChild(childIndex).blockId();
+                uint32_t endExistingChild = std::min(endChild, numChildren);
+                // Read-only traversals will load each leaf anyway, so we load them in parallel before calling the callbacks.
+                // Writing traversals don't do this, because they usually overwrite leaves without loading them.
+                bool prefetchLeaves = _readOnlyTraversal && root->depth() == 1 && endExistingChild > beginChild + 1;
+                vector<boost::optional<unique_ref<DataNode>>> prefetchedLeaves;
+                uint32_t firstPrefetchedChild = beginChild;
+                for (uint32_t childIndex = beginChild; childIndex < endExistingChild; ++childIndex) {
                     uint32_t childOffset = childIndex * leavesPerChild;
+                    bool isLastExistingChild = (childIndex == numChildren - 1);
+                    bool isLastChild = isLastExistingChild && (numChildren == endChild);
+                    if (prefetchLeaves) {
+                        if (childIndex - firstPrefetchedChild >= prefetchedLeaves.size()) {
+                            firstPrefetchedChild = childIndex;
+                            prefetchedLeaves = _prefetchChildren(root, childIndex, std::min(endExistingChild, childIndex + MAX_PREFETCHED_LEAVES));
+                        }
+                        auto leaf = _asLeaf(std::move(prefetchedLeaves[childIndex - firstPrefetchedChild]), root->readChild(childIndex).blockId());
+                        onExistingLeaf(leafOffset + childOffset, isRightBorderNode && isLastChild, LeafHandle(_nodeStore, std::move(leaf)));
+                        continue;
+                    }
+
+                    auto childBlockId = root->readChild(childIndex).blockId();
                     uint32_t localBeginIndex = utils::maxZeroSubtraction(beginIndex, childOffset);
                     uint32_t localEndIndex = std::min(leavesPerChild, endIndex - childOffset);
                     bool isFirstChild = (childIndex == beginChild);
-                    bool isLastExistingChild = (childIndex == numChildren - 1);
-                    bool isLastChild = isLastExistingChild && (numChildren == endChild);
                     ASSERT(localEndIndex <= leavesPerChild, "We don't want the child to add a tree level because it doesn't have enough space for the traversal.");
                     _traverseExistingSubtree(childBlockId, root->depth()-1, localBeginIndex, localEndIndex, leafOffset + childOffset, isLeftBorderOfTraversal && isFirstChild,
                                              isRightBorderNode && isLastChild, shouldGrowLastExistingLeaf && isLastExistingChild, onExistingLeaf, onCreateLeaf, onBacktrackFromSubtree);
@@ -169,6 +185,24 @@ namespace blobstore {
                 }
             }
 
+            vector<boost::optional<unique_ref<DataNode>>> LeafTraverser::_prefetchChildren(const DataInnerNode *node, uint32_t beginChild, uint32_t endChild) {
+                vector<blockstore::BlockId> childBlockIds;
+                childBlockIds.reserve(endChild - beginChild);
+                for (uint32_t childIndex = beginChild; childIndex < endChild; ++childIndex) {
+                    childBlockIds.push_back(node->readChild(childIndex).blockId());
+                }
+                return _nodeStore->loadMany(childBlockIds);
+            }
+
+            unique_ref<DataLeafNode> LeafTraverser::_asLeaf(boost::optional<unique_ref<DataNode>> node, const blockstore::BlockId &blockId) {
+                if (node == none) {
+                    throw std::runtime_error("Couldn't find child node " + blockId.ToString());
+                }
+                auto leaf = dynamic_pointer_move<DataLeafNode>(*node);
+                ASSERT(leaf != none, "Loaded leaf is not leaf node");
+                return std::move(*leaf);
+            }
+
             unique_ref<DataNode> LeafTraverser::_createNewSubtree(uint32_t beginIndex, uint32_t endIndex, uint32_t leafOffset, uint8_t depth, function<Data (uint32_t index)> onCreateLeaf, function<void (DataInnerNode *node)> onBacktrackFromSubtree) {
                 ASSERT(!_readOnlyTraversal, "Can't create a new subtree in a read-only traversal");
 
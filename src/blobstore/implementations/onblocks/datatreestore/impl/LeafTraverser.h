@@ -34,6 +34,9 @@ namespace blobstore {
                       std::function<void (datanodestore::DataInnerNode *node)> onBacktrackFromSubtree);
 
             private:
+                // Maximum number of leaves loaded in parallel by read-only traversals. Limits the memory used by prefetched leaves.
+                static constexpr uint32_t MAX_PREFETCHED_LEAVES = 64;
+
                 datanodestore::DataNodeStore *_nodeStore;
                 const bool _readOnlyTraversal;
 
@@ -50,6 +53,8 @@ namespace blobstore {
                                               std::function<void (uint32_t index, bool isRightBorderLeaf, LeafHandle leaf)> onExistingLeaf,
                                               std::function<cpputils::Data (uint32_t index)> onCreateLeaf,
                                               std::function<void (datanodestore::DataInnerNode *node)> onBacktrackFromSubtree);
+                std::vector<boost::optional<cpputils::unique_ref<datanodestore::DataNode>>> _prefetchChildren(const datanodestore::DataInnerNode *node, uint32_t beginChild, uint32_t endChild);
+                static cpputils::unique_ref<datanodestore::DataLeafNode> _asLeaf(boost::optional<cpputils::unique_ref<datanodestore::DataNode>> node, const blockstore::BlockId &blockId);
                 cpputils::unique_ref<datanodestore::DataInnerNode> _increaseTreeDepth(cpputils::unique_ref<datanodestore::DataNode> root);
                 cpputils::unique_ref<datanodestore::DataNode> _createNewSubtree(uint32_t beginIndex, uint32_t endIndex, uint32_t leafOffset, uint8_t depth,
                                                                                 std::function<cpputils::Data (uint32_t index)> onCreateLeaf,
@@ -46,6 +46,10 @@ public:
     return _baseTree->readAllBytes();
   }
 
+  void prefetchBytes(uint64_t offset, uint64_t count) const {
+    return _baseTree->prefetchBytes(offset, count);
+  }
+
   void writeBytes(const void *source, uint64_t offset, uint64_t count) {
     return _baseTree->writeBytes(source, offset, count);
   }
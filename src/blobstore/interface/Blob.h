@@ -22,6 +22,8 @@ public:
   virtual cpputils::Data readAll() const = 0;
   virtual void read(void *target, uint64_t offset, uint64_t size) const = 0;
   virtual uint64_t tryRead(void *target, uint64_t offset, uint64_t size) const = 0;
+  // Loads the given range (as far as it exists) so that reading it later is faster, e.g. for read-ahead
+  virtual void prefetch(uint64_t offset, uint64_t size) const = 0;
   virtual void write(const void *source, uint64_t offset, uint64_t size) = 0;
 
   virtual void flush() = 0;
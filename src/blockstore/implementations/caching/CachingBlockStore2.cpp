@@ -1,10 +1,16 @@
 #include "CachingBlockStore2.h"
+#include <algorithm>
+#include <exception>
 #include <memory>
 #include <cpp-utils/assert/assert.h>
 #include <cpp-utils/system/get_total_memory.h>
+#include <cpp-utils/logging/logging.h>
 
 using std::string;
 using std::mutex;
+using std::shared_ptr;
+using std::vector;
+using std::pair;
 using cpputils::Data;
 using cpputils::unique_ref;
 using cpputils::make_unique_ref;
@@ -12,40 +18,343 @@ using boost::optional;
 using boost::none;
 using std::unique_lock;
 using std::mutex;
+using namespace cpputils::logging;
 
 namespace blockstore {
 namespace caching {
 
-constexpr double CachingBlockStore2::MAX_LIFETIME_SEC;
+constexpr uint64_t CachingBlockStore2::DEFAULT_MAX_CACHE_SIZE_BYTES;
+constexpr double CachingBlockStore2::DEFAULT_MAX_DIRTY_AGE_SEC;
+constexpr uint64_t CachingBlockStore2::MAX_DIRTY_PERCENT;
+constexpr size_t CachingBlockStore2::MAX_PENDING_REMOVALS;
+constexpr double CachingBlockStore2::DEFAULT_MAX_DIRTY_LIFETIME_SEC;
 
 CachingBlockStore2::CachedBlock::CachedBlock(const CachingBlockStore2* blockStore, const BlockId &blockId, cpputils::Data data, bool isDirty)
-    : _blockStore(blockStore), _blockId(blockId), _data(std::move(data)), _dirty(isDirty) {
+    : _blockStore(blockStore), _blockId(blockId), _data(std::make_shared<Data>(std::move(data))), _dirty(isDirty) {
+  if (_dirty) {
+    _blockStore->_markDirty(_blockId, _data->size());
+  }
 }
 
 CachingBlockStore2::CachedBlock::~CachedBlock() {
   if (_dirty) {
-    _blockStore->_baseBlockStore->store(_blockId, _data);
+    _blockStore->_baseBlockStore->store(_blockId, *_data);
   }
-  // remove it from the list of blocks not in the base store, if it's on it
-  unique_lock<mutex> lock(_blockStore->_cachedBlocksNotInBaseStoreMutex);
-  _blockStore->_cachedBlocksNotInBaseStore.erase(_blockId);
+  // remove it from the lists of blocks not in the base store and of dirty blocks, if it's on them
+  _blockStore->_markWrittenBack(_blockId);
 }
 
 const Data& CachingBlockStore2::CachedBlock::read() const {
+  return *_data;
+}
+
+shared_ptr<const Data> CachingBlockStore2::CachedBlock::sharedData() const {
   return _data;
 }
 
+bool CachingBlockStore2::CachedBlock::isDirty() const {
+  return _dirty;
+}
+
 void CachingBlockStore2::CachedBlock::markNotDirty() && {
   _dirty = false; // Prevent writing it back into the base store
+  _blockStore->_markNotDirty(_blockId);
+}
+
+void CachingBlockStore2::CachedBlock::markWrittenBack() {
+  if (_dirty) {
+    _dirty = false;
+    _blockStore->_markWrittenBack(_blockId);
+  }
+}
+
+const BlockId &CachingBlockStore2::CachedBlock::blockId() const {
+  return _blockId;
 }
 
 void CachingBlockStore2::CachedBlock::write(Data data) {
-  _data = std::move(data);
+  _data = std::make_shared<Data>(std::move(data));
   _dirty = true;
+  _blockStore->_markDirty(_blockId, _data->size());
+}
+
+CachingBlockStore2::CachingBlockStore2(cpputils::unique_ref<BlockStore2> baseBlockStore, uint64_t maxCacheSizeBytes, double maxDirtyAgeSec)
+: _baseBlockStore(std::move(baseBlockStore)), _maxDirtyAgeSec(maxDirtyAgeSec), _maxDirtyBytes(maxCacheSizeBytes / 100 * MAX_DIRTY_PERCENT),
+  _blockStateMutex(), _cachedBlocksNotInBaseStore(), _cachedBlocksMaybeNotInBaseStore(), _dirtyBlocks(), _dirtyBlocksByAge(), _dirtyBytes(0),
+  _pendingRemovals(), _oldestPendingRemoval(), _blocksBeingRemoved(), _removalFinished(),
+  _cache(maxCacheSizeBytes, [] (const unique_ref<CachedBlock> &block) -> uint64_t {
+    return block->read().size();
+  }, [this] (std::vector<unique_ref<CachedBlock>> evicted) {
+    _writeBackEvictedBlocks(std::move(evicted));
+  }), _writeBackTimer(nullptr) {
+  ASSERT(_maxDirtyAgeSec > 0, "Max dirty age must be positive");
+  //Don't initialize the timer in the initializer list, because it then might already call _writeBackOldDirtyBlocks()
+  //before CachingBlockStore2 is done constructing.
+  _writeBackTimer = std::make_unique<PeriodicTask>([this] {
+    _writeBackOldDirtyBlocks();
+  }, _maxDirtyAgeSec / 2, "writeback_blockstore");
+}
+
+CachingBlockStore2::~CachingBlockStore2() {
+  _writeBackTimer.reset();
+  flush();
+  const CacheStatistics statistics = _cache.statistics();
+  LOG(DEBUG, "Block cache statistics: {} hits, {} misses, {} evictions", statistics.hits, statistics.misses, statistics.evictions);
 }
 
-CachingBlockStore2::CachingBlockStore2(cpputils::unique_ref<BlockStore2> baseBlockStore)
-: _baseBlockStore(std::move(baseBlockStore)), _cachedBlocksNotInBaseStoreMutex(), _cachedBlocksNotInBaseStore(), _cache("blockstore") {
+void CachingBlockStore2::_writeBackEvictedBlocks(std::vector<unique_ref<CachedBlock>> evicted) {
+  // Write back all dirty blocks with one call, so the base store can encrypt and write them in parallel.
+  // The blocks stay dirty until the base store has them, so a failed write doesn't make them look written back.
+  vector<pair<BlockId, Data>> dirtyBlocks;
+  dirtyBlocks.reserve(evicted.size());
+  for (const auto &block : evicted) {
+    if (block->isDirty()) {
+      dirtyBlocks.emplace_back(block->blockId(), block->read().copy());
+    }
+  }
+  if (!dirtyBlocks.empty()) {
+    try {
+      _baseBlockStore->storeMany(std::move(dirtyBlocks));
+    } catch (const std::exception &e) {
+      LOG(ERR, "Writing back evicted blocks failed, retrying them one by one: {}", e.what());
+      _writeBackEvictedBlocksOneByOne(&evicted);
+      return;
+    }
+  }
+  // This also removes them from _cachedBlocksNotInBaseStore, so it has to happen after they were written to the base store.
+  for (auto &block : evicted) {
+    block->markWrittenBack();
+  }
+  evicted.clear();
+}
+
+void CachingBlockStore2::_writeBackEvictedBlocksOneByOne(std::vector<unique_ref<CachedBlock>> *evicted) {
+  // The evicted blocks aren't in the cache anymore and can't be put back, so a block that can't be written
+  // here is lost. Blocks must not stay dirty though, because their destructor would try to write them again.
+  std::exception_ptr error = nullptr;
+  for (auto &block : *evicted) {
+    if (!block->isDirty()) {
+      continue;
+    }
+    try {
+      _baseBlockStore->store(block->blockId(), block->read());
+      block->markWrittenBack();
+    } catch (const std::exception &e) {
+      LOG(ERR, "Writing back evicted block {} failed, its changes are lost: {}", block->blockId().ToString(), e.what());
+      std::move(*block).markNotDirty();
+      if (error == nullptr) {
+        error = std::current_exception();
+      }
+    }
+  }
+  evicted->clear();
+  if (error != nullptr) {
+    std::rethrow_exception(error);
+  }
+}
+
+void CachingBlockStore2::_writeBackBlocks(const vector<BlockId> &blockIds) {
+  _cache.updateEntries(blockIds, [this] (const vector<unique_ref<CachedBlock>*> &blocks) {
+    // The blocks stay in the cache, so their data has to be copied for the base store.
+    vector<pair<BlockId, Data>> dirtyBlocks;
+    dirtyBlocks.reserve(blocks.size());
+    for (const unique_ref<CachedBlock> *block : blocks) {
+      if ((*block)->isDirty()) {
+        dirtyBlocks.emplace_back((*block)->blockId(), (*block)->read().copy());
+      }
+    }
+    if (!dirtyBlocks.empty()) {
+      _baseBlockStore->storeMany(std::move(dirtyBlocks));
+    }
+    for (const unique_ref<CachedBlock> *block : blocks) {
+      (*block)->markWrittenBack();
+    }
+  });
+}
+
+void CachingBlockStore2::_writeBackOldDirtyBlocks() {
+  try {
+    vector<BlockId> oldDirtyBlocks;
+    {
+      unique_lock<mutex> lock(_blockStateMutex);
+      const auto now = Clock::now();
+      for (const BlockId &blockId : _dirtyBlocksByAge) {
+        if (std::chrono::duration<double>(now - _dirtyBlocks.at(blockId).dirtySince).count() <= _maxDirtyAgeSec) {
+          break;
+        }
+        oldDirtyBlocks.push_back(blockId);
+      }
+    }
+    _writeBackBlocks(oldDirtyBlocks);
+
+    unique_lock<mutex> lock(_blockStateMutex);
+    if (!_pendingRemovals.empty() && std::chrono::duration<double>(Clock::now() - _oldestPendingRemoval).count() > _maxDirtyAgeSec) {
+      _removePendingRemovalsFromBaseStore(&lock);
+    }
+  } catch (const std::exception &e) {
+    // Keep the timer running, the blocks are still dirty and will be written back later
+    LOG(ERR, "Writing back dirty blocks failed: {}", e.what());
+  }
+}
+
+void CachingBlockStore2::_writeBackIfTooManyDirtyBytes() {
+  vector<BlockId> toWriteBack;
+  {
+    unique_lock<mutex> lock(_blockStateMutex);
+    if (_dirtyBytes <= _maxDirtyBytes) {
+      return;
+    }
+    // Write back the oldest dirty blocks until only half of the allowed dirty bytes are left,
+    // so the base store gets a batch of blocks and not only one block for each write.
+    uint64_t remainingDirtyBytes = _dirtyBytes;
+    for (const BlockId &blockId : _dirtyBlocksByAge) {
+      if (remainingDirtyBytes <= _maxDirtyBytes / 2) {
+        break;
+      }
+      toWriteBack.push_back(blockId);
+      remainingDirtyBytes -= _dirtyBlocks.at(blockId).size;
+    }
+  }
+  _writeBackBlocks(toWriteBack);
+}
+
+void CachingBlockStore2::_findOutWhichBlocksAreNotInBaseStore() const {
+  vector<BlockId> blockIds;
+  {
+    unique_lock<mutex> lock(_blockStateMutex);
+    blockIds.assign(_cachedBlocksMaybeNotInBaseStore.begin(), _cachedBlocksMaybeNotInBaseStore.end());
+  }
+  // Each block is only looked up once. Afterwards, it's either known to be in the base store or in _cachedBlocksNotInBaseStore.
+  for (const BlockId &blockId : blockIds) {
+    const bool isInBaseStore = _baseBlockStore->load(blockId) != none;
+    unique_lock<mutex> lock(_blockStateMutex);
+    // If it isn't on the list anymore, it was written back or removed in the meantime
+    if (_cachedBlocksMaybeNotInBaseStore.erase(blockId) != 0 && !isInBaseStore) {
+      _cachedBlocksNotInBaseStore.insert(blockId);
+    }
+  }
+}
+
+void CachingBlockStore2::_removeCachedBlock(const BlockId &blockId, unique_lock<mutex> *lock) {
+  ASSERT(lock->owns_lock(), "The operations in this function require a locked mutex");
+  if (_cachedBlocksNotInBaseStore.count(blockId) != 0) {
+    // It never reached the base store and doesn't have to be removed from there.
+    return;
+  }
+  if (_cachedBlocksMaybeNotInBaseStore.count(blockId) != 0) {
+    // Pending removals have to exist in the base store, otherwise numBlocks() would subtract them although they aren't counted.
+    // Blocks stored without being cached are rarely removed before being written back, so just remove it from the base store now.
+    const uint64_t numRemoved = _removeFromBaseStore({blockId}, lock);
+    UNUSED(numRemoved);
+    return;
+  }
+  // It exists in the base store. Remove it from there later, together with other removed blocks.
+  _addPendingRemoval(blockId, lock);
+}
+
+void CachingBlockStore2::_addPendingRemoval(const BlockId &blockId, unique_lock<mutex> *lock) {
+  ASSERT(lock->owns_lock(), "The operations in this function require a locked mutex");
+  if (_pendingRemovals.empty()) {
+    _oldestPendingRemoval = Clock::now();
+  }
+  _pendingRemovals.insert(blockId);
+  if (_pendingRemovals.size() >= MAX_PENDING_REMOVALS) {
+    _removePendingRemovalsFromBaseStore(lock);
+  }
+}
+
+void CachingBlockStore2::_removePendingRemovalsFromBaseStore(unique_lock<mutex> *lock) {
+  ASSERT(lock->owns_lock(), "The operations in this function require a locked mutex");
+  if (_pendingRemovals.empty()) {
+    return;
+  }
+  const vector<BlockId> blockIds(_pendingRemovals.begin(), _pendingRemovals.end());
+  _pendingRemovals.clear();
+  try {
+    const uint64_t numRemoved = _removeFromBaseStore(blockIds, lock);
+    UNUSED(numRemoved);
+  } catch (...) {
+    // Nobody could recreate them in the meantime, so they're still removed and we can try again later
+    if (_pendingRemovals.empty()) {
+      _oldestPendingRemoval = Clock::now();
+    }
+    _pendingRemovals.insert(blockIds.begin(), blockIds.end());
+    throw;
+  }
+}
+
+uint64_t CachingBlockStore2::_removeFromBaseStore(const vector<BlockId> &blockIds, unique_lock<mutex> *lock) {
+  ASSERT(lock->owns_lock(), "The operations in this function require a locked mutex");
+  if (blockIds.empty()) {
+    return 0;
+  }
+  // Don't keep the mutex locked while waiting for the base store. Marking the blocks as being removed makes sure
+  // that they can't be loaded, recreated or counted before they're removed.
+  _blocksBeingRemoved.insert(blockIds.begin(), blockIds.end());
+  lock->unlock();
+  auto finishRemoving = [this, &blockIds, lock] {
+    lock->lock();
+    for (const BlockId &blockId : blockIds) {
+      _blocksBeingRemoved.erase(_blocksBeingRemoved.find(blockId));
+    }
+    _removalFinished.notify_all();
+  };
+  uint64_t numRemoved = 0;
+  try {
+    numRemoved = _baseBlockStore->removeMany(blockIds);
+  } catch (...) {
+    finishRemoving();
+    throw;
+  }
+  finishRemoving();
+  return numRemoved;
+}
+
+void CachingBlockStore2::_waitUntilNotBeingRemoved(const BlockId &blockId, unique_lock<mutex> *lock) const {
+  ASSERT(lock->owns_lock(), "The operations in this function require a locked mutex");
+  _removalFinished.wait(*lock, [this, &blockId] {
+    return _blocksBeingRemoved.count(blockId) == 0;
+  });
+}
+
+bool CachingBlockStore2::_isPendingOrBeingRemoved(const BlockId &blockId) const {
+  unique_lock<mutex> lock(_blockStateMutex);
+  return _pendingRemovals.count(blockId) != 0 || _blocksBeingRemoved.count(blockId) != 0;
+}
+
+void CachingBlockStore2::_markDirty(const BlockId &blockId, uint64_t size) const {
+  unique_lock<mutex> lock(_blockStateMutex);
+  auto inserted = _dirtyBlocks.emplace(blockId, DirtyBlock{Clock::now(), size, _dirtyBlocksByAge.end()});
+  if (inserted.second) {
+    inserted.first->second.agePosition = _dirtyBlocksByAge.insert(_dirtyBlocksByAge.end(), blockId);
+  } else {
+    // Overwriting an already dirty block doesn't make it younger, so it still gets written back in time
+    _dirtyBytes -= inserted.first->second.size;
+    inserted.first->second.size = size;
+  }
+  _dirtyBytes += size;
+}
+
+void CachingBlockStore2::_markNotDirty(const BlockId &blockId) const {
+  unique_lock<mutex> lock(_blockStateMutex);
+  auto found = _dirtyBlocks.find(blockId);
+  if (found != _dirtyBlocks.end()) {
+    _dirtyBytes -= found->second.size;
+    _dirtyBlocksByAge.erase(found->second.agePosition);
+    _dirtyBlocks.erase(found);
+  }
+}
+
+void CachingBlockStore2::_markWrittenBack(const BlockId &blockId) const {
+  unique_lock<mutex> lock(_blockStateMutex);
+  auto found = _dirtyBlocks.find(blockId);
+  if (found != _dirtyBlocks.end()) {
+    _dirtyBytes -= found->second.size;
+    _dirtyBlocksByAge.erase(found->second.agePosition);
+    _dirtyBlocks.erase(found);
+  }
+  _cachedBlocksNotInBaseStore.erase(blockId);
+  _cachedBlocksMaybeNotInBaseStore.erase(blockId);
 }
 
 bool CachingBlockStore2::tryCreate(const BlockId &blockId, const Data &data) {
@@ -55,57 +364,90 @@ bool CachingBlockStore2::tryCreate(const BlockId &blockId, const Data &data) {
     // entry already exists in cache
     _cache.push(blockId, std::move(*popped)); // push the just popped element back to the cache
     return false;
-  } else {
-    _cache.push(blockId, make_unique_ref<CachingBlockStore2::CachedBlock>(this, blockId, data.copy(), true));
-    unique_lock<mutex> lock(_cachedBlocksNotInBaseStoreMutex);
-    _cachedBlocksNotInBaseStore.insert(blockId);
-    return true;
   }
+  {
+    unique_lock<mutex> lock(_blockStateMutex);
+    _waitUntilNotBeingRemoved(blockId, &lock);
+    if (_pendingRemovals.erase(blockId) == 0) {
+      _cachedBlocksNotInBaseStore.insert(blockId);
+    }
+    // Otherwise, the block was removed, but it's still in the base store, so this is actually an overwrite.
+  }
+  _cache.push(blockId, make_unique_ref<CachingBlockStore2::CachedBlock>(this, blockId, data.copy(), true));
+  _writeBackIfTooManyDirtyBytes();
+  return true;
 }
 
 bool CachingBlockStore2::remove(const BlockId &blockId) {
-  // TODO Don't write-through but cache remove operations
-  auto popped = _cache.pop(blockId);
+  auto popped = _cache.remove(blockId);
   if (popped != boost::none) {
-    // Remove from base store if it exists in the base store
     {
-      unique_lock<mutex> lock(_cachedBlocksNotInBaseStoreMutex);
-      if (_cachedBlocksNotInBaseStore.count(blockId) == 0) {
-          const bool existedInBaseStore = _baseBlockStore->remove(blockId);
-          if (!existedInBaseStore) {
-              throw std::runtime_error("Tried to remove block. Block existed in cache and stated it exists in base store, but wasn't found there.");
-          }
-      }
+      unique_lock<mutex> lock(_blockStateMutex);
+      _removeCachedBlock(blockId, &lock);
     }
     // Don't write back the cached block when it is destructed
     std::move(**popped).markNotDirty();
     return true;
-  } else {
-    return _baseBlockStore->remove(blockId);
   }
+  unique_lock<mutex> lock(_blockStateMutex);
+  if (_pendingRemovals.count(blockId) != 0 || _blocksBeingRemoved.count(blockId) != 0) {
+    // It was already removed
+    return false;
+  }
+  return _removeFromBaseStore({blockId}, &lock) != 0;
 }
 
-optional<unique_ref<CachingBlockStore2::CachedBlock>> CachingBlockStore2::_loadFromCacheOrBaseStore(const BlockId &blockId) const {
-  auto popped = _cache.pop(blockId);
-  if (popped != boost::none) {
-    return std::move(*popped);
-  } else {
-    auto loaded = _baseBlockStore->load(blockId);
-    if (loaded == boost::none) {
-      return boost::none;
+uint64_t CachingBlockStore2::removeMany(const std::vector<BlockId> &blockIds) {
+  uint64_t numRemoved = 0;
+  std::vector<BlockId> notCached;
+  notCached.reserve(blockIds.size());
+  for (const BlockId &blockId : blockIds) {
+    auto popped = _cache.remove(blockId);
+    if (popped == boost::none) {
+      notCached.push_back(blockId);
+      continue;
+    }
+    {
+      unique_lock<mutex> lock(_blockStateMutex);
+      _removeCachedBlock(blockId, &lock);
     }
-    return make_unique_ref<CachingBlockStore2::CachedBlock>(this, blockId, std::move(*loaded), false);
+    ++numRemoved;
+    // Don't write back the cached block when it is destructed
+    std::move(**popped).markNotDirty();
   }
+  // Remove the uncached blocks from the base store in one batch, so it can remove them in parallel.
+  unique_lock<mutex> lock(_blockStateMutex);
+  notCached.erase(std::remove_if(notCached.begin(), notCached.end(), [this] (const BlockId &blockId) {
+    return _pendingRemovals.count(blockId) != 0 || _blocksBeingRemoved.count(blockId) != 0;
+  }), notCached.end());
+  return numRemoved + _removeFromBaseStore(notCached, &lock);
 }
 
 optional<Data> CachingBlockStore2::load(const BlockId &blockId) const {
-  auto loaded = _loadFromCacheOrBaseStore(blockId);
+  auto loaded = loadShared(blockId);
+  if (loaded == boost::none) {
+    return boost::none;
+  }
+  return (*loaded)->copy();
+}
+
+optional<shared_ptr<const Data>> CachingBlockStore2::loadShared(const BlockId &blockId) const {
+  // Cache hits only take a reference to the cached data, they don't copy it or take the block out of the cache
+  shared_ptr<const Data> cached = nullptr;
+  if (_cache.read(blockId, [&cached] (const unique_ref<CachedBlock> &block) {cached = block->sharedData();})) {
+    return cached;
+  }
+  if (_isPendingOrBeingRemoved(blockId)) {
+    return boost::none;
+  }
+  auto loaded = _baseBlockStore->load(blockId);
   if (loaded == boost::none) {
     // TODO Cache non-existence?
     return boost::none;
   }
-  optional<Data> result = (*loaded)->read().copy();
-  _cache.push(blockId, std::move(*loaded));
+  auto block = make_unique_ref<CachingBlockStore2::CachedBlock>(this, blockId, std::move(*loaded), false);
+  shared_ptr<const Data> result = block->sharedData();
+  _cache.push(blockId, std::move(block));
   return result;
 }
 
@@ -114,21 +456,31 @@ void CachingBlockStore2::store(const BlockId &blockId, const Data &data) {
   if (popped != boost::none) {
     (*popped)->write(data.copy());
   } else {
-    popped = make_unique_ref<CachingBlockStore2::CachedBlock>(this, blockId, data.copy(), false);
-    // TODO Instead of storing it to the base store, we could just keep it dirty in the cache
-    //      and (if it doesn't exist in base store yet) add it to _cachedBlocksNotInBaseStore
-    _baseBlockStore->store(blockId, data);
+    {
+      // If the block was removed, it's still in the base store. Otherwise, we don't know whether it exists there.
+      unique_lock<mutex> lock(_blockStateMutex);
+      _waitUntilNotBeingRemoved(blockId, &lock);
+      if (_pendingRemovals.erase(blockId) == 0) {
+        _cachedBlocksMaybeNotInBaseStore.insert(blockId);
+      }
+    }
+    popped = make_unique_ref<CachingBlockStore2::CachedBlock>(this, blockId, data.copy(), true);
   }
   _cache.push(blockId, std::move(*popped));
+  _writeBackIfTooManyDirtyBytes();
 }
 
 uint64_t CachingBlockStore2::numBlocks() const {
-  uint64_t numInCacheButNotInBaseStore = 0;
-  {
-    unique_lock<mutex> lock(_cachedBlocksNotInBaseStoreMutex);
-    numInCacheButNotInBaseStore = _cachedBlocksNotInBaseStore.size();
-  }
-  return _baseBlockStore->numBlocks() + numInCacheButNotInBaseStore;
+  // statfs calls this, so it must not write anything back. Pending removals all exist in the base store,
+  // so once we know which of the blocks stored without being cached are new, we can compute the number of blocks.
+  _findOutWhichBlocksAreNotInBaseStore();
+  // Keep the mutex locked while counting the base store, so pending removals can't be removed from it in between.
+  // Blocks that are being removed right now might or might not be counted by the base store, so wait for them.
+  unique_lock<mutex> lock(_blockStateMutex);
+  _removalFinished.wait(lock, [this] {
+    return _blocksBeingRemoved.empty();
+  });
+  return _baseBlockStore->numBlocks() + _cachedBlocksNotInBaseStore.size() - _pendingRemovals.size();
 }
 
 uint64_t CachingBlockStore2::estimateNumFreeBytes() const {
@@ -140,17 +492,48 @@ uint64_t CachingBlockStore2::blockSizeFromPhysicalBlockSize(uint64_t blockSize)
 }
 
 void CachingBlockStore2::forEachBlock(std::function<void (const BlockId &)> callback) const {
+  // Like numBlocks(), this doesn't write anything back. Blocks in the base store that were removed are skipped.
+  _findOutWhichBlocksAreNotInBaseStore();
+  vector<BlockId> notInBaseStore;
+  std::unordered_set<BlockId> pendingRemovals;
   {
-    unique_lock<mutex> lock(_cachedBlocksNotInBaseStoreMutex);
-    for (const BlockId &blockId : _cachedBlocksNotInBaseStore) {
+    unique_lock<mutex> lock(_blockStateMutex);
+    notInBaseStore.assign(_cachedBlocksNotInBaseStore.begin(), _cachedBlocksNotInBaseStore.end());
+    pendingRemovals = _pendingRemovals;
+    pendingRemovals.insert(_blocksBeingRemoved.begin(), _blocksBeingRemoved.end());
+  }
+  for (const BlockId &blockId : notInBaseStore) {
+    callback(blockId);
+  }
+  _baseBlockStore->forEachBlock([&callback, &pendingRemovals] (const BlockId &blockId) {
+    if (pendingRemovals.count(blockId) == 0) {
       callback(blockId);
     }
+  });
+}
+
+void CachingBlockStore2::writeBack() {
+  vector<BlockId> dirtyBlocks;
+  {
+    unique_lock<mutex> lock(_blockStateMutex);
+    dirtyBlocks.reserve(_dirtyBlocks.size());
+    for (const auto &dirtyBlock : _dirtyBlocks) {
+      dirtyBlocks.push_back(dirtyBlock.first);
+    }
   }
-  _baseBlockStore->forEachBlock(std::move(callback));
+  _writeBackBlocks(dirtyBlocks);
+  unique_lock<mutex> lock(_blockStateMutex);
+  _removePendingRemovalsFromBaseStore(&lock);
 }
 
 void CachingBlockStore2::flush() {
-    _cache.flush();
+  _cache.flush();
+  unique_lock<mutex> lock(_blockStateMutex);
+  _removePendingRemovalsFromBaseStore(&lock);
+}
+
+CacheStatistics CachingBlockStore2::cacheStatistics() const {
+  return _cache.statistics();
 }
 
 }
@@ -4,28 +4,57 @@
 
 #include "../../interface/BlockStore2.h"
 #include <cpp-utils/macros.h>
-#include "../caching/cache/Cache.h"
+#include "../caching/cache/ShardedCache.h"
+#include "../caching/cache/PeriodicTask.h"
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace blockstore {
 namespace caching {
 
+/**
+ * Write-back cache for blocks. Created, stored and removed blocks are only written to (or removed from) the base store
+ * when they're evicted from the cache, when they've been dirty for longer than maxDirtyAgeSec, when dirty blocks take up
+ * more than MAX_DIRTY_PERCENT of the cache, or when writeBack() or flush() is called.
+ * Overwriting a dirty block again only writes the last version, and blocks removed before reaching the base store never get there.
+ * Blocks that were written back stay cached. Clean blocks are only evicted when the cache needs space for other blocks.
+ */
 class CachingBlockStore2 final: public BlockStore2 {
 public:
-  CachingBlockStore2(cpputils::unique_ref<BlockStore2> baseBlockStore);
+  static constexpr uint64_t DEFAULT_MAX_CACHE_SIZE_BYTES = 32 * 1024 * 1024;
+  static constexpr double DEFAULT_MAX_DIRTY_AGE_SEC = 5;
+  static constexpr uint64_t MAX_DIRTY_PERCENT = 50;
+  static constexpr size_t MAX_PENDING_REMOVALS = 1024;
+  // This is the oldest age a dirty block can reach with DEFAULT_MAX_DIRTY_AGE_SEC, because dirty blocks are checked every DEFAULT_MAX_DIRTY_AGE_SEC / 2
+  static constexpr double DEFAULT_MAX_DIRTY_LIFETIME_SEC = DEFAULT_MAX_DIRTY_AGE_SEC * 3 / 2;
+
+  CachingBlockStore2(cpputils::unique_ref<BlockStore2> baseBlockStore, uint64_t maxCacheSizeBytes = DEFAULT_MAX_CACHE_SIZE_BYTES, double maxDirtyAgeSec = DEFAULT_MAX_DIRTY_AGE_SEC);
+  ~CachingBlockStore2();
 
   bool tryCreate(const BlockId &blockId, const cpputils::Data &data) override;
   bool remove(const BlockId &blockId) override;
+  uint64_t removeMany(const std::vector<BlockId> &blockIds) override;
   boost::optional<cpputils::Data> load(const BlockId &blockId) const override;
+  boost::optional<std::shared_ptr<const cpputils::Data>> loadShared(const BlockId &blockId) const override;
   void store(const BlockId &blockId, const cpputils::Data &data) override;
   uint64_t numBlocks() const override;
   uint64_t estimateNumFreeBytes() const override;
   uint64_t blockSizeFromPhysicalBlockSize(uint64_t blockSize) const override;
   void forEachBlock(std::function<void (const BlockId &)> callback) const override;
 
+  // Writes all dirty blocks and pending removals to the base store, but keeps the blocks cached (e.g. for fsync)
+  void writeBack();
+  // Writes everything to the base store and empties the cache
   void flush();
 
+  CacheStatistics cacheStatistics() const;
+
 private:
+  using Clock = std::chrono::steady_clock;
+
   // TODO Is a cache implementation with onEvict callback instead of destructor simpler?
   class CachedBlock final {
   public:
@@ -33,31 +62,77 @@ private:
     ~CachedBlock();
 
     const cpputils::Data& read() const;
+    // The returned data stays valid and unchanged even if the block is written or evicted afterwards
+    std::shared_ptr<const cpputils::Data> sharedData() const;
     void write(cpputils::Data data);
+    bool isDirty() const;
     void markNotDirty() &&; // only on rvalue because the destructor should be called after calling markNotDirty(). It shouldn't be put back into the cache.
+    // Call this after the data returned by read() was written to the base store
+    void markWrittenBack();
+    const BlockId &blockId() const;
   private:
     const CachingBlockStore2* _blockStore;
     BlockId _blockId;
-    cpputils::Data _data;
+    // Never modified in place, write() replaces it. This way, readers can share it without copying.
+    std::shared_ptr<cpputils::Data> _data;
     bool _dirty;
 
     DISALLOW_COPY_AND_ASSIGN(CachedBlock);
   };
 
-  boost::optional<cpputils::unique_ref<CachedBlock>> _loadFromCacheOrBaseStore(const BlockId &blockId) const;
+  struct DirtyBlock final {
+    Clock::time_point dirtySince;
+    uint64_t size;
+    std::list<BlockId>::iterator agePosition;
+  };
+
+  void _writeBackEvictedBlocks(std::vector<cpputils::unique_ref<CachedBlock>> evicted);
+  // Fallback if writing back the evicted blocks together failed. Rethrows if some of them couldn't be written back.
+  void _writeBackEvictedBlocksOneByOne(std::vector<cpputils::unique_ref<CachedBlock>> *evicted);
+  // Writes those of the given blocks that are cached and dirty to the base store and keeps them cached
+  void _writeBackBlocks(const std::vector<BlockId> &blockIds);
+  void _writeBackOldDirtyBlocks();
+  void _writeBackIfTooManyDirtyBytes();
+  // Looks up whether the blocks in _cachedBlocksMaybeNotInBaseStore exist in the base store, without writing anything
+  void _findOutWhichBlocksAreNotInBaseStore() const;
+  // Updates the bookkeeping for a cached block that is being removed
+  void _removeCachedBlock(const BlockId &blockId, std::unique_lock<std::mutex> *lock);
+  void _addPendingRemoval(const BlockId &blockId, std::unique_lock<std::mutex> *lock);
+  void _removePendingRemovalsFromBaseStore(std::unique_lock<std::mutex> *lock);
+  // Unlocks the mutex while the base store removes the blocks and locks it again afterwards
+  uint64_t _removeFromBaseStore(const std::vector<BlockId> &blockIds, std::unique_lock<std::mutex> *lock);
+  void _waitUntilNotBeingRemoved(const BlockId &blockId, std::unique_lock<std::mutex> *lock) const;
+  bool _isPendingOrBeingRemoved(const BlockId &blockId) const;
+
+  // Called by CachedBlock
+  void _markDirty(const BlockId &blockId, uint64_t size) const;
+  void _markNotDirty(const BlockId &blockId) const;
+  void _markWrittenBack(const BlockId &blockId) const;
 
   cpputils::unique_ref<BlockStore2> _baseBlockStore;
+  const double _maxDirtyAgeSec;
+  const uint64_t _maxDirtyBytes;
   friend class CachedBlock;
 
-  // TODO Store CachedBlock directly, without unique_ref
-  mutable std::mutex _cachedBlocksNotInBaseStoreMutex;
+  // Protects the bookkeeping below. Never lock the cache while holding this.
+  mutable std::mutex _blockStateMutex;
   mutable std::unordered_set<BlockId> _cachedBlocksNotInBaseStore;
-  mutable Cache<BlockId, cpputils::unique_ref<CachedBlock>, 1000> _cache;
-
-public:
-  static constexpr double MAX_LIFETIME_SEC = decltype(_cache)::MAX_LIFETIME_SEC;
+  // Blocks stored without being cached. They might or might not exist in the base store yet.
+  mutable std::unordered_set<BlockId> _cachedBlocksMaybeNotInBaseStore;
+  mutable std::unordered_map<BlockId, DirtyBlock> _dirtyBlocks;
+  // Keys of _dirtyBlocks, ordered from the oldest to the youngest dirtySince
+  mutable std::list<BlockId> _dirtyBlocksByAge;
+  mutable uint64_t _dirtyBytes;
+  // Blocks that were removed, but not from the base store yet. They all exist in the base store.
+  std::unordered_set<BlockId> _pendingRemovals;
+  Clock::time_point _oldestPendingRemoval;
+  // Blocks that the base store is removing right now, without the mutex being locked. They can't be loaded or recreated until that's done.
+  std::unordered_multiset<BlockId> _blocksBeingRemoved;
+  mutable std::condition_variable _removalFinished;
 
-private:
+  // TODO Store CachedBlock directly, without unique_ref
+  mutable ShardedCache<BlockId, cpputils::unique_ref<CachedBlock>> _cache;
+  std::unique_ptr<PeriodicTask> _writeBackTimer;
 
   DISALLOW_COPY_AND_ASSIGN(CachingBlockStore2);
 };
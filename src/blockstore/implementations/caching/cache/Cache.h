@@ -6,10 +6,13 @@
 #include "QueueMap.h"
 #include "PeriodicTask.h"
 #include <memory>
+#include <vector>
 #include <boost/optional.hpp>
-#include <future>
+#include <algorithm>
+#include <thread>
 #include <cpp-utils/assert/assert.h>
 #include <cpp-utils/lock/MutexPoolLock.h>
+#include <cpp-utils/thread/ThreadPool.h>
 #include <cpp-utils/pointer/gcc_4_8_compatibility.h>
 
 namespace blockstore {
@@ -20,11 +23,17 @@ class Cache final {
 public:
   //TODO Current MAX_LIFETIME_SEC only considers time since the element was last pushed to the Cache. Also insert a real MAX_LIFETIME_SEC that forces resync of entries that have been pushed/popped often (e.g. the root blob)
   //TODO Experiment with good values
-  static constexpr double PURGE_LIFETIME_SEC = 0.5; //When an entry has this age, it will be purged from the cache
+  static constexpr double PURGE_LIFETIME_SEC = 0.5; //When a dirty entry has this age, it will be purged from the cache
+  static constexpr double CLEAN_PURGE_LIFETIME_SEC = 5; //When a clean entry has this age, it will be purged from the cache
   static constexpr double PURGE_INTERVAL = 0.5; // With this interval, we check for entries to purge
-  static constexpr double MAX_LIFETIME_SEC = PURGE_LIFETIME_SEC + PURGE_INTERVAL; // This is the oldest age an entry can reach (given purging works in an ideal world, i.e. with the ideal interval and in zero time)
+  static constexpr double MAX_LIFETIME_SEC = PURGE_LIFETIME_SEC + PURGE_INTERVAL; // This is the oldest age a dirty entry can reach (given purging works in an ideal world, i.e. with the ideal interval and in zero time)
+  static constexpr double MAX_CLEAN_LIFETIME_SEC = CLEAN_PURGE_LIFETIME_SEC + PURGE_INTERVAL; // This is the oldest age a clean entry can reach
 
-  Cache(const std::string& cacheName);
+  // Returns true if purging the value would write something back. Clean values don't have to be purged soon to get their
+  // changes written back, so they're kept for CLEAN_PURGE_LIFETIME_SEC instead. Without a DirtyChecker, all values are dirty.
+  using DirtyChecker = std::function<bool (const Value &value)>;
+
+  explicit Cache(const std::string& cacheName, DirtyChecker isDirty = nullptr);
   ~Cache();
 
   uint32_t size() const;
@@ -37,35 +46,43 @@ public:
 private:
   void _makeSpaceForEntry(std::unique_lock<std::mutex> *lock);
   void _deleteEntry(std::unique_lock<std::mutex> *lock);
-  void _deleteOldEntriesParallel();
-  void _deleteAllEntriesParallel();
-  void _deleteMatchingEntriesAtBeginningParallel(std::function<bool (const CacheEntry<Key, Value> &)> matches);
-  void _deleteMatchingEntriesAtBeginning(std::function<bool (const CacheEntry<Key, Value> &)> matches);
-  bool _deleteMatchingEntryAtBeginning(std::function<bool (const CacheEntry<Key, Value> &)> matches);
+  void _purgeOldEntries();
+  void _purgeAllEntries();
+  void _purgeMatchingEntries(const std::function<bool (const CacheEntry<Key, Value> &)> &matches);
+  bool _isOld(const CacheEntry<Key, Value> &entry) const;
 
   mutable std::mutex _mutex;
   cpputils::LockPool<Key> _currentlyFlushingEntries;
   QueueMap<Key, CacheEntry<Key, Value>> _cachedBlocks;
+  DirtyChecker _isDirty;
+  // Destructs purged entries in parallel. The threads are kept, so purging doesn't start new threads each time.
+  cpputils::ThreadPool _purgeThreadPool;
   std::unique_ptr<PeriodicTask> _timeoutFlusher;
 
   DISALLOW_COPY_AND_ASSIGN(Cache);
 };
 
 template<class Key, class Value, uint32_t MAX_ENTRIES> constexpr double Cache<Key, Value, MAX_ENTRIES>::PURGE_LIFETIME_SEC;
+template<class Key, class Value, uint32_t MAX_ENTRIES> constexpr double Cache<Key, Value, MAX_ENTRIES>::CLEAN_PURGE_LIFETIME_SEC;
 template<class Key, class Value, uint32_t MAX_ENTRIES> constexpr double Cache<Key, Value, MAX_ENTRIES>::PURGE_INTERVAL;
 template<class Key, class Value, uint32_t MAX_ENTRIES> constexpr double Cache<Key, Value, MAX_ENTRIES>::MAX_LIFETIME_SEC;
+template<class Key, class Value, uint32_t MAX_ENTRIES> constexpr double Cache<Key, Value, MAX_ENTRIES>::MAX_CLEAN_LIFETIME_SEC;
 
 template<class Key, class Value, uint32_t MAX_ENTRIES>
-Cache<Key, Value, MAX_ENTRIES>::Cache(const std::string& cacheName): _mutex(), _currentlyFlushingEntries(), _cachedBlocks(), _timeoutFlusher(nullptr) {
+Cache<Key, Value, MAX_ENTRIES>::Cache(const std::string& cacheName, DirtyChecker isDirty)
+  : _mutex(), _currentlyFlushingEntries(), _cachedBlocks(), _isDirty(std::move(isDirty)),
+    // Twice the number of cores, so we use full CPU even if half the threads are doing I/O
+    _purgeThreadPool(2 * (std::max)(1u, std::thread::hardware_concurrency()), "purge_" + cacheName), _timeoutFlusher(nullptr) {
   //Don't initialize timeoutFlusher in the initializer list,
   //because it then might already call Cache::popOldEntries() before Cache is done constructing.
-  _timeoutFlusher = std::make_unique<PeriodicTask>(std::bind(&Cache::_deleteOldEntriesParallel, this), PURGE_INTERVAL, "flush_" + cacheName);
+  _timeoutFlusher = std::make_unique<PeriodicTask>(std::bind(&Cache::_purgeOldEntries, this), PURGE_INTERVAL, "flush_" + cacheName);
 }
 
 template<class Key, class Value, uint32_t MAX_ENTRIES>
 Cache<Key, Value, MAX_ENTRIES>::~Cache() {
-  _deleteAllEntriesParallel();
-  ASSERT(_cachedBlocks.size() == 0, "Error in _deleteAllEntriesParallel()");
+  _timeoutFlusher.reset();
+  _purgeAllEntries();
+  ASSERT(_cachedBlocks.size() == 0, "Error in _purgeAllEntries()");
 }
 
 template<class Key, class Value, uint32_t MAX_ENTRIES>
@@ -116,52 +133,68 @@ void Cache<Key, Value, MAX_ENTRIES>::_deleteEntry(std::unique_lock<std::mutex> *
 };
 
 template<class Key, class Value, uint32_t MAX_ENTRIES>
-void Cache<Key, Value, MAX_ENTRIES>::_deleteAllEntriesParallel() {
-  return _deleteMatchingEntriesAtBeginningParallel([] (const CacheEntry<Key, Value> &) {
+void Cache<Key, Value, MAX_ENTRIES>::_purgeAllEntries() {
+  return _purgeMatchingEntries([] (const CacheEntry<Key, Value> &) {
       return true;
   });
 }
 
 template<class Key, class Value, uint32_t MAX_ENTRIES>
-void Cache<Key, Value, MAX_ENTRIES>::_deleteOldEntriesParallel() {
-  return _deleteMatchingEntriesAtBeginningParallel([] (const CacheEntry<Key, Value> &entry) {
-      return entry.ageSeconds() > PURGE_LIFETIME_SEC;
+void Cache<Key, Value, MAX_ENTRIES>::_purgeOldEntries() {
+  return _purgeMatchingEntries([this] (const CacheEntry<Key, Value> &entry) {
+      return _isOld(entry);
   });
 }
 
 template<class Key, class Value, uint32_t MAX_ENTRIES>
-void Cache<Key, Value, MAX_ENTRIES>::_deleteMatchingEntriesAtBeginningParallel(std::function<bool (const CacheEntry<Key, Value> &)> matches) {
-  // Twice the number of cores, so we use full CPU even if half the threads are doing I/O
-  unsigned int numThreads = 2 * (std::max)(1u, std::thread::hardware_concurrency());
-  std::vector<std::future<void>> waitHandles;
-  for (unsigned int i = 0; i < numThreads; ++i) {
-    waitHandles.push_back(std::async(std::launch::async, [this, matches] {
-        _deleteMatchingEntriesAtBeginning(matches);
-    }));
+bool Cache<Key, Value, MAX_ENTRIES>::_isOld(const CacheEntry<Key, Value> &entry) const {
+  const double ageSeconds = entry.ageSeconds();
+  if (ageSeconds <= PURGE_LIFETIME_SEC) {
+    return false;
   }
-  for (auto & waitHandle : waitHandles) {
-    waitHandle.wait();
+  if (ageSeconds > CLEAN_PURGE_LIFETIME_SEC) {
+    return true;
   }
-};
-
-template<class Key, class Value, uint32_t MAX_ENTRIES>
-void Cache<Key, Value, MAX_ENTRIES>::_deleteMatchingEntriesAtBeginning(std::function<bool (const CacheEntry<Key, Value> &)> matches) {
-  while (_deleteMatchingEntryAtBeginning(matches)) {}
+  return !_isDirty || _isDirty(entry.value());
 }
 
 template<class Key, class Value, uint32_t MAX_ENTRIES>
-bool Cache<Key, Value, MAX_ENTRIES>::_deleteMatchingEntryAtBeginning(std::function<bool (const CacheEntry<Key, Value> &)> matches) {
-  // This function can be called in parallel by multiple threads and will then cause the Value destructors
-  // to be called in parallel. The call to _deleteEntry() releases the lock while the Value destructor is running.
+void Cache<Key, Value, MAX_ENTRIES>::_purgeMatchingEntries(const std::function<bool (const CacheEntry<Key, Value> &)> &matches) {
   std::unique_lock<std::mutex> lock(_mutex);
-  if (_cachedBlocks.size() > 0 && matches(*_cachedBlocks.peek())) {
-    _deleteEntry(&lock);
-    ASSERT(lock.owns_lock(), "Something strange happened with the lock. It should be locked again when we come back.");
-    return true;
-  } else {
-    return false;
+  while (true) {
+    // Clean entries can stay longer than dirty ones, so matching entries aren't necessarily at the beginning of the queue.
+    // The cache only has a few entries, so it's fine to look at all of them.
+    std::vector<Key> keys;
+    _cachedBlocks.forEachFromOldest([&matches, &keys] (const Key &key, const CacheEntry<Key, Value> &entry) {
+      if (matches(entry)) {
+        keys.push_back(key);
+      }
+      return true;
+    });
+    if (keys.empty()) {
+      return;
+    }
+    std::vector<cpputils::MutexPoolLock<Key>> lockEntriesFromBeingPopped;
+    std::vector<boost::optional<Value>> toDestruct;
+    lockEntriesFromBeingPopped.reserve(keys.size());
+    toDestruct.reserve(keys.size());
+    for (const Key &key : keys) {
+      lockEntriesFromBeingPopped.emplace_back(&_currentlyFlushingEntries, key);
+      toDestruct.push_back(_cachedBlocks.pop(key)->releaseValue());
+    }
+    // Call the Value destructors outside of the unique_lock (see _deleteEntry)
+    lock.unlock();
+    _purgeThreadPool.runSlices(toDestruct.size(), [&toDestruct, &lockEntriesFromBeingPopped] (size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        toDestruct[i] = boost::none; // Call destructor
+        // Don't let a pop() of this entry wait for the destructors of other entries in the batch
+        lockEntriesFromBeingPopped[i].unlock();
+      }
+    });
+    lockEntriesFromBeingPopped.clear(); // unlock these first to keep same locking oder (preventing potential deadlock)
+    lock.lock();
   }
-};
+}
 
 template<class Key, class Value, uint32_t MAX_ENTRIES>
 uint32_t Cache<Key, Value, MAX_ENTRIES>::size() const {
@@ -172,7 +205,7 @@ uint32_t Cache<Key, Value, MAX_ENTRIES>::size() const {
 template<class Key, class Value, uint32_t MAX_ENTRIES>
 void Cache<Key, Value, MAX_ENTRIES>::flush() {
   //TODO Test flush()
-  return _deleteAllEntriesParallel();
+  return _purgeAllEntries();
 };
 
 }
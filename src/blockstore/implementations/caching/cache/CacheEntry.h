@@ -22,6 +22,10 @@ public:
     return static_cast<double>((currentTime() - _lastAccess).total_nanoseconds()) / static_cast<double>(1000000000);
   }
 
+  const Value &value() const {
+    return _value;
+  }
+
   Value releaseValue() {
     return std::move(_value);
   }
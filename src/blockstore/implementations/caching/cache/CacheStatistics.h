@@ -0,0 +1,26 @@
+#pragma once
+#ifndef MESSMER_BLOCKSTORE_IMPLEMENTATIONS_CACHING_CACHE_CACHESTATISTICS_H_
+#define MESSMER_BLOCKSTORE_IMPLEMENTATIONS_CACHING_CACHE_CACHESTATISTICS_H_
+
+#include <cstdint>
+
+namespace blockstore {
+namespace caching {
+
+struct CacheStatistics final {
+  uint64_t hits = 0; // pop() calls that found the entry
+  uint64_t misses = 0; // pop() calls that didn't find the entry
+  uint64_t evictions = 0; // entries the cache threw out because it was full, they were too old or it was flushed
+
+  CacheStatistics &operator+=(const CacheStatistics &rhs) {
+    hits += rhs.hits;
+    misses += rhs.misses;
+    evictions += rhs.evictions;
+    return *this;
+  }
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include "FrequencySketch.h"
+#include <algorithm>
+
+using std::pair;
+
+namespace blockstore {
+namespace caching {
+
+constexpr uint32_t FrequencySketch::MAX_FREQUENCY;
+constexpr unsigned int FrequencySketch::DEPTH;
+constexpr unsigned int FrequencySketch::COUNTERS_PER_WORD;
+constexpr uint64_t FrequencySketch::SAMPLE_SIZE_FACTOR;
+
+namespace {
+constexpr uint64_t MIN_TABLE_SIZE = 8;
+constexpr uint64_t SEEDS[] = {0xc3a5c85c97cb3127ull, 0xb492b66fbe98f273ull, 0x9ae16a3b2f90404full, 0xcbf29ce484222325ull};
+
+uint64_t nextPowerOfTwo(uint64_t value) {
+  uint64_t result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+// splitmix64 finalizer. Keys often come with weak hashes (e.g. std::hash<int> is the identity), so spread them first.
+uint64_t mix(uint64_t value) {
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+  return value ^ (value >> 31);
+}
+}
+
+FrequencySketch::FrequencySketch(uint64_t expectedNumEntries)
+  : _table(), _tableMask(0), _numIncrements(0) {
+  ensureCapacity(expectedNumEntries);
+}
+
+void FrequencySketch::ensureCapacity(uint64_t expectedNumEntries) {
+  const uint64_t tableSize = nextPowerOfTwo((std::max)(expectedNumEntries, MIN_TABLE_SIZE));
+  if (_table.empty()) {
+    _table.assign(MIN_TABLE_SIZE, 0);
+  }
+  // Doubling the table adds one bit to the index. Copying the table into the new half keeps every counter's value
+  // for both of its new positions, so we don't lose the frequencies recorded so far.
+  while (_table.size() < tableSize) {
+    const size_t oldSize = _table.size();
+    _table.resize(2 * oldSize);
+    std::copy(_table.begin(), _table.begin() + oldSize, _table.begin() + oldSize);
+  }
+  _tableMask = _table.size() - 1;
+}
+
+pair<uint64_t, unsigned int> FrequencySketch::_counterPosition(uint64_t keyHash, unsigned int row) const {
+  const uint64_t hash = mix(keyHash + SEEDS[row]);
+  const uint64_t index = (hash >> 4) & _tableMask;
+  const unsigned int offset = static_cast<unsigned int>(hash & (COUNTERS_PER_WORD - 1)) * 4;
+  return std::make_pair(index, offset);
+}
+
+void FrequencySketch::increment(uint64_t keyHash) {
+  bool incremented = false;
+  for (unsigned int row = 0; row < DEPTH; ++row) {
+    auto position = _counterPosition(keyHash, row);
+    uint64_t &word = _table[position.first];
+    if (((word >> position.second) & 0xf) < MAX_FREQUENCY) {
+      word += (1ull << position.second);
+      incremented = true;
+    }
+  }
+  if (incremented && ++_numIncrements >= SAMPLE_SIZE_FACTOR * _table.size()) {
+    _reset();
+  }
+}
+
+uint32_t FrequencySketch::frequency(uint64_t keyHash) const {
+  uint32_t result = MAX_FREQUENCY;
+  for (unsigned int row = 0; row < DEPTH; ++row) {
+    auto position = _counterPosition(keyHash, row);
+    result = (std::min)(result, static_cast<uint32_t>((_table[position.first] >> position.second) & 0xf));
+  }
+  return result;
+}
+
+void FrequencySketch::_reset() {
+  // Halve all counters. Shifting the whole word moves the lowest bit of each counter into the next counter, mask that out.
+  for (uint64_t &word : _table) {
+    word = (word >> 1) & 0x7777777777777777ull;
+  }
+  _numIncrements /= 2;
+}
+
+}
+}
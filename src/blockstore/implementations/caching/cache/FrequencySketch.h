@@ -0,0 +1,51 @@
+#pragma once
+#ifndef MESSMER_BLOCKSTORE_IMPLEMENTATIONS_CACHING_CACHE_FREQUENCYSKETCH_H_
+#define MESSMER_BLOCKSTORE_IMPLEMENTATIONS_CACHING_CACHE_FREQUENCYSKETCH_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <cpp-utils/macros.h>
+
+namespace blockstore {
+namespace caching {
+
+/**
+ * Count-min sketch with 4bit counters, estimating how often a key was accessed recently.
+ * This is the admission filter of TinyLFU: It only needs a few bits per cache entry,
+ * but still remembers the access frequency of keys that aren't in the cache anymore.
+ * To forget old accesses, all counters are halved once enough accesses were recorded.
+ */
+class FrequencySketch final {
+public:
+  static constexpr uint32_t MAX_FREQUENCY = 15;
+
+  explicit FrequencySketch(uint64_t expectedNumEntries);
+
+  // Grows the sketch if it was created for fewer entries. The recorded frequencies are kept.
+  void ensureCapacity(uint64_t expectedNumEntries);
+
+  void increment(uint64_t keyHash);
+  uint32_t frequency(uint64_t keyHash) const;
+
+private:
+  static constexpr unsigned int DEPTH = 4;
+  static constexpr unsigned int COUNTERS_PER_WORD = 16;
+  // After this many increments per expected entry, the counters are halved
+  static constexpr uint64_t SAMPLE_SIZE_FACTOR = 10;
+
+  std::vector<uint64_t> _table;
+  uint64_t _tableMask;
+  uint64_t _numIncrements;
+
+  void _reset();
+  // Returns the table index and the bit offset in that word of the counter for the given key in the given row
+  std::pair<uint64_t, unsigned int> _counterPosition(uint64_t keyHash, unsigned int row) const;
+
+  DISALLOW_COPY_AND_ASSIGN(FrequencySketch);
+};
+
+}
+}
+
+#endif
@@ -77,6 +77,16 @@ public:
     return _entries.size();
   }
 
+  // Calls callback(key, value) for the entries from the oldest to the newest one, until it returns false
+  template<class Callback>
+  void forEachFromOldest(Callback callback) {
+    for (Entry *entry = _sentinel.next; entry != &_sentinel; entry = entry->next) {
+      if (!callback(*entry->key, entry->value())) {
+        return;
+      }
+    }
+  }
+
 private:
   class Entry final {
   public:
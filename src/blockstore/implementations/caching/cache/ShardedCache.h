@@ -0,0 +1,200 @@
+#pragma once
+#ifndef MESSMER_BLOCKSTORE_IMPLEMENTATIONS_CACHING_CACHE_SHARDEDCACHE_H_
+#define MESSMER_BLOCKSTORE_IMPLEMENTATIONS_CACHING_CACHE_SHARDEDCACHE_H_
+
+#include "WTinyLfuCacheShard.h"
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <cpp-utils/macros.h>
+
+namespace blockstore {
+namespace caching {
+
+/**
+ * Cache limited by the total size of its values in bytes instead of the number of entries.
+ * Entries are distributed over several independently locked shards by the hash of their key,
+ * so threads working on different blocks don't contend on one mutex. Each shard uses W-TinyLFU
+ * (see WTinyLfuCacheShard) to decide which entries to evict.
+ *
+ * Like Cache, entries are taken out of the cache with pop() while they're used and put back with push().
+ * Unlike Cache, entries aren't purged after a fixed lifetime. They stay until they're evicted to make space or the cache is flushed,
+ * so frequently used entries don't have to be reloaded every second. Owners of dirty values are responsible for writing them
+ * back in time, e.g. with updateEntries(). Values can also be read in place with read(), which is cheaper when the caller
+ * doesn't need to own the value.
+ */
+template<class Key, class Value>
+class ShardedCache final {
+public:
+  using Shard = WTinyLfuCacheShard<Key, Value>;
+  using BatchEvictor = typename Shard::BatchEvictor;
+  using SizeGetter = typename Shard::SizeGetter;
+  using EntriesUpdater = typename Shard::EntriesUpdater;
+
+  // The window and the eviction slack of each shard (see WTinyLfuCacheShard) should be able to hold at least one entry of this size,
+  // otherwise new entries skip the window and the evictor gets them one by one. This is the size of a CryFS block with the largest
+  // default block size so far (CryFS <= 0.9.2 used 32 KiB blocks).
+  static constexpr uint64_t MAX_ENTRY_SIZE_BYTES = 32 * 1024;
+  // Don't split caches into shards that are too small for that. The default 32 MiB cache gets 8 shards of 4 MiB.
+  static constexpr uint64_t MIN_SHARD_SIZE_BYTES = (std::max)(MAX_ENTRY_SIZE_BYTES * 100 / Shard::WINDOW_PERCENT, MAX_ENTRY_SIZE_BYTES * Shard::EVICTION_SLACK_DIVISOR);
+
+  ShardedCache(uint64_t maxSizeBytes, SizeGetter sizeOf, BatchEvictor evictor);
+  ShardedCache(uint64_t maxSizeBytes, SizeGetter sizeOf, BatchEvictor evictor, uint32_t numShards);
+  ~ShardedCache();
+
+  void push(const Key &key, Value value);
+  boost::optional<Value> pop(const Key &key);
+  // Takes the value out of the cache for good, see WTinyLfuCacheShard::remove().
+  boost::optional<Value> remove(const Key &key);
+  // Calls reader with the cached value, see WTinyLfuCacheShard::read(). Returns false if the key isn't cached.
+  bool read(const Key &key, const std::function<void (const Value &value)> &reader);
+  // Calls updater with the cached values of the given keys, once per shard. See WTinyLfuCacheShard::updateEntries().
+  void updateEntries(const std::vector<Key> &keys, const EntriesUpdater &updater);
+
+  void flush();
+
+  uint64_t size() const;
+  uint64_t sizeBytes() const;
+  uint64_t maxSizeBytes() const;
+  uint32_t numShards() const;
+  CacheStatistics statistics() const;
+
+  // Twice the number of cores (rounded to a power of two), but less if the shards would get smaller than MIN_SHARD_SIZE_BYTES
+  static uint32_t defaultNumShards(uint64_t maxSizeBytes);
+
+private:
+  Shard &_shardFor(const Key &key) const;
+  void _evictMatchingEntries(const std::function<bool (double ageSeconds)> &matches);
+
+  const uint64_t _maxSizeBytes;
+  std::vector<std::unique_ptr<Shard>> _shards;
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedCache);
+};
+
+template<class Key, class Value> constexpr uint64_t ShardedCache<Key, Value>::MAX_ENTRY_SIZE_BYTES;
+template<class Key, class Value> constexpr uint64_t ShardedCache<Key, Value>::MIN_SHARD_SIZE_BYTES;
+
+template<class Key, class Value>
+ShardedCache<Key, Value>::ShardedCache(uint64_t maxSizeBytes, SizeGetter sizeOf, BatchEvictor evictor)
+  : ShardedCache(maxSizeBytes, std::move(sizeOf), std::move(evictor), defaultNumShards(maxSizeBytes)) {
+}
+
+template<class Key, class Value>
+ShardedCache<Key, Value>::ShardedCache(uint64_t maxSizeBytes, SizeGetter sizeOf, BatchEvictor evictor, uint32_t numShards)
+  : _maxSizeBytes(maxSizeBytes), _shards() {
+  ASSERT(numShards > 0, "Cache needs at least one shard");
+  _shards.reserve(numShards);
+  for (uint32_t i = 0; i < numShards; ++i) {
+    _shards.push_back(std::make_unique<Shard>(maxSizeBytes / numShards, sizeOf, evictor));
+  }
+}
+
+template<class Key, class Value>
+ShardedCache<Key, Value>::~ShardedCache() {
+  flush();
+}
+
+template<class Key, class Value>
+uint32_t ShardedCache<Key, Value>::defaultNumShards(uint64_t maxSizeBytes) {
+  const uint64_t maxNumShards = (std::max)(static_cast<uint64_t>(1), maxSizeBytes / MIN_SHARD_SIZE_BYTES);
+  const uint64_t wantedNumShards = 2 * static_cast<uint64_t>((std::max)(1u, std::thread::hardware_concurrency()));
+  uint32_t numShards = 1;
+  while (numShards < wantedNumShards && 2 * numShards <= maxNumShards) {
+    numShards *= 2;
+  }
+  return numShards;
+}
+
+template<class Key, class Value>
+typename ShardedCache<Key, Value>::Shard &ShardedCache<Key, Value>::_shardFor(const Key &key) const {
+  return *_shards[std::hash<Key>()(key) % _shards.size()];
+}
+
+template<class Key, class Value>
+void ShardedCache<Key, Value>::push(const Key &key, Value value) {
+  _shardFor(key).push(key, std::move(value));
+}
+
+template<class Key, class Value>
+boost::optional<Value> ShardedCache<Key, Value>::pop(const Key &key) {
+  return _shardFor(key).pop(key);
+}
+
+template<class Key, class Value>
+boost::optional<Value> ShardedCache<Key, Value>::remove(const Key &key) {
+  return _shardFor(key).remove(key);
+}
+
+template<class Key, class Value>
+bool ShardedCache<Key, Value>::read(const Key &key, const std::function<void (const Value &value)> &reader) {
+  return _shardFor(key).read(key, reader);
+}
+
+template<class Key, class Value>
+void ShardedCache<Key, Value>::updateEntries(const std::vector<Key> &keys, const EntriesUpdater &updater) {
+  std::vector<std::vector<Key>> keysPerShard(_shards.size());
+  for (const Key &key : keys) {
+    keysPerShard[std::hash<Key>()(key) % _shards.size()].push_back(key);
+  }
+  for (size_t i = 0; i < _shards.size(); ++i) {
+    if (!keysPerShard[i].empty()) {
+      _shards[i]->updateEntries(keysPerShard[i], updater);
+    }
+  }
+}
+
+template<class Key, class Value>
+void ShardedCache<Key, Value>::flush() {
+  _evictMatchingEntries([] (double) {return true;});
+}
+
+template<class Key, class Value>
+void ShardedCache<Key, Value>::_evictMatchingEntries(const std::function<bool (double ageSeconds)> &matches) {
+  // The evictor gets whole batches and can process them in parallel, so going through the shards one by one is enough.
+  for (const auto &shard : _shards) {
+    while (0 != shard->evictOldestEntries(matches)) {}
+  }
+}
+
+template<class Key, class Value>
+uint64_t ShardedCache<Key, Value>::size() const {
+  uint64_t result = 0;
+  for (const auto &shard : _shards) {
+    result += shard->size();
+  }
+  return result;
+}
+
+template<class Key, class Value>
+uint64_t ShardedCache<Key, Value>::sizeBytes() const {
+  uint64_t result = 0;
+  for (const auto &shard : _shards) {
+    result += shard->sizeBytes();
+  }
+  return result;
+}
+
+template<class Key, class Value>
+uint64_t ShardedCache<Key, Value>::maxSizeBytes() const {
+  return _maxSizeBytes;
+}
+
+template<class Key, class Value>
+uint32_t ShardedCache<Key, Value>::numShards() const {
+  return _shards.size();
+}
+
+template<class Key, class Value>
+CacheStatistics ShardedCache<Key, Value>::statistics() const {
+  CacheStatistics result;
+  for (const auto &shard : _shards) {
+    result += shard->statistics();
+  }
+  return result;
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,485 @@
+#pragma once
+#ifndef MESSMER_BLOCKSTORE_IMPLEMENTATIONS_CACHING_CACHE_WTINYLFUCACHESHARD_H_
+#define MESSMER_BLOCKSTORE_IMPLEMENTATIONS_CACHING_CACHE_WTINYLFUCACHESHARD_H_
+
+#include "CacheStatistics.h"
+#include "FrequencySketch.h"
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <boost/optional.hpp>
+#include <cpp-utils/assert/assert.h>
+#include <cpp-utils/lock/MutexPoolLock.h>
+
+namespace blockstore {
+namespace caching {
+
+/**
+ * One shard of a ShardedCache. It holds entries up to a byte budget and uses W-TinyLFU to decide which ones to keep:
+ * - New entries go into a small LRU window, so bursts of accesses to new keys don't get rejected right away.
+ * - Entries leaving the window are admitted into the main space only if they were accessed more often than the
+ *   entry that would have to be evicted for them (according to a FrequencySketch). This makes the cache scan resistant:
+ *   Reading a large file once doesn't throw out the blocks that are used all the time.
+ * - The main space is a segmented LRU. Entries accessed again while in the probation segment move to the protected segment.
+ *
+ * pop() takes the value out of the cache, but its node stays at the same position as a placeholder, so when the value
+ * is pushed back, the access counts as a hit in its segment. Placeholders don't count towards the byte budget and get
+ * dropped when they reach the end of their LRU list or get older than the entries being evicted by evictOldestEntries().
+ * remove() takes the value out of the cache without leaving a placeholder, for entries that won't be pushed again.
+ * read() gives access to a value without taking it out of the cache and counts as an access just like pop() and push().
+ * updateEntries() gives access to several values at once without the shard being locked, e.g. to write them back.
+ */
+template<class Key, class Value>
+class WTinyLfuCacheShard final {
+public:
+  using BatchEvictor = std::function<void (std::vector<Value> evicted)>;
+  using SizeGetter = std::function<uint64_t (const Value &value)>;
+  using EntriesUpdater = std::function<void (const std::vector<Value*> &values)>;
+
+  static constexpr uint32_t EVICTION_BATCH_SIZE = 64; // When evicting old entries, this many entries are handed to the evictor together
+  static constexpr uint64_t WINDOW_PERCENT = 1; // Size of the window in percent of the shard size
+  static constexpr uint64_t PROTECTED_PERCENT = 80; // Size of the protected segment in percent of the main space
+  // The window can grow by 1/EVICTION_SLACK_DIVISOR of the shard size before entries leave it. This way, the evictor gets
+  // several entries at once, e.g. when writing lots of new blocks.
+  static constexpr uint64_t EVICTION_SLACK_DIVISOR = 64;
+
+  // If evictor is nullptr, evicted values are just destructed.
+  WTinyLfuCacheShard(uint64_t maxSizeBytes, SizeGetter sizeOf, BatchEvictor evictor);
+  ~WTinyLfuCacheShard();
+
+  void push(const Key &key, Value value);
+  boost::optional<Value> pop(const Key &key);
+  // Like pop(), but also forgets the entry's position and doesn't count as an access. Use this for entries that are deleted.
+  boost::optional<Value> remove(const Key &key);
+  // Calls reader with the cached value while the shard is locked, so reader should be fast.
+  // Returns false (without calling reader) if the key isn't cached.
+  bool read(const Key &key, const std::function<void (const Value &value)> &reader);
+  // Calls updater with the values of those of the given keys that are in the cache and not popped.
+  // The values are taken out of the shard while updater runs, so other entries can be used in the meantime,
+  // but pop() and read() for these keys wait until updater is done. This doesn't count as an access.
+  // Keys that are currently being evicted or updated by another thread are skipped, but updateEntries() only
+  // returns once the other thread is done with them. This way, callers writing back entries (e.g. for fsync)
+  // know that all of them have reached the base store when it returns.
+  void updateEntries(const std::vector<Key> &keys, const EntriesUpdater &updater);
+
+  // Evicts up to EVICTION_BATCH_SIZE of the entries that were pushed the longest time ago, as long as matches(ageSeconds) is true.
+  // Returns the number of entries (and placeholders) removed, i.e. 0 once there is nothing matching left.
+  uint32_t evictOldestEntries(const std::function<bool (double ageSeconds)> &matches);
+
+  uint64_t size() const;
+  uint64_t sizeBytes() const;
+  CacheStatistics statistics() const;
+
+private:
+  enum Segment : uint8_t {WINDOW = 0, PROBATION = 1, PROTECTED = 2, NUM_SEGMENTS = 3};
+  using Clock = std::chrono::steady_clock;
+
+  struct Node final {
+    Segment segment;
+    typename std::list<Key>::iterator segmentPosition;
+    typename std::list<Key>::iterator agePosition;
+    Clock::time_point lastAccessed;
+    boost::optional<Value> value; // none while the entry is popped
+    uint64_t size;
+  };
+
+  class Eviction;
+
+  void _makeSpace(std::unique_lock<std::mutex> *lock);
+  void _moveToSegment(Node *node, Segment segment);
+  void _markAccessed(Node *node);
+  // Returns the least recently used node of the main space (or the window if the main space is empty), skipping notThisOne if given.
+  boost::optional<Key> _findVictim(const Key *notThisOne) const;
+  uint64_t _mainBytes() const;
+  uint64_t _totalBytes() const;
+  static uint64_t _hash(const Key &key);
+
+  const uint64_t _maxWindowBytes;
+  const uint64_t _evictionSlackBytes;
+  const uint64_t _maxMainBytes;
+  const uint64_t _maxProtectedBytes;
+  const SizeGetter _sizeOf;
+  const BatchEvictor _evictor;
+
+  mutable std::mutex _mutex;
+  cpputils::LockPool<Key> _currentlyEvictingEntries;
+  std::unordered_map<Key, Node> _nodes;
+  std::list<Key> _segments[NUM_SEGMENTS]; // Each ordered from least recently to most recently used
+  uint64_t _segmentBytes[NUM_SEGMENTS];
+  std::list<Key> _byAge; // Ordered by the time the entry was last pushed or read
+  uint64_t _numEntries;
+  FrequencySketch _sketch;
+  CacheStatistics _statistics;
+
+  DISALLOW_COPY_AND_ASSIGN(WTinyLfuCacheShard);
+};
+
+template<class Key, class Value> constexpr uint32_t WTinyLfuCacheShard<Key, Value>::EVICTION_BATCH_SIZE;
+template<class Key, class Value> constexpr uint64_t WTinyLfuCacheShard<Key, Value>::WINDOW_PERCENT;
+template<class Key, class Value> constexpr uint64_t WTinyLfuCacheShard<Key, Value>::PROTECTED_PERCENT;
+template<class Key, class Value> constexpr uint64_t WTinyLfuCacheShard<Key, Value>::EVICTION_SLACK_DIVISOR;
+
+// Collects the entries to evict while the shard is locked and hands them to the evictor after unlocking it.
+// Popping an entry that is currently being evicted blocks until the evictor is done with it.
+template<class Key, class Value>
+class WTinyLfuCacheShard<Key, Value>::Eviction final {
+public:
+  explicit Eviction(WTinyLfuCacheShard *shard): _shard(shard), _lockEntriesFromBeingPopped(), _evicted(), _numRemoved(0) {}
+
+  void remove(const Key &key) {
+    auto found = _shard->_nodes.find(key);
+    ASSERT(found != _shard->_nodes.end(), "Entry to evict not found");
+    Node &node = found->second;
+    _shard->_segments[node.segment].erase(node.segmentPosition);
+    _shard->_byAge.erase(node.agePosition);
+    if (node.value != boost::none) {
+      _shard->_segmentBytes[node.segment] -= node.size;
+      --_shard->_numEntries;
+      _lockEntriesFromBeingPopped.emplace_back(&_shard->_currentlyEvictingEntries, key);
+      _evicted.push_back(std::move(*node.value));
+    }
+    _shard->_nodes.erase(found);
+    ++_numRemoved;
+  }
+
+  uint32_t numEvicted() const {
+    return _evicted.size();
+  }
+
+  uint32_t numRemoved() const {
+    return _numRemoved;
+  }
+
+  void run(std::unique_lock<std::mutex> *lock) {
+    ASSERT(lock->owns_lock(), "The operations in this function require a locked mutex");
+    if (_evicted.empty()) {
+      return;
+    }
+    _shard->_statistics.evictions += _evicted.size();
+    // Call the evictor (or the destructors) outside of the lock, so other threads can use the shard in the meantime
+    lock->unlock();
+    if (_shard->_evictor) {
+      _shard->_evictor(std::move(_evicted));
+    }
+    _evicted.clear();
+    _lockEntriesFromBeingPopped.clear(); // unlock these first to keep same locking oder (preventing potential deadlock)
+    lock->lock();
+  }
+
+private:
+  WTinyLfuCacheShard *_shard;
+  std::vector<cpputils::MutexPoolLock<Key>> _lockEntriesFromBeingPopped;
+  std::vector<Value> _evicted;
+  uint32_t _numRemoved;
+
+  DISALLOW_COPY_AND_ASSIGN(Eviction);
+};
+
+template<class Key, class Value>
+WTinyLfuCacheShard<Key, Value>::WTinyLfuCacheShard(uint64_t maxSizeBytes, SizeGetter sizeOf, BatchEvictor evictor)
+  : _maxWindowBytes(maxSizeBytes * WINDOW_PERCENT / 100), _evictionSlackBytes(maxSizeBytes / EVICTION_SLACK_DIVISOR),
+    _maxMainBytes(maxSizeBytes - _maxWindowBytes - _evictionSlackBytes),
+    _maxProtectedBytes(_maxMainBytes * PROTECTED_PERCENT / 100),
+    _sizeOf(std::move(sizeOf)), _evictor(std::move(evictor)), _mutex(), _currentlyEvictingEntries(), _nodes(),
+    _segments(), _segmentBytes{0, 0, 0}, _byAge(), _numEntries(0), _sketch(0), _statistics() {
+}
+
+template<class Key, class Value>
+WTinyLfuCacheShard<Key, Value>::~WTinyLfuCacheShard() {
+  ASSERT(_numEntries == 0, "Cache shard wasn't flushed before destructing it");
+}
+
+template<class Key, class Value>
+boost::optional<Value> WTinyLfuCacheShard<Key, Value>::pop(const Key &key) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  cpputils::MutexPoolLock<Key> lockEntryFromBeingPopped(&_currentlyEvictingEntries, key, &lock);
+  _sketch.increment(_hash(key));
+
+  auto found = _nodes.find(key);
+  if (found == _nodes.end() || found->second.value == boost::none) {
+    ++_statistics.misses;
+    return boost::none;
+  }
+  ++_statistics.hits;
+  Node &node = found->second;
+  _segmentBytes[node.segment] -= node.size;
+  node.size = 0;
+  --_numEntries;
+  boost::optional<Value> result = std::move(node.value);
+  node.value = boost::none;
+  return result;
+}
+
+template<class Key, class Value>
+boost::optional<Value> WTinyLfuCacheShard<Key, Value>::remove(const Key &key) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  cpputils::MutexPoolLock<Key> lockEntryFromBeingPopped(&_currentlyEvictingEntries, key, &lock);
+
+  auto found = _nodes.find(key);
+  if (found == _nodes.end()) {
+    return boost::none;
+  }
+  Node &node = found->second;
+  _segments[node.segment].erase(node.segmentPosition);
+  _byAge.erase(node.agePosition);
+  boost::optional<Value> result = std::move(node.value);
+  if (result != boost::none) {
+    _segmentBytes[node.segment] -= node.size;
+    --_numEntries;
+  }
+  _nodes.erase(found);
+  return result;
+}
+
+template<class Key, class Value>
+bool WTinyLfuCacheShard<Key, Value>::read(const Key &key, const std::function<void (const Value &value)> &reader) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  // Wait until an entry currently being evicted is written back, like pop() does
+  cpputils::MutexPoolLock<Key> lockEntryFromBeingPopped(&_currentlyEvictingEntries, key, &lock);
+  _sketch.increment(_hash(key));
+
+  auto found = _nodes.find(key);
+  if (found == _nodes.end() || found->second.value == boost::none) {
+    ++_statistics.misses;
+    return false;
+  }
+  ++_statistics.hits;
+  Node &node = found->second;
+  _markAccessed(&node);
+  reader(*node.value);
+
+  // Promotions can overflow the protected segment
+  _makeSpace(&lock);
+  return true;
+}
+
+template<class Key, class Value>
+void WTinyLfuCacheShard<Key, Value>::updateEntries(const std::vector<Key> &keys, const EntriesUpdater &updater) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  std::vector<Key> takenKeys;
+  std::vector<Value> takenValues;
+  std::vector<cpputils::MutexPoolLock<Key>> lockEntriesFromBeingPopped;
+  takenKeys.reserve(keys.size());
+  takenValues.reserve(keys.size());
+  lockEntriesFromBeingPopped.reserve(keys.size());
+  std::vector<Key> skippedKeys;
+  for (const Key &key : keys) {
+    auto found = _nodes.find(key);
+    if (found == _nodes.end() || found->second.value == boost::none) {
+      skippedKeys.push_back(key);
+      continue;
+    }
+    // Entries with a value aren't locked by anyone (only popped or evicted entries are), so this doesn't block
+    lockEntriesFromBeingPopped.emplace_back(&_currentlyEvictingEntries, key);
+    Node &node = found->second;
+    _segmentBytes[node.segment] -= node.size;
+    node.size = 0;
+    --_numEntries;
+    takenKeys.push_back(key);
+    takenValues.push_back(std::move(*node.value));
+    node.value = boost::none;
+  }
+
+  std::exception_ptr error = nullptr;
+  if (!takenValues.empty()) {
+    lock.unlock();
+    std::vector<Value*> values;
+    values.reserve(takenValues.size());
+    for (Value &value : takenValues) {
+      values.push_back(&value);
+    }
+    try {
+      updater(values);
+    } catch (...) {
+      // Put the values back into the cache anyway, they must not get lost
+      error = std::current_exception();
+    }
+    lock.lock();
+  }
+
+  for (size_t i = 0; i < takenKeys.size(); ++i) {
+    const uint64_t size = _sizeOf(takenValues[i]);
+    auto found = _nodes.find(takenKeys[i]);
+    if (found == _nodes.end()) {
+      // The placeholder was dropped in the meantime
+      _segments[WINDOW].push_back(takenKeys[i]);
+      _byAge.push_back(takenKeys[i]);
+      found = _nodes.emplace(takenKeys[i], Node{WINDOW, std::prev(_segments[WINDOW].end()), std::prev(_byAge.end()), Clock::now(), boost::none, 0}).first;
+    }
+    Node &node = found->second;
+    node.value = std::move(takenValues[i]);
+    node.size = size;
+    _segmentBytes[node.segment] += size;
+    ++_numEntries;
+  }
+  lockEntriesFromBeingPopped.clear();
+  _makeSpace(&lock);
+
+  // Evictions and other updates keep their entries locked until they're done with them. Wait for them one by one,
+  // without holding any of the locks above, so two threads updating overlapping keys can't deadlock.
+  // Entries popped by users aren't locked. They're pushed back later and don't have to be waited for.
+  for (const Key &key : skippedKeys) {
+    cpputils::MutexPoolLock<Key> waitUntilOtherThreadIsDone(&_currentlyEvictingEntries, key, &lock);
+  }
+
+  if (error != nullptr) {
+    std::rethrow_exception(error);
+  }
+}
+
+template<class Key, class Value>
+void WTinyLfuCacheShard<Key, Value>::push(const Key &key, Value value) {
+  const uint64_t size = _sizeOf(value);
+  std::unique_lock<std::mutex> lock(_mutex);
+  auto found = _nodes.find(key);
+  if (found == _nodes.end()) {
+    _segments[WINDOW].push_back(key);
+    _byAge.push_back(key);
+    found = _nodes.emplace(key, Node{WINDOW, std::prev(_segments[WINDOW].end()), std::prev(_byAge.end()), Clock::now(), boost::none, 0}).first;
+    _sketch.ensureCapacity(_nodes.size());
+  } else {
+    Node &node = found->second;
+    ASSERT(node.value == boost::none, "Entry is already in the cache");
+    _markAccessed(&node);
+  }
+  Node &node = found->second;
+  node.value = std::move(value);
+  node.size = size;
+  _segmentBytes[node.segment] += size;
+  ++_numEntries;
+
+  _makeSpace(&lock);
+}
+
+template<class Key, class Value>
+void WTinyLfuCacheShard<Key, Value>::_moveToSegment(Node *node, Segment segment) {
+  _segmentBytes[node->segment] -= node->size;
+  _segments[segment].splice(_segments[segment].end(), _segments[node->segment], node->segmentPosition);
+  node->segment = segment;
+  _segmentBytes[segment] += node->size;
+}
+
+template<class Key, class Value>
+void WTinyLfuCacheShard<Key, Value>::_markAccessed(Node *node) {
+  // Entries accessed again in the main space are promoted to the protected segment.
+  _moveToSegment(node, (node->segment == WINDOW) ? WINDOW : PROTECTED);
+  _byAge.splice(_byAge.end(), _byAge, node->agePosition);
+  node->lastAccessed = Clock::now();
+}
+
+template<class Key, class Value>
+void WTinyLfuCacheShard<Key, Value>::_makeSpace(std::unique_lock<std::mutex> *lock) {
+  ASSERT(lock->owns_lock(), "The operations in this function require a locked mutex");
+  Eviction eviction(this);
+
+  // Entries leaving the window have to beat the main space's least recently used entry to be admitted.
+  // The window is only shrunk once it grew by the eviction slack, so the evictor gets all rejected entries at once.
+  if (_segmentBytes[WINDOW] > _maxWindowBytes + _evictionSlackBytes) {
+    while (_segmentBytes[WINDOW] > _maxWindowBytes) {
+      const Key candidate = _segments[WINDOW].front();
+      Node *candidateNode = &_nodes.at(candidate);
+      _moveToSegment(candidateNode, PROBATION);
+      if (candidateNode->value == boost::none) {
+        continue;
+      }
+      const uint32_t candidateFrequency = _sketch.frequency(_hash(candidate));
+      while (_mainBytes() > _maxMainBytes) {
+        boost::optional<Key> victim = _findVictim(&candidate);
+        if (victim != boost::none && _nodes.at(*victim).value == boost::none) {
+          // Placeholders don't take up space, dropping them doesn't need to beat the candidate.
+          eviction.remove(*victim);
+          continue;
+        }
+        if (victim == boost::none || candidateFrequency <= _sketch.frequency(_hash(*victim))) {
+          eviction.remove(candidate);
+          break;
+        }
+        eviction.remove(*victim);
+      }
+    }
+  }
+
+  // Entries pushed back into the main space can grow it
+  while (_mainBytes() > _maxMainBytes) {
+    eviction.remove(*_findVictim(nullptr));
+  }
+
+  // Promotions can overflow the protected segment. Demoting entries back to probation doesn't change the total size.
+  while (_segmentBytes[PROTECTED] > _maxProtectedBytes) {
+    _moveToSegment(&_nodes.at(_segments[PROTECTED].front()), PROBATION);
+  }
+
+  eviction.run(lock);
+}
+
+template<class Key, class Value>
+boost::optional<Key> WTinyLfuCacheShard<Key, Value>::_findVictim(const Key *notThisOne) const {
+  for (Segment segment : {PROBATION, PROTECTED, WINDOW}) {
+    for (const Key &key : _segments[segment]) {
+      if (notThisOne == nullptr || !(key == *notThisOne)) {
+        return key;
+      }
+    }
+  }
+  return boost::none;
+}
+
+template<class Key, class Value>
+uint32_t WTinyLfuCacheShard<Key, Value>::evictOldestEntries(const std::function<bool (double ageSeconds)> &matches) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  Eviction eviction(this);
+  const auto now = Clock::now();
+  while (!_byAge.empty() && eviction.numEvicted() < EVICTION_BATCH_SIZE) {
+    const Key oldest = _byAge.front();
+    const double ageSeconds = std::chrono::duration<double>(now - _nodes.at(oldest).lastAccessed).count();
+    if (!matches(ageSeconds)) {
+      break;
+    }
+    eviction.remove(oldest);
+  }
+  const uint32_t numRemoved = eviction.numRemoved();
+  eviction.run(&lock);
+  return numRemoved;
+}
+
+template<class Key, class Value>
+uint64_t WTinyLfuCacheShard<Key, Value>::_mainBytes() const {
+  return _segmentBytes[PROBATION] + _segmentBytes[PROTECTED];
+}
+
+template<class Key, class Value>
+uint64_t WTinyLfuCacheShard<Key, Value>::_totalBytes() const {
+  return _segmentBytes[WINDOW] + _mainBytes();
+}
+
+template<class Key, class Value>
+uint64_t WTinyLfuCacheShard<Key, Value>::_hash(const Key &key) {
+  return std::hash<Key>()(key);
+}
+
+template<class Key, class Value>
+uint64_t WTinyLfuCacheShard<Key, Value>::size() const {
+  std::unique_lock<std::mutex> lock(_mutex);
+  return _numEntries;
+}
+
+template<class Key, class Value>
+uint64_t WTinyLfuCacheShard<Key, Value>::sizeBytes() const {
+  std::unique_lock<std::mutex> lock(_mutex);
+  return _totalBytes();
+}
+
+template<class Key, class Value>
+CacheStatistics WTinyLfuCacheShard<Key, Value>::statistics() const {
+  std::unique_lock<std::mutex> lock(_mutex);
+  return _statistics;
+}
+
+}
+}
+
+#endif
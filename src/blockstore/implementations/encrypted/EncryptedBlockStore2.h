@@ -6,6 +6,7 @@
 #include <cpp-utils/macros.h>
 #include <cpp-utils/crypto/symmetric/Cipher.h>
 #include <cpp-utils/data/SerializationHelper.h>
+#include <cpp-utils/thread/ThreadPool.h>
 
 namespace blockstore {
 namespace encrypted {
@@ -21,8 +22,10 @@ public:
 
   bool tryCreate(const BlockId &blockId, const cpputils::Data &data) override;
   bool remove(const BlockId &blockId) override;
+  uint64_t removeMany(const std::vector<BlockId> &blockIds) override;
   boost::optional<cpputils::Data> load(const BlockId &blockId) const override;
   void store(const BlockId &blockId, const cpputils::Data &data) override;
+  void storeMany(std::vector<std::pair<BlockId, cpputils::Data>> blocks) override;
   uint64_t numBlocks() const override;
   uint64_t estimateNumFreeBytes() const override;
   uint64_t blockSizeFromPhysicalBlockSize(uint64_t blockSize) const override;
@@ -42,16 +45,17 @@ private:
   cpputils::Data _encrypt(const cpputils::Data &data) const;
   boost::optional<cpputils::Data> _tryDecrypt(const BlockId &blockId, const cpputils::Data &data) const;
 
-  static cpputils::Data _prependFormatHeaderToData(const cpputils::Data &data);
+  static void _prependFormatHeader(cpputils::Data *data);
 #ifndef CRYFS_NO_COMPATIBILITY
   static bool _blockIdHeaderIsCorrect(const BlockId &blockId, const cpputils::Data &data);
-  static cpputils::Data _migrateBlock(const cpputils::Data &data);
+  static cpputils::Data _migrateBlock(cpputils::Data data);
 #endif
   static void _checkFormatHeader(const cpputils::Data &data);
   static uint16_t _readFormatHeader(const cpputils::Data &data);
 
   cpputils::unique_ref<BlockStore2> _baseBlockStore;
   typename Cipher::EncryptionKey _encKey;
+  cpputils::ThreadPool _encryptionThreadPool;
 
   DISALLOW_COPY_AND_ASSIGN(EncryptedBlockStore2);
 };
@@ -66,7 +70,7 @@ constexpr uint16_t EncryptedBlockStore2<Cipher>::FORMAT_VERSION_HEADER;
 
 template<class Cipher>
 inline EncryptedBlockStore2<Cipher>::EncryptedBlockStore2(cpputils::unique_ref<BlockStore2> baseBlockStore, const typename Cipher::EncryptionKey &encKey)
-: _baseBlockStore(std::move(baseBlockStore)), _encKey(encKey) {
+: _baseBlockStore(std::move(baseBlockStore)), _encKey(encKey), _encryptionThreadPool(cpputils::ThreadPool::defaultNumThreads(), "encryptBlocks") {
 }
 
 template<class Cipher>
@@ -80,6 +84,11 @@ inline bool EncryptedBlockStore2<Cipher>::remove(const BlockId &blockId) {
   return _baseBlockStore->remove(blockId);
 }
 
+template<class Cipher>
+inline uint64_t EncryptedBlockStore2<Cipher>::removeMany(const std::vector<BlockId> &blockIds) {
+  return _baseBlockStore->removeMany(blockIds);
+}
+
 template<class Cipher>
 inline boost::optional<cpputils::Data> EncryptedBlockStore2<Cipher>::load(const BlockId &blockId) const {
   auto loaded = _baseBlockStore->load(blockId);
@@ -96,6 +105,21 @@ inline void EncryptedBlockStore2<Cipher>::store(const BlockId &blockId, const cp
   return _baseBlockStore->store(blockId, encrypted);
 }
 
+template<class Cipher>
+inline void EncryptedBlockStore2<Cipher>::storeMany(std::vector<std::pair<BlockId, cpputils::Data>> blocks) {
+  if (blocks.size() <= 1) {
+    return BlockStore2::storeMany(std::move(blocks));
+  }
+
+  // Encryption is CPU bound, so we encrypt a slice of the blocks on each core and then hand the whole batch to the base store.
+  _encryptionThreadPool.runSlices(blocks.size(), [this, &blocks] (size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      blocks[i].second = _encrypt(blocks[i].second);
+    }
+  });
+  _baseBlockStore->storeMany(std::move(blocks));
+}
+
 template<class Cipher>
 inline uint64_t EncryptedBlockStore2<Cipher>::numBlocks() const {
   return _baseBlockStore->numBlocks();
@@ -122,8 +146,10 @@ inline void EncryptedBlockStore2<Cipher>::forEachBlock(std::function<void (const
 
 template<class Cipher>
 inline cpputils::Data EncryptedBlockStore2<Cipher>::_encrypt(const cpputils::Data &data) const {
-  cpputils::Data encrypted = Cipher::encrypt(static_cast<const CryptoPP::byte*>(data.data()), data.size(), _encKey);
-  return _prependFormatHeaderToData(encrypted);
+  // Reserve headroom for the format header so we can prepend it without copying the ciphertext
+  cpputils::Data encrypted = Cipher::encrypt(static_cast<const CryptoPP::byte*>(data.data()), data.size(), _encKey, sizeof(FORMAT_VERSION_HEADER));
+  _prependFormatHeader(&encrypted);
+  return encrypted;
 }
 
 template<class Cipher>
@@ -140,7 +166,7 @@ inline boost::optional<cpputils::Data> EncryptedBlockStore2<Cipher>::_tryDecrypt
     if (!_blockIdHeaderIsCorrect(blockId, *decrypted)) {
       return boost::none;
     }
-    *decrypted = _migrateBlock(*decrypted);
+    *decrypted = _migrateBlock(std::move(*decrypted));
     // no need to write migrated back to block store because
     // this migration happens in line with a migration in IntegrityBlockStore2
     // which then writes it back
@@ -151,8 +177,9 @@ inline boost::optional<cpputils::Data> EncryptedBlockStore2<Cipher>::_tryDecrypt
 
 #ifndef CRYFS_NO_COMPATIBILITY
 template<class Cipher>
-inline cpputils::Data EncryptedBlockStore2<Cipher>::_migrateBlock(const cpputils::Data &data) {
-  return data.copyAndRemovePrefix(BlockId::BINARY_LENGTH);
+inline cpputils::Data EncryptedBlockStore2<Cipher>::_migrateBlock(cpputils::Data data) {
+  data.removePrefix(BlockId::BINARY_LENGTH);
+  return data;
 }
 
 template<class Cipher>
@@ -162,11 +189,9 @@ inline bool EncryptedBlockStore2<Cipher>::_blockIdHeaderIsCorrect(const BlockId
 #endif
 
 template<class Cipher>
-inline cpputils::Data EncryptedBlockStore2<Cipher>::_prependFormatHeaderToData(const cpputils::Data &data) {
-  cpputils::Data dataWithHeader(sizeof(FORMAT_VERSION_HEADER) + data.size());
-  cpputils::serialize<uint16_t>(dataWithHeader.dataOffset(0), FORMAT_VERSION_HEADER);
-  std::memcpy(dataWithHeader.dataOffset(sizeof(FORMAT_VERSION_HEADER)), data.data(), data.size());
-  return dataWithHeader;
+inline void EncryptedBlockStore2<Cipher>::_prependFormatHeader(cpputils::Data *data) {
+  data->growIntoHeadroom(sizeof(FORMAT_VERSION_HEADER));
+  cpputils::serialize<uint16_t>(data->data(), FORMAT_VERSION_HEADER);
 }
 
 template<class Cipher>
@@ -88,8 +88,9 @@ uint64_t IntegrityBlockStore2::_readVersion(const Data &data) {
   return deserialize<uint64_t>(data.dataOffset(VERSION_HEADER_OFFSET));
 }
 
-Data IntegrityBlockStore2::_removeHeader(const Data &data) {
-  return data.copyAndRemovePrefix(HEADER_LENGTH);
+Data IntegrityBlockStore2::_removeHeader(Data data) {
+  data.removePrefix(HEADER_LENGTH);
+  return data;
 }
 
 void IntegrityBlockStore2::integrityViolationDetected(const string &reason) const {
@@ -109,9 +110,14 @@ IntegrityBlockStore2::IntegrityBlockStore2(unique_ref<BlockStore2> baseBlockStor
 }
 
 bool IntegrityBlockStore2::tryCreate(const BlockId &blockId, const Data &data) {
-  uint64_t version = _knownBlockVersions.incrementVersion(blockId);
+  // The new version is only remembered after the block was written, see KnownBlockVersions::reserveVersion()
+  uint64_t version = _knownBlockVersions.reserveVersion(blockId);
   Data dataWithHeader = _prependHeaderToData(blockId, _knownBlockVersions.myClientId(), version, data);
-  return _baseBlockStore->tryCreate(blockId, dataWithHeader);
+  if (!_baseBlockStore->tryCreate(blockId, dataWithHeader)) {
+    return false;
+  }
+  _knownBlockVersions.commitVersion(blockId, version);
+  return true;
 }
 
 bool IntegrityBlockStore2::remove(const BlockId &blockId) {
@@ -119,6 +125,13 @@ bool IntegrityBlockStore2::remove(const BlockId &blockId) {
   return _baseBlockStore->remove(blockId);
 }
 
+uint64_t IntegrityBlockStore2::removeMany(const std::vector<BlockId> &blockIds) {
+  for (const BlockId &blockId : blockIds) {
+    _knownBlockVersions.markBlockAsDeleted(blockId);
+  }
+  return _baseBlockStore->removeMany(blockIds);
+}
+
 optional<Data> IntegrityBlockStore2::load(const BlockId &blockId) const {
   auto loaded = _baseBlockStore->load(blockId);
   if (none == loaded) {
@@ -133,15 +146,15 @@ optional<Data> IntegrityBlockStore2::load(const BlockId &blockId) const {
     if (!_checkHeader(blockId, migrated) && !_allowIntegrityViolations) {
       return optional<Data>(none);
     }
-    Data content = _removeHeader(migrated);
+    Data content = _removeHeader(std::move(migrated));
     const_cast<IntegrityBlockStore2*>(this)->store(blockId, content);
-    return optional<Data>(_removeHeader(migrated));
+    return optional<Data>(std::move(content));
   }
 #endif
   if (!_checkHeader(blockId, *loaded) && !_allowIntegrityViolations) {
     return optional<Data>(none);
   }
-  return optional<Data>(_removeHeader(*loaded));
+  return optional<Data>(_removeHeader(std::move(*loaded)));
 }
 
 #ifndef CRYFS_NO_COMPATIBILITY
@@ -156,9 +169,25 @@ Data IntegrityBlockStore2::_migrateBlock(const BlockId &blockId, const Data &dat
 #endif
 
 void IntegrityBlockStore2::store(const BlockId &blockId, const Data &data) {
-  uint64_t version = _knownBlockVersions.incrementVersion(blockId);
+  uint64_t version = _knownBlockVersions.reserveVersion(blockId);
   Data dataWithHeader = _prependHeaderToData(blockId, _knownBlockVersions.myClientId(), version, data);
-  return _baseBlockStore->store(blockId, dataWithHeader);
+  _baseBlockStore->store(blockId, dataWithHeader);
+  _knownBlockVersions.commitVersion(blockId, version);
+}
+
+void IntegrityBlockStore2::storeMany(std::vector<std::pair<BlockId, Data>> blocks) {
+  // Adding the header is cheap compared to the encryption below us, so we do it here and pass the batch on
+  std::vector<std::pair<BlockId, uint64_t>> versions;
+  versions.reserve(blocks.size());
+  for (auto &block : blocks) {
+    uint64_t version = _knownBlockVersions.reserveVersion(block.first);
+    block.second = _prependHeaderToData(block.first, _knownBlockVersions.myClientId(), version, block.second);
+    versions.emplace_back(block.first, version);
+  }
+  _baseBlockStore->storeMany(std::move(blocks));
+  for (const auto &version : versions) {
+    _knownBlockVersions.commitVersion(version.first, version.second);
+  }
 }
 
 uint64_t IntegrityBlockStore2::numBlocks() const {
@@ -223,10 +252,11 @@ void IntegrityBlockStore2::migrateBlockFromBlockstoreWithoutVersionNumbers(block
       return;
   }
 
-  uint64_t version = knownBlockVersions->incrementVersion(blockId);
+  uint64_t version = knownBlockVersions->reserveVersion(blockId);
   cpputils::Data data = std::move(*data_);
   cpputils::Data dataWithHeader = _prependHeaderToData(blockId, knownBlockVersions->myClientId(), version, data);
   baseBlockStore->store(blockId, dataWithHeader);
+  knownBlockVersions->commitVersion(blockId, version);
 }
 #endif
 
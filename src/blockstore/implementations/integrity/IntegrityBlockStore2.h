@@ -36,8 +36,10 @@ public:
 
   bool tryCreate(const BlockId &blockId, const cpputils::Data &data) override;
   bool remove(const BlockId &blockId) override;
+  uint64_t removeMany(const std::vector<BlockId> &blockIds) override;
   boost::optional<cpputils::Data> load(const BlockId &blockId) const override;
   void store(const BlockId &blockId, const cpputils::Data &data) override;
+  void storeMany(std::vector<std::pair<BlockId, cpputils::Data>> blocks) override;
   uint64_t numBlocks() const override;
   uint64_t estimateNumFreeBytes() const override;
   uint64_t blockSizeFromPhysicalBlockSize(uint64_t blockSize) const override;
@@ -76,7 +78,7 @@ private:
 #ifndef CRYFS_NO_COMPATIBILITY
   static cpputils::Data _migrateBlock(const BlockId &blockId, const cpputils::Data &data);
 #endif
-  static cpputils::Data _removeHeader(const cpputils::Data &data);
+  static cpputils::Data _removeHeader(cpputils::Data data);
   void integrityViolationDetected(const std::string &reason) const;
 
   cpputils::unique_ref<BlockStore2> _baseBlockStore;
@@ -1,5 +1,6 @@
-#include <fstream>
-#include <cpp-utils/random/Random.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <limits>
 #include <unordered_set>
 #include "KnownBlockVersions.h"
 
@@ -11,8 +12,9 @@ using std::mutex;
 using boost::optional;
 using boost::none;
 using cpputils::Data;
-using cpputils::Serializer;
 using cpputils::Deserializer;
+using cpputils::unique_ref;
+using cpputils::make_unique_ref;
 
 namespace blockstore {
 namespace integrity {
@@ -20,127 +22,167 @@ namespace integrity {
 const string KnownBlockVersions::OLD_HEADER = "cryfs.integritydata.knownblockversions;0";
 const string KnownBlockVersions::HEADER = "cryfs.integritydata.knownblockversions;1";
 constexpr uint32_t KnownBlockVersions::CLIENT_ID_FOR_DELETED_BLOCK;
+constexpr size_t KnownBlockVersions::NUM_MUTEX_STRIPES;
 
 KnownBlockVersions::KnownBlockVersions(const bf::path &stateFilePath, uint32_t myClientId)
-        :_integrityViolationOnPreviousRun(false), _knownVersions(), _lastUpdateClientId(), _stateFilePath(stateFilePath), _myClientId(myClientId), _mutex(), _valid(true) {
-    unique_lock<mutex> lock(_mutex);
+        :_stateFilePath(stateFilePath), _myClientId(myClientId), _table(_openStateFile(stateFilePath)), _blockMutexes(), _reservedVersions(), _valid(true) {
     ASSERT(_myClientId != CLIENT_ID_FOR_DELETED_BLOCK, "This is not a valid client id");
-    _loadStateFile();
 }
 
 KnownBlockVersions::KnownBlockVersions(KnownBlockVersions &&rhs) // NOLINT (intentionally not noexcept)
-        : _integrityViolationOnPreviousRun(false), _knownVersions(), _lastUpdateClientId(), _stateFilePath(), _myClientId(0), _mutex(), _valid(true) {
-    unique_lock<mutex> rhsLock(rhs._mutex);
-    unique_lock<mutex> lock(_mutex);
-    _integrityViolationOnPreviousRun = rhs._integrityViolationOnPreviousRun;
-    _knownVersions = std::move(rhs._knownVersions);
-    _lastUpdateClientId = std::move(rhs._lastUpdateClientId);
-    _stateFilePath = std::move(rhs._stateFilePath);
-    _myClientId = rhs._myClientId;
+        : _stateFilePath(std::move(rhs._stateFilePath)), _myClientId(rhs._myClientId), _table(std::move(rhs._table)), _blockMutexes(), _reservedVersions(std::move(rhs._reservedVersions)), _valid(true) {
     rhs._valid = false;
 }
 
 KnownBlockVersions::~KnownBlockVersions() {
-    unique_lock<mutex> lock(_mutex);
-    if (_valid) {
-        _saveStateFile();
-    }
+    // The table writes its changes on destruction
+}
+
+size_t KnownBlockVersions::_stripeForBlock(const BlockId &blockId) {
+    return std::hash<BlockId>()(blockId) % NUM_MUTEX_STRIPES;
+}
+
+std::mutex &KnownBlockVersions::_mutexForBlock(const BlockId &blockId) const {
+    return _blockMutexes[_stripeForBlock(blockId)];
 }
 
 void KnownBlockVersions::setIntegrityViolationOnPreviousRun(bool value) {
-    _integrityViolationOnPreviousRun = value;
+    ASSERT(_valid, "Object not valid due to a std::move");
+    _table->setIntegrityViolationOnPreviousRun(value);
 }
 
 bool KnownBlockVersions::integrityViolationOnPreviousRun() const {
-    return _integrityViolationOnPreviousRun;
+    ASSERT(_valid, "Object not valid due to a std::move");
+    return _table->integrityViolationOnPreviousRun();
 }
 
 bool KnownBlockVersions::checkAndUpdateVersion(uint32_t clientId, const BlockId &blockId, uint64_t version) {
-    unique_lock<mutex> lock(_mutex);
+    unique_lock<mutex> lock(_mutexForBlock(blockId));
     ASSERT(clientId != CLIENT_ID_FOR_DELETED_BLOCK, "This is not a valid client id");
 
     ASSERT(version > 0, "Version has to be >0"); // Otherwise we wouldn't handle notexisting entries correctly.
     ASSERT(_valid, "Object not valid due to a std::move");
 
-    uint64_t &found = _knownVersions[{clientId, blockId}]; // If the entry doesn't exist, this creates it with value 0.
+    const uint64_t found = _table->version(clientId, blockId).value_or(0);
     if (found > version) {
         // This client already published a newer block version. Rollbacks are not allowed.
         return false;
     }
 
-    uint32_t &lastUpdateClientId = _lastUpdateClientId[blockId]; // If entry doesn't exist, this creates it with value 0. However, in this case, found == 0 (and version > 0), which means found != version.
+    // If there is no entry, this is CLIENT_ID_FOR_DELETED_BLOCK. However, in this case, found == 0 (and version > 0), which means found != version.
+    const uint32_t lastUpdateClientId = _table->lastUpdateClientId(blockId).value_or(CLIENT_ID_FOR_DELETED_BLOCK);
     if (found == version && lastUpdateClientId != clientId) {
         // This is a roll back to the "newest" block of client [clientId], which was since then superseded by a version from client _lastUpdateClientId[blockId].
         // This is not allowed.
         return false;
     }
 
-    found = version;
-    lastUpdateClientId = clientId;
+    // Most loads see a version we already know. Only write if something changed, so we don't dirty pages of the table file.
+    if (found != version) {
+        _table->setVersion(clientId, blockId, version);
+    }
+    if (lastUpdateClientId != clientId) {
+        _table->setLastUpdateClientId(blockId, clientId);
+    }
     return true;
 }
 
 uint64_t KnownBlockVersions::incrementVersion(const BlockId &blockId) {
-    unique_lock<mutex> lock(_mutex);
-    uint64_t &found = _knownVersions[{_myClientId, blockId}]; // If the entry doesn't exist, this creates it with value 0.
-    uint64_t newVersion = found + 1;
+    const uint64_t newVersion = reserveVersion(blockId);
+    commitVersion(blockId, newVersion);
+    return newVersion;
+}
+
+uint64_t KnownBlockVersions::reserveVersion(const BlockId &blockId) {
+    const size_t stripe = _stripeForBlock(blockId);
+    unique_lock<mutex> lock(_blockMutexes[stripe]);
+    ASSERT(_valid, "Object not valid due to a std::move");
+    uint64_t newVersion = _table->version(_myClientId, blockId).value_or(0) + 1;
+    auto reserved = _reservedVersions[stripe].find(blockId);
+    if (reserved != _reservedVersions[stripe].end()) {
+        newVersion = std::max(newVersion, reserved->second + 1);
+    }
     if (newVersion == std::numeric_limits<uint64_t>::max()) {
         // It's *very* unlikely we ever run out of version numbers in 64bit...but just to be sure...
         throw std::runtime_error("Version overflow");
     }
-    found = newVersion;
-    _lastUpdateClientId[blockId] = _myClientId;
-    return found;
+    if (reserved != _reservedVersions[stripe].end()) {
+        reserved->second = newVersion;
+    } else {
+        _reservedVersions[stripe].emplace(blockId, newVersion);
+    }
+    return newVersion;
+}
+
+void KnownBlockVersions::commitVersion(const BlockId &blockId, uint64_t version) {
+    const size_t stripe = _stripeForBlock(blockId);
+    unique_lock<mutex> lock(_blockMutexes[stripe]);
+    ASSERT(_valid, "Object not valid due to a std::move");
+    // If a newer version was committed or loaded in the meantime, keep that one
+    if (_table->version(_myClientId, blockId).value_or(0) < version) {
+        _table->setVersion(_myClientId, blockId, version);
+    }
+    if (_table->lastUpdateClientId(blockId) != _myClientId) {
+        _table->setLastUpdateClientId(blockId, _myClientId);
+    }
+    auto reserved = _reservedVersions[stripe].find(blockId);
+    if (reserved != _reservedVersions[stripe].end() && reserved->second == version) {
+        _reservedVersions[stripe].erase(reserved);
+    }
 }
 
-void KnownBlockVersions::_loadStateFile() {
-    optional<Data> file = Data::LoadFromFile(_stateFilePath);
+unique_ref<KnownBlockVersionsTable> KnownBlockVersions::_openStateFile(const bf::path &stateFilePath) {
+    if (bf::exists(stateFilePath) && !KnownBlockVersionsTable::IsTableFile(stateFilePath)) {
+        _migrateStateFile(stateFilePath);
+    }
+    // If the file doesn't exist, this creates an empty state.
+    return make_unique_ref<KnownBlockVersionsTable>(stateFilePath);
+}
+
+void KnownBlockVersions::_migrateStateFile(const bf::path &stateFilePath) {
+    optional<Data> file = Data::LoadFromFile(stateFilePath);
     if (file == none) {
-        // File doesn't exist means we loaded empty state.
-        return;
+        throw std::runtime_error("Invalid local state: Couldn't read integrity file.");
     }
     Deserializer deserializer(&*file);
     const string loaded_header = deserializer.readString();
 
+    bool integrityViolationOnPreviousRun = false;
+    if (HEADER == loaded_header) {
+        integrityViolationOnPreviousRun = deserializer.readBool();
+    }
 #ifndef CRYFS_NO_COMPATIBILITY
-    if (OLD_HEADER == loaded_header) {
-        _knownVersions = _deserializeKnownVersions(&deserializer);
-        _lastUpdateClientId = _deserializeLastUpdateClientIds(&deserializer);
-
-        deserializer.finished();
-        _saveStateFile();
-        return;
+    else if (OLD_HEADER == loaded_header) {
+        // This format didn't store whether there was an integrity violation
     }
 #endif
-    if (HEADER != loaded_header) {
+    else {
         throw std::runtime_error("Invalid local state: Invalid integrity file header.");
     }
-    _integrityViolationOnPreviousRun = deserializer.readBool();
-    _knownVersions = _deserializeKnownVersions(&deserializer);
-    _lastUpdateClientId = _deserializeLastUpdateClientIds(&deserializer);
-
+    const auto knownVersions = _deserializeKnownVersions(&deserializer);
+    const auto lastUpdateClientIds = _deserializeLastUpdateClientIds(&deserializer);
     deserializer.finished();
-};
-
 
-void KnownBlockVersions::_saveStateFile() const {
-    Serializer serializer(
-            Serializer::StringSize(HEADER) +
-            Serializer::BoolSize() +
-            sizeof(uint64_t) + _knownVersions.size() * (sizeof(uint32_t) + BlockId::BINARY_LENGTH + sizeof(uint64_t)) +
-            sizeof(uint64_t) + _lastUpdateClientId.size() * (BlockId::BINARY_LENGTH + sizeof(uint32_t)));
-    serializer.writeString(HEADER);
-    serializer.writeBool(_integrityViolationOnPreviousRun);
-    _serializeKnownVersions(&serializer, _knownVersions);
-    _serializeLastUpdateClientIds(&serializer, _lastUpdateClientId);
-
-    serializer.finished().StoreToFile(_stateFilePath);
+    // Only replace the old state file once the table is complete, so a crash during the migration doesn't lose the state
+    const bf::path migratedPath = stateFilePath.string() + ".migrating";
+    bf::remove(migratedPath);
+    {
+        KnownBlockVersionsTable table(migratedPath);
+        for (const auto &entry : knownVersions) {
+            table.setVersion(entry.first.clientId, entry.first.blockId, entry.second);
+        }
+        for (const auto &entry : lastUpdateClientIds) {
+            table.setLastUpdateClientId(entry.first, entry.second);
+        }
+        table.setIntegrityViolationOnPreviousRun(integrityViolationOnPreviousRun);
+    }
+    bf::rename(migratedPath, stateFilePath);
 }
 
 std::unordered_map<ClientIdAndBlockId, uint64_t> KnownBlockVersions::_deserializeKnownVersions(Deserializer *deserializer) {
     uint64_t numEntries = deserializer->readUint64();
     std::unordered_map<ClientIdAndBlockId, uint64_t> result;
-    result.reserve(static_cast<uint64_t>(1.2 * numEntries)); // Reserve for factor 1.2 more, so the file system doesn't immediately have to resize it on the first new block.
+    result.reserve(numEntries);
     for (uint64_t i = 0 ; i < numEntries; ++i) {
         auto entry = _deserializeKnownVersionsEntry(deserializer);
         result.insert(entry);
@@ -149,15 +191,6 @@ std::unordered_map<ClientIdAndBlockId, uint64_t> KnownBlockVersions::_deserializ
     return result;
 }
 
-void KnownBlockVersions::_serializeKnownVersions(Serializer *serializer, const std::unordered_map<ClientIdAndBlockId, uint64_t>& knownVersions) {
-    uint64_t numEntries = knownVersions.size();
-    serializer->writeUint64(numEntries);
-
-    for (const auto &entry : knownVersions) {
-        _serializeKnownVersionsEntry(serializer, entry);
-    }
-}
-
 pair<ClientIdAndBlockId, uint64_t> KnownBlockVersions::_deserializeKnownVersionsEntry(Deserializer *deserializer) {
     uint32_t clientId = deserializer->readUint32();
     BlockId blockId(deserializer->readFixedSizeData<BlockId::BINARY_LENGTH>());
@@ -166,16 +199,10 @@ pair<ClientIdAndBlockId, uint64_t> KnownBlockVersions::_deserializeKnownVersions
     return {{clientId, blockId}, version};
 };
 
-void KnownBlockVersions::_serializeKnownVersionsEntry(Serializer *serializer, const pair<ClientIdAndBlockId, uint64_t> &entry) {
-    serializer->writeUint32(entry.first.clientId);
-    serializer->writeFixedSizeData<BlockId::BINARY_LENGTH>(entry.first.blockId.data());
-    serializer->writeUint64(entry.second);
-}
-
 std::unordered_map<BlockId, uint32_t> KnownBlockVersions::_deserializeLastUpdateClientIds(Deserializer *deserializer) {
     uint64_t numEntries = deserializer->readUint64();
     std::unordered_map<BlockId, uint32_t> result;
-    result.reserve(static_cast<uint64_t>(1.2 * numEntries)); // Reserve for factor 1.2 more, so the file system doesn't immediately have to resize it on the first new block.
+    result.reserve(numEntries);
     for (uint64_t i = 0 ; i < numEntries; ++i) {
         auto entry = _deserializeLastUpdateClientIdEntry(deserializer);
         result.insert(entry);
@@ -183,15 +210,6 @@ std::unordered_map<BlockId, uint32_t> KnownBlockVersions::_deserializeLastUpdate
     return result;
 }
 
-void KnownBlockVersions::_serializeLastUpdateClientIds(Serializer *serializer, const std::unordered_map<BlockId, uint32_t>& lastUpdateClientId) {
-    uint64_t numEntries = lastUpdateClientId.size();
-    serializer->writeUint64(numEntries);
-
-    for (const auto &entry : lastUpdateClientId) {
-        _serializeLastUpdateClientIdEntry(serializer, entry);
-    }
-}
-
 pair<BlockId, uint32_t> KnownBlockVersions::_deserializeLastUpdateClientIdEntry(Deserializer *deserializer) {
     BlockId blockId(deserializer->readFixedSizeData<BlockId::BINARY_LENGTH>());
     uint32_t clientId = deserializer->readUint32();
@@ -199,41 +217,48 @@ pair<BlockId, uint32_t> KnownBlockVersions::_deserializeLastUpdateClientIdEntry(
     return {blockId, clientId};
 };
 
-void KnownBlockVersions::_serializeLastUpdateClientIdEntry(Serializer *serializer, const pair<BlockId, uint32_t> &entry) {
-    serializer->writeFixedSizeData<BlockId::BINARY_LENGTH>(entry.first.data());
-    serializer->writeUint32(entry.second);
-}
-
 uint32_t KnownBlockVersions::myClientId() const {
     return _myClientId;
 }
 
 uint64_t KnownBlockVersions::getBlockVersion(uint32_t clientId, const BlockId &blockId) const {
-    unique_lock<mutex> lock(_mutex);
-    return _knownVersions.at({clientId, blockId});
+    unique_lock<mutex> lock(_mutexForBlock(blockId));
+    ASSERT(_valid, "Object not valid due to a std::move");
+    optional<uint64_t> version = _table->version(clientId, blockId);
+    if (version == none) {
+        throw std::out_of_range("Unknown block version");
+    }
+    return *version;
 }
 
 void KnownBlockVersions::markBlockAsDeleted(const BlockId &blockId) {
-    _lastUpdateClientId[blockId] = CLIENT_ID_FOR_DELETED_BLOCK;
+    unique_lock<mutex> lock(_mutexForBlock(blockId));
+    ASSERT(_valid, "Object not valid due to a std::move");
+    if (_table->lastUpdateClientId(blockId) != CLIENT_ID_FOR_DELETED_BLOCK) {
+        _table->setLastUpdateClientId(blockId, CLIENT_ID_FOR_DELETED_BLOCK);
+    }
 }
 
 bool KnownBlockVersions::blockShouldExist(const BlockId &blockId) const {
-    auto found = _lastUpdateClientId.find(blockId);
-    if (found == _lastUpdateClientId.end()) {
+    unique_lock<mutex> lock(_mutexForBlock(blockId));
+    ASSERT(_valid, "Object not valid due to a std::move");
+    optional<uint32_t> lastUpdateClientId = _table->lastUpdateClientId(blockId);
+    if (lastUpdateClientId == none) {
         // We've never seen (i.e. loaded) this block. So we can't say it has to exist.
         return false;
     }
     // We've seen the block before. If we didn't delete it, it should exist (only works for single-client scenario).
-    return found->second != CLIENT_ID_FOR_DELETED_BLOCK;
+    return *lastUpdateClientId != CLIENT_ID_FOR_DELETED_BLOCK;
 }
 
 std::unordered_set<BlockId> KnownBlockVersions::existingBlocks() const {
+    ASSERT(_valid, "Object not valid due to a std::move");
     std::unordered_set<BlockId> result;
-    for (const auto &entry : _lastUpdateClientId) {
-        if (entry.second != CLIENT_ID_FOR_DELETED_BLOCK) {
-            result.insert(entry.first);
+    _table->forEachLastUpdateClientId([&result] (const BlockId &blockId, uint32_t clientId) {
+        if (clientId != CLIENT_ID_FOR_DELETED_BLOCK) {
+            result.insert(blockId);
         }
-    }
+    });
     return result;
 }
 
@@ -7,14 +7,23 @@
 #include <boost/filesystem/path.hpp>
 #include <boost/optional.hpp>
 #include "ClientIdAndBlockId.h"
+#include "KnownBlockVersionsTable.h"
 #include <cpp-utils/data/Deserializer.h>
-#include <cpp-utils/data/Serializer.h>
+#include <cpp-utils/pointer/unique_ref.h>
+#include <array>
 #include <mutex>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace blockstore {
     namespace integrity {
 
+        /**
+         * Remembers the newest version of each block seen from each client, so that rollbacks to older versions are detected.
+         * The state is stored in a KnownBlockVersionsTable and every change is persisted immediately.
+         * Calls for different blocks don't block each other, so parallel block accesses aren't serialized here.
+         * State files written by older versions are migrated to the table format when they're opened.
+         */
         class KnownBlockVersions final {
         public:
             KnownBlockVersions(const boost::filesystem::path &stateFilePath, uint32_t myClientId);
@@ -26,6 +35,12 @@ namespace blockstore {
 
             uint64_t incrementVersion(const BlockId &blockId);
 
+            // Like incrementVersion(), but the new version is only kept in memory until commitVersion() is called.
+            // Call commitVersion() after the block with the new version was written. This way, a crash in between
+            // doesn't leave a known version behind that is newer than the stored block.
+            uint64_t reserveVersion(const BlockId &blockId);
+            void commitVersion(const BlockId &blockId, uint64_t version);
+
             void markBlockAsDeleted(const BlockId &blockId);
 
             bool blockShouldExist(const BlockId &blockId) const;
@@ -42,32 +57,33 @@ namespace blockstore {
             static constexpr uint32_t CLIENT_ID_FOR_DELETED_BLOCK = 0;
 
         private:
-            bool _integrityViolationOnPreviousRun;
-            std::unordered_map<ClientIdAndBlockId, uint64_t> _knownVersions;
-            std::unordered_map<BlockId, uint32_t> _lastUpdateClientId; // The client who last updated the block
+            static constexpr size_t NUM_MUTEX_STRIPES = 128;
 
             boost::filesystem::path _stateFilePath;
             uint32_t _myClientId;
-            mutable std::mutex _mutex;
+            cpputils::unique_ref<KnownBlockVersionsTable> _table;
+            // Calls for one block must not run concurrently, but calls for different blocks can.
+            // Each block is protected by one of these mutexes, chosen by the hash of its block id.
+            mutable std::array<std::mutex, NUM_MUTEX_STRIPES> _blockMutexes;
+            // Versions handed out by reserveVersion() that weren't committed yet, protected by the same mutexes as the blocks.
+            // Versions of failed writes stay here, so they aren't handed out again.
+            std::array<std::unordered_map<BlockId, uint64_t>, NUM_MUTEX_STRIPES> _reservedVersions;
             bool _valid;
 
             static const std::string OLD_HEADER;
             static const std::string HEADER;
 
-            void _loadStateFile();
-            void _saveStateFile() const;
+            static size_t _stripeForBlock(const BlockId &blockId);
+            std::mutex &_mutexForBlock(const BlockId &blockId) const;
 
-            static std::unordered_map<ClientIdAndBlockId, uint64_t> _deserializeKnownVersions(cpputils::Deserializer *deserializer);
-            static void _serializeKnownVersions(cpputils::Serializer *serializer, const std::unordered_map<ClientIdAndBlockId, uint64_t>& knownVersions);
+            static cpputils::unique_ref<KnownBlockVersionsTable> _openStateFile(const boost::filesystem::path &stateFilePath);
+            static void _migrateStateFile(const boost::filesystem::path &stateFilePath);
 
+            static std::unordered_map<ClientIdAndBlockId, uint64_t> _deserializeKnownVersions(cpputils::Deserializer *deserializer);
             static std::pair<ClientIdAndBlockId, uint64_t> _deserializeKnownVersionsEntry(cpputils::Deserializer *deserializer);
-            static void _serializeKnownVersionsEntry(cpputils::Serializer *serializer, const std::pair<ClientIdAndBlockId, uint64_t> &entry);
 
             static std::unordered_map<BlockId, uint32_t> _deserializeLastUpdateClientIds(cpputils::Deserializer *deserializer);
-            static void _serializeLastUpdateClientIds(cpputils::Serializer *serializer, const std::unordered_map<BlockId, uint32_t>& lastUpdateClientIds);
-
             static std::pair<BlockId, uint32_t> _deserializeLastUpdateClientIdEntry(cpputils::Deserializer *deserializer);
-            static void _serializeLastUpdateClientIdEntry(cpputils::Serializer *serializer, const std::pair<BlockId, uint32_t> &entry);
 
             DISALLOW_COPY_AND_ASSIGN(KnownBlockVersions);
         };
@@ -0,0 +1,297 @@
+#include "KnownBlockVersionsTable.h"
+#include <boost/filesystem.hpp>
+#include <cpp-utils/assert/assert.h>
+#include <cpp-utils/logging/logging.h>
+#include <array>
+#include <cstring>
+#include <fstream>
+
+namespace bf = boost::filesystem;
+using std::string;
+using boost::optional;
+using boost::none;
+using cpputils::MappedFile;
+using namespace cpputils::logging;
+
+namespace blockstore {
+namespace integrity {
+
+const string KnownBlockVersionsTable::MAGIC = "cryfs.integritydata.knownblockversions;2";
+constexpr uint64_t KnownBlockVersionsTable::INITIAL_NUM_SLOTS;
+constexpr uint64_t KnownBlockVersionsTable::MAX_LOAD_NUMERATOR;
+constexpr uint64_t KnownBlockVersionsTable::MAX_LOAD_DENOMINATOR;
+
+namespace {
+    bf::path tempPathFor(const bf::path &path) {
+        return path.string() + ".tmp";
+    }
+}
+
+KnownBlockVersionsTable::KnownBlockVersionsTable(const bf::path &path)
+        : _path(path), _file(bf::exists(path) ? _openTableFile(path) : _createTableFile(path, INITIAL_NUM_SLOTS)) {
+    static_assert(sizeof(Header) == 72, "The file format depends on the header size");
+    static_assert(sizeof(Slot) == 32, "The file format depends on the slot size");
+    static_assert(sizeof(std::atomic<EntryKind>) == sizeof(EntryKind) && sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "Atomics must have the same layout as the integers in the file");
+}
+
+KnownBlockVersionsTable::~KnownBlockVersionsTable() {
+    try {
+        flush();
+    } catch (const std::exception &e) {
+        LOG(ERR, "Error writing integrity data to {}: {}", _path.string(), e.what());
+    }
+}
+
+bool KnownBlockVersionsTable::IsTableFile(const bf::path &path) {
+    std::ifstream file(path.string(), std::ios::binary);
+    std::array<char, sizeof(Header::magic)> magic{};
+    file.read(magic.data(), magic.size());
+    if (!file.good()) {
+        return false;
+    }
+    return 0 == std::memcmp(magic.data(), MAGIC.c_str(), MAGIC.size() + 1);
+}
+
+uint64_t KnownBlockVersionsTable::_fileSize(uint64_t numSlots) {
+    return sizeof(Header) + numSlots * sizeof(Slot);
+}
+
+MappedFile KnownBlockVersionsTable::_createTableFile(const bf::path &path, uint64_t numSlots) {
+    // Write the table to a temporary file first, so a crash doesn't leave a file without header behind
+    const bf::path tempPath = tempPathFor(path);
+    bf::remove(tempPath);
+    {
+        MappedFile file(tempPath, _fileSize(numSlots));
+        Header *header = static_cast<Header*>(file.data());
+        std::memcpy(header->magic, MAGIC.c_str(), MAGIC.size() + 1);
+        header->numSlots = numSlots;
+        header->numUsedSlots.store(0);
+        header->integrityViolationOnPreviousRun = 0;
+        file.flush();
+    }
+    bf::rename(tempPath, path);
+    return _openTableFile(path);
+}
+
+MappedFile KnownBlockVersionsTable::_openTableFile(const bf::path &path) {
+    MappedFile file(path, 0);
+    if (file.size() < sizeof(Header)) {
+        throw std::runtime_error("Invalid local state: Integrity file too small.");
+    }
+    const Header *header = static_cast<const Header*>(file.data());
+    if (0 != std::memcmp(header->magic, MAGIC.c_str(), MAGIC.size() + 1)) {
+        throw std::runtime_error("Invalid local state: Invalid integrity file header.");
+    }
+    const bool numSlotsIsPowerOfTwo = header->numSlots != 0 && (header->numSlots & (header->numSlots - 1)) == 0;
+    if (!numSlotsIsPowerOfTwo || file.size() != _fileSize(header->numSlots) || header->numUsedSlots.load() >= header->numSlots) {
+        throw std::runtime_error("Invalid local state: Integrity file is corrupted.");
+    }
+    return file;
+}
+
+uint64_t KnownBlockVersionsTable::_hash(EntryKind kind, uint32_t clientId, const BlockId &blockId) {
+    // This decides where entries are stored in the file, so it must never change.
+    // Block ids are random, so a few bytes of them are enough.
+    const unsigned char *blockIdData = blockId.data().data();
+    uint64_t hash = 0;
+    for (unsigned int i = 0; i < sizeof(uint64_t); ++i) {
+        hash |= static_cast<uint64_t>(blockIdData[i]) << (8 * i);
+    }
+    hash ^= ((static_cast<uint64_t>(clientId) << 32) | static_cast<uint32_t>(kind)) * UINT64_C(0x9E3779B97F4A7C15);
+    // Finalizer of splitmix64
+    hash = (hash ^ (hash >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    hash = (hash ^ (hash >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return hash ^ (hash >> 31);
+}
+
+KnownBlockVersionsTable::Header *KnownBlockVersionsTable::_header() {
+    return static_cast<Header*>(_file.data());
+}
+
+const KnownBlockVersionsTable::Header *KnownBlockVersionsTable::_header() const {
+    return static_cast<const Header*>(_file.data());
+}
+
+KnownBlockVersionsTable::Slot *KnownBlockVersionsTable::_slots() {
+    return reinterpret_cast<Slot*>(static_cast<char*>(_file.data()) + sizeof(Header));
+}
+
+const KnownBlockVersionsTable::Slot *KnownBlockVersionsTable::_slots() const {
+    return reinterpret_cast<const Slot*>(static_cast<const char*>(_file.data()) + sizeof(Header));
+}
+
+const KnownBlockVersionsTable::Slot *KnownBlockVersionsTable::_findSlot(EntryKind kind, uint32_t clientId, const BlockId &blockId, bool *found) const {
+    const Slot *slots = _slots();
+    const uint64_t mask = _header()->numSlots - 1;
+    // The table is never full, so this finds an empty slot if the entry doesn't exist.
+    // Slots that are still being inserted belong to other blocks, because calls for the same block don't run concurrently.
+    for (uint64_t index = _hash(kind, clientId, blockId) & mask; ; index = (index + 1) & mask) {
+        const Slot &slot = slots[index];
+        const EntryKind slotKind = slot.kind.load(std::memory_order_acquire);
+        if (slotKind == EntryKind::EMPTY) {
+            *found = false;
+            return &slot;
+        }
+        if (slotKind == kind && slot.clientId == clientId && 0 == std::memcmp(slot.blockId, blockId.data().data(), BlockId::BINARY_LENGTH)) {
+            *found = true;
+            return &slot;
+        }
+    }
+}
+
+KnownBlockVersionsTable::Slot *KnownBlockVersionsTable::_findSlot(EntryKind kind, uint32_t clientId, const BlockId &blockId, bool *found) {
+    return const_cast<Slot*>(const_cast<const KnownBlockVersionsTable*>(this)->_findSlot(kind, clientId, blockId, found));
+}
+
+void KnownBlockVersionsTable::_set(EntryKind kind, uint32_t clientId, const BlockId &blockId, uint64_t value) {
+    while (true) {
+        boost::shared_lock<boost::shared_mutex> lock(_mutex);
+        bool found = false;
+        Slot *slot = _findSlot(kind, clientId, blockId, &found);
+        if (found) {
+            slot->value = value;
+            return;
+        }
+        if (_needsToGrow()) {
+            lock.unlock();
+            _growIfNecessary();
+            continue;
+        }
+        if (_tryInsert(slot, kind, clientId, blockId, value)) {
+            return;
+        }
+        // Another thread inserted an entry for a different block into this slot. Look for the next empty one.
+    }
+}
+
+bool KnownBlockVersionsTable::_tryInsert(Slot *slot, EntryKind kind, uint32_t clientId, const BlockId &blockId, uint64_t value) {
+    EntryKind expected = EntryKind::EMPTY;
+    if (!slot->kind.compare_exchange_strong(expected, EntryKind::INSERTING, std::memory_order_acquire)) {
+        return false;
+    }
+    blockId.ToBinary(slot->blockId);
+    slot->clientId = clientId;
+    slot->value = value;
+    // Set the kind last, so other threads (and a crash while inserting) don't see a half written entry
+    slot->kind.store(kind, std::memory_order_release);
+    _header()->numUsedSlots.fetch_add(1);
+    return true;
+}
+
+bool KnownBlockVersionsTable::_needsToGrow() const {
+    // Concurrent inserts can overshoot this by a few entries. That's fine, the table only needs to have some empty slots left.
+    return (_header()->numUsedSlots.load() + 1) * MAX_LOAD_DENOMINATOR > _header()->numSlots * MAX_LOAD_NUMERATOR;
+}
+
+void KnownBlockVersionsTable::_growIfNecessary() {
+    boost::unique_lock<boost::shared_mutex> lock(_mutex);
+    if (!_needsToGrow()) {
+        // Another thread grew the table already
+        return;
+    }
+
+    const uint64_t newNumSlots = 2 * _header()->numSlots;
+    uint64_t newNumUsedSlots = 0;
+    const bf::path tempPath = tempPathFor(_path);
+    bf::remove(tempPath);
+    {
+        MappedFile newFile(tempPath, _fileSize(newNumSlots));
+        Header *newHeader = static_cast<Header*>(newFile.data());
+        std::memcpy(newHeader->magic, _header()->magic, sizeof(newHeader->magic));
+        newHeader->numSlots = newNumSlots;
+        newHeader->integrityViolationOnPreviousRun = _header()->integrityViolationOnPreviousRun;
+        Slot *newSlots = reinterpret_cast<Slot*>(static_cast<char*>(newFile.data()) + sizeof(Header));
+        const Slot *slots = _slots();
+        for (uint64_t i = 0; i < _header()->numSlots; ++i) {
+            const EntryKind kind = slots[i].kind.load();
+            if (kind != EntryKind::VERSION && kind != EntryKind::LAST_UPDATE_CLIENT_ID) {
+                continue;
+            }
+            const BlockId blockId = BlockId::FromBinary(slots[i].blockId);
+            for (uint64_t index = _hash(kind, slots[i].clientId, blockId) & (newNumSlots - 1); ; index = (index + 1) & (newNumSlots - 1)) {
+                Slot &newSlot = newSlots[index];
+                if (newSlot.kind.load() == EntryKind::EMPTY) {
+                    std::memcpy(newSlot.blockId, slots[i].blockId, sizeof(newSlot.blockId));
+                    newSlot.clientId = slots[i].clientId;
+                    newSlot.value = slots[i].value;
+                    newSlot.kind.store(kind);
+                    break;
+                }
+            }
+            ++newNumUsedSlots;
+        }
+        newHeader->numUsedSlots.store(newNumUsedSlots);
+        newFile.flush();
+    }
+
+    // Windows can't replace a file that is still mapped
+    _file.close();
+    try {
+        bf::rename(tempPath, _path);
+    } catch (...) {
+        _file = _openTableFile(_path);
+        throw;
+    }
+    _file = _openTableFile(_path);
+}
+
+optional<uint64_t> KnownBlockVersionsTable::version(uint32_t clientId, const BlockId &blockId) const {
+    boost::shared_lock<boost::shared_mutex> lock(_mutex);
+    bool found = false;
+    const Slot *slot = _findSlot(EntryKind::VERSION, clientId, blockId, &found);
+    if (!found) {
+        return none;
+    }
+    return slot->value;
+}
+
+void KnownBlockVersionsTable::setVersion(uint32_t clientId, const BlockId &blockId, uint64_t version) {
+    _set(EntryKind::VERSION, clientId, blockId, version);
+}
+
+optional<uint32_t> KnownBlockVersionsTable::lastUpdateClientId(const BlockId &blockId) const {
+    boost::shared_lock<boost::shared_mutex> lock(_mutex);
+    bool found = false;
+    const Slot *slot = _findSlot(EntryKind::LAST_UPDATE_CLIENT_ID, 0, blockId, &found);
+    if (!found) {
+        return none;
+    }
+    return static_cast<uint32_t>(slot->value);
+}
+
+void KnownBlockVersionsTable::setLastUpdateClientId(const BlockId &blockId, uint32_t clientId) {
+    _set(EntryKind::LAST_UPDATE_CLIENT_ID, 0, blockId, clientId);
+}
+
+void KnownBlockVersionsTable::forEachLastUpdateClientId(const std::function<void (const BlockId &blockId, uint32_t clientId)> &callback) const {
+    boost::unique_lock<boost::shared_mutex> lock(_mutex);
+    const Slot *slots = _slots();
+    for (uint64_t i = 0; i < _header()->numSlots; ++i) {
+        if (slots[i].kind.load() == EntryKind::LAST_UPDATE_CLIENT_ID) {
+            callback(BlockId::FromBinary(slots[i].blockId), static_cast<uint32_t>(slots[i].value));
+        }
+    }
+}
+
+bool KnownBlockVersionsTable::integrityViolationOnPreviousRun() const {
+    boost::shared_lock<boost::shared_mutex> lock(_mutex);
+    return _header()->integrityViolationOnPreviousRun != 0;
+}
+
+void KnownBlockVersionsTable::setIntegrityViolationOnPreviousRun(bool value) {
+    boost::unique_lock<boost::shared_mutex> lock(_mutex);
+    _header()->integrityViolationOnPreviousRun = value ? 1 : 0;
+}
+
+uint64_t KnownBlockVersionsTable::numEntries() const {
+    boost::shared_lock<boost::shared_mutex> lock(_mutex);
+    return _header()->numUsedSlots.load();
+}
+
+void KnownBlockVersionsTable::flush() {
+    boost::shared_lock<boost::shared_mutex> lock(_mutex);
+    _file.flush();
+}
+
+}
+}
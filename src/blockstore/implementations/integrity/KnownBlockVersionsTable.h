@@ -0,0 +1,115 @@
+#pragma once
+#ifndef MESSMER_BLOCKSTORE_IMPLEMENTATIONS_INTEGRITY_KNOWNBLOCKVERSIONSTABLE_H_
+#define MESSMER_BLOCKSTORE_IMPLEMENTATIONS_INTEGRITY_KNOWNBLOCKVERSIONSTABLE_H_
+
+#include <cpp-utils/macros.h>
+#include <cpp-utils/system/mappedfile.h>
+#include <blockstore/utils/BlockId.h>
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <atomic>
+#include <functional>
+
+namespace blockstore {
+    namespace integrity {
+
+        /**
+         * On-disk hash table (open addressing with linear probing) storing the known block versions and the client
+         * that last updated each block. The file is mapped into memory, so opening it doesn't load anything,
+         * lookups only touch the pages they need, and each change is persisted as soon as it is made.
+         * Entries are never removed. When the table gets too full, it is rewritten into a file twice as large.
+         * Thread safe, as long as calls for the same block don't run concurrently. Calls for different blocks can
+         * insert entries in parallel, only growing the table blocks the other calls.
+         */
+        class KnownBlockVersionsTable final {
+        public:
+            // Opens the table stored at the given path, or creates an empty one if the file doesn't exist
+            explicit KnownBlockVersionsTable(const boost::filesystem::path &path);
+            ~KnownBlockVersionsTable();
+
+            // Returns true if the file at the given path is a table file (and not a state file in an older format)
+            static bool IsTableFile(const boost::filesystem::path &path);
+
+            boost::optional<uint64_t> version(uint32_t clientId, const BlockId &blockId) const;
+            void setVersion(uint32_t clientId, const BlockId &blockId, uint64_t version);
+
+            boost::optional<uint32_t> lastUpdateClientId(const BlockId &blockId) const;
+            void setLastUpdateClientId(const BlockId &blockId, uint32_t clientId);
+            // Calls the callback for each block that has a lastUpdateClientId
+            void forEachLastUpdateClientId(const std::function<void (const BlockId &blockId, uint32_t clientId)> &callback) const;
+
+            bool integrityViolationOnPreviousRun() const;
+            void setIntegrityViolationOnPreviousRun(bool value);
+
+            uint64_t numEntries() const;
+
+            // Blocks until all changes are written to disk
+            void flush();
+
+        private:
+            enum class EntryKind : uint32_t {
+                EMPTY = 0,
+                VERSION = 1,
+                LAST_UPDATE_CLIENT_ID = 2,
+                // A thread claimed the slot and is writing the entry. If the process crashed while inserting,
+                // the slot stays in this state and is dropped the next time the table grows.
+                INSERTING = 3
+            };
+
+            // Header and slots live in the mapped file. The atomics work on the file contents,
+            // because they have the same size and representation as the underlying integers.
+            struct Header final {
+                char magic[48];
+                uint64_t numSlots;
+                std::atomic<uint64_t> numUsedSlots;
+                uint8_t integrityViolationOnPreviousRun;
+                uint8_t padding[7];
+            };
+
+            struct Slot final {
+                uint8_t blockId[BlockId::BINARY_LENGTH];
+                uint32_t clientId; // 0 for LAST_UPDATE_CLIENT_ID entries
+                std::atomic<EntryKind> kind;
+                uint64_t value;
+            };
+
+            static constexpr uint64_t INITIAL_NUM_SLOTS = 1024;
+            // Grow the table when more than 3/4 of the slots are used. Linear probing gets slow when the table gets fuller.
+            static constexpr uint64_t MAX_LOAD_NUMERATOR = 3;
+            static constexpr uint64_t MAX_LOAD_DENOMINATOR = 4;
+            static const std::string MAGIC;
+
+            boost::filesystem::path _path;
+            cpputils::MappedFile _file;
+            // Shared by all calls that access entries. Exclusive while the table grows and the file is replaced,
+            // and while iterating over all entries (which would otherwise race with updates of other blocks).
+            mutable boost::shared_mutex _mutex;
+
+            static cpputils::MappedFile _createTableFile(const boost::filesystem::path &path, uint64_t numSlots);
+            static cpputils::MappedFile _openTableFile(const boost::filesystem::path &path);
+            static uint64_t _fileSize(uint64_t numSlots);
+            static uint64_t _hash(EntryKind kind, uint32_t clientId, const BlockId &blockId);
+
+            Header *_header();
+            const Header *_header() const;
+            Slot *_slots();
+            const Slot *_slots() const;
+
+            // Returns the slot holding the given entry and sets *found to true, or returns the first empty slot where it could be
+            // inserted and sets *found to false. Use *found instead of looking at the slot, because other threads can fill an empty slot.
+            const Slot *_findSlot(EntryKind kind, uint32_t clientId, const BlockId &blockId, bool *found) const;
+            Slot *_findSlot(EntryKind kind, uint32_t clientId, const BlockId &blockId, bool *found);
+            void _set(EntryKind kind, uint32_t clientId, const BlockId &blockId, uint64_t value);
+            // Returns false if another thread claimed the slot first
+            bool _tryInsert(Slot *slot, EntryKind kind, uint32_t clientId, const BlockId &blockId, uint64_t value);
+            bool _needsToGrow() const;
+            void _growIfNecessary();
+
+            DISALLOW_COPY_AND_ASSIGN(KnownBlockVersionsTable);
+        };
+
+    }
+}
+
+#endif
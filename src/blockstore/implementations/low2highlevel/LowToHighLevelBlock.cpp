@@ -5,6 +5,7 @@ using boost::none;
 using cpputils::unique_ref;
 using cpputils::make_unique_ref;
 using cpputils::Data;
+using std::shared_ptr;
 namespace DataUtils = cpputils::DataUtils;
 using std::unique_lock;
 using std::mutex;
@@ -27,7 +28,7 @@ unique_ref<LowToHighLevelBlock> LowToHighLevelBlock::Overwrite(BlockStore2 *base
 }
 
 optional<unique_ref<LowToHighLevelBlock>> LowToHighLevelBlock::Load(BlockStore2 *baseBlockStore, const BlockId &blockId) {
-  optional<Data> loadedData = baseBlockStore->load(blockId);
+  optional<shared_ptr<const Data>> loadedData = baseBlockStore->loadShared(blockId);
   if (loadedData == none) {
     return none;
   }
@@ -37,23 +38,49 @@ optional<unique_ref<LowToHighLevelBlock>> LowToHighLevelBlock::Load(BlockStore2
 LowToHighLevelBlock::LowToHighLevelBlock(const BlockId &blockId, Data data, BlockStore2 *baseBlockStore)
     :Block(blockId),
      _baseBlockStore(baseBlockStore),
+     _sharedData(nullptr),
      _data(std::move(data)),
      _dataChanged(false),
      _mutex() {
 }
 
+LowToHighLevelBlock::LowToHighLevelBlock(const BlockId &blockId, shared_ptr<const Data> sharedData, BlockStore2 *baseBlockStore)
+    :Block(blockId),
+     _baseBlockStore(baseBlockStore),
+     _sharedData(std::move(sharedData)),
+     _data(none),
+     _dataChanged(false),
+     _mutex() {
+}
+
 LowToHighLevelBlock::~LowToHighLevelBlock() {
   unique_lock<mutex> lock(_mutex);
   _storeToBaseBlock();
 }
 
+const Data &LowToHighLevelBlock::_currentData() const {
+  if (_data != none) {
+    return *_data;
+  }
+  return *_sharedData;
+}
+
+Data &LowToHighLevelBlock::_writableData() {
+  if (_data == none) {
+    // Copy on first write, the shared data must not be modified
+    _data = _sharedData->copy();
+    _sharedData = nullptr;
+  }
+  return *_data;
+}
+
 const void *LowToHighLevelBlock::data() const {
-  return _data.data();
+  return _currentData().data();
 }
 
 void LowToHighLevelBlock::write(const void *source, uint64_t offset, uint64_t count) {
   ASSERT(offset <= size() && offset + count <= size(), "Write outside of valid area"); //Also check offset < size() because of possible overflow in the addition
-  std::memcpy(_data.dataOffset(offset), source, count);
+  std::memcpy(_writableData().dataOffset(offset), source, count);
   _dataChanged = true;
 }
 
@@ -63,17 +90,18 @@ void LowToHighLevelBlock::flush() {
 }
 
 size_t LowToHighLevelBlock::size() const {
-  return _data.size();
+  return _currentData().size();
 }
 
 void LowToHighLevelBlock::resize(size_t newSize) {
-  _data = DataUtils::resize(_data, newSize);
+  _data = DataUtils::resize(_currentData(), newSize);
+  _sharedData = nullptr;
   _dataChanged = true;
 }
 
 void LowToHighLevelBlock::_storeToBaseBlock() {
   if (_dataChanged) {
-    _baseBlockStore->store(blockId(), _data);
+    _baseBlockStore->store(blockId(), _currentData());
     _dataChanged = false;
   }
 }
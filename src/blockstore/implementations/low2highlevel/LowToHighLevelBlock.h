@@ -28,6 +28,7 @@ public:
   static boost::optional<cpputils::unique_ref<LowToHighLevelBlock>> Load(BlockStore2 *baseBlockStore, const BlockId &blockId);
 
   LowToHighLevelBlock(const BlockId &blockId, cpputils::Data data, BlockStore2 *baseBlockStore);
+  LowToHighLevelBlock(const BlockId &blockId, std::shared_ptr<const cpputils::Data> sharedData, BlockStore2 *baseBlockStore);
   ~LowToHighLevelBlock();
 
   const void *data() const override;
@@ -39,10 +40,14 @@ public:
 
 private:
   BlockStore2 *_baseBlockStore;
-  cpputils::Data _data;
+  // Loaded blocks share their data with the base store's cache. They only get their own copy in _data when they're modified.
+  std::shared_ptr<const cpputils::Data> _sharedData;
+  boost::optional<cpputils::Data> _data;
   bool _dataChanged;
   std::mutex _mutex;
 
+  const cpputils::Data &_currentData() const;
+  cpputils::Data &_writableData();
   void _storeToBaseBlock();
 
   DISALLOW_COPY_AND_ASSIGN(LowToHighLevelBlock);
@@ -50,6 +50,13 @@ void LowToHighLevelBlockStore::remove(const BlockId &blockId) {
     }
 }
 
+void LowToHighLevelBlockStore::removeMany(const std::vector<BlockId> &blockIds) {
+    uint64_t numRemoved = _baseBlockStore->removeMany(blockIds);
+    if (numRemoved != blockIds.size()) {
+        throw std::runtime_error("Couldn't delete " + std::to_string(blockIds.size() - numRemoved) + " of " + std::to_string(blockIds.size()) + " blocks");
+    }
+}
+
 uint64_t LowToHighLevelBlockStore::numBlocks() const {
     return _baseBlockStore->numBlocks();
 }
@@ -25,6 +25,7 @@ public:
   cpputils::unique_ref<Block> overwrite(const blockstore::BlockId &blockId, cpputils::Data data) override;
   boost::optional<cpputils::unique_ref<Block>> load(const BlockId &blockId) override;
   void remove(const BlockId &blockId) override;
+  void removeMany(const std::vector<BlockId> &blockIds) override;
   uint64_t numBlocks() const override;
   uint64_t estimateNumFreeBytes() const override;
   uint64_t blockSizeFromPhysicalBlockSize(uint64_t blockSize) const override;
@@ -0,0 +1,187 @@
+#include "BlockCounter.h"
+#include <cpp-utils/data/Data.h>
+#include <cpp-utils/data/Serializer.h>
+#include <cpp-utils/data/Deserializer.h>
+#include <cpp-utils/logging/logging.h>
+
+namespace bf = boost::filesystem;
+using std::string;
+using std::unique_lock;
+using std::mutex;
+using std::pair;
+using boost::optional;
+using boost::none;
+using cpputils::Data;
+using cpputils::Serializer;
+using cpputils::Deserializer;
+using namespace cpputils::logging;
+
+namespace blockstore {
+namespace ondisk {
+
+const string BlockCounter::HEADER = "cryfs.blockcount;0";
+constexpr uint32_t BlockCounter::SAVE_INTERVAL;
+
+BlockCounter::BlockCounter(std::function<uint64_t ()> countBlocksByWalking, optional<bf::path> stateFile)
+  : _countBlocksByWalking(std::move(countBlocksByWalking)), _stateFile(std::move(stateFile)), _mutex(), _count(none), _exact(false),
+    _changesDuringRebuild(0), _rebuildRunning(false), _changesSinceLastSave(0), _rebuildTask() {
+  if (_stateFile == none) {
+    // Without a state file, the count is computed lazily on the first call to numBlocks().
+    return;
+  }
+  unique_lock<mutex> lock(_mutex);
+  auto loaded = _loadStateFile();
+  if (loaded != none) {
+    _count = loaded->first;
+    _exact = loaded->second;
+  }
+  if (_exact) {
+    // Mark the state file as in use, so that we rebuild the count if we crash before saving it cleanly.
+    _saveStateFile(false);
+  } else {
+    _startBackgroundRebuild();
+  }
+}
+
+BlockCounter::~BlockCounter() {
+  waitForRebuild();
+  unique_lock<mutex> lock(_mutex);
+  if (_stateFile != none && _exact) {
+    try {
+      _saveStateFile(true);
+    } catch (const std::exception &e) {
+      LOG(ERR, "Couldn't save block count: {}", e.what());
+    }
+  }
+}
+
+void BlockCounter::increment() {
+  unique_lock<mutex> lock(_mutex);
+  if (_count != none) {
+    *_count += 1;
+  }
+  if (_rebuildRunning) {
+    _changesDuringRebuild += 1;
+  }
+  _onChange();
+}
+
+void BlockCounter::decrement() {
+  unique_lock<mutex> lock(_mutex);
+  if (_count != none && *_count > 0) {
+    *_count -= 1;
+  }
+  if (_rebuildRunning) {
+    _changesDuringRebuild -= 1;
+  }
+  _onChange();
+}
+
+void BlockCounter::_onChange() {
+  if (_stateFile == none || _count == none) {
+    return;
+  }
+  if (++_changesSinceLastSave >= SAVE_INTERVAL) {
+    _saveStateFile(false);
+  }
+}
+
+uint64_t BlockCounter::numBlocks() const {
+  unique_lock<mutex> lock(_mutex);
+  if (_count != none) {
+    return *_count;
+  }
+  if (!_rebuildTask.valid()) {
+    _startBackgroundRebuild();
+  }
+  auto rebuildTask = _rebuildTask;
+  lock.unlock();
+  rebuildTask.wait();
+  lock.lock();
+  if (_count == none) {
+    // Rebuild failed. Allow a retry on the next call.
+    _rebuildTask = std::shared_future<void>();
+    throw std::runtime_error("Couldn't count the blocks in the base directory");
+  }
+  return *_count;
+}
+
+void BlockCounter::waitForRebuild() const {
+  unique_lock<mutex> lock(_mutex);
+  auto rebuildTask = _rebuildTask;
+  lock.unlock();
+  if (rebuildTask.valid()) {
+    rebuildTask.wait();
+  }
+}
+
+void BlockCounter::_startBackgroundRebuild() const {
+  // Precondition: _mutex is locked
+  _rebuildRunning = true;
+  _changesDuringRebuild = 0;
+  _rebuildTask = std::async(std::launch::async, [this] {_rebuild();}).share();
+}
+
+void BlockCounter::_rebuild() const {
+  // Blocks created or removed while we're walking the directory might or might not be seen by the walk, so the result
+  // can be off by the number of concurrent changes. That's fine for statfs, and the next rebuild fixes it.
+  uint64_t walked = 0;
+  try {
+    walked = _countBlocksByWalking();
+  } catch (const std::exception &e) {
+    LOG(ERR, "Couldn't count the blocks in the base directory: {}", e.what());
+    unique_lock<mutex> lock(_mutex);
+    _rebuildRunning = false;
+    return;
+  }
+
+  unique_lock<mutex> lock(_mutex);
+  if (_changesDuringRebuild < 0 && walked < static_cast<uint64_t>(-_changesDuringRebuild)) {
+    _count = 0;
+  } else {
+    _count = walked + _changesDuringRebuild;
+  }
+  _exact = true;
+  _rebuildRunning = false;
+  if (_stateFile != none) {
+    try {
+      _saveStateFile(false);
+    } catch (const std::exception &e) {
+      LOG(ERR, "Couldn't save block count: {}", e.what());
+    }
+  }
+}
+
+optional<pair<uint64_t, bool>> BlockCounter::_loadStateFile() const {
+  optional<Data> file = Data::LoadFromFile(*_stateFile);
+  if (file == none) {
+    return none;
+  }
+  try {
+    Deserializer deserializer(&*file);
+    if (HEADER != deserializer.readString()) {
+      LOG(WARN, "Invalid block count file header. Recounting blocks.");
+      return none;
+    }
+    uint64_t count = deserializer.readUint64();
+    bool clean = deserializer.readBool();
+    deserializer.finished();
+    return std::make_pair(count, clean);
+  } catch (const std::exception &e) {
+    LOG(WARN, "Couldn't read block count file: {}. Recounting blocks.", e.what());
+    return none;
+  }
+}
+
+void BlockCounter::_saveStateFile(bool clean) const {
+  // Precondition: _mutex is locked and _count != none
+  Serializer serializer(Serializer::StringSize(HEADER) + sizeof(uint64_t) + Serializer::BoolSize());
+  serializer.writeString(HEADER);
+  serializer.writeUint64(*_count);
+  serializer.writeBool(clean);
+  serializer.finished().StoreToFile(*_stateFile);
+  _changesSinceLastSave = 0;
+}
+
+}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#ifndef MESSMER_BLOCKSTORE_IMPLEMENTATIONS_ONDISK_BLOCKCOUNTER_H_
+#define MESSMER_BLOCKSTORE_IMPLEMENTATIONS_ONDISK_BLOCKCOUNTER_H_
+
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+#include <cpp-utils/macros.h>
+#include <functional>
+#include <future>
+#include <mutex>
+
+namespace blockstore {
+namespace ondisk {
+
+// Keeps track of the number of blocks in an OnDiskBlockStore2 so that numBlocks() doesn't have to walk the whole base directory.
+// The count is kept in memory and updated by the block store whenever it creates or removes a block.
+// If a state file is given, the count is persisted there. It is saved incrementally while the file system is in use
+// (marked as "not cleanly closed") and saved as clean when the counter is destructed. If the state file is missing or
+// wasn't cleanly closed (e.g. because of a crash), the count is rebuilt by walking the base directory in a background
+// thread. In the meantime, the last persisted count is used as an estimate.
+// Note that blocks added or removed by other clients (e.g. a sync tool) while the file system isn't mounted aren't detected.
+class BlockCounter final {
+public:
+  BlockCounter(std::function<uint64_t ()> countBlocksByWalking, boost::optional<boost::filesystem::path> stateFile);
+  ~BlockCounter();
+
+  void increment();
+  void decrement();
+
+  uint64_t numBlocks() const;
+
+  // Exposed for tests: wait until a running background rebuild is finished.
+  void waitForRebuild() const;
+
+private:
+  void _startBackgroundRebuild() const;
+  void _rebuild() const;
+  boost::optional<std::pair<uint64_t, bool>> _loadStateFile() const;
+  void _saveStateFile(bool clean) const;
+  void _onChange();
+
+  std::function<uint64_t ()> _countBlocksByWalking;
+  boost::optional<boost::filesystem::path> _stateFile;
+
+  mutable std::mutex _mutex;
+  // Current best known count. This is none if we don't have an estimate yet.
+  mutable boost::optional<uint64_t> _count;
+  // True if _count is exact, false if it is only an estimate loaded from a not cleanly closed state file.
+  mutable bool _exact;
+  // Changes that happened while the background rebuild was running. They are applied to the rebuild result.
+  mutable int64_t _changesDuringRebuild;
+  mutable bool _rebuildRunning;
+  mutable uint32_t _changesSinceLastSave;
+  mutable std::shared_future<void> _rebuildTask;
+
+  static const std::string HEADER;
+  static constexpr uint32_t SAVE_INTERVAL = 1000;
+
+  DISALLOW_COPY_AND_ASSIGN(BlockCounter);
+};
+
+}
+}
+
+#endif
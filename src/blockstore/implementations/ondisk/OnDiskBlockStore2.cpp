@@ -1,6 +1,10 @@
 #include "OnDiskBlockStore2.h"
 #include <boost/filesystem.hpp>
 #include <cpp-utils/system/diskspace.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <set>
 
 using std::string;
 using boost::optional;
@@ -16,6 +20,8 @@ namespace {
 constexpr size_t PREFIX_LENGTH = 3;
 constexpr size_t POSTFIX_LENGTH = BlockId::STRING_LENGTH - PREFIX_LENGTH;
 constexpr const char* ALLOWED_BLOCKID_CHARACTERS = "0123456789ABCDEF";
+// Writing and removing files is I/O bound, so we use more threads than there are cores.
+constexpr uint32_t IO_NUM_THREADS = 8;
 }
 
 boost::filesystem::path OnDiskBlockStore2::_getFilepath(const BlockId &blockId) const {
@@ -23,7 +29,7 @@ boost::filesystem::path OnDiskBlockStore2::_getFilepath(const BlockId &blockId)
   return _rootDir / blockIdStr.substr(0, PREFIX_LENGTH) / blockIdStr.substr(PREFIX_LENGTH);
 }
 
-Data OnDiskBlockStore2::_checkAndRemoveHeader(const Data &data) {
+Data OnDiskBlockStore2::_checkAndRemoveHeader(Data data) {
   if (!_isAcceptedCryfsHeader(data)) {
     if (_isOtherCryfsHeader(data)) {
       throw std::runtime_error("This block is not supported yet. Maybe it was created with a newer version of CryFS?");
@@ -31,9 +37,8 @@ Data OnDiskBlockStore2::_checkAndRemoveHeader(const Data &data) {
       throw std::runtime_error("This is not a valid block.");
     }
   }
-  Data result(data.size() - formatVersionHeaderSize());
-  std::memcpy(result.data(), data.dataOffset(formatVersionHeaderSize()), result.size());
-  return result;
+  data.removePrefix(formatVersionHeaderSize());
+  return data;
 }
 
 bool OnDiskBlockStore2::_isAcceptedCryfsHeader(const Data &data) {
@@ -49,20 +54,59 @@ unsigned int OnDiskBlockStore2::formatVersionHeaderSize() {
 }
 
 OnDiskBlockStore2::OnDiskBlockStore2(const boost::filesystem::path& path)
-    : _rootDir(path) {}
+    : _rootDir(path), _blockCounter([this] {return _countBlocksByWalking();}, none), _ioThreadPool(IO_NUM_THREADS, "blockIO") {}
+
+OnDiskBlockStore2::OnDiskBlockStore2(const boost::filesystem::path& path, const boost::filesystem::path& blockCountFile)
+    : _rootDir(path), _blockCounter([this] {return _countBlocksByWalking();}, blockCountFile), _ioThreadPool(IO_NUM_THREADS, "blockIO") {}
 
 bool OnDiskBlockStore2::tryCreate(const BlockId &blockId, const Data &data) {
-  auto filepath = _getFilepath(blockId);
-  if (boost::filesystem::exists(filepath)) {
+  // Creating the file exclusively makes this atomic, i.e. concurrent calls for the same block can't both succeed.
+  if (!_store(_getFilepath(blockId), data, false)) {
     return false;
   }
-
-  store(blockId, data);
+  _blockCounter.increment();
   return true;
 }
 
 bool OnDiskBlockStore2::remove(const BlockId &blockId) {
   auto filepath = _getFilepath(blockId);
+  if (!_removeBlockFile(blockId, filepath)) {
+    return false;
+  }
+  _removeDirIfEmpty(filepath.parent_path());
+  return true;
+}
+
+uint64_t OnDiskBlockStore2::removeMany(const std::vector<BlockId> &blockIds) {
+  if (blockIds.size() <= 1) {
+    return BlockStore2::removeMany(blockIds);
+  }
+
+  // Removing a block file is mostly waiting for the file system, so we remove them in parallel.
+  // Each task removes a slice of the blocks to keep the scheduling overhead low.
+  std::atomic<uint64_t> numRemoved(0);
+  _ioThreadPool.runSlices(blockIds.size(), [this, &blockIds, &numRemoved] (size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      if (_removeBlockFile(blockIds[i], _getFilepath(blockIds[i]))) {
+        ++numRemoved;
+      }
+    }
+  });
+
+  // Many blocks share a prefix directory, so we only check each of them once after all blocks are removed.
+  std::set<boost::filesystem::path> parentDirs;
+  for (const BlockId &blockId : blockIds) {
+    parentDirs.insert(_getFilepath(blockId).parent_path());
+  }
+  for (const auto &parentDir : parentDirs) {
+    if (boost::filesystem::exists(parentDir)) {
+      _removeDirIfEmpty(parentDir);
+    }
+  }
+  return numRemoved.load();
+}
+
+bool OnDiskBlockStore2::_removeBlockFile(const BlockId &blockId, const boost::filesystem::path &filepath) {
   if (!boost::filesystem::is_regular_file(filepath)) { // TODO Is this branch necessary?
     return false;
   }
@@ -71,30 +115,77 @@ bool OnDiskBlockStore2::remove(const BlockId &blockId) {
     cpputils::logging::LOG(cpputils::logging::ERR, "Couldn't find block {} to remove", blockId.ToString());
     return false;
   }
-  if (boost::filesystem::is_empty(filepath.parent_path())) {
-    boost::filesystem::remove(filepath.parent_path());
-  }
+  _blockCounter.decrement();
   return true;
 }
 
+void OnDiskBlockStore2::_removeDirIfEmpty(const boost::filesystem::path &dir) {
+  if (boost::filesystem::is_empty(dir)) {
+    boost::filesystem::remove(dir);
+  }
+}
+
 optional<Data> OnDiskBlockStore2::load(const BlockId &blockId) const {
   auto fileContent = Data::LoadFromFile(_getFilepath(blockId));
   if (fileContent == none) {
     return boost::none;
   }
-  return _checkAndRemoveHeader(*fileContent);
+  return _checkAndRemoveHeader(std::move(*fileContent));
 }
 
 void OnDiskBlockStore2::store(const BlockId &blockId, const Data &data) {
-  Data fileContent(formatVersionHeaderSize() + data.size());
-  std::memcpy(fileContent.data(), FORMAT_VERSION_HEADER.c_str(), formatVersionHeaderSize());
-  std::memcpy(fileContent.dataOffset(formatVersionHeaderSize()), data.data(), data.size());
-  auto filepath = _getFilepath(blockId);
+  if (_store(_getFilepath(blockId), data, true)) {
+    _blockCounter.increment();
+  }
+}
+
+void OnDiskBlockStore2::storeMany(std::vector<std::pair<BlockId, Data>> blocks) {
+  if (blocks.size() <= 1) {
+    return BlockStore2::storeMany(std::move(blocks));
+  }
+
+  // Like removing, writing the block files is mostly waiting for the file system, so we write them in parallel.
+  _ioThreadPool.runSlices(blocks.size(), [this, &blocks] (size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      store(blocks[i].first, blocks[i].second);
+    }
+  });
+}
+
+bool OnDiskBlockStore2::_store(const boost::filesystem::path &filepath, const Data &data, bool overwriteExisting) {
   boost::filesystem::create_directory(filepath.parent_path()); // TODO Instead create all of them once at fs creation time?
-  fileContent.StoreToFile(filepath);
+  // Try to create the file exclusively first. That tells us whether the block is new without an additional stat() call.
+  bool created = true;
+  std::FILE *file = std::fopen(filepath.string().c_str(), "wbx");
+  if (file == nullptr && errno == EEXIST) {
+    if (!overwriteExisting) {
+      return false;
+    }
+    created = false;
+    file = std::fopen(filepath.string().c_str(), "wb");
+  }
+  if (file == nullptr) {
+    throw std::runtime_error("Could not open file for writing");
+  }
+  // Write header and block data one after the other instead of copying them into a combined buffer first
+  const bool written = formatVersionHeaderSize() == std::fwrite(FORMAT_VERSION_HEADER.c_str(), 1, formatVersionHeaderSize(), file)
+                    && data.size() == std::fwrite(data.data(), 1, data.size(), file);
+  const bool closed = (0 == std::fclose(file));
+  if (!written || !closed) {
+    throw std::runtime_error("Error writing to file");
+  }
+  return created;
+}
+
+void OnDiskBlockStore2::waitForBlockCountRebuild() const {
+  _blockCounter.waitForRebuild();
 }
 
 uint64_t OnDiskBlockStore2::numBlocks() const {
+  return _blockCounter.numBlocks();
+}
+
+uint64_t OnDiskBlockStore2::_countBlocksByWalking() const {
   uint64_t count = 0;
   for (auto prefixDir = boost::filesystem::directory_iterator(_rootDir); prefixDir != boost::filesystem::directory_iterator(); ++prefixDir) {
     if (boost::filesystem::is_directory(prefixDir->path())) {
@@ -3,10 +3,12 @@
 #define MESSMER_BLOCKSTORE_IMPLEMENTATIONS_ONDISK_ONDISKBLOCKSTORE2_H_
 
 #include "../../interface/BlockStore2.h"
+#include "BlockCounter.h"
 #include <boost/filesystem/path.hpp>
 #include <cpp-utils/macros.h>
 #include <cpp-utils/pointer/unique_ref.h>
 #include <cpp-utils/logging/logging.h>
+#include <cpp-utils/thread/ThreadPool.h>
 
 namespace blockstore {
 namespace ondisk {
@@ -14,24 +16,38 @@ namespace ondisk {
 class OnDiskBlockStore2 final: public BlockStore2 {
 public:
   explicit OnDiskBlockStore2(const boost::filesystem::path& path);
+  // blockCountFile is used to persist the number of blocks between runs, so numBlocks() doesn't have to walk the base directory.
+  OnDiskBlockStore2(const boost::filesystem::path& path, const boost::filesystem::path& blockCountFile);
 
   bool tryCreate(const BlockId &blockId, const cpputils::Data &data) override;
   bool remove(const BlockId &blockId) override;
+  uint64_t removeMany(const std::vector<BlockId> &blockIds) override;
   boost::optional<cpputils::Data> load(const BlockId &blockId) const override;
   void store(const BlockId &blockId, const cpputils::Data &data) override;
+  void storeMany(std::vector<std::pair<BlockId, cpputils::Data>> blocks) override;
   uint64_t numBlocks() const override;
   uint64_t estimateNumFreeBytes() const override;
   uint64_t blockSizeFromPhysicalBlockSize(uint64_t blockSize) const override;
   void forEachBlock(std::function<void (const BlockId &)> callback) const override;
 
+  // Exposed for tests: wait until a running background rebuild of the block count is finished.
+  void waitForBlockCountRebuild() const;
+
 private:
   boost::filesystem::path _rootDir;
+  BlockCounter _blockCounter;
+  cpputils::ThreadPool _ioThreadPool;
 
   static const std::string FORMAT_VERSION_HEADER_PREFIX;
   static const std::string FORMAT_VERSION_HEADER;
 
   boost::filesystem::path _getFilepath(const BlockId &blockId) const;
-  static cpputils::Data _checkAndRemoveHeader(const cpputils::Data &data);
+  uint64_t _countBlocksByWalking() const;
+  bool _removeBlockFile(const BlockId &blockId, const boost::filesystem::path &filepath);
+  static void _removeDirIfEmpty(const boost::filesystem::path &dir);
+  // Returns true if the block file didn't exist before. If it did exist and overwriteExisting is false, doesn't write anything.
+  static bool _store(const boost::filesystem::path &filepath, const cpputils::Data &data, bool overwriteExisting);
+  static cpputils::Data _checkAndRemoveHeader(cpputils::Data data);
   static bool _isAcceptedCryfsHeader(const cpputils::Data &data);
   static bool _isOtherCryfsHeader(const cpputils::Data &data);
   static unsigned int formatVersionHeaderSize();
@@ -70,6 +70,14 @@ void ParallelAccessBlockStore::remove(const BlockId &blockId) {
   return _parallelAccessStore.remove(blockId);
 }
 
+void ParallelAccessBlockStore::removeMany(const std::vector<BlockId> &blockIds) {
+  // Blocks that are currently opened have to wait until they're released, so they go through the usual remove().
+  // All others can be removed from the base store in one batch.
+  _parallelAccessStore.removeMany(blockIds, [this] (const std::vector<BlockId> &notOpened) {
+    _baseBlockStore->removeMany(notOpened);
+  });
+}
+
 uint64_t ParallelAccessBlockStore::numBlocks() const {
   return _baseBlockStore->numBlocks();
 }
@@ -21,6 +21,7 @@ public:
   cpputils::unique_ref<Block> overwrite(const BlockId &blockId, cpputils::Data data) override;
   void remove(const BlockId &blockId) override;
   void remove(cpputils::unique_ref<Block> node) override;
+  void removeMany(const std::vector<BlockId> &blockIds) override;
   uint64_t numBlocks() const override;
   uint64_t estimateNumFreeBytes() const override;
   uint64_t blockSizeFromPhysicalBlockSize(uint64_t blockSize) const override;
@@ -25,6 +25,7 @@ public:
   bool tryCreate(const BlockId &blockId, const cpputils::Data &data) override;
   bool remove(const BlockId &blockId) override;
   boost::optional<cpputils::Data> load(const BlockId &blockId) const override;
+  boost::optional<std::shared_ptr<const cpputils::Data>> loadShared(const BlockId &blockId) const override;
   void store(const BlockId &blockId, const cpputils::Data &data) override;
   uint64_t numBlocks() const override;
   uint64_t estimateNumFreeBytes() const override;
@@ -53,6 +54,10 @@ inline boost::optional<cpputils::Data> ReadOnlyBlockStore2::load(const BlockId &
     return _baseBlockStore->load(blockId);
 }
 
+inline boost::optional<std::shared_ptr<const cpputils::Data>> ReadOnlyBlockStore2::loadShared(const BlockId &blockId) const {
+    return _baseBlockStore->loadShared(blockId);
+}
+
 inline void ReadOnlyBlockStore2::store(const BlockId &/*blockId*/, const cpputils::Data &/*data*/) {
   throw std::logic_error("Tried to call store on a ReadOnlyBlockStore. Writes to the block store aren't allowed.");
 }
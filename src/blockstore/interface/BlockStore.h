@@ -4,6 +4,7 @@
 
 #include "Block.h"
 #include <string>
+#include <vector>
 #include <boost/optional.hpp>
 #include <cpp-utils/pointer/unique_ref.h>
 #include <cpp-utils/data/Data.h>
@@ -39,6 +40,13 @@ public:
     remove(blockId);
   }
 
+  // Removes all given blocks. Block stores can override this to remove the blocks in parallel or in a single batch.
+  virtual void removeMany(const std::vector<BlockId> &blockIds) {
+    for (const BlockId &blockId : blockIds) {
+      remove(blockId);
+    }
+  }
+
   cpputils::unique_ref<Block> create(const cpputils::Data &data) {
     while(true) {
       //TODO Copy (data.copy()) necessary?
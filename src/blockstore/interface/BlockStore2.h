@@ -4,6 +4,9 @@
 
 #include "Block.h"
 #include <string>
+#include <vector>
+#include <utility>
+#include <memory>
 #include <boost/optional.hpp>
 #include <cpp-utils/pointer/unique_ref.h>
 #include <cpp-utils/data/Data.h>
@@ -24,12 +27,44 @@ public:
   WARN_UNUSED_RESULT
   virtual bool remove(const BlockId &blockId) = 0;
 
+  // Removes all given blocks and returns the number of blocks that existed and were removed.
+  // Block stores can override this to remove the blocks in parallel or in a single batch.
+  WARN_UNUSED_RESULT
+  virtual uint64_t removeMany(const std::vector<BlockId> &blockIds) {
+    uint64_t numRemoved = 0;
+    for (const BlockId &blockId : blockIds) {
+      if (remove(blockId)) {
+        ++numRemoved;
+      }
+    }
+    return numRemoved;
+  }
+
   WARN_UNUSED_RESULT
   virtual boost::optional<cpputils::Data> load(const BlockId &blockId) const = 0;
 
+  // Like load(), but the returned data can be shared with the block store (e.g. with its cache) and must not be modified.
+  // Block stores keeping blocks in memory can override this to return them without copying.
+  WARN_UNUSED_RESULT
+  virtual boost::optional<std::shared_ptr<const cpputils::Data>> loadShared(const BlockId &blockId) const {
+    boost::optional<cpputils::Data> loaded = load(blockId);
+    if (loaded == boost::none) {
+      return boost::none;
+    }
+    return std::make_shared<const cpputils::Data>(std::move(*loaded));
+  }
+
   // Store the block with the given blockId. If it doesn't exist, it is created.
   virtual void store(const BlockId &blockId, const cpputils::Data &data) = 0;
 
+  // Stores all given blocks. If a block doesn't exist, it is created. Each blockId may only appear once.
+  // Block stores can override this to process the blocks in parallel, e.g. encrypt them on all cores.
+  virtual void storeMany(std::vector<std::pair<BlockId, cpputils::Data>> blocks) {
+    for (const auto &block : blocks) {
+      store(block.first, block.second);
+    }
+  }
+
   BlockId create(const cpputils::Data& data) {
     BlockId blockId = createBlockId();
     bool success = tryCreate(blockId, data);
@@ -9,6 +9,7 @@
 #include <vendor_cryptopp/modes.h>
 #include "Cipher.h"
 #include "EncryptionKey.h"
+#include "CipherContextCache.h"
 
 namespace cpputils {
 
@@ -28,11 +29,14 @@ public:
     return ciphertextBlockSize - IV_SIZE;
   }
 
-  static Data encrypt(const CryptoPP::byte *plaintext, unsigned int plaintextSize, const EncryptionKey &encKey);
+  static Data encrypt(const CryptoPP::byte *plaintext, unsigned int plaintextSize, const EncryptionKey &encKey, size_t headroom = 0);
   static boost::optional<Data> decrypt(const CryptoPP::byte *ciphertext, unsigned int ciphertextSize, const EncryptionKey &encKey);
 
 private:
   static constexpr unsigned int IV_SIZE = BlockCipher::BLOCKSIZE;
+
+  using Encryption = typename CryptoPP::CFB_Mode<BlockCipher>::Encryption;
+  using Decryption = typename CryptoPP::CFB_Mode<BlockCipher>::Decryption;
 };
 
 template<class BlockCipher, unsigned int KeySize>
@@ -41,12 +45,12 @@ template<class BlockCipher, unsigned int KeySize>
 constexpr unsigned int CFB_Cipher<BlockCipher, KeySize>::STRING_KEYSIZE;
 
 template<typename BlockCipher, unsigned int KeySize>
-Data CFB_Cipher<BlockCipher, KeySize>::encrypt(const CryptoPP::byte *plaintext, unsigned int plaintextSize, const EncryptionKey &encKey) {
+Data CFB_Cipher<BlockCipher, KeySize>::encrypt(const CryptoPP::byte *plaintext, unsigned int plaintextSize, const EncryptionKey &encKey, size_t headroom) {
   ASSERT(encKey.binaryLength() == KeySize, "Wrong key size");
 
   FixedSizeData<IV_SIZE> iv = Random::PseudoRandom().getFixedSize<IV_SIZE>();
-  auto encryption = typename CryptoPP::CFB_Mode<BlockCipher>::Encryption(static_cast<const CryptoPP::byte*>(encKey.data()), encKey.binaryLength(), iv.data());
-  Data ciphertext(ciphertextSize(plaintextSize));
+  Encryption &encryption = CipherContextCache<Encryption>::get(encKey, iv.data(), IV_SIZE);
+  Data ciphertext = Data::WithHeadroom(ciphertextSize(plaintextSize), headroom);
   iv.ToBinary(ciphertext.data());
   if (plaintextSize > 0) {
 	  encryption.ProcessData(static_cast<CryptoPP::byte*>(ciphertext.data()) + IV_SIZE, plaintext, plaintextSize);
@@ -64,7 +68,7 @@ boost::optional<Data> CFB_Cipher<BlockCipher, KeySize>::decrypt(const CryptoPP::
 
   const CryptoPP::byte *ciphertextIV = ciphertext;
   const CryptoPP::byte *ciphertextData = ciphertext + IV_SIZE;
-  auto decryption = typename CryptoPP::CFB_Mode<BlockCipher>::Decryption(static_cast<const CryptoPP::byte*>(encKey.data()), encKey.binaryLength(), ciphertextIV);
+  Decryption &decryption = CipherContextCache<Decryption>::get(encKey, ciphertextIV, IV_SIZE);
   Data plaintext(plaintextSize(ciphertextSize));
   if (plaintext.size() > 0) {
 	  // TODO Shouldn't we pass in ciphertextSize instead of plaintext.size() here as last argument (and also in the if above)?
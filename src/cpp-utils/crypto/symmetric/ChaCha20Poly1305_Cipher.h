@@ -0,0 +1,101 @@
+#pragma once
+#ifndef MESSMER_CPPUTILS_CRYPTO_SYMMETRIC_CHACHA20POLY1305CIPHER_H_
+#define MESSMER_CPPUTILS_CRYPTO_SYMMETRIC_CHACHA20POLY1305CIPHER_H_
+
+#include "../../data/FixedSizeData.h"
+#include "../../data/Data.h"
+#include "../../random/Random.h"
+#include <vendor_cryptopp/chachapoly.h>
+#include "Cipher.h"
+#include "EncryptionKey.h"
+#include "CipherContextCache.h"
+
+namespace cpputils {
+
+namespace details {
+// CryptoPP only offers the nonce size of the ChaCha20/Poly1305 schemes as a virtual function, but we need it at compile time.
+template<class Scheme> struct ChaCha20Poly1305_IVSize;
+template<> struct ChaCha20Poly1305_IVSize<CryptoPP::ChaCha20Poly1305> final {
+    static constexpr unsigned int value = 12;
+};
+template<> struct ChaCha20Poly1305_IVSize<CryptoPP::XChaCha20Poly1305> final {
+    static constexpr unsigned int value = 24;
+};
+}
+
+/**
+ * ChaCha20/Poly1305 AEAD (RFC 8439) and its extended-nonce variant XChaCha20/Poly1305.
+ * This is a stream cipher, so unlike the GCM ciphers it is fast without AES hardware support.
+ * CryptoPP uses its SSE2/AVX2/NEON implementation of ChaCha20 if the CPU supports it.
+ */
+template<typename Scheme, unsigned int KeySize>
+class ChaCha20Poly1305_Cipher {
+public:
+    using EncryptionKey = cpputils::EncryptionKey;
+
+    static_assert(KeySize == 32, "ChaCha20/Poly1305 only supports 256bit keys");
+    static constexpr unsigned int KEYSIZE = KeySize;
+    static constexpr unsigned int STRING_KEYSIZE = 2 * KEYSIZE;
+
+    static constexpr unsigned int ciphertextSize(unsigned int plaintextBlockSize) {
+        return plaintextBlockSize + IV_SIZE + TAG_SIZE;
+    }
+
+    static constexpr unsigned int plaintextSize(unsigned int ciphertextBlockSize) {
+        return ciphertextBlockSize - IV_SIZE - TAG_SIZE;
+    }
+
+    static Data encrypt(const CryptoPP::byte *plaintext, unsigned int plaintextSize, const EncryptionKey &encKey, size_t headroom = 0);
+    static boost::optional<Data> decrypt(const CryptoPP::byte *ciphertext, unsigned int ciphertextSize, const EncryptionKey &encKey);
+
+private:
+    static constexpr unsigned int IV_SIZE = details::ChaCha20Poly1305_IVSize<Scheme>::value;
+    static constexpr unsigned int TAG_SIZE = 16;
+
+    using Encryption = typename Scheme::Encryption;
+    using Decryption = typename Scheme::Decryption;
+};
+
+template<typename Scheme, unsigned int KeySize>
+constexpr unsigned int ChaCha20Poly1305_Cipher<Scheme, KeySize>::KEYSIZE;
+template<typename Scheme, unsigned int KeySize>
+constexpr unsigned int ChaCha20Poly1305_Cipher<Scheme, KeySize>::STRING_KEYSIZE;
+
+template<typename Scheme, unsigned int KeySize>
+Data ChaCha20Poly1305_Cipher<Scheme, KeySize>::encrypt(const CryptoPP::byte *plaintext, unsigned int plaintextSize, const EncryptionKey &encKey, size_t headroom) {
+    ASSERT(encKey.binaryLength() == KeySize, "Wrong key size");
+
+    FixedSizeData<IV_SIZE> iv = Random::PseudoRandom().getFixedSize<IV_SIZE>();
+    Encryption &encryption = CipherContextCache<Encryption>::get(encKey, iv.data(), IV_SIZE);
+    Data ciphertext = Data::WithHeadroom(ciphertextSize(plaintextSize), headroom);
+
+    iv.ToBinary(ciphertext.data());
+    CryptoPP::byte *ciphertextData = static_cast<CryptoPP::byte*>(ciphertext.dataOffset(IV_SIZE));
+    encryption.ProcessData(ciphertextData, plaintext, plaintextSize);
+    encryption.TruncatedFinal(ciphertextData + plaintextSize, TAG_SIZE);
+    return ciphertext;
+}
+
+template<typename Scheme, unsigned int KeySize>
+boost::optional<Data> ChaCha20Poly1305_Cipher<Scheme, KeySize>::decrypt(const CryptoPP::byte *ciphertext, unsigned int ciphertextSize, const EncryptionKey &encKey) {
+    ASSERT(encKey.binaryLength() == KeySize, "Wrong key size");
+
+    if (ciphertextSize < IV_SIZE + TAG_SIZE) {
+      return boost::none;
+    }
+
+    const CryptoPP::byte *ciphertextIV = ciphertext;
+    const CryptoPP::byte *ciphertextData = ciphertext + IV_SIZE;
+    Decryption &decryption = CipherContextCache<Decryption>::get(encKey, ciphertextIV, IV_SIZE);
+    Data plaintext(plaintextSize(ciphertextSize));
+
+    decryption.ProcessData(static_cast<CryptoPP::byte*>(plaintext.data()), ciphertextData, plaintext.size());
+    if (!decryption.TruncatedVerify(ciphertextData + plaintext.size(), TAG_SIZE)) {
+      return boost::none;
+    }
+    return plaintext;
+}
+
+}
+
+#endif
@@ -21,6 +21,8 @@ public:
     same_type(UINT32_C(0), X::STRING_KEYSIZE);
     typename X::EncryptionKey key = X::EncryptionKey::CreateKey(Random::OSRandom(), X::KEYSIZE);
     same_type(Data(0), X::encrypt(static_cast<uint8_t*>(nullptr), UINT32_C(0), key));
+    // The last parameter is the number of bytes of headroom to reserve in front of the ciphertext
+    same_type(Data(0), X::encrypt(static_cast<uint8_t*>(nullptr), UINT32_C(0), key, static_cast<size_t>(0)));
     same_type(boost::optional<Data>(Data(0)), X::decrypt(static_cast<uint8_t*>(nullptr), UINT32_C(0), key));
     string name = X::NAME;
   }
@@ -0,0 +1,99 @@
+#pragma once
+#ifndef MESSMER_CPPUTILS_CRYPTO_SYMMETRIC_CIPHERCONTEXTCACHE_H_
+#define MESSMER_CPPUTILS_CRYPTO_SYMMETRIC_CIPHERCONTEXTCACHE_H_
+
+#include "EncryptionKey.h"
+#include "../../data/Data.h"
+#include "../../system/memory.h"
+#include "../../macros.h"
+#include <vendor_cryptopp/cryptlib.h>
+#include <boost/optional.hpp>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+
+namespace cpputils {
+
+/**
+ * Keeps one keyed CryptoPP cipher context per thread and Context type.
+ * Keying a context computes the key schedule (and for GCM the GHASH tables), which is expensive compared to
+ * encrypting a single block. With this cache, that only happens when a thread sees a different key than before.
+ * For all other messages, the context is only resynchronized with the new IV.
+ *
+ * The context object lives in unswappable memory like the key itself. Buffers that CryptoPP allocates on its own
+ * are wiped when the context is destructed, but could be swapped out before that.
+ * Whenever any EncryptionKey is destructed, each thread wipes its context on its next call to get(), so a context
+ * doesn't keep the key schedule of a key that doesn't exist anymore for longer than necessary.
+ */
+template<class Context>
+class CipherContextCache final {
+public:
+  // Returns the calling thread's context, keyed with the given key and synchronized to the given IV.
+  // The returned reference must not be used after the next call to get() from the same thread.
+  static Context &get(const EncryptionKey &key, const CryptoPP::byte *iv, size_t ivSize) {
+    thread_local CipherContextCache cache;
+    if (cache._keyDestructionGeneration != EncryptionKey::destructionGeneration()) {
+      // Some key was destructed since we keyed the context. It might have been ours, so don't keep its key schedule around.
+      cache._clear();
+    }
+    if (!cache._isKeyedWith(key)) {
+      cache._setKey(key, iv, ivSize);
+    } else {
+      cache._context()->Resynchronize(iv, static_cast<int>(ivSize));
+    }
+    return *cache._context();
+  }
+
+  ~CipherContextCache() {
+    _clear();
+  }
+
+private:
+  static_assert(alignof(Context) <= alignof(std::max_align_t), "The allocator doesn't align memory for this context type");
+
+  CipherContextCache(): _contextMemory(sizeof(Context), make_unique_ref<UnswappableAllocator>()), _key(boost::none), _keyDestructionGeneration(0) {}
+
+  Context *_context() {
+    return static_cast<Context*>(_contextMemory.data());
+  }
+
+  bool _isKeyedWith(const EncryptionKey &key) const {
+    return _key != boost::none && _key->size() == key.binaryLength() && 0 == std::memcmp(_key->data(), key.data(), key.binaryLength());
+  }
+
+  void _setKey(const EncryptionKey &key, const CryptoPP::byte *iv, size_t ivSize) {
+    _clear();
+    _keyDestructionGeneration = EncryptionKey::destructionGeneration();
+    new (_contextMemory.data()) Context();
+    // We keep our own copy of the key (instead of holding on to the EncryptionKey) so we notice if the key is changed in place.
+    Data keyCopy(key.binaryLength(), make_unique_ref<UnswappableAllocator>());
+    std::memcpy(keyCopy.data(), key.data(), key.binaryLength());
+    _key = std::move(keyCopy);
+    try {
+      _context()->SetKeyWithIV(static_cast<const CryptoPP::byte*>(key.data()), key.binaryLength(), iv, ivSize);
+    } catch (...) {
+      _clear();
+      throw;
+    }
+  }
+
+  // Destructs the context, which wipes the key schedule, and forgets the key.
+  void _clear() {
+    if (_key != boost::none) {
+      _context()->~Context();
+      _key = boost::none;
+    }
+  }
+
+  // The context is only constructed in this memory while _key is set
+  Data _contextMemory;
+  boost::optional<Data> _key;
+  uint64_t _keyDestructionGeneration;
+
+  DISALLOW_COPY_AND_ASSIGN(CipherContextCache);
+};
+
+}
+
+#endif
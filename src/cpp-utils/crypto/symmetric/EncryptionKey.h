@@ -4,6 +4,7 @@
 
 #include <cpp-utils/data/FixedSizeData.h>
 #include <memory>
+#include <atomic>
 #include <cpp-utils/system/memory.h>
 #include <cpp-utils/random/RandomGenerator.h>
 
@@ -39,16 +40,13 @@ public:
     }
 
     static EncryptionKey Null(size_t keySize) {
-        auto data = std::make_shared<Data>(
-            keySize,
-            make_unique_ref<UnswappableAllocator>()
-        );
+        auto data = _allocate(keySize);
         data->FillWithZeroes();
         return EncryptionKey(std::move(data));
     }
 
     static EncryptionKey FromString(const std::string& keyData) {
-        auto data = std::make_shared<Data>(
+        auto data = _manage(
             Data::FromString(keyData, make_unique_ref<UnswappableAllocator>())
         );
         EncryptionKey key(std::move(data));
@@ -64,10 +62,7 @@ public:
     }
 
     static EncryptionKey CreateKey(RandomGenerator &randomGenerator, size_t keySize) {
-        EncryptionKey result(std::make_shared<Data>(
-            keySize,
-            make_unique_ref<UnswappableAllocator>() // the allocator makes sure key data is never swapped to disk
-        ));
+        EncryptionKey result(_allocate(keySize));
         randomGenerator.write(result._keyData->data(), keySize);
         return result;
     }
@@ -84,7 +79,7 @@ public:
 
     EncryptionKey take(size_t numTaken) const {
         ASSERT(numTaken <= _keyData->size(), "Out of bounds");
-        auto result = std::make_shared<Data>(numTaken, make_unique_ref<UnswappableAllocator>());
+        auto result = _allocate(numTaken);
         std::memcpy(result->data(), _keyData->data(), numTaken);
         return EncryptionKey(std::move(result));
     }
@@ -92,12 +87,35 @@ public:
     EncryptionKey drop(size_t numDropped) const {
         ASSERT(numDropped <= _keyData->size(), "Out of bounds");
         const size_t resultSize = _keyData->size() - numDropped;
-        auto result = std::make_shared<Data>(resultSize, make_unique_ref<UnswappableAllocator>());
+        auto result = _allocate(resultSize);
         std::memcpy(result->data(), _keyData->dataOffset(numDropped), resultSize);
         return EncryptionKey(std::move(result));
     }
 
+    // Increases whenever the memory of a key is freed. Caches that keep data derived from a key (e.g. key schedules)
+    // compare it to notice that they might be holding on to a key that doesn't exist anymore, and wipe that data.
+    static uint64_t destructionGeneration() {
+        return _destructionGeneration().load();
+    }
+
 private:
+    static std::shared_ptr<Data> _allocate(size_t keySize) {
+        // the allocator makes sure key data is never swapped to disk
+        return _manage(Data(keySize, make_unique_ref<UnswappableAllocator>()));
+    }
+
+    static std::shared_ptr<Data> _manage(Data keyData) {
+        return std::shared_ptr<Data>(new Data(std::move(keyData)), [] (Data *data) {
+            delete data;
+            ++_destructionGeneration();
+        });
+    }
+
+    static std::atomic<uint64_t> &_destructionGeneration() {
+        static std::atomic<uint64_t> generation(0);
+        return generation;
+    }
+
     std::shared_ptr<Data> _keyData;
 };
 
@@ -8,6 +8,7 @@
 #include <vendor_cryptopp/gcm.h>
 #include "Cipher.h"
 #include "EncryptionKey.h"
+#include "CipherContextCache.h"
 
 namespace cpputils {
 
@@ -27,12 +28,16 @@ public:
         return ciphertextBlockSize - IV_SIZE - TAG_SIZE;
     }
 
-    static Data encrypt(const CryptoPP::byte *plaintext, unsigned int plaintextSize, const EncryptionKey &encKey);
+    static Data encrypt(const CryptoPP::byte *plaintext, unsigned int plaintextSize, const EncryptionKey &encKey, size_t headroom = 0);
     static boost::optional<Data> decrypt(const CryptoPP::byte *ciphertext, unsigned int ciphertextSize, const EncryptionKey &encKey);
 
 private:
     static constexpr unsigned int IV_SIZE = BlockCipher::BLOCKSIZE;
     static constexpr unsigned int TAG_SIZE = 16;
+
+    // Keying a GCM context builds its 64KiB GHASH tables, so we reuse the contexts across blocks.
+    using Encryption = typename CryptoPP::GCM<BlockCipher, CryptoPP::GCM_64K_Tables>::Encryption;
+    using Decryption = typename CryptoPP::GCM<BlockCipher, CryptoPP::GCM_64K_Tables>::Decryption;
 };
 
 template<class BlockCipher, unsigned int KeySize>
@@ -41,21 +46,17 @@ template<class BlockCipher, unsigned int KeySize>
 constexpr unsigned int GCM_Cipher<BlockCipher, KeySize>::STRING_KEYSIZE;
 
 template<typename BlockCipher, unsigned int KeySize>
-Data GCM_Cipher<BlockCipher, KeySize>::encrypt(const CryptoPP::byte *plaintext, unsigned int plaintextSize, const EncryptionKey &encKey) {
+Data GCM_Cipher<BlockCipher, KeySize>::encrypt(const CryptoPP::byte *plaintext, unsigned int plaintextSize, const EncryptionKey &encKey, size_t headroom) {
     ASSERT(encKey.binaryLength() == KeySize, "Wrong key size");
 
     FixedSizeData<IV_SIZE> iv = Random::PseudoRandom().getFixedSize<IV_SIZE>();
-    typename CryptoPP::GCM<BlockCipher, CryptoPP::GCM_64K_Tables>::Encryption encryption;
-    encryption.SetKeyWithIV(static_cast<const CryptoPP::byte*>(encKey.data()), encKey.binaryLength(), iv.data(), IV_SIZE);
-    Data ciphertext(ciphertextSize(plaintextSize));
+    Encryption &encryption = CipherContextCache<Encryption>::get(encKey, iv.data(), IV_SIZE);
+    Data ciphertext = Data::WithHeadroom(ciphertextSize(plaintextSize), headroom);
 
     iv.ToBinary(ciphertext.data());
-    CryptoPP::ArraySource(plaintext, plaintextSize, true,
-      new CryptoPP::AuthenticatedEncryptionFilter(encryption,
-        new CryptoPP::ArraySink(static_cast<CryptoPP::byte*>(ciphertext.data()) + IV_SIZE, ciphertext.size() - IV_SIZE),
-        false, TAG_SIZE
-      )
-    );
+    CryptoPP::byte *ciphertextData = static_cast<CryptoPP::byte*>(ciphertext.dataOffset(IV_SIZE));
+    encryption.ProcessData(ciphertextData, plaintext, plaintextSize);
+    encryption.TruncatedFinal(ciphertextData + plaintextSize, TAG_SIZE);
     return ciphertext;
 }
 
@@ -69,21 +70,14 @@ boost::optional<Data> GCM_Cipher<BlockCipher, KeySize>::decrypt(const CryptoPP::
 
     const CryptoPP::byte *ciphertextIV = ciphertext;
     const CryptoPP::byte *ciphertextData = ciphertext + IV_SIZE;
-    typename CryptoPP::GCM<BlockCipher, CryptoPP::GCM_64K_Tables>::Decryption decryption;
-    decryption.SetKeyWithIV(static_cast<const CryptoPP::byte*>(encKey.data()), encKey.binaryLength(), ciphertextIV, IV_SIZE);
+    Decryption &decryption = CipherContextCache<Decryption>::get(encKey, ciphertextIV, IV_SIZE);
     Data plaintext(plaintextSize(ciphertextSize));
 
-    try {
-        CryptoPP::ArraySource(static_cast<const CryptoPP::byte*>(ciphertextData), ciphertextSize - IV_SIZE, true,
-        new CryptoPP::AuthenticatedDecryptionFilter(decryption,
-          new CryptoPP::ArraySink(static_cast<CryptoPP::byte*>(plaintext.data()), plaintext.size()),
-          CryptoPP::AuthenticatedDecryptionFilter::DEFAULT_FLAGS, TAG_SIZE
-        )
-      );
-      return plaintext;
-    } catch (const CryptoPP::HashVerificationFilter::HashVerificationFailed &e) {
+    decryption.ProcessData(static_cast<CryptoPP::byte*>(plaintext.data()), ciphertextData, plaintext.size());
+    if (!decryption.TruncatedVerify(ciphertextData + plaintext.size(), TAG_SIZE)) {
       return boost::none;
     }
+    return plaintext;
 }
     
 }
@@ -30,4 +30,7 @@ namespace cpputils {
     DEFINE_CIPHER(Mars128_GCM);
     DEFINE_CIPHER(Mars128_CFB);
 
+    DEFINE_CIPHER(ChaCha20_Poly1305);
+    DEFINE_CIPHER(XChaCha20_Poly1305);
+
 }
@@ -9,6 +9,7 @@
 #include <vendor_cryptopp/mars.h>
 #include "GCM_Cipher.h"
 #include "CFB_Cipher.h"
+#include "ChaCha20Poly1305_Cipher.h"
 
 #define DECLARE_CIPHER(InstanceName, StringName, Mode, Base, Keysize) \
     class InstanceName final: public Mode<Base, Keysize> {            \
@@ -49,6 +50,9 @@ DECLARE_CIPHER(Mars256_CFB, "mars-256-cfb", CFB_Cipher, CryptoPP::MARS, 32);
 DECLARE_CIPHER(Mars128_GCM, "mars-128-gcm", GCM_Cipher, CryptoPP::MARS, 16);
 DECLARE_CIPHER(Mars128_CFB, "mars-128-cfb", CFB_Cipher, CryptoPP::MARS, 16);
 
+DECLARE_CIPHER(ChaCha20_Poly1305, "chacha20-poly1305", ChaCha20Poly1305_Cipher, CryptoPP::ChaCha20Poly1305, 32);
+DECLARE_CIPHER(XChaCha20_Poly1305, "xchacha20-poly1305", ChaCha20Poly1305_Cipher, CryptoPP::XChaCha20Poly1305, 32);
+
 }
 
 #endif
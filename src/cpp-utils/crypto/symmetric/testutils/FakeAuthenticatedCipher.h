@@ -55,8 +55,8 @@ namespace cpputils {
           return ciphertextBlockSize - sizeof(uint64_t) - sizeof(uint64_t);
         }
 
-        static Data encrypt(const CryptoPP::byte *plaintext, unsigned int plaintextSize, const EncryptionKey &encKey) {
-          Data result(ciphertextSize(plaintextSize));
+        static Data encrypt(const CryptoPP::byte *plaintext, unsigned int plaintextSize, const EncryptionKey &encKey, size_t headroom = 0) {
+          Data result = Data::WithHeadroom(ciphertextSize(plaintextSize), headroom);
 
           //Add a random IV
           uint64_t iv = std::uniform_int_distribution<uint64_t>()(random_);
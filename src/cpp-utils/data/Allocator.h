@@ -0,0 +1,31 @@
+#pragma once
+#ifndef MESSMER_CPPUTILS_DATA_ALLOCATOR_H_
+#define MESSMER_CPPUTILS_DATA_ALLOCATOR_H_
+
+#include <cstdlib>
+
+namespace cpputils {
+
+struct Allocator {
+  virtual ~Allocator() = default;
+
+  virtual void* allocate(size_t size) = 0;
+  virtual void free(void* ptr, size_t size) = 0;
+};
+
+class DefaultAllocator final : public Allocator {
+public:
+    void* allocate(size_t size) override {
+      // std::malloc has implementation defined behavior for size=0.
+      // Let's define the behavior.
+      return std::malloc((size == 0) ? 1 : size);
+    }
+
+    void free(void* data, size_t /*size*/) override {
+      std::free(data);
+    }
+};
+
+}
+
+#endif
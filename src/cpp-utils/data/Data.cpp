@@ -43,19 +43,28 @@ Data Data::LoadFromStream(istream &stream, size_t size) {
   return result;
 }
 
+Data Data::FromString(const std::string &data) {
+  ASSERT(data.size() % 2 == 0, "hex encoded data cannot have odd number of characters");
+  Data result(data.size() / 2);
+  result._decodeHex(data);
+  return result;
+}
+
 Data Data::FromString(const std::string &data, unique_ref<Allocator> allocator) {
   ASSERT(data.size() % 2 == 0, "hex encoded data cannot have odd number of characters");
   Data result(data.size() / 2, std::move(allocator));
-  {
-    CryptoPP::StringSource _1(data, true,
-      new CryptoPP::HexDecoder(
-        new CryptoPP::ArraySink(static_cast<CryptoPP::byte*>(result._data), result.size())
-      )
-    );
-  }
+  result._decodeHex(data);
   return result;
 }
 
+void Data::_decodeHex(const std::string &data) {
+  CryptoPP::StringSource _1(data, true,
+    new CryptoPP::HexDecoder(
+      new CryptoPP::ArraySink(static_cast<CryptoPP::byte*>(_data), _size)
+    )
+  );
+}
+
 std::string Data::ToString() const {
   std::string result;
   {
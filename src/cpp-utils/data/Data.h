@@ -10,32 +10,20 @@
 #include <fstream>
 #include "../assert/assert.h"
 #include "../pointer/unique_ref.h"
+#include "Allocator.h"
+#include "PooledAllocator.h"
 
 namespace cpputils {
 
-struct Allocator {
-  virtual ~Allocator() = default;
-
-  virtual void* allocate(size_t size) = 0;
-  virtual void free(void* ptr, size_t size) = 0;
-};
-
-class DefaultAllocator final : public Allocator {
-public:
-    void* allocate(size_t size) override {
-      // std::malloc has implementation defined behavior for size=0.
-      // Let's define the behavior.
-      return std::malloc((size == 0) ? 1 : size);
-    }
-
-    void free(void* data, size_t /*size*/) override {
-      std::free(data);
-    }
-};
-
 class Data final {
 public:
-  explicit Data(size_t size, unique_ref<Allocator> allocator = make_unique_ref<DefaultAllocator>());
+  // Allocates from the shared PooledAllocator. This doesn't need any per-object allocator instance.
+  explicit Data(size_t size);
+  Data(size_t size, unique_ref<Allocator> allocator);
+
+  // Creates a Data object with `headroom` bytes of unused memory in front of data().
+  // Headers can then be prepended in place with growIntoHeadroom() without copying the data.
+  static Data WithHeadroom(size_t size, size_t headroom);
   ~Data();
 
   Data(Data &&rhs) noexcept;
@@ -55,6 +43,15 @@ public:
 
   size_t size() const;
 
+  // Number of bytes of unused memory in front of data()
+  size_t headroom() const;
+
+  // Moves the start of the data numBytes to the front, into the headroom. The new bytes are uninitialized.
+  void growIntoHeadroom(size_t numBytes);
+
+  // Removes the first numBytes of the data in place, without copying. They become part of the headroom.
+  void removePrefix(size_t numBytes);
+
   Data &FillWithZeroes() &;
   Data &&FillWithZeroes() &&;
 
@@ -67,16 +64,23 @@ public:
   void StoreToStream(std::ostream &stream) const;
 
   // TODO Unify ToString/FromString functions from Data/FixedSizeData using free functions
-  static Data FromString(const std::string &data, unique_ref<Allocator> allocator = make_unique_ref<DefaultAllocator>());
+  static Data FromString(const std::string &data);
+  static Data FromString(const std::string &data, unique_ref<Allocator> allocator);
   std::string ToString() const;
 
 private:
-  std::unique_ptr<Allocator> _allocator;
+  // _allocator is either the shared PooledAllocator or points to _ownedAllocator
+  Allocator *_allocator;
+  std::unique_ptr<Allocator> _ownedAllocator;
+  // The allocated memory. The data visible to users is the subrange [_data, _data + _size) of it.
+  size_t _allocatedSize;
+  void *_allocatedData;
   size_t _size;
   void *_data;
 
   static std::streampos _getStreamSize(std::istream &stream);
   void _readFromStream(std::istream &stream);
+  void _decodeHex(const std::string &data);
   void _free();
 
   DISALLOW_COPY_AND_ASSIGN(Data);
@@ -90,27 +94,47 @@ bool operator!=(const Data &lhs, const Data &rhs);
 // Inline function definitions
 // ---------------------------
 
+inline Data::Data(size_t size)
+        : _allocator(&PooledAllocator::singleton()), _ownedAllocator(nullptr), _allocatedSize(size), _allocatedData(_allocator->allocate(_allocatedSize)), _size(size), _data(_allocatedData) {
+  if (nullptr == _data) {
+    throw std::bad_alloc();
+  }
+}
+
 inline Data::Data(size_t size, unique_ref<Allocator> allocator)
-        : _allocator(std::move(allocator)), _size(size), _data(_allocator->allocate(_size)) {
+        : _allocator(allocator.get()), _ownedAllocator(std::move(allocator)), _allocatedSize(size), _allocatedData(_allocator->allocate(_allocatedSize)), _size(size), _data(_allocatedData) {
   if (nullptr == _data) {
     throw std::bad_alloc();
   }
 }
 
+inline Data Data::WithHeadroom(size_t size, size_t headroom) {
+  Data result(headroom + size);
+  result.removePrefix(headroom);
+  return result;
+}
+
 inline Data::Data(Data &&rhs) noexcept
-        : _allocator(std::move(rhs._allocator)), _size(rhs._size), _data(rhs._data) {
+        : _allocator(rhs._allocator), _ownedAllocator(std::move(rhs._ownedAllocator)), _allocatedSize(rhs._allocatedSize), _allocatedData(rhs._allocatedData), _size(rhs._size), _data(rhs._data) {
   // Make rhs invalid, so the memory doesn't get freed in its destructor.
   rhs._allocator = nullptr;
+  rhs._allocatedData = nullptr;
+  rhs._allocatedSize = 0;
   rhs._data = nullptr;
   rhs._size = 0;
 }
 
 inline Data &Data::operator=(Data &&rhs) noexcept {
   _free();
-  _allocator = std::move(rhs._allocator);
+  _allocator = rhs._allocator;
+  _ownedAllocator = std::move(rhs._ownedAllocator);
+  _allocatedData = rhs._allocatedData;
+  _allocatedSize = rhs._allocatedSize;
   _data = rhs._data;
   _size = rhs._size;
   rhs._allocator = nullptr;
+  rhs._allocatedData = nullptr;
+  rhs._allocatedSize = 0;
   rhs._data = nullptr;
   rhs._size = 0;
 
@@ -122,10 +146,13 @@ inline Data::~Data() {
 }
 
 inline void Data::_free() {
-    if (nullptr != _allocator.get()) {
-        _allocator->free(_data, _size);
+    if (nullptr != _allocator) {
+        _allocator->free(_allocatedData, _allocatedSize);
     }
     _allocator = nullptr;
+    _ownedAllocator = nullptr;
+    _allocatedData = nullptr;
+    _allocatedSize = 0;
     _data = nullptr;
     _size = 0;
 }
@@ -163,6 +190,22 @@ inline size_t Data::size() const {
   return _size;
 }
 
+inline size_t Data::headroom() const {
+  return static_cast<const uint8_t*>(_data) - static_cast<const uint8_t*>(_allocatedData);
+}
+
+inline void Data::growIntoHeadroom(size_t numBytes) {
+  ASSERT(numBytes <= headroom(), "Not enough headroom");
+  _data = static_cast<uint8_t*>(_data) - numBytes;
+  _size += numBytes;
+}
+
+inline void Data::removePrefix(size_t numBytes) {
+  ASSERT(numBytes <= _size, "Can't remove more than there is");
+  _data = static_cast<uint8_t*>(_data) + numBytes;
+  _size -= numBytes;
+}
+
 inline Data &Data::FillWithZeroes() & {
     std::memset(_data, 0, _size);
     return *this;
@@ -0,0 +1,120 @@
+#include "PooledAllocator.h"
+#include <array>
+#include <atomic>
+#include <vector>
+
+namespace cpputils {
+
+constexpr size_t PooledAllocator::SIZE_CLASS_GRANULARITY;
+constexpr size_t PooledAllocator::MIN_POOLED_SIZE;
+constexpr size_t PooledAllocator::MAX_POOLED_SIZE;
+constexpr size_t PooledAllocator::MAX_CACHED_BYTES_PER_THREAD;
+
+namespace {
+constexpr size_t NUM_SIZE_CLASSES = PooledAllocator::MAX_POOLED_SIZE / PooledAllocator::SIZE_CLASS_GRANULARITY;
+
+bool isPooledSize(size_t size) {
+  return size >= PooledAllocator::MIN_POOLED_SIZE && size <= PooledAllocator::MAX_POOLED_SIZE;
+}
+
+size_t sizeClassIndex(size_t size) {
+  return (size - 1) / PooledAllocator::SIZE_CLASS_GRANULARITY;
+}
+
+size_t sizeClassBytes(size_t sizeClassIndex) {
+  return (sizeClassIndex + 1) * PooledAllocator::SIZE_CLASS_GRANULARITY;
+}
+
+std::atomic<uint64_t> numPoolHits(0);
+std::atomic<uint64_t> numPoolMisses(0);
+std::atomic<uint64_t> numUnpooledAllocations(0);
+
+class ThreadLocalPool final {
+public:
+  ThreadLocalPool(): _freeBuffers(), _cachedBytes(0) {}
+
+  ~ThreadLocalPool();
+
+  void *pop(size_t sizeClass) {
+    auto &freeList = _freeBuffers[sizeClass];
+    if (freeList.empty()) {
+      return nullptr;
+    }
+    void *result = freeList.back();
+    freeList.pop_back();
+    _cachedBytes -= sizeClassBytes(sizeClass);
+    return result;
+  }
+
+  bool push(size_t sizeClass, void *ptr) {
+    const size_t bytes = sizeClassBytes(sizeClass);
+    if (_cachedBytes + bytes > PooledAllocator::MAX_CACHED_BYTES_PER_THREAD) {
+      return false;
+    }
+    _freeBuffers[sizeClass].push_back(ptr);
+    _cachedBytes += bytes;
+    return true;
+  }
+
+private:
+  std::array<std::vector<void*>, NUM_SIZE_CLASSES> _freeBuffers;
+  size_t _cachedBytes;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadLocalPool);
+};
+
+// Data objects can still be destructed after the thread local pool of their thread is gone
+// (e.g. static Data instances destructed after the main thread's thread locals).
+// This flag is trivially destructible and can be checked safely at that point.
+thread_local bool threadLocalPoolDestructed = false;
+thread_local ThreadLocalPool threadLocalPool;
+
+ThreadLocalPool::~ThreadLocalPool() {
+  threadLocalPoolDestructed = true;
+  for (auto &freeList : _freeBuffers) {
+    for (void *ptr : freeList) {
+      std::free(ptr);
+    }
+  }
+}
+}
+
+PooledAllocator &PooledAllocator::singleton() {
+  static PooledAllocator singleton;
+  return singleton;
+}
+
+PooledAllocator::Statistics PooledAllocator::statistics() {
+  return Statistics{numPoolHits.load(), numPoolMisses.load(), numUnpooledAllocations.load()};
+}
+
+void* PooledAllocator::allocate(size_t size) {
+  if (!isPooledSize(size)) {
+    numUnpooledAllocations.fetch_add(1, std::memory_order_relaxed);
+    // std::malloc has implementation defined behavior for size=0.
+    // Let's define the behavior.
+    return std::malloc((size == 0) ? 1 : size);
+  }
+  const size_t sizeClass = sizeClassIndex(size);
+  if (!threadLocalPoolDestructed) {
+    void *result = threadLocalPool.pop(sizeClass);
+    if (nullptr != result) {
+      numPoolHits.fetch_add(1, std::memory_order_relaxed);
+      return result;
+    }
+  }
+  numPoolMisses.fetch_add(1, std::memory_order_relaxed);
+  // Always allocate the full size class so the buffer can later be reused for any size in this class.
+  return std::malloc(sizeClassBytes(sizeClass));
+}
+
+void PooledAllocator::free(void* ptr, size_t size) {
+  if (nullptr != ptr && isPooledSize(size) && !threadLocalPoolDestructed) {
+    if (threadLocalPool.push(sizeClassIndex(size), ptr)) {
+      return;
+    }
+  }
+  std::free(ptr);
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+#ifndef MESSMER_CPPUTILS_DATA_POOLEDALLOCATOR_H_
+#define MESSMER_CPPUTILS_DATA_POOLEDALLOCATOR_H_
+
+#include "Allocator.h"
+#include "../macros.h"
+#include <cstdint>
+
+namespace cpputils {
+
+/**
+ * Allocator that keeps freed buffers in a thread local, size-classed free list and hands them out again
+ * for later allocations of the same size class. This avoids going to malloc for every block-sized
+ * buffer we create when loading, decrypting, encrypting or storing a block.
+ * Buffers smaller than MIN_POOLED_SIZE or larger than MAX_POOLED_SIZE are directly passed through to malloc.
+ *
+ * The allocator itself is stateless, all Data objects share the instance returned by singleton().
+ */
+class PooledAllocator final : public Allocator {
+public:
+  static constexpr size_t SIZE_CLASS_GRANULARITY = 4096;
+  static constexpr size_t MIN_POOLED_SIZE = 4096;
+  static constexpr size_t MAX_POOLED_SIZE = 128 * 1024;
+  // Upper limit for the memory each thread keeps cached in its free lists
+  static constexpr size_t MAX_CACHED_BYTES_PER_THREAD = 4 * 1024 * 1024;
+
+  struct Statistics final {
+    // Allocations that were served from a free list
+    uint64_t numPoolHits;
+    // Allocations in the pooled size range that had to go to malloc
+    uint64_t numPoolMisses;
+    // Allocations outside of the pooled size range
+    uint64_t numUnpooledAllocations;
+  };
+
+  static PooledAllocator &singleton();
+
+  // Counters summed up over all threads since program start
+  static Statistics statistics();
+
+  void* allocate(size_t size) override;
+  void free(void* ptr, size_t size) override;
+
+private:
+  PooledAllocator() = default;
+
+  DISALLOW_COPY_AND_ASSIGN(PooledAllocator);
+};
+
+}
+
+#endif
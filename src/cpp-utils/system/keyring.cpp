@@ -0,0 +1,117 @@
+#include "keyring.h"
+#include <stdexcept>
+
+#if defined(__linux__)
+
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/keyctl.h>
+#include <cerrno>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+
+namespace {
+// These come from keyutils.h, but we call the syscalls directly to not depend on libkeyutils
+constexpr uint32_t KEY_POS_ALL = 0x3f000000;
+constexpr uint32_t KEY_USR_VIEW = 0x00010000;
+constexpr uint32_t KEY_USR_READ = 0x00020000;
+constexpr uint32_t KEY_USR_WRITE = 0x00040000;
+constexpr uint32_t KEY_USR_SEARCH = 0x00080000;
+constexpr uint32_t KEY_USR_SETATTR = 0x00200000;
+
+constexpr const char* KEY_TYPE = "user";
+
+long searchKey(const std::string& description) {
+	return syscall(SYS_keyctl, KEYCTL_SEARCH, KEY_SPEC_USER_KEYRING, KEY_TYPE, description.c_str(), 0);
+}
+
+void removeKey(long keyId) {
+	if (0 != syscall(SYS_keyctl, KEYCTL_INVALIDATE, keyId)) {
+		// Kernels older than 3.5 don't support KEYCTL_INVALIDATE
+		syscall(SYS_keyctl, KEYCTL_UNLINK, keyId, KEY_SPEC_USER_KEYRING);
+	}
+}
+}
+
+namespace cpputils {
+namespace keyring {
+
+bool isSupported() {
+	// Containers often forbid the keyring syscalls (EPERM from seccomp), and some kernels are built without keyring support (ENOSYS).
+	if (-1 == syscall(SYS_keyctl, KEYCTL_GET_KEYRING_ID, KEY_SPEC_USER_KEYRING, 0)) {
+		return errno != EPERM && errno != ENOSYS;
+	}
+	return true;
+}
+
+void store(const std::string& description, const void* data, size_t size, std::chrono::seconds timeout) {
+	if (timeout.count() <= 0) {
+		// A timeout of 0 would keep the key forever
+		throw std::invalid_argument("Keyring entries need a positive timeout");
+	}
+	// The kernel takes the timeout as unsigned int. Longer timeouts are cut to the longest one it can represent.
+	const unsigned int timeoutSeconds = static_cast<unsigned int>(std::min<std::chrono::seconds::rep>(timeout.count(), std::numeric_limits<unsigned int>::max()));
+	long keyId = syscall(SYS_add_key, KEY_TYPE, description.c_str(), data, size, KEY_SPEC_USER_KEYRING);
+	if (keyId == -1) {
+		throw std::runtime_error("Error adding key to the user keyring. Errno: " + std::to_string(errno));
+	}
+	// By default, only processes possessing the user keyring can read the key, which isn't the case for all sessions.
+	// Allow all processes of this user, but not other users.
+	const uint32_t permissions = KEY_POS_ALL | KEY_USR_VIEW | KEY_USR_READ | KEY_USR_WRITE | KEY_USR_SEARCH | KEY_USR_SETATTR;
+	if (0 != syscall(SYS_keyctl, KEYCTL_SETPERM, keyId, permissions)) {
+		int error = errno;
+		removeKey(keyId);
+		throw std::runtime_error("Error setting permissions of key in the user keyring. Errno: " + std::to_string(error));
+	}
+	if (0 != syscall(SYS_keyctl, KEYCTL_SET_TIMEOUT, keyId, timeoutSeconds)) {
+		int error = errno;
+		// Don't leave a key without timeout in the keyring
+		removeKey(keyId);
+		throw std::runtime_error("Error setting timeout of key in the user keyring. Errno: " + std::to_string(error));
+	}
+}
+
+bool load(const std::string& description, void* target, size_t size) {
+	long keyId = searchKey(description);
+	if (keyId == -1) {
+		return false;
+	}
+	long readSize = syscall(SYS_keyctl, KEYCTL_READ, keyId, target, size);
+	return readSize >= 0 && static_cast<size_t>(readSize) == size;
+}
+
+void remove(const std::string& description) {
+	long keyId = searchKey(description);
+	if (keyId != -1) {
+		removeKey(keyId);
+	}
+}
+
+}
+}
+
+#else
+
+namespace cpputils {
+namespace keyring {
+
+bool isSupported() {
+	return false;
+}
+
+void store(const std::string& /*description*/, const void* /*data*/, size_t /*size*/, std::chrono::seconds /*timeout*/) {
+	throw std::runtime_error("The kernel keyring isn't supported on this platform");
+}
+
+bool load(const std::string& /*description*/, void* /*target*/, size_t /*size*/) {
+	return false;
+}
+
+void remove(const std::string& /*description*/) {
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+#ifndef MESSMER_CPPUTILS_SYSTEM_KEYRING_H
+#define MESSMER_CPPUTILS_SYSTEM_KEYRING_H
+
+#include <chrono>
+#include <string>
+
+namespace cpputils {
+namespace keyring {
+
+/**
+ * Stores secrets in the kernel keyring of the current user. Entries live in kernel memory, are only readable
+ * by processes of the same user and are dropped by the kernel when their timeout expires.
+ * Currently only supported on Linux.
+ */
+
+bool isSupported();
+
+// Stores the data under the given description, replacing an existing entry with the same description.
+// Throws if the data can't be stored.
+void store(const std::string& description, const void* data, size_t size, std::chrono::seconds timeout);
+
+// Reads the entry with the given description into target and returns true,
+// or returns false if there is no such entry, it expired, or its size isn't the given size.
+bool load(const std::string& description, void* target, size_t size);
+
+// Removes the entry with the given description, if it exists.
+void remove(const std::string& description);
+
+}
+}
+
+#endif
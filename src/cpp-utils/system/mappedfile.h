@@ -0,0 +1,77 @@
+#pragma once
+#ifndef MESSMER_CPPUTILS_SYSTEM_MAPPEDFILE_H
+#define MESSMER_CPPUTILS_SYSTEM_MAPPEDFILE_H
+
+#include <boost/filesystem/path.hpp>
+#include <cstdint>
+#include "../macros.h"
+
+namespace cpputils {
+
+/**
+ * A file mapped into memory for reading and writing. Changes to the memory are written to the file by the operating system,
+ * so they survive a crash of the process even if flush() wasn't called.
+ */
+class MappedFile final {
+public:
+    // Opens the file (or creates it if it doesn't exist), grows it to minSize bytes if it is smaller, and maps the whole file.
+    // New bytes are zero.
+    MappedFile(const boost::filesystem::path &path, uint64_t minSize);
+    MappedFile(MappedFile &&rhs) noexcept;
+    MappedFile &operator=(MappedFile &&rhs) noexcept;
+    ~MappedFile();
+
+    void *data();
+    const void *data() const;
+    uint64_t size() const;
+
+    // Blocks until all changes are written to the file
+    void flush();
+
+    // Unmaps the file, e.g. to rename or delete it on Windows. Afterwards, the object can't be used anymore.
+    void close();
+
+private:
+    void *_data;
+    uint64_t _size;
+
+    DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+inline MappedFile::MappedFile(MappedFile &&rhs) noexcept: _data(rhs._data), _size(rhs._size) {
+    rhs._data = nullptr;
+    rhs._size = 0;
+}
+
+inline MappedFile &MappedFile::operator=(MappedFile &&rhs) noexcept {
+    if (_data != nullptr) {
+        close();
+    }
+    _data = rhs._data;
+    _size = rhs._size;
+    rhs._data = nullptr;
+    rhs._size = 0;
+    return *this;
+}
+
+inline MappedFile::~MappedFile() {
+    if (_data != nullptr) {
+        close();
+    }
+}
+
+inline void *MappedFile::data() {
+    return _data;
+}
+
+inline const void *MappedFile::data() const {
+    return _data;
+}
+
+inline uint64_t MappedFile::size() const {
+    return _size;
+}
+
+}
+
+#endif
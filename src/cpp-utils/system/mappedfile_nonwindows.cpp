@@ -0,0 +1,69 @@
+#if !defined(_MSC_VER)
+
+#include "mappedfile.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdexcept>
+#include <string>
+#include <cpp-utils/assert/assert.h>
+#include <cpp-utils/logging/logging.h>
+
+using namespace cpputils::logging;
+
+namespace cpputils {
+
+MappedFile::MappedFile(const boost::filesystem::path &path, uint64_t minSize): _data(nullptr), _size(0) {
+    const int fd = ::open(path.string().c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        throw std::runtime_error("Error opening file " + path.string() + ". Errno: " + std::to_string(errno));
+    }
+    struct ::stat stat{};
+    if (0 != ::fstat(fd, &stat)) {
+        const int error = errno;
+        ::close(fd);
+        throw std::runtime_error("Error calling fstat. Errno: " + std::to_string(error));
+    }
+    _size = static_cast<uint64_t>(stat.st_size);
+    if (_size < minSize) {
+        if (0 != ::ftruncate(fd, static_cast<off_t>(minSize))) {
+            const int error = errno;
+            ::close(fd);
+            throw std::runtime_error("Error growing file " + path.string() + ". Errno: " + std::to_string(error));
+        }
+        _size = minSize;
+    }
+    if (_size == 0) {
+        ::close(fd);
+        throw std::runtime_error("Can't map empty file " + path.string());
+    }
+    void *data = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // The mapping stays valid after closing the file descriptor
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Error calling mmap. Errno: " + std::to_string(errno));
+    }
+    _data = data;
+}
+
+void MappedFile::flush() {
+    ASSERT(_data != nullptr, "File isn't mapped");
+    if (0 != ::msync(_data, _size, MS_SYNC)) {
+        throw std::runtime_error("Error calling msync. Errno: " + std::to_string(errno));
+    }
+}
+
+void MappedFile::close() {
+    ASSERT(_data != nullptr, "File isn't mapped");
+    if (0 != ::munmap(_data, _size)) {
+        LOG(WARN, "Error calling munmap. Errno: {}", errno);
+    }
+    _data = nullptr;
+    _size = 0;
+}
+
+}
+
+#endif
@@ -0,0 +1,64 @@
+#if defined(_MSC_VER)
+
+#include "mappedfile.h"
+#include <Windows.h>
+#include <stdexcept>
+#include <string>
+#include <cpp-utils/assert/assert.h>
+#include <cpp-utils/logging/logging.h>
+
+using namespace cpputils::logging;
+
+namespace cpputils {
+
+MappedFile::MappedFile(const boost::filesystem::path &path, uint64_t minSize): _data(nullptr), _size(0) {
+	HANDLE file = ::CreateFileW(path.wstring().c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (INVALID_HANDLE_VALUE == file) {
+		throw std::runtime_error("Error opening file " + path.string() + ". Errno: " + std::to_string(GetLastError()));
+	}
+	LARGE_INTEGER fileSize;
+	if (!::GetFileSizeEx(file, &fileSize)) {
+		const DWORD error = GetLastError();
+		::CloseHandle(file);
+		throw std::runtime_error("Error calling GetFileSizeEx. Errno: " + std::to_string(error));
+	}
+	_size = (std::max)(static_cast<uint64_t>(fileSize.QuadPart), minSize);
+	if (_size == 0) {
+		::CloseHandle(file);
+		throw std::runtime_error("Can't map empty file " + path.string());
+	}
+
+	// If the mapping is larger than the file, this grows the file and fills it with zeroes
+	HANDLE mapping = ::CreateFileMappingW(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(_size >> 32), static_cast<DWORD>(_size & 0xFFFFFFFF), nullptr);
+	::CloseHandle(file);
+	if (nullptr == mapping) {
+		throw std::runtime_error("Error calling CreateFileMapping. Errno: " + std::to_string(GetLastError()));
+	}
+	void *data = ::MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	// The view keeps the file and the mapping open
+	::CloseHandle(mapping);
+	if (nullptr == data) {
+		throw std::runtime_error("Error calling MapViewOfFile. Errno: " + std::to_string(GetLastError()));
+	}
+	_data = data;
+}
+
+void MappedFile::flush() {
+	ASSERT(_data != nullptr, "File isn't mapped");
+	if (!::FlushViewOfFile(_data, 0)) {
+		throw std::runtime_error("Error calling FlushViewOfFile. Errno: " + std::to_string(GetLastError()));
+	}
+}
+
+void MappedFile::close() {
+	ASSERT(_data != nullptr, "File isn't mapped");
+	if (!::UnmapViewOfFile(_data)) {
+		LOG(WARN, "Error calling UnmapViewOfFile. Errno: {}", GetLastError());
+	}
+	_data = nullptr;
+	_size = 0;
+}
+
+}
+
+#endif
@@ -0,0 +1,52 @@
+#include "ThreadPool.h"
+#include "../assert/assert.h"
+#include <thread>
+
+using std::function;
+using std::string;
+
+namespace cpputils {
+
+    ThreadPool::ThreadPool(uint32_t numThreads, string threadName)
+    : _numThreads(numThreads), _threadName(std::move(threadName)), _workers(), _tasks(), _mutex(), _taskAdded() {
+        ASSERT(_numThreads > 0, "ThreadPool needs at least one thread");
+    }
+
+    ThreadPool::~ThreadPool() {
+        // Stop the workers before the mutex and condition variable they're using are destructed.
+        // Tasks that didn't run yet are dropped, i.e. their futures get a broken_promise error.
+        _workers.clear();
+    }
+
+    uint32_t ThreadPool::defaultNumThreads() {
+        // hardware_concurrency() returns 0 if it can't determine the number of cores
+        return std::max(2u, std::thread::hardware_concurrency());
+    }
+
+    void ThreadPool::_addTask(function<void()> task) {
+        boost::unique_lock<boost::mutex> lock(_mutex);
+        if (_workers.empty()) {
+            _workers.reserve(_numThreads);
+            for (uint32_t i = 0; i < _numThreads; ++i) {
+                _workers.push_back(make_unique_ref<LoopThread>([this] {return _runNextTask();}, _threadName));
+                _workers.back()->start();
+            }
+        }
+        _tasks.push_back(std::move(task));
+        lock.unlock();
+        _taskAdded.notify_one();
+    }
+
+    bool ThreadPool::_runNextTask() {
+        function<void()> task;
+        {
+            boost::unique_lock<boost::mutex> lock(_mutex);
+            // This is an interruption point, i.e. LoopThread::stop() and fork() can stop the thread while it is waiting.
+            _taskAdded.wait(lock, [this] {return !_tasks.empty();});
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+        task();
+        return true;
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+#ifndef MESSMER_CPPUTILS_THREAD_THREADPOOL_H
+#define MESSMER_CPPUTILS_THREAD_THREADPOOL_H
+
+#include "LoopThread.h"
+#include "../pointer/unique_ref.h"
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <memory>
+#include <vector>
+
+namespace cpputils {
+
+    /**
+     * A fixed-size pool of worker threads executing tasks in FIFO order.
+     * The worker threads are LoopThreads, i.e. they are correctly stopped and restarted around fork().
+     * They are only started once the first task is added, so an unused ThreadPool doesn't cost any threads.
+     */
+    class ThreadPool final {
+    public:
+        ThreadPool(uint32_t numThreads, std::string threadName);
+        ~ThreadPool();
+
+        // Number of threads to use for pools doing CPU bound work (e.g. decryption)
+        static uint32_t defaultNumThreads();
+
+        uint32_t numThreads() const {
+            return _numThreads;
+        }
+
+        // Schedule the task to be run on one of the worker threads.
+        // Exceptions thrown by the task are rethrown when calling get() on the returned future.
+        template<class Task>
+        std::future<decltype(std::declval<Task>()())> run(Task task);
+
+        // Split the index range [0, numItems) into at most numThreads() slices and run task(begin, end) for each slice on the worker threads.
+        // Blocks until all slices are done. If a slice throws, the first such exception is rethrown after all slices finished.
+        template<class Task>
+        void runSlices(size_t numItems, Task task);
+
+    private:
+        void _addTask(std::function<void()> task);
+        bool _runNextTask();
+
+        const uint32_t _numThreads;
+        const std::string _threadName;
+        std::vector<unique_ref<LoopThread>> _workers;
+        std::deque<std::function<void()>> _tasks;
+        boost::mutex _mutex;
+        boost::condition_variable _taskAdded;
+
+        DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+    };
+
+    template<class Task>
+    inline std::future<decltype(std::declval<Task>()())> ThreadPool::run(Task task) {
+        using Result = decltype(std::declval<Task>()());
+        // std::function needs to be copyable, but std::packaged_task isn't. That's why it's wrapped into a shared_ptr.
+        auto packagedTask = std::make_shared<std::packaged_task<Result ()>>(std::move(task));
+        auto future = packagedTask->get_future();
+        _addTask([packagedTask] {
+            (*packagedTask)();
+        });
+        return future;
+    }
+
+    template<class Task>
+    inline void ThreadPool::runSlices(size_t numItems, Task task) {
+        const size_t numSlices = std::min<size_t>(numItems, _numThreads);
+        std::vector<std::future<void>> slices;
+        slices.reserve(numSlices);
+        for (size_t slice = 0; slice < numSlices; ++slice) {
+            const size_t begin = numItems * slice / numSlices;
+            const size_t end = numItems * (slice + 1) / numSlices;
+            slices.push_back(run([&task, begin, end] {
+                task(begin, end);
+            }));
+        }
+        // The slices reference task (and usually the caller's data), so we have to wait for all of them before an exception can leave this function.
+        for (auto &slice : slices) {
+            slice.wait();
+        }
+        for (auto &slice : slices) {
+            slice.get();
+        }
+    }
+}
+
+#endif
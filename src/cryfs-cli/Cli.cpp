@@ -7,12 +7,16 @@
 #include <cpp-utils/assert/backtrace.h>
 
 #include <fspp/fuse/Fuse.h>
+#if defined(FSPP_HAVE_FUSE3_LOWLEVEL)
+#include <fspp/fuse/LowlevelFuse.h>
+#endif
 #include <fspp/impl/FilesystemImpl.h>
 #include <cpp-utils/process/subprocess.h>
 #include <cpp-utils/io/DontEchoStdinToStdoutRAII.h>
 #include <cryfs/impl/filesystem/CryDevice.h>
 #include <cryfs/impl/config/CryConfigLoader.h>
 #include <cryfs/impl/config/CryPasswordBasedKeyProvider.h>
+#include <cryfs/impl/config/CryCachingKeyProvider.h>
 #include "program_options/Parser.h"
 #include <boost/filesystem.hpp>
 
@@ -64,6 +68,12 @@ using boost::chrono::milliseconds;
 using cpputils::dynamic_pointer_move;
 using gitversion::VersionCompare;
 
+#if defined(FSPP_HAVE_FUSE3_LOWLEVEL)
+using FuseFrontend = fspp::fuse::LowlevelFuse;
+#else
+using FuseFrontend = fspp::fuse::Fuse;
+#endif
+
 //TODO Delete a large file in parallel possible? Takes a long time right now...
 //TODO Improve parallelity.
 //TODO Replace ASSERTs with other error handling when it is not a programming error but an environment influence (e.g. a block is missing)
@@ -203,7 +213,7 @@ namespace cryfs_cli {
 
     CryConfigLoader::ConfigLoadResult Cli::_loadOrCreateConfig(const ProgramOptions &options, const LocalStateDir& localStateDir) {
         auto configFile = _determineConfigFile(options);
-        auto config = _loadOrCreateConfigFile(std::move(configFile), localStateDir, options.cipher(), options.blocksizeBytes(), options.allowFilesystemUpgrade(), options.missingBlockIsIntegrityViolation(), options.allowReplacedFilesystem());
+        auto config = _loadOrCreateConfigFile(std::move(configFile), localStateDir, options.cipher(), options.blocksizeBytes(), options.allowFilesystemUpgrade(), options.missingBlockIsIntegrityViolation(), options.allowReplacedFilesystem(), options.cacheKeyMinutes());
         if (config.is_left()) {
             switch(config.left()) {
                 case CryConfigFile::LoadError::DecryptionFailed:
@@ -216,17 +226,34 @@ namespace cryfs_cli {
         return std::move(config.right());
     }
 
-    either<CryConfigFile::LoadError, CryConfigLoader::ConfigLoadResult> Cli::_loadOrCreateConfigFile(bf::path configFilePath, LocalStateDir localStateDir, const optional<string> &cipher, const optional<uint32_t> &blocksizeBytes, bool allowFilesystemUpgrade, const optional<bool> &missingBlockIsIntegrityViolation, bool allowReplacedFilesystem) {
+    either<CryConfigFile::LoadError, CryConfigLoader::ConfigLoadResult> Cli::_loadOrCreateConfigFile(bf::path configFilePath, LocalStateDir localStateDir, const optional<string> &cipher, const optional<uint32_t> &blocksizeBytes, bool allowFilesystemUpgrade, const optional<bool> &missingBlockIsIntegrityViolation, bool allowReplacedFilesystem, const optional<double> &cacheKeyMinutes) {
         // TODO Instead of passing in _askPasswordXXX functions to KeyProvider, only pass in console and move logic to the key provider,
         //      for example by having a separate CryPasswordBasedKeyProvider / CryNoninteractivePasswordBasedKeyProvider.
-        auto keyProvider = make_unique_ref<CryPasswordBasedKeyProvider>(
+        unique_ref<CryKeyProvider> keyProvider = make_unique_ref<CryPasswordBasedKeyProvider>(
           _console,
           _noninteractive ? Cli::_askPasswordNoninteractive(_console) : Cli::_askPasswordForExistingFilesystem(_console),
           _noninteractive ? Cli::_askPasswordNoninteractive(_console) : Cli::_askPasswordForNewFilesystem(_console),
           make_unique_ref<SCrypt>(_scryptSettings)
         );
-        return CryConfigLoader(_console, _keyGenerator, std::move(keyProvider), std::move(localStateDir),
-                               cipher, blocksizeBytes, missingBlockIsIntegrityViolation).loadOrCreate(std::move(configFilePath), allowFilesystemUpgrade, allowReplacedFilesystem);
+        CryCachingKeyProvider *cachingKeyProvider = nullptr;
+        if (cacheKeyMinutes != none) {
+          auto timeout = std::chrono::seconds(static_cast<int64_t>(*cacheKeyMinutes * 60));
+          auto cachingKeyProviderRef = make_unique_ref<CryCachingKeyProvider>(std::move(keyProvider), timeout);
+          cachingKeyProvider = cachingKeyProviderRef.get();
+          keyProvider = std::move(cachingKeyProviderRef);
+        }
+        CryConfigLoader configLoader(_console, _keyGenerator, std::move(keyProvider), std::move(localStateDir),
+                                     cipher, blocksizeBytes, missingBlockIsIntegrityViolation);
+        auto result = configLoader.loadOrCreate(std::move(configFilePath), allowFilesystemUpgrade, allowReplacedFilesystem);
+        if (cachingKeyProvider != nullptr) {
+          // Only cache keys that could decrypt the config file, and drop cached keys that couldn't
+          if (result.is_right()) {
+            cachingKeyProvider->keyWasCorrect();
+          } else if (result.left() == CryConfigFile::LoadError::DecryptionFailed) {
+            cachingKeyProvider->keyWasWrong();
+          }
+        }
+        return result;
     }
 
     namespace {
@@ -248,10 +275,11 @@ namespace cryfs_cli {
     void Cli::_runFilesystem(const ProgramOptions &options, std::function<void()> onMounted) {
         try {
             LocalStateDir localStateDir(Environment::localStateDir());
-            auto blockStore = make_unique_ref<OnDiskBlockStore2>(options.baseDir());
             auto config = _loadOrCreateConfig(options, localStateDir);
+            auto blockCountFile = localStateDir.forFilesystemId(config.configFile->config()->FilesystemId()) / "blockcount";
+            auto blockStore = make_unique_ref<OnDiskBlockStore2>(options.baseDir(), blockCountFile);
             printConfig(*config.configFile->config());
-            unique_ptr<fspp::fuse::Fuse> fuse = nullptr;
+            unique_ptr<FuseFrontend> fuse = nullptr;
             bool stoppedBecauseOfIntegrityViolation = false;
 
             auto onIntegrityViolation = [&fuse, &stoppedBecauseOfIntegrityViolation] () {
@@ -268,10 +296,11 @@ namespace cryfs_cli {
               }
             };
             const bool missingBlockIsIntegrityViolation = config.configFile->config()->missingBlockIsIntegrityViolation();
-            _device = optional<unique_ref<CryDevice>>(make_unique_ref<CryDevice>(std::move(config.configFile), std::move(blockStore), std::move(localStateDir), config.myClientId, options.allowIntegrityViolations(), missingBlockIsIntegrityViolation, std::move(onIntegrityViolation)));
+            const bool singleClient = config.configFile->config()->ExclusiveClientId() != none;
+            _device = optional<unique_ref<CryDevice>>(make_unique_ref<CryDevice>(std::move(config.configFile), std::move(blockStore), std::move(localStateDir), config.myClientId, options.allowIntegrityViolations(), missingBlockIsIntegrityViolation, std::move(onIntegrityViolation), options.cacheSizeBytes()));
             _sanityCheckFilesystem(_device->get());
 
-            auto initFilesystem = [&] (fspp::fuse::Fuse *fs){
+            auto initFilesystem = [&] (FuseFrontend *fs){
                 ASSERT(_device != none, "File system not ready to be initialized. Was it already initialized before?");
 
                 //TODO Test auto unmounting after idle timeout
@@ -287,7 +316,12 @@ namespace cryfs_cli {
                 return make_shared<fspp::FilesystemImpl>(std::move(*_device));
             };
 
-            fuse = make_unique<fspp::fuse::Fuse>(initFilesystem, std::move(onMounted), "cryfs", "cryfs@" + options.baseDir().string());
+            fuse = make_unique<FuseFrontend>(initFilesystem, std::move(onMounted), "cryfs", "cryfs@" + options.baseDir().string());
+            if (singleClient) {
+                // No other client is allowed to change the file system, so everything goes through this mount
+                // and the kernel can keep its caches for a long time.
+                fuse->setKernelCacheTimeouts(fspp::fuse::KernelCacheTimeouts::Long());
+            }
 
             _initLogfile(options);
 
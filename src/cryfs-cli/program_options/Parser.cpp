@@ -5,13 +5,17 @@
 #include <cryfs/impl/config/CryConfigConsole.h>
 #include <cryfs/impl/CryfsException.h>
 #include <cryfs-cli/Environment.h>
+#include <blockstore/implementations/caching/CachingBlockStore2.h>
+#include <cryfs/impl/config/CryCachingKeyProvider.h>
 
 namespace po = boost::program_options;
 namespace bf = boost::filesystem;
 using namespace cryfs_cli::program_options;
 using cryfs::CryConfigConsole;
+using cryfs::CryCachingKeyProvider;
 using cryfs::CryfsException;
 using cryfs::ErrorCode;
+using blockstore::caching::CachingBlockStore2;
 using std::vector;
 using std::cerr;
 using std::endl;
@@ -78,6 +82,14 @@ ProgramOptions Parser::parse(const vector<string> &supportedCiphers) const {
     if (vm.count("blocksize")) {
         blocksizeBytes = vm["blocksize"].as<uint32_t>();
     }
+    optional<uint64_t> cacheSizeBytes = none;
+    if (vm.count("cache-size")) {
+        cacheSizeBytes = _parseCacheSize(vm["cache-size"].as<string>());
+    }
+    optional<double> cacheKeyMinutes = none;
+    if (vm.count("cache-key")) {
+        cacheKeyMinutes = _checkValidCacheKeyMinutes(vm["cache-key"].as<double>());
+    }
     bool allowIntegrityViolations = vm.count("allow-integrity-violations");
     optional<bool> missingBlockIsIntegrityViolation = none;
     if (vm.count("missing-block-is-integrity-violation")) {
@@ -92,7 +104,7 @@ ProgramOptions Parser::parse(const vector<string> &supportedCiphers) const {
         }
     }
 
-    return ProgramOptions(std::move(baseDir), std::move(mountDir), std::move(configfile), foreground, allowFilesystemUpgrade, allowReplacedFilesystem, createMissingBasedir, createMissingMountpoint, std::move(unmountAfterIdleMinutes), std::move(logfile), std::move(cipher), blocksizeBytes, allowIntegrityViolations, std::move(missingBlockIsIntegrityViolation), std::move(fuseOptions));
+    return ProgramOptions(std::move(baseDir), std::move(mountDir), std::move(configfile), foreground, allowFilesystemUpgrade, allowReplacedFilesystem, createMissingBasedir, createMissingMountpoint, std::move(unmountAfterIdleMinutes), std::move(logfile), std::move(cipher), blocksizeBytes, cacheSizeBytes, cacheKeyMinutes, allowIntegrityViolations, std::move(missingBlockIsIntegrityViolation), std::move(fuseOptions));
 }
 
 void Parser::_checkValidCipher(const string &cipher, const vector<string> &supportedCiphers) {
@@ -101,6 +113,25 @@ void Parser::_checkValidCipher(const string &cipher, const vector<string> &suppo
     }
 }
 
+uint64_t Parser::_parseCacheSize(const string &cacheSize) {
+    optional<uint64_t> result = parseByteSize(cacheSize);
+    if (result == none || *result == 0) {
+        throw CryfsException("Invalid cache size: " + cacheSize, ErrorCode::InvalidArguments);
+    }
+    return *result;
+}
+
+double Parser::_checkValidCacheKeyMinutes(double cacheKeyMinutes) {
+    if (!CryCachingKeyProvider::IsSupported()) {
+        throw CryfsException("--cache-key is not supported on this platform. It needs the Linux kernel keyring.", ErrorCode::InvalidArguments);
+    }
+    // Less than a second would round to a timeout of zero
+    if (!(cacheKeyMinutes * 60 >= 1)) {
+        throw CryfsException("Invalid key cache duration: " + std::to_string(cacheKeyMinutes) + " minutes", ErrorCode::InvalidArguments);
+    }
+    return cacheKeyMinutes;
+}
+
 po::variables_map Parser::_parseOptionsOrShowHelp(const vector<string> &options, const vector<string> &supportedCiphers) {
     try {
       return _parseOptions(options, supportedCiphers);
@@ -156,6 +187,8 @@ void Parser::_addAllowedOptions(po::options_description *desc) {
     cipher_description += CryConfigConsole::DEFAULT_CIPHER;
     string blocksize_description = "The block size used when storing ciphertext blocks (in bytes). Default: ";
     blocksize_description += std::to_string(CryConfigConsole::DEFAULT_BLOCKSIZE_BYTES);
+    string cache_size_description = "Maximal amount of memory used to cache blocks, e.g. 512M or 4G. Default: ";
+    cache_size_description += std::to_string(CachingBlockStore2::DEFAULT_MAX_CACHE_SIZE_BYTES / 1024 / 1024) + "M";
     options.add_options()
             ("help,h", "show help message")
             ("config,c", po::value<string>(), "Configuration file")
@@ -163,6 +196,7 @@ void Parser::_addAllowedOptions(po::options_description *desc) {
             ("fuse-option,o", po::value<vector<string>>(), "Add a fuse mount option. Example: atime or noatime.")
             ("cipher", po::value<string>(), cipher_description.c_str())
             ("blocksize", po::value<uint32_t>(), blocksize_description.c_str())
+            ("cache-size", po::value<string>(), cache_size_description.c_str())
             ("missing-block-is-integrity-violation", po::value<bool>(), "Whether to treat a missing block as an integrity violation. This makes sure you notice if an attacker deleted some of your files, but only works in single-client mode. You will not be able to use the file system on other devices.")
             ("allow-integrity-violations", "Disable integrity checks. Integrity checks ensure that your file system was not manipulated or rolled back to an earlier version. Disabling them is needed if you want to load an old snapshot of your file system.")
             ("allow-filesystem-upgrade", "Allow upgrading the file system if it was created with an old CryFS version. After the upgrade, older CryFS versions might not be able to use the file system anymore.")
@@ -171,6 +205,7 @@ void Parser::_addAllowedOptions(po::options_description *desc) {
             ("create-missing-mountpoint", "Creates the mountpoint even if there is no directory currently there, skipping the normal confirmation message to create it later.")
             ("show-ciphers", "Show list of supported ciphers.")
             ("unmount-idle", po::value<double>(), "Automatically unmount after specified number of idle minutes.")
+            ("cache-key", po::value<double>(), "Remember the key derived from your password in the kernel keyring for the specified number of minutes. Mounting the file system again within that time doesn't ask for the password and skips the (intentionally slow) key derivation. Anyone who can run processes as your user can mount the file system during that time. Only supported on Linux.")
             ("logfile", po::value<string>(), "Specify the file to write log messages to. If this is not specified, log messages will go to stdout, or syslog if CryFS is running in the background.")
             ("version", "Show CryFS version number")
             ;
@@ -27,6 +27,8 @@ namespace cryfs_cli {
             static boost::program_options::variables_map _parseOptionsOrShowHelp(const std::vector<std::string> &options, const std::vector<std::string> &supportedCiphers);
             static boost::program_options::variables_map _parseOptions(const std::vector<std::string> &options, const std::vector<std::string> &supportedCiphers);
             static void _checkValidCipher(const std::string &cipher, const std::vector<std::string> &supportedCiphers);
+            static uint64_t _parseCacheSize(const std::string &cacheSize);
+            static double _checkValidCacheKeyMinutes(double cacheKeyMinutes);
 
             std::vector<std::string> _options;
 
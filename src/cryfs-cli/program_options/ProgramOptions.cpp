@@ -15,6 +15,8 @@ ProgramOptions::ProgramOptions(bf::path baseDir, bf::path mountDir, optional<bf:
                                optional<double> unmountAfterIdleMinutes,
                                optional<bf::path> logFile, optional<string> cipher,
                                optional<uint32_t> blocksizeBytes,
+                               optional<uint64_t> cacheSizeBytes,
+                               optional<double> cacheKeyMinutes,
                                bool allowIntegrityViolations,
                                boost::optional<bool> missingBlockIsIntegrityViolation,
                                vector<string> fuseOptions)
@@ -24,6 +26,8 @@ ProgramOptions::ProgramOptions(bf::path baseDir, bf::path mountDir, optional<bf:
       _createMissingBasedir(createMissingBasedir), _createMissingMountpoint(createMissingMountpoint),
       _unmountAfterIdleMinutes(std::move(unmountAfterIdleMinutes)), _logFile(std::move(logFile)),
       _cipher(std::move(cipher)), _blocksizeBytes(std::move(blocksizeBytes)),
+      _cacheSizeBytes(std::move(cacheSizeBytes)),
+      _cacheKeyMinutes(std::move(cacheKeyMinutes)),
       _allowIntegrityViolations(allowIntegrityViolations),
       _missingBlockIsIntegrityViolation(std::move(missingBlockIsIntegrityViolation)),
       _fuseOptions(std::move(fuseOptions)),
@@ -81,6 +85,14 @@ const optional<uint32_t> &ProgramOptions::blocksizeBytes() const {
     return _blocksizeBytes;
 }
 
+const optional<uint64_t> &ProgramOptions::cacheSizeBytes() const {
+    return _cacheSizeBytes;
+}
+
+const optional<double> &ProgramOptions::cacheKeyMinutes() const {
+    return _cacheKeyMinutes;
+}
+
 bool ProgramOptions::allowIntegrityViolations() const {
     return _allowIntegrityViolations;
 }
@@ -20,6 +20,8 @@ namespace cryfs_cli {
                            boost::optional<boost::filesystem::path> logFile,
                            boost::optional<std::string> cipher,
                            boost::optional<uint32_t> blocksizeBytes,
+                           boost::optional<uint64_t> cacheSizeBytes,
+                           boost::optional<double> cacheKeyMinutes,
                            bool allowIntegrityViolations,
                            boost::optional<bool> missingBlockIsIntegrityViolation,
                            std::vector<std::string> fuseOptions);
@@ -37,6 +39,8 @@ namespace cryfs_cli {
             const boost::optional<boost::filesystem::path> &logFile() const;
             const boost::optional<std::string> &cipher() const;
             const boost::optional<uint32_t> &blocksizeBytes() const;
+            const boost::optional<uint64_t> &cacheSizeBytes() const;
+            const boost::optional<double> &cacheKeyMinutes() const;
             bool allowIntegrityViolations() const;
             const boost::optional<bool> &missingBlockIsIntegrityViolation() const;
             const std::vector<std::string> &fuseOptions() const;
@@ -55,6 +59,8 @@ namespace cryfs_cli {
             boost::optional<boost::filesystem::path> _logFile;
             boost::optional<std::string> _cipher;
             boost::optional<uint32_t> _blocksizeBytes;
+            boost::optional<uint64_t> _cacheSizeBytes;
+            boost::optional<double> _cacheKeyMinutes;
             bool _allowIntegrityViolations;
             boost::optional<bool> _missingBlockIsIntegrityViolation;
             std::vector<std::string> _fuseOptions;
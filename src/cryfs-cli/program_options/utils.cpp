@@ -1,11 +1,15 @@
 #include "utils.h"
 #include <algorithm>
+#include <cctype>
+#include <limits>
 #include <string>
 
 using std::pair;
 using std::make_pair;
 using std::vector;
 using std::string;
+using boost::optional;
+using boost::none;
 
 namespace cryfs_cli {
     namespace program_options {
@@ -23,5 +27,41 @@ namespace cryfs_cli {
             );
         }
 
+        optional<uint64_t> parseByteSize(const string &size) {
+            size_t pos = 0;
+            uint64_t value = 0;
+            for (; pos < size.size() && std::isdigit(static_cast<unsigned char>(size[pos])); ++pos) {
+                const uint64_t digit = size[pos] - '0';
+                if (value > (std::numeric_limits<uint64_t>::max() - digit) / 10) {
+                    return none;
+                }
+                value = 10 * value + digit;
+            }
+            if (pos == 0) {
+                return none;
+            }
+
+            string suffix = size.substr(pos);
+            std::transform(suffix.begin(), suffix.end(), suffix.begin(), [] (char c) {return std::toupper(static_cast<unsigned char>(c));});
+            unsigned int shift = 0;
+            if (suffix == "" || suffix == "B") {
+                shift = 0;
+            } else if (suffix == "K" || suffix == "KB" || suffix == "KIB") {
+                shift = 10;
+            } else if (suffix == "M" || suffix == "MB" || suffix == "MIB") {
+                shift = 20;
+            } else if (suffix == "G" || suffix == "GB" || suffix == "GIB") {
+                shift = 30;
+            } else if (suffix == "T" || suffix == "TB" || suffix == "TIB") {
+                shift = 40;
+            } else {
+                return none;
+            }
+            if (value > (std::numeric_limits<uint64_t>::max() >> shift)) {
+                return none;
+            }
+            return value << shift;
+        }
+
     }
 }
@@ -2,9 +2,11 @@
 #ifndef MESSMER_CRYFSCLI_PROGRAMOPTIONS_UTILS_H
 #define MESSMER_CRYFSCLI_PROGRAMOPTIONS_UTILS_H
 
+#include <cstdint>
 #include <utility>
 #include <vector>
 #include <string>
+#include <boost/optional.hpp>
 
 namespace cryfs_cli {
     namespace program_options {
@@ -12,6 +14,12 @@ namespace cryfs_cli {
          * Splits an array of program options into two arrays of program options, split at a double dash '--' option.
          */
         std::pair<std::vector<std::string>, std::vector<std::string>> splitAtDoubleDash(const std::vector<std::string> &options);
+
+        /**
+         * Parses a size in bytes with an optional binary unit suffix, e.g. "4096", "512K", "64M" or "4G".
+         * Returns none if the string isn't a valid size.
+         */
+        boost::optional<uint64_t> parseByteSize(const std::string &size);
     }
 }
 
@@ -0,0 +1,76 @@
+#include "CryCachingKeyProvider.h"
+#include <cpp-utils/system/keyring.h>
+#include <cpp-utils/crypto/hash/Hash.h>
+#include <cpp-utils/logging/logging.h>
+
+using cpputils::unique_ref;
+using cpputils::EncryptionKey;
+using cpputils::Data;
+using boost::none;
+using std::string;
+namespace keyring = cpputils::keyring;
+namespace hash = cpputils::hash;
+using namespace cpputils::logging;
+
+namespace cryfs {
+
+CryCachingKeyProvider::CryCachingKeyProvider(unique_ref<CryKeyProvider> keyProvider, std::chrono::seconds timeout)
+: _keyProvider(std::move(keyProvider)), _timeout(timeout), _lastKey(none) {}
+
+bool CryCachingKeyProvider::IsSupported() {
+  return keyring::isSupported();
+}
+
+EncryptionKey CryCachingKeyProvider::requestKeyForExistingFilesystem(size_t keySize, const Data& kdfParameters) {
+  string description = _cacheEntryDescription(keySize, kdfParameters);
+  EncryptionKey cachedKey = EncryptionKey::Null(keySize);
+  if (keyring::load(description, cachedKey.data(), keySize)) {
+    LOG(INFO, "Using config file key from the kernel keyring");
+    _lastKey = LastKey{std::move(description), cachedKey, true};
+    return cachedKey;
+  }
+  auto key = _keyProvider->requestKeyForExistingFilesystem(keySize, kdfParameters);
+  _lastKey = LastKey{std::move(description), key, false};
+  return key;
+}
+
+CryKeyProvider::KeyResult CryCachingKeyProvider::requestKeyForNewFilesystem(size_t keySize) {
+  auto keyResult = _keyProvider->requestKeyForNewFilesystem(keySize);
+  _lastKey = LastKey{_cacheEntryDescription(keySize, keyResult.kdfParameters), keyResult.key, false};
+  return keyResult;
+}
+
+void CryCachingKeyProvider::keyWasCorrect() {
+  if (_lastKey == none) {
+    return;
+  }
+  if (!_lastKey->fromCache) {
+    try {
+      // Don't refresh the timeout when the key came from the cache, the cached key should expire after the timeout even if it is used
+      keyring::store(_lastKey->cacheEntryDescription, _lastKey->key.data(), _lastKey->key.binaryLength(), _timeout);
+    } catch (const std::exception &e) {
+      // Not caching the key only makes the next mount slower
+      LOG(WARN, "Couldn't store the config file key in the kernel keyring: {}", e.what());
+    }
+  }
+  _lastKey = none;
+}
+
+void CryCachingKeyProvider::keyWasWrong() {
+  if (_lastKey == none) {
+    return;
+  }
+  if (_lastKey->fromCache) {
+    keyring::remove(_lastKey->cacheEntryDescription);
+  }
+  _lastKey = none;
+}
+
+string CryCachingKeyProvider::_cacheEntryDescription(size_t keySize, const Data& kdfParameters) {
+  // The salt is part of the kdf parameters, so this is different for each file system.
+  // Hash them to get a description of fixed length.
+  auto kdfParametersHash = hash::hash(kdfParameters, hash::Salt::Null());
+  return "cryfs:configkey:" + std::to_string(keySize) + ":" + kdfParametersHash.digest.ToString();
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+#ifndef CRYFS_CRYCACHINGKEYPROVIDER_H
+#define CRYFS_CRYCACHINGKEYPROVIDER_H
+
+#include "CryKeyProvider.h"
+#include <cpp-utils/pointer/unique_ref.h>
+#include <cpp-utils/macros.h>
+#include <boost/optional.hpp>
+#include <chrono>
+
+namespace cryfs {
+
+/**
+ * Remembers the config file key in the kernel keyring of the current user, so that mounting the file system again
+ * before the timeout expires doesn't need to ask for the password and doesn't run the (intentionally slow) key derivation.
+ * Keys are identified by the key derivation parameters stored in the config file, which contain a random salt.
+ * A key only goes into the cache after the caller confirmed it could decrypt the config file with it.
+ */
+class CryCachingKeyProvider final : public CryKeyProvider {
+public:
+  CryCachingKeyProvider(cpputils::unique_ref<CryKeyProvider> keyProvider, std::chrono::seconds timeout);
+
+  static bool IsSupported();
+
+  cpputils::EncryptionKey requestKeyForExistingFilesystem(size_t keySize, const cpputils::Data& kdfParameters) override;
+  KeyResult requestKeyForNewFilesystem(size_t keySize) override;
+
+  // Call this after the config file was decrypted with the last returned key.
+  // If the key wasn't taken from the cache, it is put into the cache now.
+  void keyWasCorrect();
+  // Call this if the config file couldn't be decrypted with the last returned key.
+  // If the key was taken from the cache, it is removed from the cache so the next attempt asks for the password again.
+  void keyWasWrong();
+
+private:
+  static std::string _cacheEntryDescription(size_t keySize, const cpputils::Data& kdfParameters);
+
+  struct LastKey final {
+    std::string cacheEntryDescription;
+    cpputils::EncryptionKey key;
+    bool fromCache;
+  };
+
+  cpputils::unique_ref<CryKeyProvider> _keyProvider;
+  std::chrono::seconds _timeout;
+  boost::optional<LastKey> _lastKey;
+
+  DISALLOW_COPY_AND_ASSIGN(CryCachingKeyProvider);
+};
+
+}
+
+#endif
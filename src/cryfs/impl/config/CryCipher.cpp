@@ -78,7 +78,9 @@ const vector<shared_ptr<CryCipher>> CryCiphers::SUPPORTED_CIPHERS = {
         make_shared<CryCipherInstance<Mars256_GCM>>(),
         make_shared<CryCipherInstance<Mars256_CFB>>(INTEGRITY_WARNING),
         make_shared<CryCipherInstance<Mars128_GCM>>(),
-        make_shared<CryCipherInstance<Mars128_CFB>>(INTEGRITY_WARNING)
+        make_shared<CryCipherInstance<Mars128_CFB>>(INTEGRITY_WARNING),
+        make_shared<CryCipherInstance<ChaCha20_Poly1305>>(),
+        make_shared<CryCipherInstance<XChaCha20_Poly1305>>()
 };
 
 const CryCipher& CryCiphers::find(const string &cipherName) {
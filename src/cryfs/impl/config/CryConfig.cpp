@@ -19,6 +19,7 @@ using cpputils::Random;
 namespace cryfs {
 
 constexpr const char* CryConfig::FilesystemFormatVersion;
+constexpr const char* CryConfig::FilesystemFormatVersionWithoutFileSizesInDirEntries;
 
 CryConfig::CryConfig()
 : _rootBlob("")
@@ -30,6 +31,7 @@ CryConfig::CryConfig()
 , _blocksizeBytes(0)
 , _filesystemId(FilesystemID::Null())
 , _exclusiveClientId(none)
+, _fileSizesInDirEntries(true)
 #ifndef CRYFS_NO_COMPATIBILITY
 , _hasVersionNumbers(true)
 , _hasParentPointers(true)
@@ -53,6 +55,7 @@ CryConfig CryConfig::load(const Data &data) {
   cfg._lastOpenedWithVersion = pt.get<string>("cryfs.lastOpenedWithVersion", cfg._version); // In CryFS <= 0.9.8, we didn't have this field, but used the cryfs.version field for this purpose.
   cfg._blocksizeBytes = pt.get<uint64_t>("cryfs.blocksizeBytes", 32832); // CryFS <= 0.9.2 used a 32KB block size which was this physical block size.
   cfg._exclusiveClientId = pt.get_optional<uint32_t>("cryfs.exclusiveClientId");
+  cfg._fileSizesInDirEntries = pt.get<bool>("cryfs.fileSizesInDirEntries", false); // File systems created before this field existed don't have sizes in their dir entries
 #ifndef CRYFS_NO_COMPATIBILITY
   cfg._hasVersionNumbers = pt.get<bool>("cryfs.migrations.hasVersionNumbers", false);
   cfg._hasParentPointers = pt.get<bool>("cryfs.migrations.hasParentPointers", false);
@@ -82,6 +85,7 @@ Data CryConfig::save() const {
   if (_exclusiveClientId != none) {
     pt.put<uint32_t>("cryfs.exclusiveClientId", *_exclusiveClientId);
   }
+  pt.put<bool>("cryfs.fileSizesInDirEntries", _fileSizesInDirEntries);
 #ifndef CRYFS_NO_COMPATIBILITY
   pt.put<bool>("cryfs.migrations.hasVersionNumbers", _hasVersionNumbers);
   pt.put<bool>("cryfs.migrations.hasParentPointers", _hasParentPointers);
@@ -168,6 +172,14 @@ bool CryConfig::missingBlockIsIntegrityViolation() const {
     return _exclusiveClientId != boost::none;
 }
 
+bool CryConfig::FileSizesInDirEntries() const {
+  return _fileSizesInDirEntries;
+}
+
+void CryConfig::SetFileSizesInDirEntries(bool value) {
+  _fileSizesInDirEntries = value;
+}
+
 #ifndef CRYFS_NO_COMPATIBILITY
 bool CryConfig::HasVersionNumbers() const {
   return _hasVersionNumbers;
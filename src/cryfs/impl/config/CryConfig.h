@@ -12,7 +12,12 @@ namespace cryfs {
 
 class CryConfig final {
 public:
-  static constexpr const char* FilesystemFormatVersion = "0.10";
+  // Storage format of new file systems. They store file sizes in their dir entries (see FileSizesInDirEntries()).
+  // Older CryFS versions refuse to load file systems with a newer format version than their own.
+  static constexpr const char* FilesystemFormatVersion = "0.11";
+  // Storage format of file systems that don't store file sizes in their dir entries. CryFS 0.10 can still read them,
+  // so they keep this format version, and loading them with this version doesn't need a migration.
+  static constexpr const char* FilesystemFormatVersionWithoutFileSizesInDirEntries = "0.10";
 
   //TODO No default constructor, pass in config values instead!
   CryConfig();
@@ -51,6 +56,12 @@ public:
 
   bool missingBlockIsIntegrityViolation() const;
 
+  // If set, directory entries store the size of files and symlinks, so stat() doesn't have to load the child blob.
+  // CryFS versions that don't know about this can't read the directories, so it is only enabled for new file systems,
+  // and these get the newer FilesystemFormatVersion to make older versions refuse them.
+  bool FileSizesInDirEntries() const;
+  void SetFileSizesInDirEntries(bool value);
+
 #ifndef CRYFS_NO_COMPATIBILITY
   // This is a trigger to recognize old file systems that didn't have version numbers.
   // Version numbers cannot be disabled, but the file system will be migrated to version numbers automatically.
@@ -76,6 +87,7 @@ private:
   uint64_t _blocksizeBytes;
   FilesystemID _filesystemId;
   boost::optional<uint32_t> _exclusiveClientId;
+  bool _fileSizesInDirEntries;
 #ifndef CRYFS_NO_COMPATIBILITY
   bool _hasVersionNumbers;
   bool _hasParentPointers;
@@ -44,8 +44,10 @@ either<CryConfigFile::LoadError, CryConfigLoader::ConfigLoadResult> CryConfigLoa
   }
 #endif
   _checkVersion(*config.right()->config(), allowFilesystemUpgrade);
-  if (config.right()->config()->Version() != CryConfig::FilesystemFormatVersion) {
-    config.right()->config()->SetVersion(CryConfig::FilesystemFormatVersion);
+  // File systems without file sizes in their dir entries can still be read by CryFS 0.10, so don't make it refuse them
+  const char *formatVersion = config.right()->config()->FileSizesInDirEntries() ? CryConfig::FilesystemFormatVersion : CryConfig::FilesystemFormatVersionWithoutFileSizesInDirEntries;
+  if (gitversion::VersionCompare::isOlderThan(config.right()->config()->Version(), formatVersion)) {
+    config.right()->config()->SetVersion(formatVersion);
     if (access == CryConfigFile::Access::ReadWrite) {
       config.right()->save();
     }
@@ -72,7 +74,7 @@ void CryConfigLoader::_checkVersion(const CryConfig &config, bool allowFilesyste
       throw CryfsException("This filesystem is for CryFS " + config.Version() + " or later. Please update your CryFS version.", ErrorCode::TooNewFilesystemFormat);
     }
   }
-  if (!allowFilesystemUpgrade && gitversion::VersionCompare::isOlderThan(config.Version(), CryConfig::FilesystemFormatVersion)) {
+  if (!allowFilesystemUpgrade && gitversion::VersionCompare::isOlderThan(config.Version(), CryConfig::FilesystemFormatVersionWithoutFileSizesInDirEntries)) {
     if (!_console->askYesNo("This filesystem is for CryFS " + config.Version() + " (or a later version with the same storage format). You're running a CryFS version using storage format " + CryConfig::FilesystemFormatVersion + ". It is recommended to create a new filesystem with CryFS 0.10 and copy your files into it. If you don't want to do that, we can also attempt to migrate the existing filesystem, but that can take a long time, you won't be getting some of the performance advantages of the 0.10 release series, and if the migration fails, your data may be lost. If you decide to continue, please make sure you have a backup of your data. Do you want to attempt a migration now?", false)) {
       throw CryfsException("This filesystem is for CryFS " + config.Version() + " (or a later version with the same storage format). It has to be migrated.", ErrorCode::TooOldFilesystemFormat);
     }
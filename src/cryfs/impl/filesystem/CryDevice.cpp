@@ -6,6 +6,7 @@
 #include "CryDir.h"
 #include "CryFile.h"
 #include "CrySymlink.h"
+#include "CryOpenFile.h"
 
 #include <fspp/fs_interface/FuseErrnoException.h>
 #include <blobstore/implementations/onblocks/BlobStoreOnBlocks.h>
@@ -21,6 +22,8 @@
 #include <blockstore/interface/BlockStore2.h>
 #include "cryfs/impl/localstate/LocalStateDir.h"
 #include <cryfs/impl/CryfsException.h>
+#include <cpp-utils/logging/logging.h>
+#include <cpp-utils/assert/assert.h>
 
 
 using std::string;
@@ -35,6 +38,7 @@ using blobstore::BlobStore;
 using blockstore::lowtohighlevel::LowToHighLevelBlockStore;
 using blobstore::onblocks::BlobStoreOnBlocks;
 using blockstore::caching::CachingBlockStore2;
+using blockstore::caching::PeriodicTask;
 using blockstore::integrity::IntegrityBlockStore2;
 using cpputils::unique_ref;
 using cpputils::make_unique_ref;
@@ -54,14 +58,30 @@ namespace bf = boost::filesystem;
 
 namespace cryfs {
 
-CryDevice::CryDevice(std::shared_ptr<CryConfigFile> configFile, unique_ref<BlockStore2> blockStore, const LocalStateDir& localStateDir, uint32_t myClientId, bool allowIntegrityViolations, bool missingBlockIsIntegrityViolation, std::function<void()> onIntegrityViolation)
-: _fsBlobStore(CreateFsBlobStore(std::move(blockStore), configFile.get(), localStateDir, myClientId, allowIntegrityViolations, missingBlockIsIntegrityViolation, std::move(onIntegrityViolation))),
+namespace {
+// Read aheads mostly wait for leaves loaded by DataNodeStore's own thread pool, so a few threads are enough.
+constexpr uint32_t READ_AHEAD_NUM_THREADS = 2;
+}
+
+CryDevice::CryDevice(std::shared_ptr<CryConfigFile> configFile, unique_ref<BlockStore2> blockStore, const LocalStateDir& localStateDir, uint32_t myClientId, bool allowIntegrityViolations, bool missingBlockIsIntegrityViolation, std::function<void()> onIntegrityViolation, optional<uint64_t> blockCacheSizeBytes)
+: _blockCache(nullptr),
+  _fsBlobStore(CreateFsBlobStore(std::move(blockStore), configFile.get(), localStateDir, myClientId, allowIntegrityViolations, missingBlockIsIntegrityViolation, std::move(onIntegrityViolation), blockCacheSizeBytes, &_blockCache)),
   _rootBlobId(GetOrCreateRootBlobId(configFile.get())), _configFile(std::move(configFile)),
-  _onFsAction() {
+  _onFsAction(), _readAheadThreadPool(READ_AHEAD_NUM_THREADS, "readAhead"), _readAheadCounters(),
+  _openFilesMutex(), _openFiles(), _openFilesInUse(), _openFileNotInUse(), _storeTimestampUpdatesTimer(nullptr) {
+  //Don't initialize the timer in the initializer list, because it then might already run before CryDevice is done constructing.
+  _storeTimestampUpdatesTimer = std::make_unique<PeriodicTask>([this] {
+    _storeTimestampUpdatesOfAllOpenFiles();
+  }, std::chrono::duration<double>(CryOpenFile::TIMESTAMP_UPDATE_MAX_DELAY).count(), "timestamps");
+}
+
+CryDevice::~CryDevice() {
+  _storeTimestampUpdatesTimer.reset();
+  LOG(DEBUG, "Read ahead statistics: {} hits, {} misses", _readAheadCounters.hits.load(), _readAheadCounters.misses.load());
 }
 
-unique_ref<parallelaccessfsblobstore::ParallelAccessFsBlobStore> CryDevice::CreateFsBlobStore(unique_ref<BlockStore2> blockStore, CryConfigFile *configFile, const LocalStateDir& localStateDir, uint32_t myClientId, bool allowIntegrityViolations, bool missingBlockIsIntegrityViolation, std::function<void()> onIntegrityViolation) {
-  auto blobStore = CreateBlobStore(std::move(blockStore), localStateDir, configFile, myClientId, allowIntegrityViolations, missingBlockIsIntegrityViolation, std::move(onIntegrityViolation));
+unique_ref<parallelaccessfsblobstore::ParallelAccessFsBlobStore> CryDevice::CreateFsBlobStore(unique_ref<BlockStore2> blockStore, CryConfigFile *configFile, const LocalStateDir& localStateDir, uint32_t myClientId, bool allowIntegrityViolations, bool missingBlockIsIntegrityViolation, std::function<void()> onIntegrityViolation, optional<uint64_t> blockCacheSizeBytes, CachingBlockStore2 **blockCache) {
+  auto blobStore = CreateBlobStore(std::move(blockStore), localStateDir, configFile, myClientId, allowIntegrityViolations, missingBlockIsIntegrityViolation, std::move(onIntegrityViolation), blockCacheSizeBytes, blockCache);
 
 #ifndef CRYFS_NO_COMPATIBILITY
   auto fsBlobStore = MigrateOrCreateFsBlobStore(std::move(blobStore), configFile);
@@ -93,16 +113,17 @@ unique_ref<fsblobstore::FsBlobStore> CryDevice::MigrateOrCreateFsBlobStore(uniqu
 }
 #endif
 
-unique_ref<blobstore::BlobStore> CryDevice::CreateBlobStore(unique_ref<BlockStore2> blockStore, const LocalStateDir& localStateDir, CryConfigFile *configFile, uint32_t myClientId, bool allowIntegrityViolations, bool missingBlockIsIntegrityViolation, std::function<void()> onIntegrityViolation) {
+unique_ref<blobstore::BlobStore> CryDevice::CreateBlobStore(unique_ref<BlockStore2> blockStore, const LocalStateDir& localStateDir, CryConfigFile *configFile, uint32_t myClientId, bool allowIntegrityViolations, bool missingBlockIsIntegrityViolation, std::function<void()> onIntegrityViolation, optional<uint64_t> blockCacheSizeBytes, CachingBlockStore2 **blockCache) {
   auto integrityEncryptedBlockStore = CreateIntegrityEncryptedBlockStore(std::move(blockStore), localStateDir, configFile, myClientId, allowIntegrityViolations, missingBlockIsIntegrityViolation, std::move(onIntegrityViolation));
   // Create integrityEncryptedBlockStore not in the same line as BlobStoreOnBlocks, because it can modify BlocksizeBytes
   // in the configFile and therefore has to be run before the second parameter to the BlobStoreOnBlocks parameter is evaluated.
+  auto cachingBlockStore = make_unique_ref<CachingBlockStore2>(
+      std::move(integrityEncryptedBlockStore),
+      blockCacheSizeBytes.value_or(CachingBlockStore2::DEFAULT_MAX_CACHE_SIZE_BYTES)
+  );
+  *blockCache = cachingBlockStore.get();
   return make_unique_ref<BlobStoreOnBlocks>(
-     make_unique_ref<LowToHighLevelBlockStore>(
-         make_unique_ref<CachingBlockStore2>(
-             std::move(integrityEncryptedBlockStore)
-         )
-     ),
+     make_unique_ref<LowToHighLevelBlockStore>(std::move(cachingBlockStore)),
      configFile->config()->BlocksizeBytes());
 }
 
@@ -225,36 +246,70 @@ CryDevice::DirBlobWithParent CryDevice::LoadDirBlobWithParent(const bf::path &pa
 }
 
 CryDevice::BlobWithParent CryDevice::LoadBlobWithParent(const bf::path &path) {
+  // Resolve path components using the directory entry cache as far as possible, so we only have to load
+  // directory blobs for components that aren't cached. Blobs are loaded lazily, i.e. if all components are
+  // cached, we only load the blob itself and its parent.
+  fsblobstore::DirEntryCache *dirEntryCache = _fsBlobStore->dirEntryCache();
   optional<unique_ref<DirBlobRef>> parentBlob = none;
-  optional<unique_ref<FsBlobRef>> currentBlobOpt = _fsBlobStore->load(_rootBlobId);
-  if (currentBlobOpt == none) {
-    LOG(ERR, "Could not load root blob. Is the base directory accessible?");
-    throw FuseErrnoException(EIO);
-  }
-  unique_ref<FsBlobRef> currentBlob = std::move(*currentBlobOpt);
-  ASSERT(currentBlob->parentPointer() == BlockId::Null(), "Root Blob should have a nullptr as parent");
+  optional<unique_ref<FsBlobRef>> currentBlob = none;
+  BlockId parentId = BlockId::Null();
+  BlockId currentId = _rootBlobId;
+  fspp::Dir::EntryType currentType = fspp::Dir::EntryType::DIR;
 
   for (const bf::path &component : path.relative_path()) {
-    auto currentDir = dynamic_pointer_move<DirBlobRef>(currentBlob);
+    if (currentType != fspp::Dir::EntryType::DIR) {
+      // We know the type from the dir entry, no need to load the blob to find out it isn't a directory
+      throw FuseErrnoException(ENOTDIR); // Path component is not a dir
+    }
+    auto cached = dirEntryCache->get(currentId, component.string());
+    if (cached != none) {
+      parentBlob = none;
+      currentBlob = none;
+      parentId = currentId;
+      currentId = cached->blockId;
+      currentType = cached->type;
+      continue;
+    }
+
+    if (currentBlob == none) {
+      currentBlob = LoadBlobForPathResolution(currentId);
+    }
+    auto currentDir = dynamic_pointer_move<DirBlobRef>(*currentBlob);
     if (currentDir == none) {
       throw FuseErrnoException(ENOTDIR); // Path component is not a dir
     }
 
-    auto childOpt = (*currentDir)->GetChild(component.string());
+    auto childOpt = (*currentDir)->GetChild(component.string()); // This also adds the entry to dirEntryCache
     if (childOpt == boost::none) {
       throw FuseErrnoException(ENOENT); // Child entry in directory not found
     }
     BlockId childId = childOpt->blockId();
+    currentType = childOpt->type();
     auto nextBlob = _fsBlobStore->load(childId);
     if (nextBlob == none) {
       throw FuseErrnoException(ENOENT); // Blob for directory entry not found
     }
     parentBlob = std::move(*currentDir);
     currentBlob = std::move(*nextBlob);
-    ASSERT(currentBlob->parentPointer() == (*parentBlob)->blockId(), "Blob has wrong parent pointer");
+    parentId = currentId;
+    currentId = childId;
+  }
+
+  if (currentBlob == none) {
+    currentBlob = _fsBlobStore->load(currentId);
+    if (currentBlob == none) {
+      throw FuseErrnoException(ENOENT); // Blob for directory entry not found
+    }
   }
+  if (parentBlob == none && parentId != BlockId::Null()) {
+    auto loadedParent = LoadBlobForPathResolution(parentId);
+    auto parent = dynamic_pointer_move<DirBlobRef>(loadedParent);
+    ASSERT(parent != none, "Cached directory entry has a parent that isn't a directory");
+    parentBlob = std::move(*parent);
+  }
+  ASSERT((*currentBlob)->parentPointer() == parentId, "Blob has wrong parent pointer");
 
-  return BlobWithParent{std::move(currentBlob), std::move(parentBlob)};
+  return BlobWithParent{std::move(*currentBlob), std::move(parentBlob)};
 
   //TODO (I think this is resolved, but I should test it)
   //     Running the python script, waiting for "Create files in sequential order...", then going into dir ~/tmp/cryfs-mount-.../Bonnie.../ and calling "ls"
@@ -304,6 +359,18 @@ unique_ref<FsBlobRef> CryDevice::LoadBlob(const blockstore::BlockId &blockId) {
   return std::move(*blob);
 }
 
+unique_ref<FsBlobRef> CryDevice::LoadBlobForPathResolution(const BlockId &blockId) {
+  auto blob = _fsBlobStore->load(blockId);
+  if (blob == none) {
+    if (blockId == _rootBlobId) {
+      LOG(ERR, "Could not load root blob. Is the base directory accessible?");
+      throw FuseErrnoException(EIO);
+    }
+    throw FuseErrnoException(ENOENT); // Blob for directory entry not found
+  }
+  return std::move(*blob);
+}
+
 void CryDevice::RemoveBlob(const blockstore::BlockId &blockId) {
   auto blob = _fsBlobStore->load(blockId);
   if (blob == none) {
@@ -344,4 +411,98 @@ uint64_t CryDevice::numBlocks() const {
   return _fsBlobStore->numBlocks();
 }
 
+void CryDevice::writeBackBlockCache() const {
+  _blockCache->writeBack();
+}
+
+cpputils::ThreadPool &CryDevice::readAheadThreadPool() const {
+  return _readAheadThreadPool;
+}
+
+ReadAheadCounters &CryDevice::readAheadCounters() const {
+  return _readAheadCounters;
+}
+
+void CryDevice::registerOpenFile(const BlockId &blockId, const CryOpenFile *openFile) const {
+  std::unique_lock<std::mutex> lock(_openFilesMutex);
+  _openFiles.emplace(blockId, openFile);
+}
+
+void CryDevice::unregisterOpenFile(const BlockId &blockId, const CryOpenFile *openFile) const {
+  std::unique_lock<std::mutex> lock(_openFilesMutex);
+  // The caller destructs the open file afterwards, so wait until nobody is storing its updates anymore
+  _openFileNotInUse.wait(lock, [this, openFile] {
+    return _openFilesInUse.count(openFile) == 0;
+  });
+  auto range = _openFiles.equal_range(blockId);
+  for (auto iter = range.first; iter != range.second; ++iter) {
+    if (iter->second == openFile) {
+      _openFiles.erase(iter);
+      return;
+    }
+  }
+  ASSERT(false, "Open file wasn't registered");
+}
+
+void CryDevice::storeTimestampUpdatesOfOpenFiles(const BlockId &blockId) const {
+  std::vector<const CryOpenFile*> openFiles;
+  {
+    std::unique_lock<std::mutex> lock(_openFilesMutex);
+    auto range = _openFiles.equal_range(blockId);
+    for (auto iter = range.first; iter != range.second; ++iter) {
+      openFiles.push_back(iter->second);
+    }
+    _markOpenFilesInUse(openFiles);
+  }
+  try {
+    for (const CryOpenFile *openFile : openFiles) {
+      openFile->storeTimestampUpdates();
+    }
+  } catch (...) {
+    _releaseOpenFilesInUse(openFiles);
+    throw;
+  }
+  _releaseOpenFilesInUse(openFiles);
+}
+
+void CryDevice::_storeTimestampUpdatesOfAllOpenFiles() const {
+  std::vector<const CryOpenFile*> openFiles;
+  {
+    std::unique_lock<std::mutex> lock(_openFilesMutex);
+    openFiles.reserve(_openFiles.size());
+    for (const auto &openFile : _openFiles) {
+      openFiles.push_back(openFile.second);
+    }
+    _markOpenFilesInUse(openFiles);
+  }
+  for (const CryOpenFile *openFile : openFiles) {
+    try {
+      openFile->storeTimestampUpdates();
+    } catch (const std::exception &e) {
+      // The next access, flush or close will try again
+      LOG(ERR, "Couldn't update timestamps in parent directory: {}", e.what());
+    }
+  }
+  _releaseOpenFilesInUse(openFiles);
+}
+
+void CryDevice::_markOpenFilesInUse(const std::vector<const CryOpenFile*> &openFiles) const {
+  // Needs _openFilesMutex to be locked
+  for (const CryOpenFile *openFile : openFiles) {
+    ++_openFilesInUse[openFile];
+  }
+}
+
+void CryDevice::_releaseOpenFilesInUse(const std::vector<const CryOpenFile*> &openFiles) const {
+  std::unique_lock<std::mutex> lock(_openFilesMutex);
+  for (const CryOpenFile *openFile : openFiles) {
+    auto found = _openFilesInUse.find(openFile);
+    ASSERT(found != _openFilesInUse.end(), "Open file wasn't marked as in use");
+    if (0 == --found->second) {
+      _openFilesInUse.erase(found);
+    }
+  }
+  _openFileNotInUse.notify_all();
+}
+
 }
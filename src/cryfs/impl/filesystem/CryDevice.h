@@ -9,18 +9,29 @@
 #include <boost/filesystem.hpp>
 #include <fspp/fs_interface/Device.h>
 #include <cryfs/impl/localstate/LocalStateDir.h>
+#include <cpp-utils/thread/ThreadPool.h>
+#include <blockstore/implementations/caching/CachingBlockStore2.h>
+#include <blockstore/implementations/caching/cache/PeriodicTask.h>
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include "cryfs/impl/filesystem/parallelaccessfsblobstore/ParallelAccessFsBlobStore.h"
 #include "cryfs/impl/filesystem/parallelaccessfsblobstore/DirBlobRef.h"
 #include "cryfs/impl/filesystem/parallelaccessfsblobstore/FileBlobRef.h"
 #include "cryfs/impl/filesystem/parallelaccessfsblobstore/SymlinkBlobRef.h"
+#include "cryfs/impl/filesystem/ReadAheadDetector.h"
 
 
 namespace cryfs {
+class CryOpenFile;
 
 class CryDevice final: public fspp::Device {
 public:
-  CryDevice(std::shared_ptr<CryConfigFile> config, cpputils::unique_ref<blockstore::BlockStore2> blockStore, const LocalStateDir& localStateDir, uint32_t myClientId, bool allowIntegrityViolations, bool missingBlockIsIntegrityViolation, std::function<void ()> onIntegrityViolation);
+  // If blockCacheSizeBytes is none, CachingBlockStore2::DEFAULT_MAX_CACHE_SIZE_BYTES is used
+  CryDevice(std::shared_ptr<CryConfigFile> config, cpputils::unique_ref<blockstore::BlockStore2> blockStore, const LocalStateDir& localStateDir, uint32_t myClientId, bool allowIntegrityViolations, bool missingBlockIsIntegrityViolation, std::function<void ()> onIntegrityViolation, boost::optional<uint64_t> blockCacheSizeBytes);
+  ~CryDevice();
 
   statvfs statfs() override;
 
@@ -47,21 +58,48 @@ public:
 
   uint64_t numBlocks() const;
 
-private:
+  // Writes all dirty cached blocks to the underlying block store, e.g. for fsync
+  void writeBackBlockCache() const;
+
+  cpputils::ThreadPool &readAheadThreadPool() const;
+  ReadAheadCounters &readAheadCounters() const;
 
+  // Open files register themselves, so their collected timestamp updates can be stored periodically
+  // and before operations that set the timestamps of the file explicitly.
+  void registerOpenFile(const blockstore::BlockId &blockId, const CryOpenFile *openFile) const;
+  void unregisterOpenFile(const blockstore::BlockId &blockId, const CryOpenFile *openFile) const;
+  // Stores the timestamp updates that open files of this blob collected but didn't store yet
+  void storeTimestampUpdatesOfOpenFiles(const blockstore::BlockId &blockId) const;
+
+private:
+  void _storeTimestampUpdatesOfAllOpenFiles() const;
+  // Open files marked as in use aren't unregistered (and therefore not destructed) until they're released again.
+  // This way, their updates can be stored without holding _openFilesMutex.
+  void _markOpenFilesInUse(const std::vector<const CryOpenFile*> &openFiles) const;
+  void _releaseOpenFilesInUse(const std::vector<const CryOpenFile*> &openFiles) const;
+
+  // Owned by _fsBlobStore. Declared before it so it's already set when _fsBlobStore is initialized.
+  blockstore::caching::CachingBlockStore2 *_blockCache;
   cpputils::unique_ref<parallelaccessfsblobstore::ParallelAccessFsBlobStore> _fsBlobStore;
 
   blockstore::BlockId _rootBlobId;
   std::shared_ptr<CryConfigFile> _configFile;
   std::vector<std::function<void()>> _onFsAction;
+  mutable cpputils::ThreadPool _readAheadThreadPool;
+  mutable ReadAheadCounters _readAheadCounters;
+  mutable std::mutex _openFilesMutex;
+  mutable std::unordered_multimap<blockstore::BlockId, const CryOpenFile*> _openFiles;
+  mutable std::unordered_map<const CryOpenFile*, size_t> _openFilesInUse;
+  mutable std::condition_variable _openFileNotInUse;
+  std::unique_ptr<blockstore::caching::PeriodicTask> _storeTimestampUpdatesTimer;
 
   blockstore::BlockId GetOrCreateRootBlobId(CryConfigFile *config);
   blockstore::BlockId CreateRootBlobAndReturnId();
-  static cpputils::unique_ref<parallelaccessfsblobstore::ParallelAccessFsBlobStore> CreateFsBlobStore(cpputils::unique_ref<blockstore::BlockStore2> blockStore, CryConfigFile *configFile, const LocalStateDir& localStateDir, uint32_t myClientId, bool allowIntegrityViolations, bool missingBlockIsIntegrityViolation, std::function<void()> onIntegrityViolation);
+  static cpputils::unique_ref<parallelaccessfsblobstore::ParallelAccessFsBlobStore> CreateFsBlobStore(cpputils::unique_ref<blockstore::BlockStore2> blockStore, CryConfigFile *configFile, const LocalStateDir& localStateDir, uint32_t myClientId, bool allowIntegrityViolations, bool missingBlockIsIntegrityViolation, std::function<void()> onIntegrityViolation, boost::optional<uint64_t> blockCacheSizeBytes, blockstore::caching::CachingBlockStore2 **blockCache);
 #ifndef CRYFS_NO_COMPATIBILITY
   static cpputils::unique_ref<fsblobstore::FsBlobStore> MigrateOrCreateFsBlobStore(cpputils::unique_ref<blobstore::BlobStore> blobStore, CryConfigFile *configFile);
 #endif
-  static cpputils::unique_ref<blobstore::BlobStore> CreateBlobStore(cpputils::unique_ref<blockstore::BlockStore2> blockStore, const LocalStateDir& localStateDir, CryConfigFile *configFile, uint32_t myClientId, bool allowIntegrityViolations, bool missingBlockIsIntegrityViolation, std::function<void()> onIntegrityViolation);
+  static cpputils::unique_ref<blobstore::BlobStore> CreateBlobStore(cpputils::unique_ref<blockstore::BlockStore2> blockStore, const LocalStateDir& localStateDir, CryConfigFile *configFile, uint32_t myClientId, bool allowIntegrityViolations, bool missingBlockIsIntegrityViolation, std::function<void()> onIntegrityViolation, boost::optional<uint64_t> blockCacheSizeBytes, blockstore::caching::CachingBlockStore2 **blockCache);
   static cpputils::unique_ref<blockstore::BlockStore2> CreateIntegrityEncryptedBlockStore(cpputils::unique_ref<blockstore::BlockStore2> blockStore, const LocalStateDir& localStateDir, CryConfigFile *configFile, uint32_t myClientId, bool allowIntegrityViolations, bool missingBlockIsIntegrityViolation, std::function<void()> onIntegrityViolation);
   static cpputils::unique_ref<blockstore::BlockStore2> CreateEncryptedBlockStore(const CryConfig &config, cpputils::unique_ref<blockstore::BlockStore2> baseBlockStore);
 
@@ -70,6 +108,7 @@ private:
       boost::optional<cpputils::unique_ref<parallelaccessfsblobstore::DirBlobRef>> parent;
   };
   BlobWithParent LoadBlobWithParent(const boost::filesystem::path &path);
+  cpputils::unique_ref<parallelaccessfsblobstore::FsBlobRef> LoadBlobForPathResolution(const blockstore::BlockId &blockId);
 
   DISALLOW_COPY_AND_ASSIGN(CryDevice);
 };
@@ -96,6 +96,10 @@ void CryDir::createSymlink(const string &name, const bf::path &target, fspp::uid
   auto child = device()->CreateSymlinkBlob(target, blockId());
   auto now = cpputils::time::now();
   blob->AddChildSymlink(name, child->blockId(), uid, gid, now, now);
+  if (device()->config().FileSizesInDirEntries()) {
+    // Symlinks never change, so their size only has to be stored once
+    blob->setSizeOfChild(child->blockId(), child->lstat_size());
+  }
 }
 
 void CryDir::remove() {
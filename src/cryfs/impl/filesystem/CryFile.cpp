@@ -44,7 +44,13 @@ void CryFile::truncate(fspp::num_bytes_t size) {
   device()->callFsActionCallbacks();
   auto blob = LoadBlob(); // NOLINT (workaround https://gcc.gnu.org/bugzilla/show_bug.cgi?id=82481 )
   blob->resize(size);
+  // Otherwise, storing an older write of an open file later would overwrite the mtime set here
+  device()->storeTimestampUpdatesOfOpenFiles(blockId());
   parent()->updateModificationTimestampForChild(blockId());
+  if (device()->config().FileSizesInDirEntries()) {
+    // Set it while we still have the blob loaded, so that a concurrent stat() can't see the old size
+    parent()->setSizeOfChild(blockId(), size);
+  }
 }
 
 fspp::Dir::EntryType CryFile::getType() const {
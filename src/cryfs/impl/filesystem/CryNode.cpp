@@ -98,7 +98,7 @@ void CryNode::rename(const bf::path &to) {
   } else {
     _updateTargetDirModificationTimestamp(*targetDir, std::move(targetDirParent));
     targetDir->AddOrOverwriteChild(to.filename().string(), oldEntry.blockId(), oldEntry.type(), oldEntry.mode(), oldEntry.uid(), oldEntry.gid(),
-                                   oldEntry.lastAccessTime(), oldEntry.lastModificationTime(), onOverwritten);
+                                   oldEntry.lastAccessTime(), oldEntry.lastModificationTime(), oldEntry.size(), onOverwritten);
     (*_parent)->RemoveChild(oldEntry.name());
     // targetDir is now the new parent for this node. Adapt to it, so we can call further operations on this node object.
     LoadBlob()->setParentPointer(targetDir->blockId());
@@ -129,6 +129,8 @@ void CryNode::utimens(timespec lastAccessTime, timespec lastModificationTime) {
     //TODO What should we do?
     return;
   }
+  // Otherwise, storing an older read or write of an open file later would overwrite the timestamps set here
+  device()->storeTimestampUpdatesOfOpenFiles(_blockId);
   (*_parent)->utimensChild(_blockId, lastAccessTime, lastModificationTime);
 }
 
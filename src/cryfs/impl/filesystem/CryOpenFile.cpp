@@ -5,63 +5,221 @@
 
 #include "CryDevice.h"
 #include <fspp/fs_interface/FuseErrnoException.h>
+#include <cpp-utils/logging/logging.h>
+#include <cpp-utils/system/time.h>
 
 
 using std::shared_ptr;
 using cpputils::unique_ref;
 using cryfs::parallelaccessfsblobstore::FileBlobRef;
 using cryfs::parallelaccessfsblobstore::DirBlobRef;
+using namespace cpputils::logging;
 
 //TODO Get rid of this in favor of a exception hierarchy
 
 namespace cryfs {
 
+constexpr uint64_t CryOpenFile::READ_AHEAD_INITIAL_WINDOW_SIZE;
+constexpr uint64_t CryOpenFile::READ_AHEAD_MAX_WINDOW_SIZE;
+constexpr std::chrono::seconds CryOpenFile::TIMESTAMP_UPDATE_MAX_DELAY;
+
 CryOpenFile::CryOpenFile(const CryDevice *device, shared_ptr<DirBlobRef> parent, unique_ref<FileBlobRef> fileBlob)
-: _device(device), _parent(parent), _fileBlob(std::move(fileBlob)) {
+: _device(device), _parent(parent), _fileBlob(std::move(fileBlob)), _readAheadMutex(),
+  _readAheadDetector(READ_AHEAD_INITIAL_WINDOW_SIZE, READ_AHEAD_MAX_WINDOW_SIZE), _runningReadAheads(),
+  _timestampUpdatesMutex(), _timestampUpdates(TIMESTAMP_UPDATE_MAX_DELAY), _sizeInParentMutex(), _sizeInParentIsStored(false) {
+  if (_device->config().FileSizesInDirEntries()) {
+    // Fixes the stored size if it is missing, e.g. because CryFS crashed before the file was flushed after a write.
+    // The file wasn't changed since it was loaded, so its data doesn't have to be written back first.
+    _parent->setSizeOfChild(_fileBlob->blockId(), _fileBlob->size());
+    _sizeInParentIsStored = true;
+  }
+  _device->registerOpenFile(_fileBlob->blockId(), this);
 }
 
 CryOpenFile::~CryOpenFile() {
-  //TODO
+  // After this, the device doesn't call storeTimestampUpdates() anymore
+  _device->unregisterOpenFile(_fileBlob->blockId(), this);
+  // Read aheads access _fileBlob, so they have to finish before it is destructed
+  _waitForReadAhead();
+  try {
+    boost::unique_lock<boost::shared_mutex> sizeLock(_sizeInParentMutex);
+    _updateSizeInParent();
+  } catch (const std::exception &e) {
+    LOG(ERR, "Couldn't update file size in parent directory: {}", e.what());
+  }
+  try {
+    std::unique_lock<std::mutex> lock(_timestampUpdatesMutex);
+    _storeTimestampUpdatesInParent();
+  } catch (const std::exception &e) {
+    LOG(ERR, "Couldn't update timestamps in parent directory: {}", e.what());
+  }
 } // NOLINT (workaround https://gcc.gnu.org/bugzilla/show_bug.cgi?id=82481 )
 
 void CryOpenFile::flush() {
   _device->callFsActionCallbacks();
-  _fileBlob->flush();
+  {
+    boost::unique_lock<boost::shared_mutex> sizeLock(_sizeInParentMutex);
+    _fileBlob->flush();
+    _updateSizeInParent();
+  }
+  {
+    std::unique_lock<std::mutex> lock(_timestampUpdatesMutex);
+    _storeTimestampUpdatesInParent();
+  }
   _parent->flush();
 }
 
+void CryOpenFile::_updateSizeInParent() const {
+  if (_device->config().FileSizesInDirEntries()) {
+    if (!_sizeInParentIsStored) {
+      // The file was changed. Write its data back before storing the new size, so the size can't reach the disk first.
+      _fileBlob->flush();
+      _device->writeBackBlockCache();
+    }
+    _parent->setSizeOfChild(_fileBlob->blockId(), _fileBlob->size());
+    _sizeInParentIsStored = true;
+  }
+}
+
+boost::shared_lock<boost::shared_mutex> CryOpenFile::_lockSizeInParentForChange() const {
+  boost::shared_lock<boost::shared_mutex> lock(_sizeInParentMutex);
+  // Loops because the size could be stored again between unlocking the exclusive lock and locking the shared one
+  while (_sizeInParentIsStored) {
+    lock.unlock();
+    {
+      boost::unique_lock<boost::shared_mutex> exclusiveLock(_sizeInParentMutex);
+      if (_sizeInParentIsStored) {
+        // Remove the size and persist that before changing the file. If CryFS crashes before the next flush
+        // stores the new size, stat() then loads the file instead of returning an outdated size.
+        _parent->setSizeOfChild(_fileBlob->blockId(), boost::none);
+        _parent->flush();
+        _device->writeBackBlockCache();
+        _sizeInParentIsStored = false;
+      }
+    }
+    lock.lock();
+  }
+  return lock;
+}
+
+void CryOpenFile::storeTimestampUpdates() const {
+  std::unique_lock<std::mutex> lock(_timestampUpdatesMutex);
+  if (_timestampUpdates.hasUpdates()) {
+    _storeTimestampUpdatesInParent();
+  }
+}
+
+void CryOpenFile::_storeTimestampUpdatesInParent() const {
+  const auto updates = _timestampUpdates.takeUpdates(cpputils::time::now());
+  if (updates.lastAccessTime != boost::none || updates.lastModificationTime != boost::none) {
+    _parent->applyDelayedTimestampUpdatesForChild(_fileBlob->blockId(), updates.lastAccessTime, timestampUpdateBehavior(), updates.lastModificationTime);
+  }
+}
+
 fspp::Node::stat_info CryOpenFile::stat() const {
   _device->callFsActionCallbacks();
-  return _parent->statChildWithKnownSize(_fileBlob->blockId(), _fileBlob->size());
+  std::unique_lock<std::mutex> lock(_timestampUpdatesMutex);
+  auto result = _parent->statChildWithKnownSize(_fileBlob->blockId(), _fileBlob->size());
+  _timestampUpdates.applyTo(&result, timestampUpdateBehavior());
+  return result;
 }
 
 void CryOpenFile::truncate(fspp::num_bytes_t size) const {
   _device->callFsActionCallbacks();
-  _fileBlob->resize(size);
-  _parent->updateModificationTimestampForChild(_fileBlob->blockId());
+  {
+    auto sizeLock = _lockSizeInParentForChange();
+    _fileBlob->resize(size);
+  }
+  {
+    // Store the timestamps right away, like a truncate through the path does
+    std::unique_lock<std::mutex> lock(_timestampUpdatesMutex);
+    _timestampUpdates.onWrite(cpputils::time::now());
+    _storeTimestampUpdatesInParent();
+  }
 }
 
 fspp::num_bytes_t CryOpenFile::read(void *buf, fspp::num_bytes_t count, fspp::num_bytes_t offset) const {
   _device->callFsActionCallbacks();
-  _parent->updateAccessTimestampForChild(_fileBlob->blockId(), timestampUpdateBehavior());
+  {
+    std::unique_lock<std::mutex> lock(_timestampUpdatesMutex);
+    if (_timestampUpdates.onRead(cpputils::time::now())) {
+      _storeTimestampUpdatesInParent();
+    }
+  }
+  {
+    std::unique_lock<std::mutex> lock(_readAheadMutex);
+    auto decision = _readAheadDetector.onRead(offset.value(), count.value());
+    if (decision.isSequential) {
+      auto &counter = decision.isHit ? _device->readAheadCounters().hits : _device->readAheadCounters().misses;
+      ++counter;
+    }
+    if (decision.readAheadSize != 0) {
+      _readAhead(decision.readAheadOffset, decision.readAheadSize);
+    }
+  }
   return _fileBlob->read(buf, offset, count);
 }
 
+void CryOpenFile::_readAhead(uint64_t offset, uint64_t size) const {
+  // Needs _readAheadMutex to be locked
+  _runningReadAheads.remove_if([] (const std::future<void> &readAhead) {
+    return readAhead.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  });
+  // Prefetching the range loads and decrypts its leaves, which puts them into the block cache
+  // where the following read() calls will find them.
+  _runningReadAheads.push_back(_device->readAheadThreadPool().run([this, offset, size] {
+    try {
+      _fileBlob->prefetch(fspp::num_bytes_t(offset), fspp::num_bytes_t(size));
+    } catch (const std::exception &e) {
+      // Read ahead is only an optimization. If it fails, the actual read() will report the error.
+      LOG(DEBUG, "Read ahead failed: {}", e.what());
+    }
+  }));
+}
+
+void CryOpenFile::_waitForReadAhead() const {
+  std::unique_lock<std::mutex> lock(_readAheadMutex);
+  for (auto &readAhead : _runningReadAheads) {
+    try {
+      readAhead.get();
+    } catch (const std::future_error &e) {
+      // The thread pool was destructed before the read ahead ran. Nothing to wait for.
+    }
+  }
+  _runningReadAheads.clear();
+}
+
 void CryOpenFile::write(const void *buf, fspp::num_bytes_t count, fspp::num_bytes_t offset) {
   _device->callFsActionCallbacks();
-  _parent->updateModificationTimestampForChild(_fileBlob->blockId());
+  {
+    std::unique_lock<std::mutex> lock(_timestampUpdatesMutex);
+    if (_timestampUpdates.onWrite(cpputils::time::now())) {
+      _storeTimestampUpdatesInParent();
+    }
+  }
+  auto sizeLock = _lockSizeInParentForChange();
   _fileBlob->write(buf, offset, count);
 }
 
 void CryOpenFile::fsync() {
   _device->callFsActionCallbacks();
-  _fileBlob->flush();
+  {
+    boost::unique_lock<boost::shared_mutex> sizeLock(_sizeInParentMutex);
+    _fileBlob->flush();
+    _updateSizeInParent();
+  }
+  {
+    std::unique_lock<std::mutex> lock(_timestampUpdatesMutex);
+    _storeTimestampUpdatesInParent();
+  }
   _parent->flush();
+  _device->writeBackBlockCache();
 }
 
 void CryOpenFile::fdatasync() {
   _device->callFsActionCallbacks();
   _fileBlob->flush();
+  _device->writeBackBlockCache();
 }
 
 fspp::TimestampUpdateBehavior CryOpenFile::timestampUpdateBehavior() const {
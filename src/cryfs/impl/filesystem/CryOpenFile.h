@@ -5,6 +5,13 @@
 #include <fspp/fs_interface/OpenFile.h>
 #include "cryfs/impl/filesystem/parallelaccessfsblobstore/FileBlobRef.h"
 #include "cryfs/impl/filesystem/parallelaccessfsblobstore/DirBlobRef.h"
+#include "ReadAheadDetector.h"
+#include "TimestampUpdateCoalescer.h"
+#include <boost/thread/shared_mutex.hpp>
+#include <chrono>
+#include <future>
+#include <list>
+#include <mutex>
 
 namespace cryfs {
 class CryDevice;
@@ -23,10 +30,43 @@ public:
   void fdatasync() override;
   fspp::TimestampUpdateBehavior timestampUpdateBehavior() const;
 
+  // Stores the timestamp updates collected by reads and writes that weren't stored yet
+  void storeTimestampUpdates() const;
+
+  // Reads and writes store their timestamp updates in the parent directory at most this often.
+  // Updates that are still collected after that are stored by a timer in CryDevice.
+  // The kernel caches file attributes for about as long by default.
+  static constexpr std::chrono::seconds TIMESTAMP_UPDATE_MAX_DELAY{1};
+
 private:
+  void _readAhead(uint64_t offset, uint64_t size) const;
+  void _waitForReadAhead() const;
+  // If the file system stores file sizes in dir entries, update the one in the parent.
+  // If the file was changed since the size was stored, its data is written back first.
+  // Needs _sizeInParentMutex to be locked exclusively.
+  void _updateSizeInParent() const;
+  // Removes the size from the parent (if it's stored there) before a change to the file would make it outdated.
+  // Returns a shared lock on _sizeInParentMutex that has to be held while changing the file.
+  boost::shared_lock<boost::shared_mutex> _lockSizeInParentForChange() const;
+  // Needs _timestampUpdatesMutex to be locked
+  void _storeTimestampUpdatesInParent() const;
+
+  // Initial and maximal number of bytes read ahead for sequential reads
+  static constexpr uint64_t READ_AHEAD_INITIAL_WINDOW_SIZE = 128 * 1024;
+  static constexpr uint64_t READ_AHEAD_MAX_WINDOW_SIZE = 4 * 1024 * 1024;
+
   const CryDevice *_device;
   std::shared_ptr<parallelaccessfsblobstore::DirBlobRef> _parent;
   cpputils::unique_ref<parallelaccessfsblobstore::FileBlobRef> _fileBlob;
+  mutable std::mutex _readAheadMutex;
+  mutable ReadAheadDetector _readAheadDetector;
+  mutable std::list<std::future<void>> _runningReadAheads;
+  mutable std::mutex _timestampUpdatesMutex;
+  mutable TimestampUpdateCoalescer _timestampUpdates;
+  // Changes to the file hold it shared, storing the size holds it exclusively.
+  // This way, a stored size always includes all changes that happened before.
+  mutable boost::shared_mutex _sizeInParentMutex;
+  mutable bool _sizeInParentIsStored;
 
   DISALLOW_COPY_AND_ASSIGN(CryOpenFile);
 };
@@ -0,0 +1,44 @@
+#include "ReadAheadDetector.h"
+#include <cpp-utils/assert/assert.h>
+#include <algorithm>
+
+namespace cryfs {
+
+ReadAheadDetector::ReadAheadDetector(uint64_t initialWindowSize, uint64_t maxWindowSize)
+: _initialWindowSize(initialWindowSize), _maxWindowSize(maxWindowSize), _nextExpectedOffset(0), _windowSize(0), _readAheadBegin(0), _readAheadEnd(0) {
+  ASSERT(0 < initialWindowSize && initialWindowSize <= maxWindowSize, "Invalid window sizes");
+}
+
+ReadAheadDetector::Decision ReadAheadDetector::onRead(uint64_t offset, uint64_t count) {
+  const uint64_t readEnd = offset + count;
+  const bool isSequential = (offset == _nextExpectedOffset);
+  const bool isHit = isSequential && _readAheadBegin <= offset && readEnd <= _readAheadEnd;
+  _nextExpectedOffset = readEnd;
+
+  if (!isSequential) {
+    _windowSize = 0;
+    _readAheadBegin = 0;
+    _readAheadEnd = 0;
+    return Decision{false, false, 0, 0};
+  }
+
+  // Only read ahead again once the reader consumed half of what was read ahead,
+  // so that the reads ahead of time stay in flight while the reader continues.
+  if (_windowSize != 0 && readEnd + _windowSize / 2 < _readAheadEnd) {
+    return Decision{true, isHit, 0, 0};
+  }
+
+  _windowSize = (_windowSize == 0) ? _initialWindowSize : std::min(2 * _windowSize, _maxWindowSize);
+  const uint64_t readAheadOffset = std::max(readEnd, _readAheadEnd);
+  const uint64_t readAheadEnd = readEnd + _windowSize;
+  if (readAheadEnd <= readAheadOffset) {
+    return Decision{true, isHit, 0, 0};
+  }
+  if (readAheadOffset != _readAheadEnd) {
+    _readAheadBegin = readAheadOffset;
+  }
+  _readAheadEnd = readAheadEnd;
+  return Decision{true, isHit, readAheadOffset, readAheadEnd - readAheadOffset};
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+#ifndef MESSMER_CRYFS_FILESYSTEM_READAHEADDETECTOR_H_
+#define MESSMER_CRYFS_FILESYSTEM_READAHEADDETECTOR_H_
+
+#include <cpp-utils/macros.h>
+#include <atomic>
+#include <cstdint>
+
+namespace cryfs {
+
+// Counts how many sequential reads could be served from ranges that were read ahead before.
+struct ReadAheadCounters final {
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> misses{0};
+};
+
+/**
+ * ReadAheadDetector watches the reads on an open file and decides which ranges should be read ahead.
+ * Like the kernel readahead, it starts with a small window once it recognizes sequential reads,
+ * doubles the window each time the reader gets close to the end of the range read ahead so far,
+ * and resets it on the first non-sequential read.
+ * This class is not thread safe.
+ */
+class ReadAheadDetector final {
+public:
+  struct Decision final {
+    bool isSequential;
+    // Only valid for sequential reads: true iff the read is completely within a range that was read ahead.
+    bool isHit;
+    // Range that should be read ahead. readAheadSize is 0 if nothing should be read ahead.
+    uint64_t readAheadOffset;
+    uint64_t readAheadSize;
+  };
+
+  ReadAheadDetector(uint64_t initialWindowSize, uint64_t maxWindowSize);
+
+  Decision onRead(uint64_t offset, uint64_t count);
+
+private:
+  const uint64_t _initialWindowSize;
+  const uint64_t _maxWindowSize;
+  uint64_t _nextExpectedOffset;
+  uint64_t _windowSize;
+  uint64_t _readAheadBegin;
+  uint64_t _readAheadEnd;
+
+  DISALLOW_COPY_AND_ASSIGN(ReadAheadDetector);
+};
+
+}
+
+#endif
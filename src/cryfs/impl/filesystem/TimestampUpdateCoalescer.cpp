@@ -0,0 +1,60 @@
+#include "TimestampUpdateCoalescer.h"
+
+using boost::none;
+
+namespace cryfs {
+
+namespace {
+timespec add(timespec time, std::chrono::nanoseconds duration) {
+  constexpr long NANOSECONDS_PER_SECOND = 1000000000;
+  const auto nanoseconds = time.tv_nsec + duration.count();
+  time.tv_sec += nanoseconds / NANOSECONDS_PER_SECOND;
+  time.tv_nsec = nanoseconds % NANOSECONDS_PER_SECOND;
+  return time;
+}
+}
+
+TimestampUpdateCoalescer::TimestampUpdateCoalescer(std::chrono::nanoseconds maxDelay)
+: _maxDelay(maxDelay), _lastStored(none), _updates{none, none} {
+}
+
+bool TimestampUpdateCoalescer::onRead(timespec now) {
+  _updates.lastAccessTime = now;
+  return _shouldStore(now);
+}
+
+bool TimestampUpdateCoalescer::onWrite(timespec now) {
+  _updates.lastModificationTime = now;
+  return _shouldStore(now);
+}
+
+TimestampUpdateCoalescer::Updates TimestampUpdateCoalescer::takeUpdates(timespec now) {
+  Updates result = _updates;
+  _updates = Updates{none, none};
+  _lastStored = now;
+  return result;
+}
+
+bool TimestampUpdateCoalescer::hasUpdates() const {
+  return _updates.lastAccessTime != none || _updates.lastModificationTime != none;
+}
+
+bool TimestampUpdateCoalescer::_shouldStore(timespec now) const {
+  return _lastStored == none || add(*_lastStored, _maxDelay) <= now;
+}
+
+void TimestampUpdateCoalescer::applyTo(fspp::stat_info *stat, const fspp::TimestampUpdateBehavior &timestampUpdateBehavior) const {
+  // Same rules as DirEntryList::applyDelayedTimestampUpdatesForChild
+  if (_updates.lastAccessTime != none
+      && timestampUpdateBehavior->shouldUpdateATimeOnFileRead(stat->atime, stat->mtime, *_updates.lastAccessTime)) {
+    stat->atime = *_updates.lastAccessTime;
+  }
+  if (_updates.lastModificationTime != none) {
+    stat->mtime = *_updates.lastModificationTime;
+    if (stat->ctime < stat->mtime) {
+      stat->ctime = stat->mtime;
+    }
+  }
+}
+
+}
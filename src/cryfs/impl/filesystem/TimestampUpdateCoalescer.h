@@ -0,0 +1,59 @@
+#pragma once
+#ifndef MESSMER_CRYFS_FILESYSTEM_TIMESTAMPUPDATECOALESCER_H_
+#define MESSMER_CRYFS_FILESYSTEM_TIMESTAMPUPDATECOALESCER_H_
+
+#include <cpp-utils/macros.h>
+#include <cpp-utils/system/time.h>
+#include <fspp/fs_interface/Context.h>
+#include <fspp/fs_interface/Types.h>
+#include <boost/optional.hpp>
+#include <chrono>
+
+namespace cryfs {
+
+/**
+ * TimestampUpdateCoalescer collects the timestamp updates caused by reads and writes to an open file,
+ * so that they don't have to be stored in the parent directory on every access.
+ * An access tells the caller to store the collected updates if they weren't stored for maxDelay,
+ * so the first access stores them immediately and the following ones at most once per maxDelay.
+ * Updates collected by the last accesses are stored by a timer (see CryDevice) or when the file is flushed or closed.
+ * Until then, stat() on the open file shows them by calling applyTo().
+ * This class is not thread safe.
+ */
+class TimestampUpdateCoalescer final {
+public:
+  struct Updates final {
+    // Time of the last read, if there was one. Whether it updates the atime is decided by the TimestampUpdateBehavior.
+    boost::optional<timespec> lastAccessTime;
+    // Time of the last write, if there was one
+    boost::optional<timespec> lastModificationTime;
+  };
+
+  explicit TimestampUpdateCoalescer(std::chrono::nanoseconds maxDelay);
+
+  // Return true if the collected updates should be stored now
+  bool onRead(timespec now);
+  bool onWrite(timespec now);
+
+  // Return true if there are collected updates that weren't stored yet
+  bool hasUpdates() const;
+
+  // Returns the collected updates and forgets them. The caller has to store them.
+  Updates takeUpdates(timespec now);
+
+  // Changes the timestamps the parent directory has stored to what they'll be once the collected updates are stored
+  void applyTo(fspp::stat_info *stat, const fspp::TimestampUpdateBehavior &timestampUpdateBehavior) const;
+
+private:
+  bool _shouldStore(timespec now) const;
+
+  const std::chrono::nanoseconds _maxDelay;
+  boost::optional<timespec> _lastStored;
+  Updates _updates;
+
+  DISALLOW_COPY_AND_ASSIGN(TimestampUpdateCoalescer);
+};
+
+}
+
+#endif
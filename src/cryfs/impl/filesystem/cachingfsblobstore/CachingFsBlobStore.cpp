@@ -16,6 +16,7 @@ namespace cryfs {
 namespace cachingfsblobstore {
 
     constexpr double CachingFsBlobStore::MAX_LIFETIME_SEC;
+    constexpr double CachingFsBlobStore::MAX_CLEAN_LIFETIME_SEC;
 
     optional<unique_ref<FsBlobRef>> CachingFsBlobStore::load(const BlockId &blockId) {
         auto fromCache = _cache.pop(blockId);
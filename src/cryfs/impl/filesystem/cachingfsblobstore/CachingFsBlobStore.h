@@ -28,6 +28,7 @@ namespace cryfs {
             uint64_t virtualBlocksizeBytes() const;
             uint64_t numBlocks() const;
             uint64_t estimateSpaceForNumBlocksLeft() const;
+            fsblobstore::DirEntryCache *dirEntryCache();
 
             void releaseForCache(cpputils::unique_ref<fsblobstore::FsBlob> baseBlob);
 
@@ -41,7 +42,9 @@ namespace cryfs {
             blockstore::caching::Cache<blockstore::BlockId, cpputils::unique_ref<fsblobstore::FsBlob>, 50> _cache;
 
         public:
+            // Blobs with unflushed changes are flushed after MAX_LIFETIME_SEC, others are kept cached for up to MAX_CLEAN_LIFETIME_SEC
             static constexpr double MAX_LIFETIME_SEC = decltype(_cache)::MAX_LIFETIME_SEC;
+            static constexpr double MAX_CLEAN_LIFETIME_SEC = decltype(_cache)::MAX_CLEAN_LIFETIME_SEC;
 
         private:
 
@@ -50,7 +53,9 @@ namespace cryfs {
 
 
         inline CachingFsBlobStore::CachingFsBlobStore(cpputils::unique_ref<fsblobstore::FsBlobStore> baseBlobStore)
-                : _baseBlobStore(std::move(baseBlobStore)), _cache("fsblobstore") {
+                : _baseBlobStore(std::move(baseBlobStore)), _cache("fsblobstore", [] (const cpputils::unique_ref<fsblobstore::FsBlob> &blob) {
+                    return blob->hasUnflushedChanges();
+                }) {
         }
 
         inline CachingFsBlobStore::~CachingFsBlobStore() {
@@ -108,6 +113,10 @@ namespace cryfs {
             return _baseBlobStore->estimateSpaceForNumBlocksLeft();
         }
 
+        inline fsblobstore::DirEntryCache *CachingFsBlobStore::dirEntryCache() {
+            return _baseBlobStore->dirEntryCache();
+        }
+
     }
 }
 
@@ -26,8 +26,14 @@ namespace fsblobstore {
 
 constexpr fspp::num_bytes_t DirBlob::DIR_LSTAT_SIZE;
 
-DirBlob::DirBlob(unique_ref<Blob> blob, std::function<fspp::num_bytes_t (const blockstore::BlockId&)> getLstatSize) :
-    FsBlob(std::move(blob)), _getLstatSize(getLstatSize), _getLstatSizeMutex(), _entries(), _entriesAndChangedMutex(), _changed(false) {
+namespace {
+// Unchanged regions shorter than this are rewritten anyway instead of splitting the write into two calls.
+// Each write call has to traverse the data tree, so writing a few unchanged bytes is cheaper.
+constexpr size_t MIN_UNCHANGED_REGION_SIZE = 256;
+}
+
+DirBlob::DirBlob(unique_ref<Blob> blob, std::function<fspp::num_bytes_t (const blockstore::BlockId&, const boost::optional<fspp::num_bytes_t>&)> getLstatSize, DirEntryCache *dirEntryCache) :
+    FsBlob(std::move(blob)), _getLstatSize(getLstatSize), _getLstatSizeMutex(), _entries(), _serializedEntries(0), _dirEntryCache(dirEntryCache), _entriesAndChangedMutex(), _changed(false) {
   ASSERT(baseBlob().blobType() == FsBlobView::BlobType::DIR, "Loaded blob is not a directory");
   _readEntriesFromBlob();
 }
@@ -37,30 +43,71 @@ DirBlob::~DirBlob() {
   _writeEntriesToBlob();
 }
 
+bool DirBlob::hasUnflushedChanges() const {
+  std::unique_lock<std::mutex> lock(_entriesAndChangedMutex);
+  return _changed || FsBlob::hasUnflushedChanges();
+}
+
 void DirBlob::flush() {
   std::unique_lock<std::mutex> lock(_entriesAndChangedMutex);
   _writeEntriesToBlob();
   baseBlob().flush();
 }
 
-unique_ref<DirBlob> DirBlob::InitializeEmptyDir(unique_ref<Blob> blob, const blockstore::BlockId &parent, std::function<fspp::num_bytes_t(const blockstore::BlockId&)> getLstatSize) {
+unique_ref<DirBlob> DirBlob::InitializeEmptyDir(unique_ref<Blob> blob, const blockstore::BlockId &parent, std::function<fspp::num_bytes_t(const blockstore::BlockId&, const boost::optional<fspp::num_bytes_t>&)> getLstatSize, DirEntryCache *dirEntryCache) {
   InitializeBlob(blob.get(), FsBlobView::BlobType::DIR, parent);
-  return make_unique_ref<DirBlob>(std::move(blob), getLstatSize);
+  return make_unique_ref<DirBlob>(std::move(blob), getLstatSize, dirEntryCache);
 }
 
 void DirBlob::_writeEntriesToBlob() {
   if (_changed) {
     Data serialized = _entries.serialize();
-    baseBlob().resize(serialized.size());
-    baseBlob().write(serialized.data(), 0, serialized.size());
+    if (serialized.size() != _serializedEntries.size()) {
+      baseBlob().resize(serialized.size());
+    }
+    _writeChangedRanges(serialized);
+    _serializedEntries = std::move(serialized);
     _changed = false;
   }
 }
 
+void DirBlob::_writeChangedRanges(const Data &serialized) {
+  // Entries are sorted by blob id, so metadata changes (chmod, utimens, ...) of a single child only change a small
+  // byte range of the serialized form. Only writing the changed ranges means that only the leaves containing
+  // them get rewritten (and re-encrypted) instead of all leaves of the directory blob.
+  const uint8_t *newData = static_cast<const uint8_t*>(serialized.data());
+  const uint8_t *oldData = static_cast<const uint8_t*>(_serializedEntries.data());
+  const size_t commonSize = std::min(serialized.size(), _serializedEntries.size());
+
+  size_t pos = 0;
+  while (pos < commonSize) {
+    if (newData[pos] == oldData[pos]) {
+      ++pos;
+      continue;
+    }
+    const size_t rangeBegin = pos;
+    size_t rangeEnd = pos + 1;
+    size_t unchangedRegionSize = 0;
+    for (pos = rangeEnd; pos < commonSize && unchangedRegionSize < MIN_UNCHANGED_REGION_SIZE; ++pos) {
+      if (newData[pos] == oldData[pos]) {
+        ++unchangedRegionSize;
+      } else {
+        unchangedRegionSize = 0;
+        rangeEnd = pos + 1;
+      }
+    }
+    baseBlob().write(newData + rangeBegin, rangeBegin, rangeEnd - rangeBegin);
+  }
+
+  if (serialized.size() > commonSize) {
+    baseBlob().write(newData + commonSize, commonSize, serialized.size() - commonSize);
+  }
+}
+
 void DirBlob::_readEntriesFromBlob() {
   //No lock needed, because this is only called from the constructor.
-  Data data = baseBlob().readAll();
-  _entries.deserializeFrom(static_cast<uint8_t*>(data.data()), data.size());
+  _serializedEntries = baseBlob().readAll();
+  _entries.deserializeFrom(static_cast<uint8_t*>(_serializedEntries.data()), _serializedEntries.size());
 }
 
 void DirBlob::AddChildDir(const std::string &name, const BlockId &blobId, fspp::mode_t mode, fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime) {
@@ -90,21 +137,32 @@ void DirBlob::_addChild(const std::string &name, const BlockId &blobId,
 
 void DirBlob::AddOrOverwriteChild(const std::string &name, const BlockId &blobId, fspp::Dir::EntryType entryType,
                                   fspp::mode_t mode, fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime,
-                                  std::function<void (const blockstore::BlockId &blockId)> onOverwritten) {
+                                  boost::optional<fspp::num_bytes_t> size, std::function<void (const blockstore::BlockId &blockId)> onOverwritten) {
   std::unique_lock<std::mutex> lock(_entriesAndChangedMutex);
-  _entries.addOrOverwrite(name, blobId, entryType, mode, uid, gid, lastAccessTime, lastModificationTime, onOverwritten);
+  _entries.addOrOverwrite(name, blobId, entryType, mode, uid, gid, lastAccessTime, lastModificationTime, size, onOverwritten);
+  _dirEntryCache->invalidate(blockId(), name);
   _changed = true;
 }
 
 void DirBlob::RenameChild(const blockstore::BlockId &blockId, const std::string &newName, std::function<void (const blockstore::BlockId &blockId)> onOverwritten) {
   std::unique_lock<std::mutex> lock(_entriesAndChangedMutex);
+  auto oldEntry = _entries.get(blockId);
+  if (oldEntry != none) {
+    _dirEntryCache->invalidate(this->blockId(), oldEntry->name());
+  }
   _entries.rename(blockId, newName, onOverwritten);
+  _dirEntryCache->invalidate(this->blockId(), newName);
   _changed = true;
 }
 
 boost::optional<const DirEntry&> DirBlob::GetChild(const string &name) const {
   std::unique_lock<std::mutex> lock(_entriesAndChangedMutex);
-  return _entries.get(name);
+  auto found = _entries.get(name);
+  if (found != none) {
+    // Populate the cache while holding the lock, so that we can't race with an invalidation of this entry.
+    _dirEntryCache->put(blockId(), name, found->blockId(), found->type());
+  }
+  return found;
 }
 
 boost::optional<const DirEntry&> DirBlob::GetChild(const BlockId &blockId) const {
@@ -115,11 +173,16 @@ boost::optional<const DirEntry&> DirBlob::GetChild(const BlockId &blockId) const
 void DirBlob::RemoveChild(const string &name) {
   std::unique_lock<std::mutex> lock(_entriesAndChangedMutex);
   _entries.remove(name);
+  _dirEntryCache->invalidate(blockId(), name);
   _changed = true;
 }
 
 void DirBlob::RemoveChild(const BlockId &blockId) {
   std::unique_lock<std::mutex> lock(_entriesAndChangedMutex);
+  auto found = _entries.get(blockId);
+  if (found != none) {
+    _dirEntryCache->invalidate(this->blockId(), found->name());
+  }
   _entries.remove(blockId);
   _changed = true;
 }
@@ -137,6 +200,20 @@ fspp::num_bytes_t DirBlob::lstat_size() const {
 }
 
 fspp::Node::stat_info DirBlob::statChild(const BlockId &blockId) const {
+  std::unique_lock<std::mutex> entriesLock(_entriesAndChangedMutex);
+  auto childOpt = _entries.get(blockId);
+  if (childOpt == boost::none) {
+    throw fspp::fuse::FuseErrnoException(ENOENT);
+  }
+  const fspp::Dir::EntryType childType = childOpt->type();
+  const boost::optional<fspp::num_bytes_t> storedSize = childOpt->size();
+  entriesLock.unlock();
+
+  if (childType == fspp::Dir::EntryType::DIR) {
+    // All directories have the same lstat size, no need to load the child blob
+    return statChildWithKnownSize(blockId, DIR_LSTAT_SIZE);
+  }
+
   std::unique_lock<std::mutex> lock(_getLstatSizeMutex);
   auto lstatSizeGetter = _getLstatSize;
 
@@ -147,7 +224,7 @@ fspp::Node::stat_info DirBlob::statChild(const BlockId &blockId) const {
   // lstatSizeGetter can call ParallelAccessFsBlobStore::load().
   lock.unlock();
 
-  auto lstatSize = lstatSizeGetter(blockId);
+  auto lstatSize = lstatSizeGetter(blockId, storedSize);
   return statChildWithKnownSize(blockId, lstatSize);
 }
 
@@ -186,6 +263,17 @@ void DirBlob::updateModificationTimestampForChild(const BlockId &blockId) {
   _changed = true;
 }
 
+void DirBlob::applyDelayedTimestampUpdatesForChild(const BlockId &blockId, const boost::optional<timespec> &lastAccessTime, const fspp::TimestampUpdateBehavior &timestampUpdateBehavior, const boost::optional<timespec> &lastModificationTime) {
+  std::unique_lock<std::mutex> lock(_entriesAndChangedMutex);
+  if (_entries.get(blockId) == none) {
+    // The child was removed or moved to a different directory while it was open
+    return;
+  }
+  if (_entries.applyDelayedTimestampUpdatesForChild(blockId, lastAccessTime, timestampUpdateBehavior, lastModificationTime)) {
+    _changed = true;
+  }
+}
+
 void DirBlob::chmodChild(const BlockId &blockId, fspp::mode_t mode) {
   std::unique_lock<std::mutex> lock(_entriesAndChangedMutex);
   _entries.setMode(blockId, mode);
@@ -205,7 +293,18 @@ void DirBlob::utimensChild(const BlockId &blockId, timespec lastAccessTime, time
   _changed = true;
 }
 
-void DirBlob::setLstatSizeGetter(std::function<fspp::num_bytes_t(const blockstore::BlockId&)> getLstatSize) {
+void DirBlob::setSizeOfChild(const BlockId &blockId, boost::optional<fspp::num_bytes_t> size) {
+  std::unique_lock<std::mutex> lock(_entriesAndChangedMutex);
+  if (_entries.get(blockId) == none) {
+    // The child was removed or moved to a different directory while it was open
+    return;
+  }
+  if (_entries.setSize(blockId, size)) {
+    _changed = true;
+  }
+}
+
+void DirBlob::setLstatSizeGetter(std::function<fspp::num_bytes_t(const blockstore::BlockId&, const boost::optional<fspp::num_bytes_t>&)> getLstatSize) {
     std::lock_guard<std::mutex> lock(_getLstatSizeMutex);
     _getLstatSize = std::move(getLstatSize);
 }
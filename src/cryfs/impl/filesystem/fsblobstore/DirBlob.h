@@ -4,10 +4,12 @@
 
 #include <blockstore/utils/BlockId.h>
 #include <cpp-utils/macros.h>
+#include <cpp-utils/data/Data.h>
 #include <fspp/fs_interface/Dir.h>
 #include <fspp/fs_interface/Node.h>
 #include "FsBlob.h"
 #include "cryfs/impl/filesystem/fsblobstore/utils/DirEntryList.h"
+#include "cryfs/impl/filesystem/fsblobstore/utils/DirEntryCache.h"
 #include <mutex>
 
 namespace cryfs {
@@ -20,14 +22,17 @@ namespace cryfs {
 
             static cpputils::unique_ref<DirBlob> InitializeEmptyDir(cpputils::unique_ref<blobstore::Blob> blob,
                                                                     const blockstore::BlockId &parent,
-                                                                    std::function<fspp::num_bytes_t (const blockstore::BlockId&)> getLstatSize);
+                                                                    std::function<fspp::num_bytes_t (const blockstore::BlockId&, const boost::optional<fspp::num_bytes_t>&)> getLstatSize,
+                                                                    DirEntryCache *dirEntryCache);
 
-            DirBlob(cpputils::unique_ref<blobstore::Blob> blob, std::function<fspp::num_bytes_t (const blockstore::BlockId&)> getLstatSize);
+            DirBlob(cpputils::unique_ref<blobstore::Blob> blob, std::function<fspp::num_bytes_t (const blockstore::BlockId&, const boost::optional<fspp::num_bytes_t>&)> getLstatSize, DirEntryCache *dirEntryCache);
 
             ~DirBlob();
 
             fspp::num_bytes_t lstat_size() const override;
 
+            bool hasUnflushedChanges() const override;
+
             void AppendChildrenTo(std::vector<fspp::Dir::Entry> *result) const;
 
             //TODO Test NumChildren()
@@ -45,9 +50,10 @@ namespace cryfs {
 
             void AddChildSymlink(const std::string &name, const blockstore::BlockId &blobId, fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime);
 
+            // size is the size to store in the entry (see DirEntry::size()), e.g. the one the entry had before being moved here
             void AddOrOverwriteChild(const std::string &name, const blockstore::BlockId &blobId, fspp::Dir::EntryType type,
                           fspp::mode_t mode, fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime,
-                          std::function<void (const blockstore::BlockId &blockId)> onOverwritten);
+                          boost::optional<fspp::num_bytes_t> size, std::function<void (const blockstore::BlockId &blockId)> onOverwritten);
 
             void RenameChild(const blockstore::BlockId &blockId, const std::string &newName, std::function<void (const blockstore::BlockId &blockId)> onOverwritten);
 
@@ -65,13 +71,20 @@ namespace cryfs {
 
             void updateModificationTimestampForChild(const blockstore::BlockId &blockId);
 
+            // Stores the timestamp updates an open file collected for the child, see TimestampUpdateCoalescer
+            void applyDelayedTimestampUpdatesForChild(const blockstore::BlockId &blockId, const boost::optional<timespec> &lastAccessTime, const fspp::TimestampUpdateBehavior &timestampUpdateBehavior, const boost::optional<timespec> &lastModificationTime);
+
             void chmodChild(const blockstore::BlockId &blockId, fspp::mode_t mode);
 
             void chownChild(const blockstore::BlockId &blockId, fspp::uid_t uid, fspp::gid_t gid);
 
             void utimensChild(const blockstore::BlockId &blockId, timespec lastAccessTime, timespec lastModificationTime);
 
-            void setLstatSizeGetter(std::function<fspp::num_bytes_t(const blockstore::BlockId&)> getLstatSize);
+            // Stores the size of a file child (see DirEntry::size()). boost::none removes it, so stat() loads the child blob instead.
+            void setSizeOfChild(const blockstore::BlockId &blockId, boost::optional<fspp::num_bytes_t> size);
+
+            // The getter gets the size stored in the dir entry (if any) and can return it instead of loading the child blob
+            void setLstatSizeGetter(std::function<fspp::num_bytes_t(const blockstore::BlockId&, const boost::optional<fspp::num_bytes_t>&)> getLstatSize);
 
         private:
 
@@ -79,12 +92,16 @@ namespace cryfs {
                           fspp::mode_t mode, fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime);
             void _readEntriesFromBlob();
             void _writeEntriesToBlob();
+            void _writeChangedRanges(const cpputils::Data &serialized);
 
             cpputils::unique_ref<blobstore::Blob> releaseBaseBlob() override;
 
-            std::function<fspp::num_bytes_t (const blockstore::BlockId&)> _getLstatSize;
+            std::function<fspp::num_bytes_t (const blockstore::BlockId&, const boost::optional<fspp::num_bytes_t>&)> _getLstatSize;
             mutable std::mutex _getLstatSizeMutex;
             DirEntryList _entries;
+            // Serialized form of _entries as it is currently stored in the blob. Used to only write the bytes that actually changed.
+            cpputils::Data _serializedEntries;
+            DirEntryCache *_dirEntryCache;
             mutable std::mutex _entriesAndChangedMutex;
             bool _changed;
 
@@ -25,6 +25,10 @@ fspp::num_bytes_t FileBlob::read(void *target, fspp::num_bytes_t offset, fspp::n
   return fspp::num_bytes_t(baseBlob().tryRead(target, offset.value(), count.value()));
 }
 
+void FileBlob::prefetch(fspp::num_bytes_t offset, fspp::num_bytes_t count) const {
+  baseBlob().prefetch(offset.value(), count.value());
+}
+
 void FileBlob::write(const void *source, fspp::num_bytes_t offset, fspp::num_bytes_t count) {
   baseBlob().write(source, offset.value(), count.value());
 }
@@ -15,6 +15,9 @@ namespace cryfs {
 
             fspp::num_bytes_t read(void *target, fspp::num_bytes_t offset, fspp::num_bytes_t count) const;
 
+            // Loads the leaves of the given range into the block cache, see blobstore::Blob::prefetch()
+            void prefetch(fspp::num_bytes_t offset, fspp::num_bytes_t count) const;
+
             void write(const void *source, fspp::num_bytes_t offset, fspp::num_bytes_t count);
 
             void flush();
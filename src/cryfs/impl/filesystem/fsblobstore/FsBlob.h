@@ -14,6 +14,8 @@ namespace cryfs {
             virtual ~FsBlob();
 
             virtual fspp::num_bytes_t lstat_size() const = 0;
+            // True if the blob has changes that weren't flushed to the underlying blob store yet
+            virtual bool hasUnflushedChanges() const;
             const blockstore::BlockId &blockId() const;
             const blockstore::BlockId &parentPointer() const;
             void setParentPointer(const blockstore::BlockId &parentId);
@@ -48,6 +50,10 @@ namespace cryfs {
         inline FsBlob::~FsBlob() {
         }
 
+        inline bool FsBlob::hasUnflushedChanges() const {
+            return _baseBlob.hasUnflushedChanges();
+        }
+
         inline const blockstore::BlockId &FsBlob::blockId() const {
             return _baseBlob.blockId();
         }
@@ -62,6 +68,8 @@ namespace cryfs {
 
         inline void FsBlob::InitializeBlob(blobstore::Blob *blob, FsBlobView::BlobType magicNumber, const blockstore::BlockId &parent) {
             FsBlobView::InitializeBlob(blob, magicNumber, parent);
+            // The header is written to the blob directly, so the FsBlobView created afterwards wouldn't know about it
+            blob->flush();
         }
 
         inline cpputils::unique_ref<blobstore::Blob> FsBlob::releaseBaseBlob() {
@@ -31,6 +31,8 @@ namespace cryfs {
 
             uint64_t virtualBlocksizeBytes() const;
 
+            DirEntryCache *dirEntryCache();
+
 #ifndef CRYFS_NO_COMPATIBILITY
             static cpputils::unique_ref<FsBlobStore> migrate(cpputils::unique_ref<blobstore::BlobStore> blobStore, const blockstore::BlockId &blockId);
 #endif
@@ -41,15 +43,16 @@ namespace cryfs {
             void _migrate(cpputils::unique_ref<blobstore::Blob> node, const blockstore::BlockId &parentId, cpputils::SignalCatcher* signalCatcher, std::function<void(uint32_t numNodes)> perBlobCallback);
 #endif
 
-            std::function<fspp::num_bytes_t(const blockstore::BlockId &)> _getLstatSize();
+            std::function<fspp::num_bytes_t(const blockstore::BlockId &, const boost::optional<fspp::num_bytes_t> &)> _getLstatSize();
 
             cpputils::unique_ref<blobstore::BlobStore> _baseBlobStore;
+            DirEntryCache _dirEntryCache;
 
             DISALLOW_COPY_AND_ASSIGN(FsBlobStore);
         };
 
         inline FsBlobStore::FsBlobStore(cpputils::unique_ref<blobstore::BlobStore> baseBlobStore)
-                : _baseBlobStore(std::move(baseBlobStore)) {
+                : _baseBlobStore(std::move(baseBlobStore)), _dirEntryCache() {
         }
 
         inline cpputils::unique_ref<FileBlob> FsBlobStore::createFileBlob(const blockstore::BlockId &parent) {
@@ -59,7 +62,7 @@ namespace cryfs {
 
         inline cpputils::unique_ref<DirBlob> FsBlobStore::createDirBlob(const blockstore::BlockId &parent) {
             auto blob = _baseBlobStore->create();
-            return DirBlob::InitializeEmptyDir(std::move(blob), parent, _getLstatSize());
+            return DirBlob::InitializeEmptyDir(std::move(blob), parent, _getLstatSize(), &_dirEntryCache);
         }
 
         inline cpputils::unique_ref<SymlinkBlob> FsBlobStore::createSymlinkBlob(const boost::filesystem::path &target, const blockstore::BlockId &parent) {
@@ -83,8 +86,10 @@ namespace cryfs {
             _baseBlobStore->remove(blockId);
         }
 
-        inline std::function<fspp::num_bytes_t (const blockstore::BlockId &)> FsBlobStore::_getLstatSize() {
-            return [this] (const blockstore::BlockId &blockId) {
+        inline std::function<fspp::num_bytes_t (const blockstore::BlockId &, const boost::optional<fspp::num_bytes_t> &)> FsBlobStore::_getLstatSize() {
+            // Ignores the stored size. This store doesn't know whether the child is open and might have a newer size.
+            // ParallelAccessFsBlobStore replaces this getter with one that knows.
+            return [this] (const blockstore::BlockId &blockId, const boost::optional<fspp::num_bytes_t> &/*storedSize*/) {
                 auto blob = load(blockId);
                 ASSERT(blob != boost::none, "Blob not found");
                 return (*blob)->lstat_size();
@@ -94,6 +99,10 @@ namespace cryfs {
         inline uint64_t FsBlobStore::virtualBlocksizeBytes() const {
             return _baseBlobStore->virtualBlocksizeBytes();
         }
+
+        inline DirEntryCache *FsBlobStore::dirEntryCache() {
+            return &_dirEntryCache;
+        }
     }
 }
 
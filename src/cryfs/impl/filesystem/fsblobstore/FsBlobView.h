@@ -4,6 +4,7 @@
 
 #include <blobstore/interface/Blob.h>
 #include <cpp-utils/pointer/unique_ref.h>
+#include <atomic>
 
 namespace cryfs {
 
@@ -17,7 +18,7 @@ namespace cryfs {
             SYMLINK = 0x02
         };
 
-        FsBlobView(cpputils::unique_ref<blobstore::Blob> baseBlob): _baseBlob(std::move(baseBlob)), _parentPointer(blockstore::BlockId::Null()) {
+        FsBlobView(cpputils::unique_ref<blobstore::Blob> baseBlob): _baseBlob(std::move(baseBlob)), _parentPointer(blockstore::BlockId::Null()), _hasUnflushedChanges(false) {
             _checkHeader(*_baseBlob);
             _loadParentPointer();
         }
@@ -58,6 +59,7 @@ namespace cryfs {
         }
 
         void resize(uint64_t numBytes) override {
+            _hasUnflushedChanges = true;
             return _baseBlob->resize(numBytes + HEADER_SIZE);
         }
 
@@ -77,14 +79,26 @@ namespace cryfs {
             return _baseBlob->tryRead(target, offset + HEADER_SIZE, size);
         }
 
+        void prefetch(uint64_t offset, uint64_t size) const override {
+            return _baseBlob->prefetch(offset + HEADER_SIZE, size);
+        }
+
         void write(const void *source, uint64_t offset, uint64_t size) override {
+            _hasUnflushedChanges = true;
             return _baseBlob->write(source, offset + HEADER_SIZE, size);
         }
 
         void flush() override {
+            // Reset it before flushing, so changes made concurrently to the flush aren't forgotten
+            _hasUnflushedChanges = false;
             return _baseBlob->flush();
         }
 
+        // True if something was written through this view since the last flush()
+        bool hasUnflushedChanges() const {
+            return _hasUnflushedChanges;
+        }
+
         uint32_t numNodes() const override {
             return _baseBlob->numNodes();
         }
@@ -128,12 +142,14 @@ namespace cryfs {
         }
 
         void _storeParentPointer() {
+            _hasUnflushedChanges = true;
             _baseBlob->write(_parentPointer.data().data(), sizeof(FORMAT_VERSION_HEADER) + sizeof(uint8_t), blockstore::BlockId::BINARY_LENGTH);
         }
 
 
         cpputils::unique_ref<blobstore::Blob> _baseBlob;
         blockstore::BlockId _parentPointer;
+        std::atomic<bool> _hasUnflushedChanges;
 
         DISALLOW_COPY_AND_ASSIGN(FsBlobView);
     };
@@ -24,6 +24,8 @@ unique_ref<SymlinkBlob> SymlinkBlob::InitializeSymlink(unique_ref<Blob> blob, co
   string targetStr = target.string();
   symlinkBlobView.resize(targetStr.size());
   symlinkBlobView.write(targetStr.c_str(), 0, targetStr.size());
+  // The new view created by the SymlinkBlob constructor wouldn't know about the write
+  symlinkBlobView.flush();
   return make_unique_ref<SymlinkBlob>(symlinkBlobView.releaseBaseBlob());
 }
 
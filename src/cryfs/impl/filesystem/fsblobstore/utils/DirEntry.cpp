@@ -10,6 +10,10 @@ namespace cryfs {
     namespace fsblobstore {
 
         namespace {
+            // Set in the serialized type field if the entry stores the size of the child. The size then follows the blob id.
+            // Older CryFS versions don't know this flag and can't read directories with such entries.
+            constexpr uint8_t HAS_SIZE_FLAG = 0x80;
+
             template<typename DataType>
             size_t _serialize(void* dst, const DataType& obj) {
                 cpputils::serialize<DataType>(dst, obj);
@@ -75,7 +79,11 @@ namespace cryfs {
                     _mode.hasDirFlag()) + ", " + std::to_string(_mode.hasSymlinkFlag()) + ", " + std::to_string(static_cast<uint8_t>(_type))
             );
             unsigned int offset = 0;
-            offset += _serialize<uint8_t>(dest + offset, static_cast<uint8_t>(_type));
+            uint8_t serializedType = static_cast<uint8_t>(_type);
+            if (_size != boost::none) {
+                serializedType |= HAS_SIZE_FLAG;
+            }
+            offset += _serialize<uint8_t>(dest + offset, serializedType);
             offset += _serialize<uint32_t>(dest + offset, _mode.value());
             offset += _serialize<uint32_t>(dest + offset, _uid.value());
             offset += _serialize<uint32_t>(dest + offset, _gid.value());
@@ -84,11 +92,15 @@ namespace cryfs {
             offset += _serializeTimeValue(dest + offset, _lastMetadataChangeTime);
             offset += _serializeString(dest + offset, _name);
             offset += _serializeBlockId(dest + offset, _blockId);
+            if (_size != boost::none) {
+                offset += _serialize<uint64_t>(dest + offset, static_cast<uint64_t>(_size->value()));
+            }
             ASSERT(offset == serializedSize(), "Didn't write correct number of elements");
         }
 
         const char *DirEntry::deserializeAndAddToVector(const char *pos, vector<DirEntry> *result) {
-            fspp::Dir::EntryType type = static_cast<fspp::Dir::EntryType>(_deserialize<uint8_t>(&pos));
+            uint8_t serializedType = _deserialize<uint8_t>(&pos);
+            fspp::Dir::EntryType type = static_cast<fspp::Dir::EntryType>(static_cast<uint8_t>(serializedType & ~HAS_SIZE_FLAG));
             fspp::mode_t mode = fspp::mode_t(_deserialize<uint32_t>(&pos));
             fspp::uid_t uid = fspp::uid_t(_deserialize<uint32_t>(&pos));
             fspp::gid_t gid = fspp::gid_t(_deserialize<uint32_t>(&pos));
@@ -97,14 +109,18 @@ namespace cryfs {
             timespec lastMetadataChangeTime = _deserializeTimeValue(&pos);
             string name = _deserializeString(&pos);
             BlockId blockId = _deserializeBlockId(&pos);
+            boost::optional<fspp::num_bytes_t> size = boost::none;
+            if (serializedType & HAS_SIZE_FLAG) {
+                size = fspp::num_bytes_t(static_cast<int64_t>(_deserialize<uint64_t>(&pos)));
+            }
 
-            result->emplace_back(type, name, blockId, mode, uid, gid, lastAccessTime, lastModificationTime, lastMetadataChangeTime);
+            result->emplace_back(type, name, blockId, mode, uid, gid, lastAccessTime, lastModificationTime, lastMetadataChangeTime, size);
             return pos;
         }
 
         size_t DirEntry::serializedSize() const {
             return 1 + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t) + 3*_serializedTimeValueSize() + (
-                    _name.size() + 1) + _blockId.BINARY_LENGTH;
+                    _name.size() + 1) + _blockId.BINARY_LENGTH + (_size != boost::none ? sizeof(uint64_t) : 0);
         }
     }
 }
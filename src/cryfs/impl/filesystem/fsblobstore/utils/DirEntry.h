@@ -6,6 +6,7 @@
 #include <fspp/fs_interface/Dir.h>
 #include <fspp/fs_interface/Types.h>
 #include <cpp-utils/system/time.h>
+#include <boost/optional.hpp>
 #include <sys/stat.h>
 
 namespace cryfs {
@@ -15,7 +16,7 @@ namespace cryfs {
         public:
             DirEntry(fspp::Dir::EntryType type, const std::string &name, const blockstore::BlockId &blockId, fspp::mode_t mode,
                   fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime,
-                  timespec lastMetadataChangeTime);
+                  timespec lastMetadataChangeTime, boost::optional<fspp::num_bytes_t> size = boost::none);
 
             void serialize(uint8_t* dest) const;
             size_t serializedSize() const;
@@ -43,9 +44,16 @@ namespace cryfs {
 
             timespec lastModificationTime() const;
             void setLastModificationTime(timespec value);
+            // For modifications that are stored later than they happened. The metadata change time is the modification time then.
+            void setLastModificationTimeOfDelayedUpdate(timespec value);
 
             timespec lastMetadataChangeTime() const;
 
+            // lstat size of the child, if it is stored in the entry. This is an optional extension of the on-disk format
+            // that allows answering stat() without loading the child blob. It is only set for files and symlinks.
+            const boost::optional<fspp::num_bytes_t> &size() const;
+            void setSize(boost::optional<fspp::num_bytes_t> value);
+
         private:
 
             void _updateLastMetadataChangeTime();
@@ -59,13 +67,14 @@ namespace cryfs {
             timespec _lastAccessTime;
             timespec _lastModificationTime;
             timespec _lastMetadataChangeTime;
+            boost::optional<fspp::num_bytes_t> _size;
         };
 
         inline DirEntry::DirEntry(fspp::Dir::EntryType type, const std::string &name, const blockstore::BlockId &blockId, fspp::mode_t mode,
             fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime,
-            timespec lastMetadataChangeTime)
+            timespec lastMetadataChangeTime, boost::optional<fspp::num_bytes_t> size)
                 : _type(type), _name(name), _blockId(blockId), _mode(mode), _uid(uid), _gid(gid), _lastAccessTime(lastAccessTime),
-                _lastModificationTime(lastModificationTime), _lastMetadataChangeTime(lastMetadataChangeTime) {
+                _lastModificationTime(lastModificationTime), _lastMetadataChangeTime(lastMetadataChangeTime), _size(size) {
             switch (_type) {
                 case fspp::Dir::EntryType::FILE:
                     _mode.addFileFlag();
@@ -118,6 +127,15 @@ namespace cryfs {
             return _lastMetadataChangeTime;
         }
 
+        inline const boost::optional<fspp::num_bytes_t> &DirEntry::size() const {
+            return _size;
+        }
+
+        inline void DirEntry::setSize(boost::optional<fspp::num_bytes_t> value) {
+            // The size is cached metadata of the child blob, changing it doesn't change the entry's metadata change time
+            _size = value;
+        }
+
         inline void DirEntry::setType(fspp::Dir::EntryType value) {
             _type = value;
             _updateLastMetadataChangeTime();
@@ -152,6 +170,13 @@ namespace cryfs {
             _updateLastMetadataChangeTime();
         }
 
+        inline void DirEntry::setLastModificationTimeOfDelayedUpdate(timespec value) {
+            _lastModificationTime = value;
+            if (_lastMetadataChangeTime < value) {
+                _lastMetadataChangeTime = value;
+            }
+        }
+
         inline void DirEntry::_updateLastMetadataChangeTime() {
             _lastMetadataChangeTime = cpputils::time::now();
         }
@@ -0,0 +1,69 @@
+#include "DirEntryCache.h"
+
+using std::string;
+using std::unique_lock;
+using std::mutex;
+using blockstore::BlockId;
+using boost::optional;
+using boost::none;
+
+namespace cryfs {
+namespace fsblobstore {
+
+constexpr size_t DirEntryCache::NUM_SHARDS;
+constexpr uint32_t DirEntryCache::MAX_ENTRIES_PER_SHARD;
+
+DirEntryCache::DirEntryCache(): _shards() {
+}
+
+optional<DirEntryCache::Entry> DirEntryCache::get(const BlockId &parent, const string &name) {
+    string key = _key(parent, name);
+    Shard &shard = _shard(parent);
+    unique_lock<mutex> lock(shard.mutex);
+    optional<Entry> found = shard.entries.pop(key);
+    if (found == none) {
+        return none;
+    }
+    // Push it back to the end of the queue so that often used entries don't get evicted
+    shard.entries.push(key, *found);
+    return found;
+}
+
+void DirEntryCache::put(const BlockId &parent, const string &name, const BlockId &blockId, fspp::Dir::EntryType type) {
+    string key = _key(parent, name);
+    Shard &shard = _shard(parent);
+    unique_lock<mutex> lock(shard.mutex);
+    shard.entries.pop(key);
+    if (shard.entries.size() >= MAX_ENTRIES_PER_SHARD) {
+        shard.entries.pop();
+    }
+    shard.entries.push(key, Entry{blockId, type});
+}
+
+void DirEntryCache::invalidate(const BlockId &parent, const string &name) {
+    string key = _key(parent, name);
+    Shard &shard = _shard(parent);
+    unique_lock<mutex> lock(shard.mutex);
+    shard.entries.pop(key);
+}
+
+void DirEntryCache::clear() {
+    for (Shard &shard : _shards) {
+        unique_lock<mutex> lock(shard.mutex);
+        while (shard.entries.pop() != none) {}
+    }
+}
+
+DirEntryCache::Shard &DirEntryCache::_shard(const BlockId &parent) {
+    return _shards[std::hash<BlockId>()(parent) % NUM_SHARDS];
+}
+
+string DirEntryCache::_key(const BlockId &parent, const string &name) {
+    // The binary blob id has a fixed length, so prefixing it to the name gives an unambiguous key.
+    string key(reinterpret_cast<const char*>(parent.data().data()), BlockId::BINARY_LENGTH);
+    key.append(name);
+    return key;
+}
+
+}
+}
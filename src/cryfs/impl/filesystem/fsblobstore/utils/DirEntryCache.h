@@ -0,0 +1,57 @@
+#pragma once
+#ifndef MESSMER_CRYFS_FILESYSTEM_FSBLOBSTORE_UTILS_DIRENTRYCACHE_H
+#define MESSMER_CRYFS_FILESYSTEM_FSBLOBSTORE_UTILS_DIRENTRYCACHE_H
+
+#include <blockstore/utils/BlockId.h>
+#include <blockstore/implementations/caching/cache/QueueMap.h>
+#include <fspp/fs_interface/Dir.h>
+#include <cpp-utils/macros.h>
+#include <boost/optional.hpp>
+#include <array>
+#include <mutex>
+#include <string>
+
+namespace cryfs {
+    namespace fsblobstore {
+
+        // Caches the lookup (parent directory, child name) -> (child blob id, entry type), so that path resolution
+        // doesn't have to load every directory blob on the way. Keying by the parent's blob id instead of by the full
+        // path means that renaming or removing a directory doesn't invalidate anything below it.
+        // DirBlob invalidates an entry whenever it removes a child or replaces it with a different blob.
+        // The cache is bounded and sharded by parent blob id so that concurrent lookups don't contend on one mutex.
+        class DirEntryCache final {
+        public:
+            struct Entry final {
+                blockstore::BlockId blockId;
+                fspp::Dir::EntryType type;
+            };
+
+            DirEntryCache();
+
+            boost::optional<Entry> get(const blockstore::BlockId &parent, const std::string &name);
+            void put(const blockstore::BlockId &parent, const std::string &name, const blockstore::BlockId &blockId, fspp::Dir::EntryType type);
+            void invalidate(const blockstore::BlockId &parent, const std::string &name);
+            void clear();
+
+            static constexpr size_t NUM_SHARDS = 16;
+            static constexpr uint32_t MAX_ENTRIES_PER_SHARD = 4096;
+
+        private:
+            struct Shard final {
+                Shard(): mutex(), entries() {}
+                std::mutex mutex;
+                blockstore::caching::QueueMap<std::string, Entry> entries;
+            };
+
+            Shard &_shard(const blockstore::BlockId &parent);
+            static std::string _key(const blockstore::BlockId &parent, const std::string &name);
+
+            std::array<Shard, NUM_SHARDS> _shards;
+
+            DISALLOW_COPY_AND_ASSIGN(DirEntryCache);
+        };
+
+    }
+}
+
+#endif
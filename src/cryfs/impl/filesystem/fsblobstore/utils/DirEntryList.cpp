@@ -1,5 +1,5 @@
 #include "DirEntryList.h"
-#include <limits>
+#include <algorithm>
 #include <cpp-utils/system/time.h>
 
 //TODO Get rid of that in favor of better error handling
@@ -13,7 +13,7 @@ using blockstore::BlockId;
 namespace cryfs {
 namespace fsblobstore {
 
-DirEntryList::DirEntryList() : _entries() {
+DirEntryList::DirEntryList() : _entries(), _blockIdsByName() {
 }
 
 Data DirEntryList::serialize() const {
@@ -37,11 +37,16 @@ uint64_t DirEntryList::_serializedSize() const {
 
 void DirEntryList::deserializeFrom(const void *data, uint64_t size) {
     _entries.clear();
+    _blockIdsByName.clear();
     const char *pos = static_cast<const char*>(data);
     while (pos < static_cast<const char*>(data) + size) {
         pos = DirEntry::deserializeAndAddToVector(pos, &_entries);
         ASSERT(_entries.size() == 1 || std::less<BlockId>()(_entries[_entries.size()-2].blockId(), _entries[_entries.size()-1].blockId()), "Invariant hurt: Directory entries should be ordered by blockId and not have duplicate blockIds.");
     }
+    _blockIdsByName.reserve(_entries.size());
+    for (const auto &entry : _entries) {
+        _blockIdsByName.emplace(entry.name(), entry.blockId());
+    }
 }
 
 bool DirEntryList::_hasChild(const string &name) const {
@@ -53,24 +58,33 @@ void DirEntryList::add(const string &name, const BlockId &blobId, fspp::Dir::Ent
     if (_hasChild(name)) {
         throw fspp::fuse::FuseErrnoException(EEXIST);
     }
-    _add(name, blobId, entryType, mode, uid, gid, lastAccessTime, lastModificationTime);
+    _add(name, blobId, entryType, mode, uid, gid, lastAccessTime, lastModificationTime, boost::none);
 }
 
 void DirEntryList::_add(const string &name, const BlockId &blobId, fspp::Dir::EntryType entryType, fspp::mode_t mode,
-                       fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime) {
+                       fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime,
+                       boost::optional<fspp::num_bytes_t> size) {
     auto insert_pos = _findUpperBound(blobId);
-    _entries.emplace(insert_pos, entryType, name, blobId, mode, uid, gid, lastAccessTime, lastModificationTime, cpputils::time::now());
+    _entries.emplace(insert_pos, entryType, name, blobId, mode, uid, gid, lastAccessTime, lastModificationTime, cpputils::time::now(), size);
+    _blockIdsByName.emplace(name, blobId);
+}
+
+void DirEntryList::_removeFromNameIndex(const DirEntry &entry) {
+    auto found = _blockIdsByName.find(entry.name());
+    if (found != _blockIdsByName.end() && found->second == entry.blockId()) {
+        _blockIdsByName.erase(found);
+    }
 }
 
 void DirEntryList::addOrOverwrite(const string &name, const BlockId &blobId, fspp::Dir::EntryType entryType, fspp::mode_t mode,
                        fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime,
-                       std::function<void (const blockstore::BlockId &blockId)> onOverwritten) {
+                       boost::optional<fspp::num_bytes_t> size, std::function<void (const blockstore::BlockId &blockId)> onOverwritten) {
     auto found = _findByName(name);
     if (found != _entries.end()) {
         onOverwritten(found->blockId());
-        _overwrite(found, name, blobId, entryType, mode, uid, gid, lastAccessTime, lastModificationTime);
+        _overwrite(found, name, blobId, entryType, mode, uid, gid, lastAccessTime, lastModificationTime, size);
     } else {
-        _add(name, blobId, entryType, mode, uid, gid, lastAccessTime, lastModificationTime);
+        _add(name, blobId, entryType, mode, uid, gid, lastAccessTime, lastModificationTime, size);
     }
 }
 
@@ -79,10 +93,14 @@ void DirEntryList::rename(const blockstore::BlockId &blockId, const std::string
     if (foundSameName != _entries.end() && foundSameName->blockId() != blockId) {
         _checkAllowedOverwrite(foundSameName->type(), _findById(blockId)->type());
         onOverwritten(foundSameName->blockId());
+        _removeFromNameIndex(*foundSameName);
         _entries.erase(foundSameName);
     }
 
-    _findById(blockId)->setName(name);
+    auto found = _findById(blockId);
+    _removeFromNameIndex(*found);
+    found->setName(name);
+    _blockIdsByName.emplace(name, blockId);
 }
 
 void DirEntryList::_checkAllowedOverwrite(fspp::Dir::EntryType oldType, fspp::Dir::EntryType newType) {
@@ -99,12 +117,14 @@ void DirEntryList::_checkAllowedOverwrite(fspp::Dir::EntryType oldType, fspp::Di
 }
 
 void DirEntryList::_overwrite(vector<DirEntry>::iterator entry, const string &name, const BlockId &blobId, fspp::Dir::EntryType entryType, fspp::mode_t mode,
-                        fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime) {
+                        fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime,
+                        boost::optional<fspp::num_bytes_t> size) {
     _checkAllowedOverwrite(entry->type(), entryType);
     // The new entry has possibly a different blockId, so it has to be in a different list position (list is ordered by blockIds).
     // That's why we remove-and-add instead of just modifying the existing entry.
+    _removeFromNameIndex(*entry);
     _entries.erase(entry);
-    _add(name, blobId, entryType, mode, uid, gid, lastAccessTime, lastModificationTime);
+    _add(name, blobId, entryType, mode, uid, gid, lastAccessTime, lastModificationTime, size);
 }
 
 boost::optional<const DirEntry&> DirEntryList::get(const string &name) const {
@@ -116,8 +136,8 @@ boost::optional<const DirEntry&> DirEntryList::get(const string &name) const {
 }
 
 boost::optional<const DirEntry&> DirEntryList::get(const BlockId &blockId) const {
-    auto found = _findById(blockId);
-    if (found == _entries.end()) {
+    auto found = const_cast<DirEntryList*>(this)->_findLowerBound(blockId);
+    if (found == _entries.end() || found->blockId() != blockId) {
         return boost::none;
     }
     return *found;
@@ -128,6 +148,7 @@ void DirEntryList::remove(const string &name) {
     if (found == _entries.end()) {
         throw fspp::fuse::FuseErrnoException(ENOENT);
     }
+    _removeFromNameIndex(*found);
     _entries.erase(found);
 }
 
@@ -136,13 +157,20 @@ void DirEntryList::remove(const BlockId &blockId) {
     auto upperBound = std::find_if(lowerBound, _entries.end(), [&blockId] (const DirEntry &entry) {
         return entry.blockId() != blockId;
     });
+    for (auto iter = lowerBound; iter != upperBound; ++iter) {
+        _removeFromNameIndex(*iter);
+    }
     _entries.erase(lowerBound, upperBound);
 }
 
 vector<DirEntry>::iterator DirEntryList::_findByName(const string &name) {
-    return std::find_if(_entries.begin(), _entries.end(), [&name] (const DirEntry &entry) {
-        return entry.name() == name;
-    });
+    auto foundId = _blockIdsByName.find(name);
+    if (foundId == _blockIdsByName.end()) {
+        return _entries.end();
+    }
+    auto found = _findLowerBound(foundId->second);
+    ASSERT(found != _entries.end() && found->blockId() == foundId->second && found->name() == name, "Invariant hurt: Name index out of sync with directory entries.");
+    return found;
 }
 
 vector<DirEntry>::const_iterator DirEntryList::_findByName(const string &name) const {
@@ -158,34 +186,17 @@ vector<DirEntry>::iterator DirEntryList::_findById(const BlockId &blockId) {
 }
 
 vector<DirEntry>::iterator DirEntryList::_findLowerBound(const BlockId &blockId) {
-    return _findFirst(blockId, [&blockId] (const DirEntry &entry) {
-        return !std::less<BlockId>()(entry.blockId(), blockId);
+    return std::lower_bound(_entries.begin(), _entries.end(), blockId, [] (const DirEntry &entry, const BlockId &value) {
+        return std::less<BlockId>()(entry.blockId(), value);
     });
 }
 
 vector<DirEntry>::iterator DirEntryList::_findUpperBound(const BlockId &blockId) {
-    return _findFirst(blockId, [&blockId] (const DirEntry &entry) {
-        return std::less<BlockId>()(blockId, entry.blockId());
+    return std::upper_bound(_entries.begin(), _entries.end(), blockId, [] (const BlockId &value, const DirEntry &entry) {
+        return std::less<BlockId>()(value, entry.blockId());
     });
 }
 
-vector<DirEntry>::iterator DirEntryList::_findFirst(const BlockId &hint, std::function<bool (const DirEntry&)> pred) {
-    //TODO Factor out a datastructure that keeps a sorted std::vector and allows these _findLowerBound()/_findUpperBound operations using this hinted linear search
-    if (_entries.size() == 0) {
-        return _entries.end();
-    }
-    double startpos_percent = static_cast<double>(*static_cast<const unsigned char*>(hint.data().data())) / std::numeric_limits<unsigned char>::max();
-    auto iter = _entries.begin() + static_cast<int>(startpos_percent * static_cast<double>(_entries.size()-1));
-    ASSERT(iter >= _entries.begin() && iter < _entries.end(), "Startpos out of range");
-    while(iter != _entries.begin() && pred(*iter)) {
-        --iter;
-    }
-    while(iter != _entries.end() && !pred(*iter)) {
-        ++iter;
-    }
-    return iter;
-}
-
 vector<DirEntry>::const_iterator DirEntryList::_findById(const BlockId &blockId) const {
     return const_cast<DirEntryList*>(this)->_findById(blockId);
 }
@@ -222,6 +233,15 @@ bool DirEntryList::setUidGid(const BlockId &blockId, fspp::uid_t uid, fspp::gid_
     return changed;
 }
 
+bool DirEntryList::setSize(const blockstore::BlockId &blockId, boost::optional<fspp::num_bytes_t> size) {
+    auto found = _findById(blockId);
+    if (found->size() == size) {
+        return false;
+    }
+    found->setSize(size);
+    return true;
+}
+
 void DirEntryList::setAccessTimes(const blockstore::BlockId &blockId, timespec lastAccessTime, timespec lastModificationTime) {
     auto found = _findById(blockId);
     found->setLastAccessTime(lastAccessTime);
@@ -230,30 +250,43 @@ void DirEntryList::setAccessTimes(const blockstore::BlockId &blockId, timespec l
 
 bool DirEntryList::updateAccessTimestampForChild(const blockstore::BlockId &blockId, fspp::TimestampUpdateBehavior timestampUpdateBehavior) {
     auto found = _findById(blockId);
-
-    const timespec lastAccessTime = found->lastAccessTime();
-    const timespec lastModificationTime = found->lastModificationTime();
     const timespec now = cpputils::time::now();
+    if (_shouldUpdateAccessTimestamp(*found, timestampUpdateBehavior, now)) {
+        found->setLastAccessTime(now);
+        return true;
+    }
+    return false;
+}
 
-    switch (found->type()) {
+bool DirEntryList::_shouldUpdateAccessTimestamp(const DirEntry &entry, const fspp::TimestampUpdateBehavior &timestampUpdateBehavior, timespec accessTime) {
+    switch (entry.type()) {
         case fspp::Dir::EntryType::FILE:
             // fallthrough
         case fspp::Dir::EntryType::SYMLINK:
-            if (timestampUpdateBehavior->shouldUpdateATimeOnFileRead(lastAccessTime, lastModificationTime, now)) {
-                found->setLastAccessTime(now);
-                return true;
-            }
-            return false;
+            return timestampUpdateBehavior->shouldUpdateATimeOnFileRead(entry.lastAccessTime(), entry.lastModificationTime(), accessTime);
         case fspp::Dir::EntryType::DIR:
-            if (timestampUpdateBehavior->shouldUpdateATimeOnDirectoryRead(lastAccessTime, lastModificationTime, now)) {
-                found->setLastAccessTime(now);
-                return true;
-            }
-            return false;
+            return timestampUpdateBehavior->shouldUpdateATimeOnDirectoryRead(entry.lastAccessTime(), entry.lastModificationTime(), accessTime);
     }
     throw std::logic_error("Unhandled case");
 }
 
+bool DirEntryList::applyDelayedTimestampUpdatesForChild(const blockstore::BlockId &blockId, const boost::optional<timespec> &lastAccessTime, const fspp::TimestampUpdateBehavior &timestampUpdateBehavior, const boost::optional<timespec> &lastModificationTime) {
+    auto found = _findById(blockId);
+    // Operations that set the timestamps explicitly (e.g. utimens, which "cp -p" calls before closing the file) store the
+    // delayed updates of open files before, so the delayed updates here are never newer than explicitly set timestamps.
+    bool changed = false;
+    // The read is checked against the mtime from before the write, like it would have been when updating on each access
+    if (lastAccessTime != boost::none && _shouldUpdateAccessTimestamp(*found, timestampUpdateBehavior, *lastAccessTime)) {
+        found->setLastAccessTime(*lastAccessTime);
+        changed = true;
+    }
+    if (lastModificationTime != boost::none) {
+        found->setLastModificationTimeOfDelayedUpdate(*lastModificationTime);
+        changed = true;
+    }
+    return changed;
+}
+
 void DirEntryList::updateModificationTimestampForChild(const blockstore::BlockId &blockId) {
     auto found = _findById(blockId);
     found->setLastModificationTime(cpputils::time::now());
@@ -7,6 +7,7 @@
 #include "DirEntry.h"
 #include <vector>
 #include <string>
+#include <unordered_map>
 
 //TODO Address elements by name instead of by blockId when accessing them. Who knows whether there is two hard links for the same blob.
 
@@ -26,7 +27,7 @@ namespace cryfs {
                      fspp::mode_t mode, fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime);
             void addOrOverwrite(const std::string &name, const blockstore::BlockId &blobId, fspp::Dir::EntryType entryType,
                      fspp::mode_t mode, fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime,
-                     std::function<void (const blockstore::BlockId &blockId)> onOverwritten);
+                     boost::optional<fspp::num_bytes_t> size, std::function<void (const blockstore::BlockId &blockId)> onOverwritten);
             void rename(const blockstore::BlockId &blockId, const std::string &name, std::function<void (const blockstore::BlockId &blockId)> onOverwritten);
             boost::optional<const DirEntry&> get(const std::string &name) const;
             boost::optional<const DirEntry&> get(const blockstore::BlockId &blockId) const;
@@ -42,6 +43,10 @@ namespace cryfs {
             void setAccessTimes(const blockstore::BlockId &blockId, timespec lastAccessTime, timespec lastModificationTime);
             bool updateAccessTimestampForChild(const blockstore::BlockId &blockId, fspp::TimestampUpdateBehavior timestampUpdateBehavior);
             void updateModificationTimestampForChild(const blockstore::BlockId &blockId);
+            // Stores timestamp updates that were collected while the child was open. Returns true if a timestamp changed.
+            bool applyDelayedTimestampUpdatesForChild(const blockstore::BlockId &blockId, const boost::optional<timespec> &lastAccessTime, const fspp::TimestampUpdateBehavior &timestampUpdateBehavior, const boost::optional<timespec> &lastModificationTime);
+            // Returns true if the stored size changed
+            bool setSize(const blockstore::BlockId &blockId, boost::optional<fspp::num_bytes_t> size);
 
         private:
             uint64_t _serializedSize() const;
@@ -52,14 +57,20 @@ namespace cryfs {
             std::vector<DirEntry>::const_iterator _findById(const blockstore::BlockId &blockId) const;
             std::vector<DirEntry>::iterator _findUpperBound(const blockstore::BlockId &blockId);
             std::vector<DirEntry>::iterator _findLowerBound(const blockstore::BlockId &blockId);
-            std::vector<DirEntry>::iterator _findFirst(const blockstore::BlockId &hint, std::function<bool (const DirEntry&)> pred);
+            void _removeFromNameIndex(const DirEntry &entry);
             void _add(const std::string &name, const blockstore::BlockId &blobId, fspp::Dir::EntryType entryType,
-                     fspp::mode_t mode, fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime);
+                     fspp::mode_t mode, fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime,
+                     boost::optional<fspp::num_bytes_t> size);
             void _overwrite(std::vector<DirEntry>::iterator entry, const std::string &name, const blockstore::BlockId &blobId, fspp::Dir::EntryType entryType,
-                      fspp::mode_t mode, fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime);
+                      fspp::mode_t mode, fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime,
+                      boost::optional<fspp::num_bytes_t> size);
             static void _checkAllowedOverwrite(fspp::Dir::EntryType oldType, fspp::Dir::EntryType newType);
+            static bool _shouldUpdateAccessTimestamp(const DirEntry &entry, const fspp::TimestampUpdateBehavior &timestampUpdateBehavior, timespec accessTime);
 
             std::vector<DirEntry> _entries;
+            // Secondary index so that name lookups and duplicate checks don't have to scan _entries.
+            // Entries are found by looking up the blockId in _entries, which is ordered by blockId.
+            std::unordered_map<std::string, blockstore::BlockId> _blockIdsByName;
 
             DISALLOW_COPY_AND_ASSIGN(DirEntryList);
         };
@@ -41,8 +41,8 @@ public:
 
     void AddOrOverwriteChild(const std::string &name, const blockstore::BlockId &blobId, fspp::Dir::EntryType type,
                   fspp::mode_t mode, fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime,
-                  std::function<void (const blockstore::BlockId &blockId)> onOverwritten) {
-        return _base->AddOrOverwriteChild(name, blobId, type, mode, uid, gid, lastAccessTime, lastModificationTime, onOverwritten);
+                  boost::optional<fspp::num_bytes_t> size, std::function<void (const blockstore::BlockId &blockId)> onOverwritten) {
+        return _base->AddOrOverwriteChild(name, blobId, type, mode, uid, gid, lastAccessTime, lastModificationTime, size, onOverwritten);
     }
 
     void RenameChild(const blockstore::BlockId &blockId, const std::string &newName, std::function<void (const blockstore::BlockId &blockId)> onOverwritten) {
@@ -65,6 +65,10 @@ public:
         return _base->updateModificationTimestampForChild(blockId);
     }
 
+    void applyDelayedTimestampUpdatesForChild(const blockstore::BlockId &blockId, const boost::optional<timespec> &lastAccessTime, const fspp::TimestampUpdateBehavior &timestampUpdateBehavior, const boost::optional<timespec> &lastModificationTime) {
+        return _base->applyDelayedTimestampUpdatesForChild(blockId, lastAccessTime, timestampUpdateBehavior, lastModificationTime);
+    }
+
     void chmodChild(const blockstore::BlockId &blockId, fspp::mode_t mode) {
         return _base->chmodChild(blockId, mode);
     }
@@ -77,6 +81,10 @@ public:
         return _base->utimensChild(blockId, lastAccessTime, lastModificationTime);
     }
 
+    void setSizeOfChild(const blockstore::BlockId &blockId, boost::optional<fspp::num_bytes_t> size) {
+        return _base->setSizeOfChild(blockId, size);
+    }
+
     void AddChildDir(const std::string &name, const blockstore::BlockId &blobId, fspp::mode_t mode, fspp::uid_t uid, fspp::gid_t gid, timespec lastAccessTime, timespec lastModificationTime) {
         return _base->AddChildDir(name, blobId, mode, uid, gid, lastAccessTime, lastModificationTime);
     }
@@ -24,6 +24,10 @@ public:
         return _base->read(target, offset, count);
     }
 
+    void prefetch(fspp::num_bytes_t offset, fspp::num_bytes_t count) const {
+        return _base->prefetch(offset, count);
+    }
+
     void write(const void *source, fspp::num_bytes_t offset, fspp::num_bytes_t count) {
         return _base->write(source, offset, count);
     }
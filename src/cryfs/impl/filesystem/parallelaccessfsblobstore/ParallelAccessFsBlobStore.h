@@ -29,13 +29,14 @@ namespace cryfs {
             uint64_t virtualBlocksizeBytes() const;
             uint64_t numBlocks() const;
             uint64_t estimateSpaceForNumBlocksLeft() const;
+            fsblobstore::DirEntryCache *dirEntryCache();
 
         private:
 
             cpputils::unique_ref<cachingfsblobstore::CachingFsBlobStore> _baseBlobStore;
             parallelaccessstore::ParallelAccessStore<cachingfsblobstore::FsBlobRef, FsBlobRef, blockstore::BlockId> _parallelAccessStore;
 
-            std::function<fspp::num_bytes_t (const blockstore::BlockId &)> _getLstatSize();
+            std::function<fspp::num_bytes_t (const blockstore::BlockId &, const boost::optional<fspp::num_bytes_t> &)> _getLstatSize();
 
             DISALLOW_COPY_AND_ASSIGN(ParallelAccessFsBlobStore);
         };
@@ -50,8 +51,13 @@ namespace cryfs {
             return _parallelAccessStore.remove(blockId, std::move(blob));
         }
 
-        inline std::function<fspp::num_bytes_t (const blockstore::BlockId &blockId)> ParallelAccessFsBlobStore::_getLstatSize() {
-            return [this] (const blockstore::BlockId &blockId) {
+        inline std::function<fspp::num_bytes_t (const blockstore::BlockId &blockId, const boost::optional<fspp::num_bytes_t> &storedSize)> ParallelAccessFsBlobStore::_getLstatSize() {
+            return [this] (const blockstore::BlockId &blockId, const boost::optional<fspp::num_bytes_t> &storedSize) {
+                // The size stored in the dir entry is only updated when an open file is flushed or closed,
+                // so it can only be used if nobody has the child open.
+                if (storedSize != boost::none && !_parallelAccessStore.isOpened(blockId)) {
+                    return *storedSize;
+                }
                 auto blob = load(blockId);
                 ASSERT(blob != boost::none, "Blob not found");
                 return (*blob)->lstat_size();
@@ -69,6 +75,10 @@ namespace cryfs {
         inline uint64_t ParallelAccessFsBlobStore::estimateSpaceForNumBlocksLeft() const {
             return _baseBlobStore->estimateSpaceForNumBlocksLeft();
         }
+
+        inline fsblobstore::DirEntryCache *ParallelAccessFsBlobStore::dirEntryCache() {
+            return _baseBlobStore->dirEntryCache();
+        }
     }
 }
 
@@ -353,6 +353,24 @@ TYPED_TEST_P(FsppOpenFileTest_Timestamps, fdatasync) {
     });
 }
 
+TYPED_TEST_P(FsppOpenFileTest_Timestamps, givenWrite_whenChmodBeforeClosing_thenKeepsModificationTimestampOfWrite) {
+    this->testBuilder().withAnyAtimeConfig([&] {
+        auto openFile = this->CreateAndOpenFileWithSize("/myfile", fspp::num_bytes_t(10));
+        openFile->write("content", fspp::num_bytes_t(7), fspp::num_bytes_t(0));
+        this->ensureNodeTimestampsAreOld(this->stat(*openFile));
+        const timespec timeBeforeWrite = cpputils::time::now();
+        openFile->write("content", fspp::num_bytes_t(7), fspp::num_bytes_t(0));
+        const timespec timeAfterWrite = cpputils::time::now();
+        auto node = this->Load("/myfile");
+        node->chmod(this->stat(*node).mode);
+        cpputils::destruct(std::move(openFile));
+        const auto stat = this->stat(*this->Load("/myfile"));
+        EXPECT_LE(timeBeforeWrite, stat.mtime);
+        EXPECT_GE(timeAfterWrite, stat.mtime);
+        EXPECT_LT(timeAfterWrite, stat.ctime);
+    });
+}
+
 REGISTER_TYPED_TEST_SUITE_P(FsppOpenFileTest_Timestamps,
    stat,
    truncate_empty_to_empty,
@@ -370,7 +388,8 @@ REGISTER_TYPED_TEST_SUITE_P(FsppOpenFileTest_Timestamps,
    write_outofbounds,
    flush,
    fsync,
-   fdatasync
+   fdatasync,
+   givenWrite_whenChmodBeforeClosing_thenKeepsModificationTimestampOfWrite
 );
 
 #endif
@@ -0,0 +1,110 @@
+#include "AtimeOptions.h"
+#include <cpp-utils/assert/assert.h>
+#include <algorithm>
+#include <array>
+
+#include <range/v3/view/split.hpp>
+#include <range/v3/view/join.hpp>
+#include <range/v3/view/filter.hpp>
+
+using std::vector;
+using std::string;
+
+namespace fspp {
+namespace fuse {
+
+namespace {
+void extractAllAtimeOptionsAndRemoveOnesUnknownToLibfuse_(string* csv_options, vector<string>* result) {
+    const auto is_fuse_supported_atime_flag = [] (const std::string& flag) {
+        constexpr std::array<const char*, 2> flags = {"noatime", "atime"};
+        return flags.end() != std::find(flags.begin(), flags.end(), flag);
+    };
+    const auto is_fuse_unsupported_atime_flag = [] (const std::string& flag) {
+        constexpr std::array<const char*, 3> flags = {"strictatime", "relatime", "nodiratime"};
+        return flags.end() != std::find(flags.begin(), flags.end(), flag);
+    };
+    *csv_options = *csv_options
+        | ranges::view::split(',')
+        | ranges::view::filter(
+            [&] (const std::string& elem) {
+                if (is_fuse_unsupported_atime_flag(elem)) {
+                    result->push_back(elem);
+                    return false;
+                }
+                if (is_fuse_supported_atime_flag(elem)) {
+                    result->push_back(elem);
+                }
+                return true;
+            })
+        | ranges::view::join(',')
+        | ranges::to<string>();
+}
+}
+
+vector<string> extractAllAtimeOptionsAndRemoveOnesUnknownToLibfuse(vector<string>* fuseOptions) {
+    vector<string> result;
+    bool lastOptionWasDashO = false;
+    for (string& option : *fuseOptions) {
+        if (lastOptionWasDashO) {
+            extractAllAtimeOptionsAndRemoveOnesUnknownToLibfuse_(&option, &result);
+        }
+        lastOptionWasDashO = (option == "-o");
+    }
+    return result;
+}
+
+Context createContextFromAtimeOptions(const vector<string> &fuseOptions) {
+    const bool has_atime_flag = fuseOptions.end() != std::find(fuseOptions.begin(), fuseOptions.end(), "atime");
+    const bool has_noatime_flag = fuseOptions.end() != std::find(fuseOptions.begin(), fuseOptions.end(), "noatime");
+    const bool has_relatime_flag = fuseOptions.end() != std::find(fuseOptions.begin(), fuseOptions.end(), "relatime");
+    const bool has_strictatime_flag = fuseOptions.end() != std::find(fuseOptions.begin(), fuseOptions.end(), "strictatime");
+    const bool has_nodiratime_flag = fuseOptions.end() != std::find(fuseOptions.begin(), fuseOptions.end(), "nodiratime");
+
+    // Default is NOATIME, this reduces the probability for synchronization conflicts
+    Context context(noatime());
+
+    if (has_noatime_flag) {
+        ASSERT(!has_atime_flag, "Cannot have both, noatime and atime flags set.");
+        ASSERT(!has_relatime_flag, "Cannot have both, noatime and relatime flags set.");
+        ASSERT(!has_strictatime_flag, "Cannot have both, noatime and strictatime flags set.");
+        // note: can have nodiratime flag set but that is ignored because it is already included in the noatime policy.
+        context.setTimestampUpdateBehavior(noatime());
+    } else if (has_relatime_flag) {
+        // note: can have atime and relatime both set, they're identical
+        ASSERT(!has_noatime_flag, "This shouldn't happen, or we would have hit a case above.");
+        ASSERT(!has_strictatime_flag, "Cannot have both, relatime and strictatime flags set.");
+        if (has_nodiratime_flag) {
+            context.setTimestampUpdateBehavior(nodiratime_relatime());
+        } else {
+            context.setTimestampUpdateBehavior(relatime());
+        }
+    } else if (has_atime_flag) {
+        // note: can have atime and relatime both set, they're identical
+        ASSERT(!has_noatime_flag, "This shouldn't happen, or we would have hit a case above");
+        ASSERT(!has_strictatime_flag, "Cannot have both, atime and strictatime flags set.");
+        if (has_nodiratime_flag) {
+            context.setTimestampUpdateBehavior(nodiratime_relatime());
+        } else {
+            context.setTimestampUpdateBehavior(relatime());
+        }
+    } else if (has_strictatime_flag) {
+        ASSERT(!has_noatime_flag, "This shouldn't happen, or we would have hit a case above");
+        ASSERT(!has_atime_flag, "This shouldn't happen, or we would have hit a case above");
+        ASSERT(!has_relatime_flag, "This shouldn't happen, or we would have hit a case above");
+        if (has_nodiratime_flag) {
+            context.setTimestampUpdateBehavior(nodiratime_strictatime());
+        } else {
+            context.setTimestampUpdateBehavior(strictatime());
+        }
+    } else if (has_nodiratime_flag) {
+        ASSERT(!has_noatime_flag, "This shouldn't happen, or we would have hit a case above");
+        ASSERT(!has_atime_flag, "This shouldn't happen, or we would have hit a case above");
+        ASSERT(!has_relatime_flag, "This shouldn't happen, or we would have hit a case above");
+        ASSERT(!has_strictatime_flag, "This shouldn't happen, or we would have hit a case above");
+        context.setTimestampUpdateBehavior(noatime()); // use noatime by default
+    }
+    return context;
+}
+
+}
+}
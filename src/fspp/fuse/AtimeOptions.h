@@ -0,0 +1,26 @@
+#pragma once
+#ifndef MESSMER_FSPP_FUSE_ATIMEOPTIONS_H_
+#define MESSMER_FSPP_FUSE_ATIMEOPTIONS_H_
+
+#include <string>
+#include <vector>
+#include <fspp/fs_interface/Context.h>
+
+namespace fspp {
+namespace fuse {
+
+// Return a list of all atime options (e.g. atime, noatime, relatime, strictatime, nodiratime) that occur in the
+// fuseOptions input. They must be preceded by a '-o', i.e. {..., '-o', 'noatime', ...} and multiple ones can be
+// csv-concatenated, i.e. {..., '-o', 'atime,nodiratime', ...}.
+// Also, this function removes all of these atime options that are unknown to libfuse (i.e. all except atime and noatime)
+// from the input fuseOptions so we can pass it on to libfuse without crashing.
+std::vector<std::string> extractAllAtimeOptionsAndRemoveOnesUnknownToLibfuse(std::vector<std::string>* fuseOptions);
+
+// Create the file system context with the timestamp update behavior selected by the given atime options.
+// If there are no atime options, the default is noatime.
+Context createContextFromAtimeOptions(const std::vector<std::string> &atimeOptions);
+
+}
+}
+
+#endif
@@ -16,13 +16,10 @@
 #include <cpp-utils/thread/debugging.h>
 #include <csignal>
 #include "InvalidFilesystem.h"
+#include "AtimeOptions.h"
 #include <codecvt>
 #include <boost/algorithm/string/replace.hpp>
 
-#include <range/v3/view/split.hpp>
-#include <range/v3/view/join.hpp>
-#include <range/v3/view/filter.hpp>
-
 #if defined(_MSC_VER)
 #include <dokan/dokan.h>
 #endif
@@ -261,7 +258,7 @@ Fuse::~Fuse() {
 }
 
 Fuse::Fuse(std::function<shared_ptr<Filesystem> (Fuse *fuse)> init, std::function<void()> onMounted, std::string fstype, boost::optional<std::string> fsname)
-  :_init(std::move(init)), _onMounted(std::move(onMounted)), _fs(make_shared<InvalidFilesystem>()), _mountdir(), _running(false), _fstype(std::move(fstype)), _fsname(std::move(fsname)) {
+  :_init(std::move(init)), _onMounted(std::move(onMounted)), _fs(make_shared<InvalidFilesystem>()), _mountdir(), _running(false), _fstype(std::move(fstype)), _fsname(std::move(fsname)), _context(boost::none), _kernelCacheTimeouts(KernelCacheTimeouts::Default()) {
   ASSERT(static_cast<bool>(_init), "Invalid init given");
   ASSERT(static_cast<bool>(_onMounted), "Invalid onMounted given");
 }
@@ -300,51 +297,6 @@ void Fuse::_removeAndWarnIfExists(vector<string> *fuseOptions, const std::string
   }
 }
 
-namespace {
-void extractAllAtimeOptionsAndRemoveOnesUnknownToLibfuse_(string* csv_options, vector<string>* result) {
-    const auto is_fuse_supported_atime_flag = [] (const std::string& flag) {
-        constexpr std::array<const char*, 2> flags = {"noatime", "atime"};
-        return flags.end() != std::find(flags.begin(), flags.end(), flag);
-    };
-    const auto is_fuse_unsupported_atime_flag = [] (const std::string& flag) {
-        constexpr std::array<const char*, 3> flags = {"strictatime", "relatime", "nodiratime"};
-        return flags.end() != std::find(flags.begin(), flags.end(), flag);
-    };
-    *csv_options = *csv_options
-        | ranges::view::split(',')
-        | ranges::view::filter(
-            [&] (const std::string& elem) {
-                if (is_fuse_unsupported_atime_flag(elem)) {
-                    result->push_back(elem);
-                    return false;
-                }
-                if (is_fuse_supported_atime_flag(elem)) {
-                    result->push_back(elem);
-                }
-                return true;
-            })
-        | ranges::view::join(',')
-        | ranges::to<string>();
-}
-
-// Return a list of all atime options (e.g. atime, noatime, relatime, strictatime, nodiratime) that occur in the
-// fuseOptions input. They must be preceded by a '-o', i.e. {..., '-o', 'noatime', ...} and multiple ones can be
-// csv-concatenated, i.e. {..., '-o', 'atime,nodiratime', ...}.
-// Also, this function removes all of these atime options that are unknown to libfuse (i.e. all except atime and noatime)
-// from the input fuseOptions so we can pass it on to libfuse without crashing.
-vector<string> extractAllAtimeOptionsAndRemoveOnesUnknownToLibfuse_(vector<string>* fuseOptions) {
-    vector<string> result;
-    bool lastOptionWasDashO = false;
-    for (string& option : *fuseOptions) {
-        if (lastOptionWasDashO) {
-            extractAllAtimeOptionsAndRemoveOnesUnknownToLibfuse_(&option, &result);
-        }
-        lastOptionWasDashO = (option == "-o");
-    }
-    return result;
-}
-}
-
 void Fuse::_run(const bf::path &mountdir, vector<string> fuseOptions) {
 #if defined(__GLIBC__)|| defined(__APPLE__) || defined(_MSC_VER)
   // Avoid encoding errors for non-utf8 characters, see https://github.com/cryfs/cryfs/issues/247
@@ -356,69 +308,17 @@ void Fuse::_run(const bf::path &mountdir, vector<string> fuseOptions) {
 
   ASSERT(_argv.size() == 0, "Filesystem already started");
 
-  vector<string> atimeOptions = extractAllAtimeOptionsAndRemoveOnesUnknownToLibfuse_(&fuseOptions);
-  _createContext(atimeOptions);
+  vector<string> atimeOptions = extractAllAtimeOptionsAndRemoveOnesUnknownToLibfuse(&fuseOptions);
+  _context = createContextFromAtimeOptions(atimeOptions);
 
   _argv = _build_argv(mountdir, fuseOptions);
 
   fuse_main(_argv.size(), _argv.data(), operations(), this);
 }
 
-void Fuse::_createContext(const vector<string> &fuseOptions) {
-    const bool has_atime_flag = fuseOptions.end() != std::find(fuseOptions.begin(), fuseOptions.end(), "atime");
-    const bool has_noatime_flag = fuseOptions.end() != std::find(fuseOptions.begin(), fuseOptions.end(), "noatime");
-    const bool has_relatime_flag = fuseOptions.end() != std::find(fuseOptions.begin(), fuseOptions.end(), "relatime");
-    const bool has_strictatime_flag = fuseOptions.end() != std::find(fuseOptions.begin(), fuseOptions.end(), "strictatime");
-    const bool has_nodiratime_flag = fuseOptions.end() != std::find(fuseOptions.begin(), fuseOptions.end(), "nodiratime");
-
-    // Default is NOATIME, this reduces the probability for synchronization conflicts
-    _context = Context(noatime());
-
-    if (has_noatime_flag) {
-        ASSERT(!has_atime_flag, "Cannot have both, noatime and atime flags set.");
-        ASSERT(!has_relatime_flag, "Cannot have both, noatime and relatime flags set.");
-        ASSERT(!has_strictatime_flag, "Cannot have both, noatime and strictatime flags set.");
-        // note: can have nodiratime flag set but that is ignored because it is already included in the noatime policy.
-        _context->setTimestampUpdateBehavior(noatime());
-    } else if (has_relatime_flag) {
-        // note: can have atime and relatime both set, they're identical
-        ASSERT(!has_noatime_flag, "This shouldn't happen, or we would have hit a case above.");
-        ASSERT(!has_strictatime_flag, "Cannot have both, relatime and strictatime flags set.");
-        if (has_nodiratime_flag) {
-            _context->setTimestampUpdateBehavior(nodiratime_relatime());
-        } else {
-            _context->setTimestampUpdateBehavior(relatime());
-        }
-    } else if (has_atime_flag) {
-        // note: can have atime and relatime both set, they're identical
-        ASSERT(!has_noatime_flag, "This shouldn't happen, or we would have hit a case above");
-        ASSERT(!has_strictatime_flag, "Cannot have both, atime and strictatime flags set.");
-        if (has_nodiratime_flag) {
-            _context->setTimestampUpdateBehavior(nodiratime_relatime());
-        } else {
-            _context->setTimestampUpdateBehavior(relatime());
-        }
-    } else if (has_strictatime_flag) {
-        ASSERT(!has_noatime_flag, "This shouldn't happen, or we would have hit a case above");
-        ASSERT(!has_atime_flag, "This shouldn't happen, or we would have hit a case above");
-        ASSERT(!has_relatime_flag, "This shouldn't happen, or we would have hit a case above");
-        if (has_nodiratime_flag) {
-            _context->setTimestampUpdateBehavior(nodiratime_strictatime());
-        } else {
-            _context->setTimestampUpdateBehavior(strictatime());
-        }
-    } else if (has_nodiratime_flag) {
-        ASSERT(!has_noatime_flag, "This shouldn't happen, or we would have hit a case above");
-        ASSERT(!has_atime_flag, "This shouldn't happen, or we would have hit a case above");
-        ASSERT(!has_relatime_flag, "This shouldn't happen, or we would have hit a case above");
-        ASSERT(!has_strictatime_flag, "This shouldn't happen, or we would have hit a case above");
-        _context->setTimestampUpdateBehavior(noatime()); // use noatime by default
-    }
-}
-
 vector<char *> Fuse::_build_argv(const bf::path &mountdir, const vector<string> &fuseOptions) {
   vector<char *> argv;
-  argv.reserve(6 + fuseOptions.size()); // fuseOptions + executable name + mountdir + 2x fuse options (subtype, fsname), each taking 2 entries ("-o", "key=value").
+  argv.reserve(12 + fuseOptions.size()); // fuseOptions + executable name + mountdir + 5x fuse options (subtype, fsname, attr_timeout, entry_timeout, negative_timeout), each taking 2 entries ("-o", "key=value").
   argv.push_back(_create_c_string(_fstype)); // The first argument (executable name) is the file system type
   argv.push_back(_create_c_string(mountdir.string())); // The second argument is the mountdir
   for (const string &option : fuseOptions) {
@@ -431,6 +331,11 @@ vector<char *> Fuse::_build_argv(const bf::path &mountdir, const vector<string>
 #ifdef __APPLE__
   // Make volume name default to mountdir on macOS
   _add_fuse_option_if_not_exists(&argv, "volname", mountdir.filename().string());
+#endif
+#if !defined(_MSC_VER)
+  _add_fuse_option_if_not_exists(&argv, "attr_timeout", std::to_string(_kernelCacheTimeouts.attrTimeoutSeconds));
+  _add_fuse_option_if_not_exists(&argv, "entry_timeout", std::to_string(_kernelCacheTimeouts.entryTimeoutSeconds));
+  _add_fuse_option_if_not_exists(&argv, "negative_timeout", std::to_string(_kernelCacheTimeouts.negativeTimeoutSeconds));
 #endif
   // TODO Also set read/write size for osxfuse. The options there are called differently.
   // large_read not necessary because reads are large anyhow. This option is only important for 2.4.
@@ -475,6 +380,11 @@ void Fuse::stop() {
   unmount(_mountdir, false);
 }
 
+void Fuse::setKernelCacheTimeouts(KernelCacheTimeouts timeouts) {
+  ASSERT(_argv.size() == 0, "Filesystem already started");
+  _kernelCacheTimeouts = timeouts;
+}
+
 void Fuse::unmount(const bf::path& mountdir, bool force) {
   //TODO Find better way to unmount (i.e. don't use external fusermount). Unmounting by kill(getpid(), SIGINT) worked, but left the mount directory transport endpoint as not connected.
 #if defined(__APPLE__)
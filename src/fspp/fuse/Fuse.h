@@ -12,6 +12,7 @@
 #include <cpp-utils/macros.h>
 #include <atomic>
 #include "stat_compatibility.h"
+#include "KernelCacheTimeouts.h"
 #include <fspp/fs_interface/Context.h>
 
 namespace fspp {
@@ -30,6 +31,10 @@ public:
   bool running() const;
   void stop();
 
+  // Has to be called before the file system is run. libfuse 2 can't invalidate kernel caches by path, so only use
+  // long timeouts if nothing else changes the file system.
+  void setKernelCacheTimeouts(KernelCacheTimeouts timeouts);
+
   static void unmount(const boost::filesystem::path &mountdir, bool force = false);
 
   int getattr(const boost::filesystem::path &path, fspp::fuse::STAT *stbuf);
@@ -73,7 +78,6 @@ private:
   static bool _has_entry_with_prefix(const std::string &prefix, const std::vector<char *> &vec);
   std::vector<char *> _build_argv(const boost::filesystem::path &mountdir, const std::vector<std::string> &fuseOptions);
   void _add_fuse_option_if_not_exists(std::vector<char *> *argv, const std::string &key, const std::string &value);
-  void _createContext(const std::vector<std::string> &fuseOptions);
 
   std::function<std::shared_ptr<Filesystem> (Fuse *fuse)> _init;
   std::function<void()> _onMounted;
@@ -84,6 +88,7 @@ private:
   std::string _fstype;
   boost::optional<std::string> _fsname;
   boost::optional<Context> _context;
+  KernelCacheTimeouts _kernelCacheTimeouts;
 
   DISALLOW_COPY_AND_ASSIGN(Fuse);
 };
@@ -0,0 +1,132 @@
+#include "InodeTable.h"
+#include "../fs_interface/FuseErrnoException.h"
+#include <cpp-utils/assert/assert.h>
+
+namespace bf = boost::filesystem;
+using std::string;
+using boost::none;
+
+namespace fspp {
+namespace fuse {
+
+constexpr uint64_t InodeTable::ROOT_INODE;
+
+InodeTable::InodeTable()
+: _mutex(), _inodes(), _inodeByLocation(), _freeInodes(), _nextInode(ROOT_INODE + 1) {
+  _inodes.emplace(ROOT_INODE, Entry{0, 1, none});
+}
+
+InodeTable::Inode InodeTable::lookup(uint64_t parent, const string &name) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  Location location(parent, name);
+  auto found = _inodeByLocation.find(location);
+  if (found != _inodeByLocation.end()) {
+    Entry &entry = _inodes.at(found->second);
+    ++entry.lookupCount;
+    return Inode{found->second, entry.generation};
+  }
+
+  uint64_t number = 0;
+  uint64_t generation = 0;
+  if (_freeInodes.empty()) {
+    number = _nextInode++;
+  } else {
+    number = _freeInodes.back().first;
+    generation = _freeInodes.back().second;
+    _freeInodes.pop_back();
+  }
+  _inodes.emplace(number, Entry{generation, 1, location});
+  _inodeByLocation.emplace(std::move(location), number);
+  return Inode{number, generation};
+}
+
+void InodeTable::forget(uint64_t inode, uint64_t nlookup) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (inode == ROOT_INODE) {
+    // The root inode is never freed
+    return;
+  }
+  auto found = _inodes.find(inode);
+  if (found == _inodes.end()) {
+    return;
+  }
+  ASSERT(found->second.lookupCount >= nlookup, "Kernel forgot more lookups than it did");
+  found->second.lookupCount -= nlookup;
+  if (found->second.lookupCount == 0) {
+    if (found->second.location != none) {
+      _inodeByLocation.erase(*found->second.location);
+    }
+    _freeInodes.emplace_back(inode, found->second.generation + 1);
+    _inodes.erase(found);
+  }
+}
+
+bf::path InodeTable::path(uint64_t inode) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _path(inode);
+}
+
+bf::path InodeTable::childPath(uint64_t parent, const string &name) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _path(parent) / name;
+}
+
+bf::path InodeTable::_path(uint64_t inode) const {
+  std::vector<const string*> names;
+  while (inode != ROOT_INODE) {
+    auto found = _inodes.find(inode);
+    if (found == _inodes.end()) {
+      throw FuseErrnoException(ESTALE);
+    }
+    if (found->second.location == none) {
+      throw FuseErrnoException(ENOENT);
+    }
+    names.push_back(&found->second.location->second);
+    inode = found->second.location->first;
+  }
+  bf::path result = "/";
+  for (auto name = names.rbegin(); name != names.rend(); ++name) {
+    result /= **name;
+  }
+  return result;
+}
+
+void InodeTable::rename(uint64_t oldParent, const string &oldName, uint64_t newParent, const string &newName) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  Location oldLocation(oldParent, oldName);
+  Location newLocation(newParent, newName);
+  if (oldLocation == newLocation) {
+    return;
+  }
+  auto found = _inodeByLocation.find(oldLocation);
+  _detach(newLocation);
+  if (found == _inodeByLocation.end()) {
+    // The kernel never looked up the renamed node, nothing to update
+    return;
+  }
+  uint64_t inode = found->second;
+  _inodeByLocation.erase(found);
+  _inodes.at(inode).location = newLocation;
+  _inodeByLocation.emplace(std::move(newLocation), inode);
+}
+
+void InodeTable::remove(uint64_t parent, const string &name) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _detach(Location(parent, name));
+}
+
+void InodeTable::_detach(const Location &location) {
+  auto found = _inodeByLocation.find(location);
+  if (found != _inodeByLocation.end()) {
+    _inodes.at(found->second).location = none;
+    _inodeByLocation.erase(found);
+  }
+}
+
+size_t InodeTable::size() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _inodes.size();
+}
+
+}
+}
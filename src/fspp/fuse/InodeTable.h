@@ -0,0 +1,80 @@
+#pragma once
+#ifndef MESSMER_FSPP_FUSE_INODETABLE_H_
+#define MESSMER_FSPP_FUSE_INODETABLE_H_
+
+#include <cpp-utils/macros.h>
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace fspp {
+namespace fuse {
+
+/**
+ * Maps the inode numbers handed out to the kernel by the lowlevel fuse frontend to the nodes they stand for.
+ * Each inode remembers its parent inode and its name, so renaming a directory doesn't have to touch its children.
+ * An inode lives as long as the kernel has lookups for it. After that, its number can be handed out again,
+ * but with a new generation number, so the kernel can tell the two apart.
+ * Thread safe.
+ */
+class InodeTable final {
+public:
+  static constexpr uint64_t ROOT_INODE = 1;
+
+  struct Inode final {
+    uint64_t number;
+    uint64_t generation;
+  };
+
+  InodeTable();
+
+  // Returns the inode of the given child and increases its lookup count.
+  // If the child doesn't have an inode yet, it gets a new one.
+  Inode lookup(uint64_t parent, const std::string &name);
+  // Decreases the lookup count and frees the inode when it reaches zero
+  void forget(uint64_t inode, uint64_t nlookup);
+
+  // Throws FuseErrnoException(ENOENT) if the node was removed and ESTALE if the inode isn't known.
+  boost::filesystem::path path(uint64_t inode) const;
+  boost::filesystem::path childPath(uint64_t parent, const std::string &name) const;
+
+  // Has to be called after the node was renamed. If there was a node at the target location, it is detached.
+  void rename(uint64_t oldParent, const std::string &oldName, uint64_t newParent, const std::string &newName);
+  // Has to be called after the node was removed. Its inode stays valid until the kernel forgets it, but doesn't have a path anymore.
+  void remove(uint64_t parent, const std::string &name);
+
+  // Number of inodes currently in use, including the root inode
+  size_t size() const;
+
+private:
+  using Location = std::pair<uint64_t, std::string>; // parent inode and name
+
+  struct Entry final {
+    uint64_t generation;
+    uint64_t lookupCount;
+    // none for the root inode and for removed nodes
+    boost::optional<Location> location;
+  };
+
+  boost::filesystem::path _path(uint64_t inode) const;
+  void _detach(const Location &location);
+
+  mutable std::mutex _mutex;
+  std::unordered_map<uint64_t, Entry> _inodes;
+  std::map<Location, uint64_t> _inodeByLocation;
+  // Freed inode numbers with the generation to use when handing them out again
+  std::vector<std::pair<uint64_t, uint64_t>> _freeInodes;
+  uint64_t _nextInode;
+
+  DISALLOW_COPY_AND_ASSIGN(InodeTable);
+};
+
+}
+}
+
+#endif
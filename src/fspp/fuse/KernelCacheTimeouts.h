@@ -0,0 +1,31 @@
+#pragma once
+#ifndef MESSMER_FSPP_FUSE_KERNELCACHETIMEOUTS_H_
+#define MESSMER_FSPP_FUSE_KERNELCACHETIMEOUTS_H_
+
+namespace fspp {
+namespace fuse {
+
+// How long the kernel may answer stat() and path lookups from its cache before asking the file system again.
+// Fuse options given by the user (e.g. "-o attr_timeout=5") take precedence.
+struct KernelCacheTimeouts final {
+  double attrTimeoutSeconds;
+  double entryTimeoutSeconds;
+  // How long the kernel remembers that a name doesn't exist
+  double negativeTimeoutSeconds;
+
+  // The libfuse defaults. Changes that don't go through the mount are seen after a second.
+  static KernelCacheTimeouts Default() {
+    return KernelCacheTimeouts{1.0, 1.0, 0.0};
+  }
+
+  // For file systems that are only changed through the mount. The kernel keeps its cache up to date for those changes
+  // itself, so it can keep the cache much longer and stat-heavy workloads don't have to ask the file system each time.
+  static KernelCacheTimeouts Long() {
+    return KernelCacheTimeouts{60.0, 60.0, 60.0};
+  }
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,765 @@
+#include "LowlevelFuse.h"
+#include "Filesystem.h"
+#include "InvalidFilesystem.h"
+#include "AtimeOptions.h"
+#include "../fs_interface/FuseErrnoException.h"
+#include <cpp-utils/assert/assert.h>
+#include <cpp-utils/data/Data.h>
+#include <cpp-utils/logging/logging.h>
+#include <cpp-utils/process/subprocess.h>
+#include <cpp-utils/system/time.h>
+#include <cpp-utils/thread/debugging.h>
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/join.hpp>
+#include <algorithm>
+#include <array>
+#include <codecvt>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+
+#define FUSE_USE_VERSION 35
+#include <fuse3/fuse_lowlevel.h>
+
+using std::vector;
+using std::string;
+using std::shared_ptr;
+using std::make_shared;
+using cpputils::Data;
+using cpputils::set_thread_name;
+using namespace cpputils::logging;
+namespace bf = boost::filesystem;
+
+// Remove the following line, if you don't want to output each fuse operation on the console
+//#define FSPP_LOG 1
+
+namespace fspp {
+namespace fuse {
+
+constexpr uint32_t LowlevelFuse::MAX_WRITE_BYTES;
+
+namespace {
+// d_ino for readdir entries the kernel didn't look up yet. The kernel looks them up before using them.
+constexpr fuse_ino_t UNKNOWN_INO = 0xffffffff;
+
+class ThreadNameForDebugging final {
+public:
+  ThreadNameForDebugging(const string& threadName) {
+    std::string name = "fspp_" + threadName;
+    set_thread_name(name.c_str());
+  }
+
+  ~ThreadNameForDebugging() {
+    set_thread_name("fspp_idle");
+  }
+};
+
+// Runs the operation and, if it throws, replies to the request with the corresponding error.
+// The operation has to reply itself when it succeeds, and replying has to be the last thing it does.
+template<class Operation>
+void handleErrors(fuse_req_t req, const char *name, Operation &&operation) {
+  ThreadNameForDebugging _threadName(name);
+#ifdef FSPP_LOG
+  LOG(DEBUG, "{}", name);
+#endif
+  try {
+    std::forward<Operation>(operation)();
+  } catch(const cpputils::AssertFailed &e) {
+    LOG(ERR, "AssertFailed in LowlevelFuse::{}: {}", name, e.what());
+    fuse_reply_err(req, EIO);
+  } catch(const FuseErrnoException &e) {
+#ifdef FSPP_LOG
+    LOG(WARN, "{}: failed with errno {}", name, e.getErrno());
+#endif
+    fuse_reply_err(req, e.getErrno());
+  } catch(const std::exception &e) {
+    LOG(ERR, "Exception thrown in LowlevelFuse::{}: {}", name, e.what());
+    fuse_reply_err(req, EIO);
+  } catch(...) {
+    LOG(ERR, "Unknown exception thrown in LowlevelFuse::{}", name);
+    fuse_reply_err(req, EIO);
+  }
+}
+
+bool isDotOrDotDot(const string &name) {
+  return name == "." || name == "..";
+}
+
+::mode_t modeForEntryType(Dir::EntryType type) {
+  switch (type) {
+    case Dir::EntryType::DIR:
+      return S_IFDIR;
+    case Dir::EntryType::FILE:
+      return S_IFREG;
+    case Dir::EntryType::SYMLINK:
+      return S_IFLNK;
+  }
+  ASSERT(false, "Unknown entry type");
+}
+}
+
+class LowlevelFuseOperations final {
+public:
+  static void init(void *userdata, fuse_conn_info *conn) {
+    ThreadNameForDebugging _threadName("init");
+    auto fuse = static_cast<LowlevelFuse*>(userdata);
+
+    if (fuse->_allowWritebackCache && (conn->capable & FUSE_CAP_WRITEBACK_CACHE)) {
+      // Lets the kernel combine small writes into large ones before sending them to us
+      conn->want |= FUSE_CAP_WRITEBACK_CACHE;
+      fuse->_writebackCache = true;
+    }
+    // Move write data from the fuse device into our buffers without an extra copy in libfuse
+    conn->want |= (conn->capable & (FUSE_CAP_SPLICE_READ | FUSE_CAP_SPLICE_WRITE | FUSE_CAP_SPLICE_MOVE));
+    conn->max_write = LowlevelFuse::MAX_WRITE_BYTES;
+
+    fuse->_fs = fuse->_init(fuse);
+    ASSERT(fuse->_context != boost::none, "Context should have been initialized in LowlevelFuse::run() but somehow didn't");
+    fuse->_fs->setContext(Context { *fuse->_context });
+
+    LOG(INFO, "Filesystem started.");
+
+    fuse->_running = true;
+    fuse->_onMounted();
+
+#ifdef FSPP_LOG
+    cpputils::logging::setLevel(DEBUG);
+#endif
+  }
+
+  static void destroy(void *userdata) {
+    ThreadNameForDebugging _threadName("destroy");
+    auto fuse = static_cast<LowlevelFuse*>(userdata);
+    fuse->_fs = make_shared<InvalidFilesystem>();
+    LOG(INFO, "Filesystem stopped.");
+    fuse->_running = false;
+    cpputils::logging::logger()->flush();
+  }
+
+  static void lookup(fuse_req_t req, fuse_ino_t parent, const char *name) {
+    handleErrors(req, "lookup", [&] {
+      auto fuse = _fuse(req);
+      fuse_entry_param entry{};
+      try {
+        entry = _lookupEntry(fuse, parent, name);
+      } catch (const FuseErrnoException &e) {
+        if (e.getErrno() != ENOENT || fuse->_kernelCacheTimeouts.negativeTimeoutSeconds <= 0) {
+          throw;
+        }
+        // An entry with inode 0 lets the kernel cache that the name doesn't exist
+        fuse_entry_param negativeEntry{};
+        negativeEntry.entry_timeout = fuse->_kernelCacheTimeouts.negativeTimeoutSeconds;
+        fuse_reply_entry(req, &negativeEntry);
+        return;
+      }
+      _replyEntry(req, entry);
+    });
+  }
+
+  static void forget(fuse_req_t req, fuse_ino_t ino, uint64_t nlookup) {
+    _forget(_fuse(req), ino, nlookup);
+    fuse_reply_none(req);
+  }
+
+  static void forget_multi(fuse_req_t req, size_t count, fuse_forget_data *forgets) {
+    for (size_t i = 0; i < count; ++i) {
+      _forget(_fuse(req), forgets[i].ino, forgets[i].nlookup);
+    }
+    fuse_reply_none(req);
+  }
+
+  static void getattr(fuse_req_t req, fuse_ino_t ino, fuse_file_info *fileinfo) {
+    handleErrors(req, "getattr", [&] {
+      auto fuse = _fuse(req);
+      STAT stbuf{};
+      if (fileinfo != nullptr) {
+        fuse->_fs->fstat(fileinfo->fh, &stbuf);
+      } else {
+        fuse->_fs->lstat(fuse->_inodes.path(ino), &stbuf);
+      }
+      stbuf.st_ino = ino;
+      fuse_reply_attr(req, &stbuf, fuse->_kernelCacheTimeouts.attrTimeoutSeconds);
+    });
+  }
+
+  static void setattr(fuse_req_t req, fuse_ino_t ino, struct stat *attr, int to_set, fuse_file_info *fileinfo) {
+    handleErrors(req, "setattr", [&] {
+      auto fuse = _fuse(req);
+      const bf::path path = fuse->_inodes.path(ino);
+      if (to_set & FUSE_SET_ATTR_MODE) {
+        fuse->_fs->chmod(path, attr->st_mode);
+      }
+      if (to_set & (FUSE_SET_ATTR_UID | FUSE_SET_ATTR_GID)) {
+        // -1 keeps the current value, like chown(2)
+        const ::uid_t uid = (to_set & FUSE_SET_ATTR_UID) ? attr->st_uid : static_cast<::uid_t>(-1);
+        const ::gid_t gid = (to_set & FUSE_SET_ATTR_GID) ? attr->st_gid : static_cast<::gid_t>(-1);
+        fuse->_fs->chown(path, uid, gid);
+      }
+      if (to_set & FUSE_SET_ATTR_SIZE) {
+        if (fileinfo != nullptr) {
+          fuse->_fs->ftruncate(fileinfo->fh, fspp::num_bytes_t(attr->st_size));
+        } else {
+          fuse->_fs->truncate(path, fspp::num_bytes_t(attr->st_size));
+        }
+      }
+      if (to_set & (FUSE_SET_ATTR_ATIME | FUSE_SET_ATTR_MTIME | FUSE_SET_ATTR_ATIME_NOW | FUSE_SET_ATTR_MTIME_NOW)) {
+        STAT current{};
+        fuse->_fs->lstat(path, &current);
+        const timespec now = cpputils::time::now();
+        timespec lastAccessTime = current.st_atim;
+        timespec lastModificationTime = current.st_mtim;
+        if (to_set & FUSE_SET_ATTR_ATIME_NOW) {
+          lastAccessTime = now;
+        } else if (to_set & FUSE_SET_ATTR_ATIME) {
+          lastAccessTime = attr->st_atim;
+        }
+        if (to_set & FUSE_SET_ATTR_MTIME_NOW) {
+          lastModificationTime = now;
+        } else if (to_set & FUSE_SET_ATTR_MTIME) {
+          lastModificationTime = attr->st_mtim;
+        }
+        fuse->_fs->utimens(path, lastAccessTime, lastModificationTime);
+      }
+
+      STAT stbuf{};
+      if (fileinfo != nullptr) {
+        fuse->_fs->fstat(fileinfo->fh, &stbuf);
+      } else {
+        fuse->_fs->lstat(path, &stbuf);
+      }
+      stbuf.st_ino = ino;
+      fuse_reply_attr(req, &stbuf, fuse->_kernelCacheTimeouts.attrTimeoutSeconds);
+    });
+  }
+
+  static void readlink(fuse_req_t req, fuse_ino_t ino) {
+    handleErrors(req, "readlink", [&] {
+      auto fuse = _fuse(req);
+      std::array<char, PATH_MAX + 1> buf{};
+      fuse->_fs->readSymlink(fuse->_inodes.path(ino), buf.data(), fspp::num_bytes_t(buf.size()));
+      fuse_reply_readlink(req, buf.data());
+    });
+  }
+
+  static void mkdir(fuse_req_t req, fuse_ino_t parent, const char *name, ::mode_t mode) {
+    handleErrors(req, "mkdir", [&] {
+      auto fuse = _fuse(req);
+      const fuse_ctx *context = fuse_req_ctx(req);
+      fuse->_fs->mkdir(fuse->_inodes.childPath(parent, name), mode, context->uid, context->gid);
+      _replyEntry(req, _lookupEntry(fuse, parent, name));
+    });
+  }
+
+  static void unlink(fuse_req_t req, fuse_ino_t parent, const char *name) {
+    handleErrors(req, "unlink", [&] {
+      auto fuse = _fuse(req);
+      fuse->_fs->unlink(fuse->_inodes.childPath(parent, name));
+      fuse->_inodes.remove(parent, name);
+      fuse_reply_err(req, 0);
+    });
+  }
+
+  static void rmdir(fuse_req_t req, fuse_ino_t parent, const char *name) {
+    handleErrors(req, "rmdir", [&] {
+      auto fuse = _fuse(req);
+      fuse->_fs->rmdir(fuse->_inodes.childPath(parent, name));
+      fuse->_inodes.remove(parent, name);
+      fuse_reply_err(req, 0);
+    });
+  }
+
+  static void symlink(fuse_req_t req, const char *link, fuse_ino_t parent, const char *name) {
+    handleErrors(req, "symlink", [&] {
+      auto fuse = _fuse(req);
+      const fuse_ctx *context = fuse_req_ctx(req);
+      fuse->_fs->createSymlink(link, fuse->_inodes.childPath(parent, name), context->uid, context->gid);
+      _replyEntry(req, _lookupEntry(fuse, parent, name));
+    });
+  }
+
+  static void rename(fuse_req_t req, fuse_ino_t parent, const char *name, fuse_ino_t newparent, const char *newname, unsigned int flags) {
+    handleErrors(req, "rename", [&] {
+      if (flags != 0) {
+        // RENAME_EXCHANGE and RENAME_NOREPLACE aren't supported by the Filesystem interface
+        throw FuseErrnoException(EINVAL);
+      }
+      auto fuse = _fuse(req);
+      fuse->_fs->rename(fuse->_inodes.childPath(parent, name), fuse->_inodes.childPath(newparent, newname));
+      fuse->_inodes.rename(parent, name, newparent, newname);
+      fuse_reply_err(req, 0);
+    });
+  }
+
+  static void open(fuse_req_t req, fuse_ino_t ino, fuse_file_info *fileinfo) {
+    handleErrors(req, "open", [&] {
+      auto fuse = _fuse(req);
+      _adjustFlagsForWritebackCache(fuse, fileinfo);
+      fileinfo->fh = fuse->_fs->openFile(fuse->_inodes.path(ino), fileinfo->flags);
+      if (fuse_reply_open(req, fileinfo) != 0) {
+        // The request was interrupted, the kernel won't release the file
+        _closeFileUnknownToKernel(fuse, fileinfo->fh);
+      }
+    });
+  }
+
+  static void create(fuse_req_t req, fuse_ino_t parent, const char *name, ::mode_t mode, fuse_file_info *fileinfo) {
+    handleErrors(req, "create", [&] {
+      auto fuse = _fuse(req);
+      _adjustFlagsForWritebackCache(fuse, fileinfo);
+      const fuse_ctx *context = fuse_req_ctx(req);
+      fileinfo->fh = fuse->_fs->createAndOpenFile(fuse->_inodes.childPath(parent, name), mode, context->uid, context->gid);
+      fuse_entry_param entry{};
+      try {
+        // Like libfuse 2, get the attributes from the open file instead of looking the path up again
+        fuse->_fs->fstat(fileinfo->fh, &entry.attr);
+        _addEntry(fuse, parent, name, &entry);
+      } catch (...) {
+        _closeFileUnknownToKernel(fuse, fileinfo->fh);
+        throw;
+      }
+      if (fuse_reply_create(req, &entry, fileinfo) != 0) {
+        fuse->_inodes.forget(entry.ino, 1);
+        _closeFileUnknownToKernel(fuse, fileinfo->fh);
+      }
+    });
+  }
+
+  static void read(fuse_req_t req, fuse_ino_t /*ino*/, size_t size, off_t offset, fuse_file_info *fileinfo) {
+    handleErrors(req, "read", [&] {
+      Data buffer(size);
+      auto numRead = _fuse(req)->_fs->read(fileinfo->fh, buffer.data(), fspp::num_bytes_t(size), fspp::num_bytes_t(offset));
+      fuse_reply_buf(req, static_cast<const char*>(buffer.data()), numRead.value());
+    });
+  }
+
+  static void write_buf(fuse_req_t req, fuse_ino_t /*ino*/, fuse_bufvec *bufv, off_t offset, fuse_file_info *fileinfo) {
+    handleErrors(req, "write_buf", [&] {
+      auto fuse = _fuse(req);
+      const size_t size = fuse_buf_size(bufv);
+      if (bufv->count == 1 && !(bufv->buf[0].flags & FUSE_BUF_IS_FD)) {
+        // The data is already in memory, write it directly
+        fuse->_fs->write(fileinfo->fh, static_cast<const char*>(bufv->buf[0].mem) + bufv->off, fspp::num_bytes_t(size), fspp::num_bytes_t(offset));
+        fuse_reply_write(req, size);
+      } else {
+        // The data is still in a pipe (splice), move it into a buffer first
+        Data buffer(size);
+        fuse_bufvec dest{};
+        dest.count = 1;
+        dest.buf[0].size = size;
+        dest.buf[0].mem = buffer.data();
+        dest.buf[0].fd = -1;
+        ssize_t copied = fuse_buf_copy(&dest, bufv, FUSE_BUF_SPLICE_MOVE);
+        if (copied < 0) {
+          throw FuseErrnoException(static_cast<int>(-copied));
+        }
+        // If the pipe had less data than announced, only that was written. Tell the kernel, so it doesn't assume the rest was written too.
+        fuse->_fs->write(fileinfo->fh, buffer.data(), fspp::num_bytes_t(copied), fspp::num_bytes_t(offset));
+        fuse_reply_write(req, static_cast<size_t>(copied));
+      }
+    });
+  }
+
+  static void flush(fuse_req_t req, fuse_ino_t /*ino*/, fuse_file_info *fileinfo) {
+    handleErrors(req, "flush", [&] {
+      _fuse(req)->_fs->flush(fileinfo->fh);
+      fuse_reply_err(req, 0);
+    });
+  }
+
+  static void release(fuse_req_t req, fuse_ino_t /*ino*/, fuse_file_info *fileinfo) {
+    handleErrors(req, "release", [&] {
+      _fuse(req)->_fs->closeFile(fileinfo->fh);
+      fuse_reply_err(req, 0);
+    });
+  }
+
+  static void fsync(fuse_req_t req, fuse_ino_t /*ino*/, int datasync, fuse_file_info *fileinfo) {
+    handleErrors(req, "fsync", [&] {
+      if (datasync) {
+        _fuse(req)->_fs->fdatasync(fileinfo->fh);
+      } else {
+        _fuse(req)->_fs->fsync(fileinfo->fh);
+      }
+      fuse_reply_err(req, 0);
+    });
+  }
+
+  static void opendir(fuse_req_t req, fuse_ino_t ino, fuse_file_info *fileinfo) {
+    handleErrors(req, "opendir", [&] {
+      auto fuse = _fuse(req);
+      auto entries = cpputils::make_unique_ref<LowlevelFuse::OpenDir>(fuse->_fs->readDir(fuse->_inodes.path(ino)));
+      {
+        std::lock_guard<std::mutex> lock(fuse->_openDirsMutex);
+        fileinfo->fh = fuse->_openDirs.add(std::move(entries));
+      }
+      if (fuse_reply_open(req, fileinfo) != 0) {
+        _releaseDir(fuse, fileinfo->fh);
+      }
+    });
+  }
+
+  static void readdir(fuse_req_t req, fuse_ino_t ino, size_t size, off_t offset, fuse_file_info *fileinfo) {
+    handleErrors(req, "readdir", [&] {
+      _readdir(req, ino, size, offset, fileinfo, false);
+    });
+  }
+
+  static void readdirplus(fuse_req_t req, fuse_ino_t ino, size_t size, off_t offset, fuse_file_info *fileinfo) {
+    handleErrors(req, "readdirplus", [&] {
+      _readdir(req, ino, size, offset, fileinfo, true);
+    });
+  }
+
+  static void releasedir(fuse_req_t req, fuse_ino_t /*ino*/, fuse_file_info *fileinfo) {
+    handleErrors(req, "releasedir", [&] {
+      _releaseDir(_fuse(req), fileinfo->fh);
+      fuse_reply_err(req, 0);
+    });
+  }
+
+  static void fsyncdir(fuse_req_t req, fuse_ino_t /*ino*/, int /*datasync*/, fuse_file_info * /*fileinfo*/) {
+    // Directory changes are written together with the file system state, see Fuse::fsyncdir
+    fuse_reply_err(req, 0);
+  }
+
+  static void statfs(fuse_req_t req, fuse_ino_t /*ino*/) {
+    handleErrors(req, "statfs", [&] {
+      struct ::statvfs stbuf{};
+      _fuse(req)->_fs->statfs(&stbuf);
+      fuse_reply_statfs(req, &stbuf);
+    });
+  }
+
+  static void access(fuse_req_t req, fuse_ino_t ino, int mask) {
+    handleErrors(req, "access", [&] {
+      auto fuse = _fuse(req);
+      fuse->_fs->access(fuse->_inodes.path(ino), mask);
+      fuse_reply_err(req, 0);
+    });
+  }
+
+  static const fuse_lowlevel_ops *operations() {
+    static fuse_lowlevel_ops ops = [] {
+      fuse_lowlevel_ops result{};
+      result.init = &LowlevelFuseOperations::init;
+      result.destroy = &LowlevelFuseOperations::destroy;
+      result.lookup = &LowlevelFuseOperations::lookup;
+      result.forget = &LowlevelFuseOperations::forget;
+      result.forget_multi = &LowlevelFuseOperations::forget_multi;
+      result.getattr = &LowlevelFuseOperations::getattr;
+      result.setattr = &LowlevelFuseOperations::setattr;
+      result.readlink = &LowlevelFuseOperations::readlink;
+      result.mkdir = &LowlevelFuseOperations::mkdir;
+      result.unlink = &LowlevelFuseOperations::unlink;
+      result.rmdir = &LowlevelFuseOperations::rmdir;
+      result.symlink = &LowlevelFuseOperations::symlink;
+      result.rename = &LowlevelFuseOperations::rename;
+      result.open = &LowlevelFuseOperations::open;
+      result.create = &LowlevelFuseOperations::create;
+      result.read = &LowlevelFuseOperations::read;
+      result.write_buf = &LowlevelFuseOperations::write_buf;
+      result.flush = &LowlevelFuseOperations::flush;
+      result.release = &LowlevelFuseOperations::release;
+      result.fsync = &LowlevelFuseOperations::fsync;
+      result.opendir = &LowlevelFuseOperations::opendir;
+      result.readdir = &LowlevelFuseOperations::readdir;
+      result.readdirplus = &LowlevelFuseOperations::readdirplus;
+      result.releasedir = &LowlevelFuseOperations::releasedir;
+      result.fsyncdir = &LowlevelFuseOperations::fsyncdir;
+      result.statfs = &LowlevelFuseOperations::statfs;
+      result.access = &LowlevelFuseOperations::access;
+      return result;
+    }();
+    return &ops;
+  }
+
+private:
+  static LowlevelFuse *_fuse(fuse_req_t req) {
+    return static_cast<LowlevelFuse*>(fuse_req_userdata(req));
+  }
+
+  static void _forget(LowlevelFuse *fuse, fuse_ino_t ino, uint64_t nlookup) {
+    try {
+      fuse->_inodes.forget(ino, nlookup);
+    } catch(const std::exception &e) {
+      // forget can't report errors to the kernel
+      LOG(ERR, "Exception thrown in LowlevelFuse::forget: {}", e.what());
+    }
+  }
+
+  // Looks up the child and counts the lookup. The caller has to hand the entry to the kernel,
+  // or forget it if that fails, because the kernel only forgets entries it knows about.
+  static fuse_entry_param _lookupEntry(LowlevelFuse *fuse, fuse_ino_t parent, const string &name) {
+    fuse_entry_param entry{};
+    fuse->_fs->lstat(fuse->_inodes.childPath(parent, name), &entry.attr);
+    _addEntry(fuse, parent, name, &entry);
+    return entry;
+  }
+
+  // Counts the lookup of a child whose attributes are already in entry->attr and fills in the rest of the entry.
+  // The same rules as for _lookupEntry() apply.
+  static void _addEntry(LowlevelFuse *fuse, fuse_ino_t parent, const string &name, fuse_entry_param *entry) {
+    auto inode = fuse->_inodes.lookup(parent, name);
+    entry->ino = inode.number;
+    entry->generation = inode.generation;
+    entry->attr.st_ino = inode.number;
+    entry->attr_timeout = fuse->_kernelCacheTimeouts.attrTimeoutSeconds;
+    entry->entry_timeout = fuse->_kernelCacheTimeouts.entryTimeoutSeconds;
+  }
+
+  static void _replyEntry(fuse_req_t req, const fuse_entry_param &entry) {
+    auto fuse = _fuse(req);
+    if (fuse_reply_entry(req, &entry) != 0) {
+      fuse->_inodes.forget(entry.ino, 1);
+    }
+  }
+
+  static void _adjustFlagsForWritebackCache(LowlevelFuse *fuse, fuse_file_info *fileinfo) {
+    if (fuse->_writebackCache) {
+      // With the writeback cache, the kernel reads pages of files that are only open for writing,
+      // and it handles O_APPEND itself.
+      if ((fileinfo->flags & O_ACCMODE) == O_WRONLY) {
+        fileinfo->flags = (fileinfo->flags & ~O_ACCMODE) | O_RDWR;
+      }
+      fileinfo->flags &= ~O_APPEND;
+    }
+  }
+
+  // Closes a file that was opened for a request that failed. This can't report errors anymore, because the
+  // request either already got its reply, or is going to get the error that made it fail.
+  static void _closeFileUnknownToKernel(LowlevelFuse *fuse, uint64_t handle) {
+    try {
+      fuse->_fs->closeFile(handle);
+    } catch(const std::exception &e) {
+      LOG(ERR, "Exception thrown in LowlevelFuse when closing file: {}", e.what());
+    }
+  }
+
+  static void _releaseDir(LowlevelFuse *fuse, uint64_t handle) {
+    std::lock_guard<std::mutex> lock(fuse->_openDirsMutex);
+    fuse->_openDirs.remove(static_cast<int>(handle));
+  }
+
+  static void _readdir(fuse_req_t req, fuse_ino_t ino, size_t size, off_t offset, fuse_file_info *fileinfo, bool plus) {
+    auto fuse = _fuse(req);
+    const LowlevelFuse::OpenDir *entries = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(fuse->_openDirsMutex);
+      entries = fuse->_openDirs.get(static_cast<int>(fileinfo->fh));
+    }
+
+    // The offset the kernel gives us is the one we stored with the last entry it got, i.e. the index of the next entry
+    vector<char> buffer(size);
+    size_t bufferUsed = 0;
+    for (size_t index = static_cast<size_t>(offset); index < entries->size(); ++index) {
+      const Dir::Entry &dirEntry = (*entries)[index];
+      const off_t nextOffset = static_cast<off_t>(index + 1);
+      char *pos = buffer.data() + bufferUsed;
+      const size_t remaining = size - bufferUsed;
+      size_t entrySize = 0;
+      if (plus) {
+        fuse_entry_param entry{};
+        // If entry.ino stays 0, the kernel doesn't instantiate an inode for the entry and looks it up when it's used
+        entry.attr.st_ino = UNKNOWN_INO;
+        entry.attr.st_mode = modeForEntryType(dirEntry.type);
+        if (!isDotOrDotDot(dirEntry.name)) {
+          try {
+            entry = _lookupEntry(fuse, ino, dirEntry.name);
+          } catch (const FuseErrnoException &) {
+            // E.g. the entry was removed after the directory was opened. Return it without attributes like readdir does,
+            // so listing the directory doesn't fail because of it.
+          }
+        }
+        entrySize = fuse_add_direntry_plus(req, pos, remaining, dirEntry.name.c_str(), &entry, nextOffset);
+        if (entrySize > remaining && entry.ino != 0) {
+          // Didn't fit, so the kernel won't get this lookup
+          fuse->_inodes.forget(entry.ino, 1);
+        }
+      } else {
+        STAT stbuf{};
+        stbuf.st_ino = UNKNOWN_INO;
+        stbuf.st_mode = modeForEntryType(dirEntry.type);
+        entrySize = fuse_add_direntry(req, pos, remaining, dirEntry.name.c_str(), &stbuf, nextOffset);
+      }
+      if (entrySize > remaining) {
+        break;
+      }
+      bufferUsed += entrySize;
+    }
+    fuse_reply_buf(req, buffer.data(), bufferUsed);
+  }
+};
+
+LowlevelFuse::LowlevelFuse(std::function<shared_ptr<Filesystem> (LowlevelFuse *fuse)> init, std::function<void()> onMounted, std::string fstype, boost::optional<std::string> fsname)
+  :_init(std::move(init)), _onMounted(std::move(onMounted)), _fs(make_shared<InvalidFilesystem>()), _inodes(), _openDirsMutex(), _openDirs(),
+   _mountdir(), _running(false), _allowWritebackCache(true), _writebackCache(false), _fstype(std::move(fstype)), _fsname(std::move(fsname)), _context(boost::none),
+   _kernelCacheTimeouts(KernelCacheTimeouts::Default()) {
+  ASSERT(static_cast<bool>(_init), "Invalid init given");
+  ASSERT(static_cast<bool>(_onMounted), "Invalid onMounted given");
+}
+
+LowlevelFuse::~LowlevelFuse() {
+}
+
+void LowlevelFuse::runInForeground(const bf::path &mountdir, vector<string> fuseOptions) {
+  _run(mountdir, std::move(fuseOptions), true);
+}
+
+void LowlevelFuse::runInBackground(const bf::path &mountdir, vector<string> fuseOptions) {
+  _run(mountdir, std::move(fuseOptions), false);
+}
+
+void LowlevelFuse::_run(const bf::path &mountdir, vector<string> fuseOptions, bool foreground) {
+#if defined(__GLIBC__)
+  // Avoid encoding errors for non-utf8 characters, see https://github.com/cryfs/cryfs/issues/247
+  bf::path::imbue(std::locale(std::locale(), new std::codecvt_utf8_utf16<wchar_t>()));
+#endif
+
+  _mountdir = mountdir;
+
+  vector<string> atimeOptions = extractAllAtimeOptionsAndRemoveOnesUnknownToLibfuse(&fuseOptions);
+  _context = createContextFromAtimeOptions(atimeOptions);
+  _extractOptionsUnknownToLibfuse(&fuseOptions);
+
+  vector<string> args = _buildArgs(mountdir, fuseOptions);
+  vector<char*> argv;
+  argv.reserve(args.size());
+  for (string &arg : args) {
+    argv.push_back(&arg[0]);
+  }
+  fuse_args fuseArgs = FUSE_ARGS_INIT(static_cast<int>(argv.size()), argv.data());
+  fuse_cmdline_opts cmdlineOptions{};
+  if (0 != fuse_parse_cmdline(&fuseArgs, &cmdlineOptions)) {
+    throw std::runtime_error("Invalid fuse options");
+  }
+  // fuse_parse_cmdline() allocates the mountpoint, and we don't need it because we know it already
+  free(cmdlineOptions.mountpoint);
+  foreground = foreground || cmdlineOptions.foreground;
+
+  fuse_session *session = fuse_session_new(&fuseArgs, LowlevelFuseOperations::operations(), sizeof(fuse_lowlevel_ops), this);
+  fuse_opt_free_args(&fuseArgs);
+  if (session == nullptr) {
+    throw std::runtime_error("Could not create fuse session");
+  }
+  if (0 != fuse_set_signal_handlers(session)) {
+    fuse_session_destroy(session);
+    throw std::runtime_error("Could not set up signal handlers");
+  }
+  if (0 != fuse_session_mount(session, mountdir.string().c_str())) {
+    fuse_remove_signal_handlers(session);
+    fuse_session_destroy(session);
+    throw std::runtime_error("Could not mount filesystem");
+  }
+  fuse_daemonize(foreground ? 1 : 0);
+
+  if (cmdlineOptions.singlethread) {
+    fuse_session_loop(session);
+  } else {
+    fuse_loop_config loopConfig{};
+    loopConfig.clone_fd = cmdlineOptions.clone_fd;
+    loopConfig.max_idle_threads = cmdlineOptions.max_idle_threads;
+    fuse_session_loop_mt(session, &loopConfig);
+  }
+
+  fuse_session_unmount(session);
+  fuse_remove_signal_handlers(session);
+  fuse_session_destroy(session);
+}
+
+vector<string> LowlevelFuse::_buildArgs(const bf::path &mountdir, const vector<string> &fuseOptions) const {
+  vector<string> args;
+  args.reserve(6 + fuseOptions.size()); // fuseOptions + executable name + mountdir + 2x fuse options (subtype, fsname), each taking 2 entries ("-o", "key=value").
+  args.push_back(_fstype); // The first argument (executable name) is the file system type
+  args.push_back(mountdir.string());
+  for (const string &option : fuseOptions) {
+    args.push_back(option);
+  }
+  if (!_hasOption(args, "subtype")) {
+    args.push_back("-o");
+    args.push_back("subtype=" + _fstype);
+  }
+  if (!_hasOption(args, "fsname")) {
+    auto fsname = _fsname.get_value_or(_fstype);
+    boost::replace_all(fsname, ",", "\\,"); // Avoid fuse options parser bug where a comma in the fsname is misinterpreted as an options delimiter, see https://github.com/cryfs/cryfs/issues/326
+    args.push_back("-o");
+    args.push_back("fsname=" + fsname);
+  }
+  // libfuse 3 doesn't know the big_writes option anymore, large writes are always enabled. max_write is set in init().
+  return args;
+}
+
+void LowlevelFuse::_extractOptionsUnknownToLibfuse(vector<string> *fuseOptions) {
+  // The libfuse 3 lowlevel API doesn't know these options and would refuse to mount, so we take them out and answer
+  // requests with these timeouts ourselves. The writeback cache options are the ones libfuse 3 uses for its connection options.
+  const auto parseTimeout = [] (const string &option, const string &key, double *result) {
+    if (0 != option.compare(0, key.size() + 1, key + "=")) {
+      return false;
+    }
+    try {
+      *result = std::stod(option.substr(key.size() + 1));
+    } catch (const std::logic_error &) {
+      throw std::runtime_error("Invalid fuse option: " + option);
+    }
+    return true;
+  };
+  bool lastOptionWasDashO = false;
+  for (auto option = fuseOptions->begin(); option != fuseOptions->end(); ) {
+    if (!lastOptionWasDashO) {
+      lastOptionWasDashO = (*option == "-o");
+      ++option;
+      continue;
+    }
+    lastOptionWasDashO = false;
+    vector<string> csvOptions;
+    boost::split(csvOptions, *option, [] (char c) {return c == ',';});
+    vector<string> remaining;
+    for (const string &csvOption : csvOptions) {
+      if (!parseTimeout(csvOption, "attr_timeout", &_kernelCacheTimeouts.attrTimeoutSeconds)
+          && !parseTimeout(csvOption, "entry_timeout", &_kernelCacheTimeouts.entryTimeoutSeconds)
+          && !parseTimeout(csvOption, "negative_timeout", &_kernelCacheTimeouts.negativeTimeoutSeconds)) {
+        if (csvOption == "writeback_cache") {
+          _allowWritebackCache = true;
+        } else if (csvOption == "no_writeback_cache") {
+          _allowWritebackCache = false;
+        } else {
+          remaining.push_back(csvOption);
+        }
+      }
+    }
+    if (remaining.empty()) {
+      // Remove the "-o" together with its now empty value
+      option = fuseOptions->erase(option - 1, option + 1);
+    } else {
+      *option = boost::algorithm::join(remaining, ",");
+      ++option;
+    }
+  }
+}
+
+void LowlevelFuse::setKernelCacheTimeouts(KernelCacheTimeouts timeouts) {
+  ASSERT(!_running, "Filesystem already started");
+  _kernelCacheTimeouts = timeouts;
+}
+
+bool LowlevelFuse::_hasOption(const vector<string> &args, const string &key) {
+  // The fuse option can either be present as "-okey=value" or as "-o key=value", we have to check both.
+  return std::any_of(args.begin(), args.end(), [&key] (const string &arg) {
+    return 0 == arg.compare(0, key.size() + 1, key + "=") || 0 == arg.compare(0, key.size() + 3, "-o" + key + "=");
+  });
+}
+
+bool LowlevelFuse::running() const {
+  return _running;
+}
+
+void LowlevelFuse::stop() {
+  // "-z" takes care that if the filesystem can't be unmounted right now because something is opened, it will be unmounted as soon as it can be.
+  int returncode = cpputils::Subprocess::call("fusermount3 -z -u " + _mountdir.string()).exitcode;
+  if (returncode != 0) {
+    throw std::runtime_error("Could not unmount filesystem");
+  }
+}
+
+}
+}
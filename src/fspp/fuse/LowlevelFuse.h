@@ -0,0 +1,83 @@
+#pragma once
+#ifndef MESSMER_FSPP_FUSE_LOWLEVELFUSE_H_
+#define MESSMER_FSPP_FUSE_LOWLEVELFUSE_H_
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+#include <cpp-utils/macros.h>
+#include <fspp/fs_interface/Context.h>
+#include <fspp/fs_interface/Dir.h>
+#include <fspp/impl/IdList.h>
+#include "InodeTable.h"
+#include "KernelCacheTimeouts.h"
+
+namespace fspp {
+namespace fuse {
+class Filesystem;
+class LowlevelFuseOperations;
+
+/**
+ * Mounts a Filesystem using the libfuse 3 lowlevel API. Unlike Fuse, which uses the path based high level API
+ * of libfuse 2, the kernel addresses nodes by inode number here, and readdirplus returns the attributes of all
+ * directory entries in one round trip instead of the kernel calling getattr for each of them.
+ * Paths are only built from the inode table when calling into the path based Filesystem interface.
+ * Only available on Linux, and only if fspp was built with FSPP_FUSE3_LOWLEVEL. Fuse stays the fallback.
+ * This header doesn't include the libfuse 3 headers, so it can be used together with Fuse.h.
+ */
+class LowlevelFuse final {
+public:
+  explicit LowlevelFuse(std::function<std::shared_ptr<Filesystem> (LowlevelFuse *fuse)> init, std::function<void()> onMounted, std::string fstype, boost::optional<std::string> fsname);
+  ~LowlevelFuse();
+
+  void runInBackground(const boost::filesystem::path &mountdir, std::vector<std::string> fuseOptions);
+  void runInForeground(const boost::filesystem::path &mountdir, std::vector<std::string> fuseOptions);
+  bool running() const;
+  void stop();
+
+  // Has to be called before the file system is run. Fuse options given by the user take precedence.
+  void setKernelCacheTimeouts(KernelCacheTimeouts timeouts);
+
+  // Largest write request the kernel sends us. Larger writes mean fewer requests and fewer updates of the blob tree.
+  static constexpr uint32_t MAX_WRITE_BYTES = 1024 * 1024;
+
+private:
+  friend class LowlevelFuseOperations;
+
+  // Directory entries are read when the directory is opened, and readdir calls return them piece by piece from here
+  using OpenDir = std::vector<Dir::Entry>;
+
+  void _run(const boost::filesystem::path &mountdir, std::vector<std::string> fuseOptions, bool foreground);
+  std::vector<std::string> _buildArgs(const boost::filesystem::path &mountdir, const std::vector<std::string> &fuseOptions) const;
+  static bool _hasOption(const std::vector<std::string> &args, const std::string &key);
+  void _extractOptionsUnknownToLibfuse(std::vector<std::string> *fuseOptions);
+
+  std::function<std::shared_ptr<Filesystem> (LowlevelFuse *fuse)> _init;
+  std::function<void()> _onMounted;
+  std::shared_ptr<Filesystem> _fs;
+  InodeTable _inodes;
+  std::mutex _openDirsMutex;
+  IdList<OpenDir> _openDirs;
+  boost::filesystem::path _mountdir;
+  std::atomic<bool> _running;
+  // Cleared by the no_writeback_cache option
+  bool _allowWritebackCache;
+  // Set in init() if the kernel supports it and it's allowed. The kernel then caches writes and might read from files opened write-only.
+  bool _writebackCache;
+  std::string _fstype;
+  boost::optional<std::string> _fsname;
+  boost::optional<Context> _context;
+  KernelCacheTimeouts _kernelCacheTimeouts;
+
+  DISALLOW_COPY_AND_ASSIGN(LowlevelFuse);
+};
+
+}
+}
+
+#endif
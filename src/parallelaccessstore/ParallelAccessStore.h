@@ -6,6 +6,10 @@
 #include <memory>
 #include <map>
 #include <unordered_map>
+#include <unordered_set>
+#include <condition_variable>
+#include <vector>
+#include <functional>
 #include <boost/thread/future.hpp>
 #include <cassert>
 #include <type_traits>
@@ -26,6 +30,8 @@ public:
     ~ParallelAccessStore() {
         ASSERT(_openResources.size() == 0, "Still resources open when trying to destruct");
         ASSERT(_resourcesToRemove.size() == 0, "Still resources to remove when trying to destruct");
+        ASSERT(_keysBeingLoaded.size() == 0, "Still resources being loaded when trying to destruct");
+        ASSERT(_keysBeingRemoved.size() == 0, "Still resources being removed when trying to destruct");
     };
 
   class ResourceRefBase {
@@ -58,6 +64,10 @@ public:
   cpputils::unique_ref<ResourceRef> loadOrAdd(const Key &key, std::function<void (ResourceRef*)> onExists, std::function<cpputils::unique_ref<Resource> ()> onAdd, std::function<cpputils::unique_ref<ResourceRef>(Resource*)> createResourceRef);
   void remove(const Key &key, cpputils::unique_ref<ResourceRef> block);
   void remove(const Key &key);
+  // Removes resources that aren't opened with one call to removeNotOpened. They're marked as being removed while that
+  // runs, so that they can't be loaded in between. Opened resources are removed with remove(key) afterwards, which waits
+  // until they're released.
+  void removeMany(const std::vector<Key> &keys, std::function<void (const std::vector<Key> &notOpened)> removeNotOpened);
 
 private:
   class OpenResource final {
@@ -93,12 +103,22 @@ private:
 
   std::unordered_map<Key, OpenResource> _openResources;
   std::map<Key, boost::promise<cpputils::unique_ref<Resource>>> _resourcesToRemove;
+  // Keys that are loaded from or removed from the base store right now. This happens without holding _mutex,
+  // so that different resources can be loaded in parallel. Other operations on these keys wait until it's finished.
+  std::unordered_set<Key> _keysBeingLoaded;
+  std::unordered_multiset<Key> _keysBeingRemoved;
+  std::condition_variable _loadingOrRemovingFinished;
 
   template<class ActualResourceRef>
   cpputils::unique_ref<ActualResourceRef> _add(const Key &key, cpputils::unique_ref<Resource> resource, std::function<cpputils::unique_ref<ActualResourceRef>(Resource*)> createResourceRef);
 
   boost::future<cpputils::unique_ref<Resource>> _resourceToRemoveFuture(const Key &key);
   cpputils::unique_ref<Resource> _waitForResourceToRemove(const Key &key, boost::future<cpputils::unique_ref<Resource>> resourceToRemoveFuture);
+  void _removeReleasedResource(const Key &key, cpputils::unique_ref<Resource> resource);
+
+  void _waitUntilNotLoadingOrRemoving(std::unique_lock<std::mutex> *lock, const Key &key);
+  void _finishLoading(const Key &key);
+  void _finishRemoving(const std::vector<Key> &keys);
 
   void release(const Key &key);
   friend class CachedResource;
@@ -111,7 +131,10 @@ ParallelAccessStore<Resource, ResourceRef, Key>::ParallelAccessStore(cpputils::u
   : _mutex(),
   _baseStore(std::move(baseStore)),
   _openResources(),
-  _resourcesToRemove() {
+  _resourcesToRemove(),
+  _keysBeingLoaded(),
+  _keysBeingRemoved(),
+  _loadingOrRemovingFinished() {
   static_assert(std::is_base_of<ResourceRefBase, ResourceRef>::value, "ResourceRef must inherit from ResourceRefBase");
 }
 
@@ -156,7 +179,8 @@ cpputils::unique_ref<ResourceRef> ParallelAccessStore<Resource, ResourceRef, Key
 
 template<class Resource, class ResourceRef, class Key>
 cpputils::unique_ref<ResourceRef> ParallelAccessStore<Resource, ResourceRef, Key>::loadOrAdd(const Key &key, std::function<void (ResourceRef*)> onExists, std::function<cpputils::unique_ref<Resource> ()> onAdd, std::function<cpputils::unique_ref<ResourceRef>(Resource*)> createResourceRef) {
-    std::lock_guard<std::mutex> lock(_mutex);
+    std::unique_lock<std::mutex> lock(_mutex);
+    _waitUntilNotLoadingOrRemoving(&lock, key);
     auto found = _openResources.find(key);
     if (found == _openResources.end()) {
         auto resource = onAdd();
@@ -178,11 +202,24 @@ boost::optional<cpputils::unique_ref<ResourceRef>> ParallelAccessStore<Resource,
 
 template<class Resource, class ResourceRef, class Key>
 boost::optional<cpputils::unique_ref<ResourceRef>> ParallelAccessStore<Resource, ResourceRef, Key>::load(const Key &key, std::function<cpputils::unique_ref<ResourceRef>(Resource*)> createResourceRef) {
-  //TODO This lock doesn't allow loading different blocks in parallel. Can we only lock the requested key?
-  std::lock_guard<std::mutex> lock(_mutex);
+  std::unique_lock<std::mutex> lock(_mutex);
+  _waitUntilNotLoadingOrRemoving(&lock, key);
   auto found = _openResources.find(key);
   if (found == _openResources.end()) {
-    auto resource = _baseStore->loadFromBaseStore(key);
+    // Load without holding the lock, so that other resources can be loaded in parallel.
+    // Marking the key as being loaded makes other accesses to this resource wait until it's loaded.
+    _keysBeingLoaded.insert(key);
+    lock.unlock();
+    boost::optional<cpputils::unique_ref<Resource>> resource = boost::none;
+    try {
+      resource = _baseStore->loadFromBaseStore(key);
+    } catch (...) {
+      _finishLoading(key);
+      throw;
+    }
+    lock.lock();
+    _keysBeingLoaded.erase(key);
+    _loadingOrRemovingFinished.notify_all();
     if (resource == boost::none) {
       return boost::none;
     }
@@ -202,9 +239,23 @@ void ParallelAccessStore<Resource, ResourceRef, Key>::remove(const Key &key, cpp
 
   //Wait for last resource user to release it
   auto resourceToRemove = resourceToRemoveFuture.get();
-  std::lock_guard<std::mutex> lock(_mutex); // TODO Just added this as a precaution on a whim, but I seriously need to rethink locking here.
-  _resourcesToRemove.erase(key); //TODO Is this erase causing a race condition?
-  _baseStore->removeFromBaseStore(std::move(resourceToRemove));
+  _removeReleasedResource(key, std::move(resourceToRemove));
+}
+
+template<class Resource, class ResourceRef, class Key>
+void ParallelAccessStore<Resource, ResourceRef, Key>::_removeReleasedResource(const Key &key, cpputils::unique_ref<Resource> resource) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _resourcesToRemove.erase(key);
+  }
+  // release() marked the key as being removed, so loading it waits until it's removed and we don't need to hold the lock.
+  try {
+    _baseStore->removeFromBaseStore(std::move(resource));
+  } catch (...) {
+    _finishRemoving({key});
+    throw;
+  }
+  _finishRemoving({key});
 }
 
 template<class Resource, class ResourceRef, class Key>
@@ -217,19 +268,90 @@ boost::future<cpputils::unique_ref<Resource>> ParallelAccessStore<Resource, Reso
 
 template<class Resource, class ResourceRef, class Key>
 void ParallelAccessStore<Resource, ResourceRef, Key>::remove(const Key &key) {
-    auto found = _openResources.find(key);
-    if (found != _openResources.end()) {
-        auto resourceToRemoveFuture = _resourceToRemoveFuture(key);
+    std::unique_lock<std::mutex> lock(_mutex);
+    _waitUntilNotLoadingOrRemoving(&lock, key);
+    if (_openResources.find(key) != _openResources.end()) {
+        // Register while still holding the lock, so the resource can't be released in between without fulfilling the promise
+        auto insertResult = _resourcesToRemove.emplace(key, boost::promise<cpputils::unique_ref<Resource>>());
+        ASSERT(true == insertResult.second, "Inserting failed");
+        auto resourceToRemoveFuture = insertResult.first->second.get_future();
+        lock.unlock();
         //Wait for last resource user to release it
         auto resourceToRemove = resourceToRemoveFuture.get();
-        std::lock_guard<std::mutex> lock(_mutex); // TODO Just added this as a precaution on a whim, but I seriously need to rethink locking here.
-        _resourcesToRemove.erase(key); //TODO Is this erase causing a race condition?
-        _baseStore->removeFromBaseStore(std::move(resourceToRemove));
+        _removeReleasedResource(key, std::move(resourceToRemove));
     } else {
-        _baseStore->removeFromBaseStore(key);
+        // Loading the key waits until it's removed, so we don't need to hold the lock while removing it.
+        _keysBeingRemoved.insert(key);
+        lock.unlock();
+        try {
+            _baseStore->removeFromBaseStore(key);
+        } catch (...) {
+            _finishRemoving({key});
+            throw;
+        }
+        _finishRemoving({key});
+    }
+};
+
+template<class Resource, class ResourceRef, class Key>
+void ParallelAccessStore<Resource, ResourceRef, Key>::removeMany(const std::vector<Key> &keys, std::function<void (const std::vector<Key> &notOpened)> removeNotOpened) {
+    std::vector<Key> opened;
+    std::vector<Key> notOpened;
+    notOpened.reserve(keys.size());
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        for (const Key &key : keys) {
+            // If the resource is being loaded, wait until it's opened (or found not to exist) to decide
+            _loadingOrRemovingFinished.wait(lock, [this, &key] {
+                return _keysBeingLoaded.count(key) == 0;
+            });
+            if (_openResources.find(key) != _openResources.end()) {
+                opened.push_back(key);
+            } else {
+                notOpened.push_back(key);
+                _keysBeingRemoved.insert(key);
+            }
+        }
+    }
+    // Loading these keys waits until they're removed, so we don't need to hold the lock while removing them.
+    try {
+        removeNotOpened(notOpened);
+    } catch (...) {
+        _finishRemoving(notOpened);
+        throw;
+    }
+    _finishRemoving(notOpened);
+    for (const Key &key : opened) {
+        remove(key);
     }
 };
 
+template<class Resource, class ResourceRef, class Key>
+void ParallelAccessStore<Resource, ResourceRef, Key>::_waitUntilNotLoadingOrRemoving(std::unique_lock<std::mutex> *lock, const Key &key) {
+  ASSERT(lock->owns_lock(), "Given lock must be locked");
+  _loadingOrRemovingFinished.wait(*lock, [this, &key] {
+    return _keysBeingLoaded.count(key) == 0 && _keysBeingRemoved.count(key) == 0;
+  });
+}
+
+template<class Resource, class ResourceRef, class Key>
+void ParallelAccessStore<Resource, ResourceRef, Key>::_finishLoading(const Key &key) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _keysBeingLoaded.erase(key);
+  _loadingOrRemovingFinished.notify_all();
+}
+
+template<class Resource, class ResourceRef, class Key>
+void ParallelAccessStore<Resource, ResourceRef, Key>::_finishRemoving(const std::vector<Key> &keys) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (const Key &key : keys) {
+    auto found = _keysBeingRemoved.find(key);
+    ASSERT(found != _keysBeingRemoved.end(), "Key wasn't marked as being removed");
+    _keysBeingRemoved.erase(found);
+  }
+  _loadingOrRemovingFinished.notify_all();
+}
+
 template<class Resource, class ResourceRef, class Key>
 void ParallelAccessStore<Resource, ResourceRef, Key>::release(const Key &key) {
   std::lock_guard<std::mutex> lock(_mutex);
@@ -239,6 +361,8 @@ void ParallelAccessStore<Resource, ResourceRef, Key>::release(const Key &key) {
   if (found->second.refCountIsZero()) {
 	  auto foundToRemove = _resourcesToRemove.find(key);
 	  if (foundToRemove != _resourcesToRemove.end()) {
+	    // Mark it while still holding the lock, so it can't be loaded again before the remover removed it
+	    _keysBeingRemoved.insert(key);
 	    foundToRemove->second.set_value(found->second.moveResourceOut());
 	  }
 	  _openResources.erase(found);
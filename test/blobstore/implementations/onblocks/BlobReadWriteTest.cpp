@@ -149,6 +149,29 @@ TEST_F(BlobReadWriteTest, givenBlobResizedToZero_whenWriteZeroBytes_thenDoesntGr
   EXPECT_EQ(0, blob->size());
 }
 
+TEST_F(BlobReadWriteTest, givenEmptyBlob_whenPrefetch_thenDoesntGrow) {
+  blob->prefetch(0, 5);
+  blob->prefetch(LAYOUT.maxBytesPerLeaf() * 3, 5);
+  EXPECT_EQ(0, blob->size());
+}
+
+TEST_F(BlobReadWriteTest, givenLargeBlob_whenPrefetch_thenReadsCorrectData) {
+  blob->resize(LARGE_SIZE);
+  blob->write(randomData.data(), 0, LARGE_SIZE);
+  auto loaded = loadBlob(blob->blockId());
+  loaded->prefetch(LAYOUT.maxBytesPerLeaf() / 2, LAYOUT.maxBytesPerLeaf() * 10);
+  EXPECT_DATA_READS_AS(randomData, *loaded, 0, LARGE_SIZE);
+}
+
+TEST_F(BlobReadWriteTest, givenBlob_whenPrefetchPastEnd_thenDoesntGrow) {
+  blob->resize(LAYOUT.maxBytesPerLeaf() * 2);
+  blob->write(randomData.data(), 0, LAYOUT.maxBytesPerLeaf() * 2);
+  blob->prefetch(LAYOUT.maxBytesPerLeaf(), LAYOUT.maxBytesPerLeaf() * 5);
+  blob->prefetch(LAYOUT.maxBytesPerLeaf() * 3, LAYOUT.maxBytesPerLeaf());
+  EXPECT_EQ(LAYOUT.maxBytesPerLeaf() * 2, blob->size());
+  EXPECT_DATA_READS_AS(randomData, *blob, 0, LAYOUT.maxBytesPerLeaf() * 2);
+}
+
 struct DataRange {
   uint64_t blobsize;
   uint64_t offset;
@@ -108,6 +108,38 @@ TEST_F(DataNodeStoreTest, NodeIsNotLoadableAfterDeleting) {
   EXPECT_EQ(none, nodeStore->load(nodekey));
 }
 
+TEST_F(DataNodeStoreTest, LoadManyWithoutNodes) {
+  auto loaded = nodeStore->loadMany({});
+  EXPECT_EQ(0u, loaded.size());
+}
+
+TEST_F(DataNodeStoreTest, LoadManyReturnsNodesInGivenOrder) {
+  std::vector<BlockId> blockIds;
+  for (uint8_t i = 0; i < 20; ++i) {
+    blockIds.push_back(nodeStore->createNewLeafNode(Data(i))->blockId());
+  }
+
+  auto loaded = nodeStore->loadMany(blockIds);
+
+  ASSERT_EQ(blockIds.size(), loaded.size());
+  for (size_t i = 0; i < blockIds.size(); ++i) {
+    EXPECT_EQ(blockIds[i], loaded[i].value()->blockId());
+    EXPECT_EQ(i, dynamic_cast<DataLeafNode*>(loaded[i].value().get())->numBytes());
+  }
+}
+
+TEST_F(DataNodeStoreTest, LoadManyReturnsNoneForNonexistingNodes) {
+  BlockId existing = nodeStore->createNewLeafNode(Data(0))->blockId();
+  BlockId nonexisting = BlockId::FromString("1491BB4932A389EE14BC7090AC772972");
+
+  auto loaded = nodeStore->loadMany({existing, nonexisting, existing});
+
+  ASSERT_EQ(3u, loaded.size());
+  EXPECT_NE(none, loaded[0]);
+  EXPECT_EQ(none, loaded[1]);
+  EXPECT_NE(none, loaded[2]);
+}
+
 TEST_F(DataNodeStoreTest, NumNodesIsCorrectOnEmptyNodestore) {
   EXPECT_EQ(0u, nodeStore->numNodes());
 }
@@ -0,0 +1,87 @@
+#include "testutils/DataTreeTest.h"
+#include <cpp-utils/data/DataFixture.h>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using blobstore::onblocks::datatreestore::DataTree;
+using cpputils::Data;
+using cpputils::DataFixture;
+using cpputils::unique_ref;
+
+class DataTreeTest_ParallelWrites: public DataTreeTest {
+public:
+  static constexpr size_t NUM_THREADS = 8;
+  static constexpr uint64_t BYTES_PER_THREAD = 5000; // Not a multiple of the leaf size, so threads share border leaves
+
+  unique_ref<DataTree> CreateTreeWithSize(uint64_t size) {
+    auto tree = treeStore.createNewTree();
+    tree->resizeNumBytes(size);
+    return tree;
+  }
+
+  template<class Func>
+  void runInParallel(Func func) {
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < NUM_THREADS; ++thread) {
+      threads.emplace_back(func, thread);
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+};
+
+constexpr size_t DataTreeTest_ParallelWrites::NUM_THREADS;
+constexpr uint64_t DataTreeTest_ParallelWrites::BYTES_PER_THREAD;
+
+TEST_F(DataTreeTest_ParallelWrites, OverwritingDifferentRegions) {
+  auto tree = CreateTreeWithSize(NUM_THREADS * BYTES_PER_THREAD);
+  const Data data = DataFixture::generate(NUM_THREADS * BYTES_PER_THREAD);
+
+  runInParallel([&] (size_t thread) {
+    for (uint64_t offset = 0; offset < BYTES_PER_THREAD; offset += 100) {
+      const uint64_t treeOffset = thread * BYTES_PER_THREAD + offset;
+      tree->writeBytes(data.dataOffset(treeOffset), treeOffset, 100);
+    }
+  });
+
+  EXPECT_EQ(NUM_THREADS * BYTES_PER_THREAD, tree->numBytes());
+  EXPECT_EQ(data, tree->readAllBytes());
+}
+
+TEST_F(DataTreeTest_ParallelWrites, GrowingAndOverwriting) {
+  // Half of the threads overwrite existing data, the other half append, so both kinds of writes run concurrently
+  auto tree = CreateTreeWithSize(NUM_THREADS / 2 * BYTES_PER_THREAD);
+  const Data data = DataFixture::generate(NUM_THREADS * BYTES_PER_THREAD);
+
+  runInParallel([&] (size_t thread) {
+    for (uint64_t offset = 0; offset < BYTES_PER_THREAD; offset += 100) {
+      const uint64_t treeOffset = thread * BYTES_PER_THREAD + offset;
+      tree->writeBytes(data.dataOffset(treeOffset), treeOffset, 100);
+    }
+  });
+
+  EXPECT_EQ(NUM_THREADS * BYTES_PER_THREAD, tree->numBytes());
+  EXPECT_EQ(data, tree->readAllBytes());
+}
+
+TEST_F(DataTreeTest_ParallelWrites, ReadingWhileOverwriting) {
+  auto tree = CreateTreeWithSize(NUM_THREADS * BYTES_PER_THREAD);
+  const Data data = DataFixture::generate(NUM_THREADS * BYTES_PER_THREAD);
+  tree->writeBytes(data.data(), 0, data.size());
+
+  // Writers write the same data again, so readers must always see it, no matter how reads and writes interleave
+  runInParallel([&] (size_t thread) {
+    Data read(100);
+    for (uint64_t offset = 0; offset < BYTES_PER_THREAD; offset += 100) {
+      const uint64_t treeOffset = thread * BYTES_PER_THREAD + offset;
+      if (thread % 2 == 0) {
+        tree->writeBytes(data.dataOffset(treeOffset), treeOffset, 100);
+      } else {
+        tree->readBytes(read.data(), treeOffset, 100);
+        EXPECT_EQ(0, std::memcmp(data.dataOffset(treeOffset), read.data(), 100));
+      }
+    }
+  });
+}
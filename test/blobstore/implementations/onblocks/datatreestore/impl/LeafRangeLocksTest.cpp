@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include "blobstore/implementations/onblocks/datatreestore/impl/LeafRangeLocks.h"
+#include <boost/optional.hpp>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+using blobstore::onblocks::datatreestore::LeafRangeLocks;
+
+class LeafRangeLocksTest : public ::testing::Test {
+public:
+  LeafRangeLocks locks;
+
+  // Returns true if the given function finishes while the lock held by the caller is still held
+  template<class LockFunc>
+  bool finishesWhileLocked(LockFunc lockFunc) {
+    std::atomic<bool> finished(false);
+    std::thread thread([&] {
+      auto lock = lockFunc();
+      finished = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    bool result = finished;
+    _releaseAndJoin(&thread);
+    return result;
+  }
+
+  void setReleaseCallback(std::function<void ()> release) {
+    _release = std::move(release);
+  }
+
+private:
+  void _releaseAndJoin(std::thread *thread) {
+    _release();
+    thread->join();
+  }
+
+  std::function<void ()> _release;
+};
+
+TEST_F(LeafRangeLocksTest, SharedLocksOnSameRangeDontBlock) {
+  auto lock = boost::make_optional(locks.lockShared(0, 10));
+  setReleaseCallback([&] {lock = boost::none;});
+  EXPECT_TRUE(finishesWhileLocked([this] {return locks.lockShared(0, 10);}));
+}
+
+TEST_F(LeafRangeLocksTest, ExclusiveLocksOnDifferentRangesDontBlock) {
+  auto lock = boost::make_optional(locks.lockExclusive(0, 10));
+  setReleaseCallback([&] {lock = boost::none;});
+  EXPECT_TRUE(finishesWhileLocked([this] {return locks.lockExclusive(10, 20);}));
+}
+
+TEST_F(LeafRangeLocksTest, ExclusiveLockBlocksOverlappingExclusiveLock) {
+  auto lock = boost::make_optional(locks.lockExclusive(0, 10));
+  setReleaseCallback([&] {lock = boost::none;});
+  EXPECT_FALSE(finishesWhileLocked([this] {return locks.lockExclusive(9, 20);}));
+}
+
+TEST_F(LeafRangeLocksTest, ExclusiveLockBlocksOverlappingSharedLock) {
+  auto lock = boost::make_optional(locks.lockExclusive(5, 10));
+  setReleaseCallback([&] {lock = boost::none;});
+  EXPECT_FALSE(finishesWhileLocked([this] {return locks.lockShared(0, 6);}));
+}
+
+TEST_F(LeafRangeLocksTest, SharedLockBlocksOverlappingExclusiveLock) {
+  auto lock = boost::make_optional(locks.lockShared(0, 10));
+  setReleaseCallback([&] {lock = boost::none;});
+  EXPECT_FALSE(finishesWhileLocked([this] {return locks.lockExclusive(3, 4);}));
+}
+
+TEST_F(LeafRangeLocksTest, EmptyRangeDoesntBlock) {
+  auto lock = boost::make_optional(locks.lockExclusive(0, 10));
+  setReleaseCallback([&] {lock = boost::none;});
+  EXPECT_TRUE(finishesWhileLocked([this] {return locks.lockExclusive(5, 5);}));
+}
+
+TEST_F(LeafRangeLocksTest, MovedLockIsReleasedOnce) {
+  {
+    auto lock = locks.lockExclusive(0, 10);
+    auto movedLock = std::move(lock);
+  }
+  auto lock = locks.lockExclusive(0, 10);
+}
@@ -35,3 +35,6 @@ public:
 };
 
 INSTANTIATE_TYPED_TEST_SUITE_P(Caching, BlockStore2Test, CachingBlockStore2TestFixture);
+INSTANTIATE_TYPED_TEST_SUITE_P(Caching, BlockStore2RemoveManyTest, CachingBlockStore2TestFixture);
+INSTANTIATE_TYPED_TEST_SUITE_P(Caching, BlockStore2StoreManyTest, CachingBlockStore2TestFixture);
+INSTANTIATE_TYPED_TEST_SUITE_P(Caching, BlockStore2LoadSharedTest, CachingBlockStore2TestFixture);
@@ -1,12 +1,23 @@
 #include <gtest/gtest.h>
 #include "blockstore/implementations/caching/CachingBlockStore2.h"
 #include "blockstore/implementations/inmemory/InMemoryBlockStore2.h"
+#include "blockstore/implementations/low2highlevel/LowToHighLevelBlockStore.h"
+#include <cpp-utils/data/DataFixture.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <unordered_set>
 
 using ::testing::Test;
 
 using cpputils::Data;
+using cpputils::DataFixture;
+using cpputils::make_unique_ref;
+using std::shared_ptr;
 
 using blockstore::inmemory::InMemoryBlockStore2;
+using blockstore::lowtohighlevel::LowToHighLevelBlockStore;
 
 using namespace blockstore::caching;
 
@@ -51,4 +62,415 @@ TEST_F(CachingBlockStore2Test, PhysicalBlockSize_positive) {
   EXPECT_EQ(10*1024u, blockStore.blockSizeFromPhysicalBlockSize(base.size()));
 }
 
+TEST_F(CachingBlockStore2Test, givenCachedBlock_whenLoadingShared_thenDataIsNotCopied) {
+  auto blockId = blockStore.create(DataFixture::generate(1024));
+  shared_ptr<const Data> loaded1 = blockStore.loadShared(blockId).value();
+  shared_ptr<const Data> loaded2 = blockStore.loadShared(blockId).value();
+  EXPECT_EQ(loaded1.get(), loaded2.get());
+}
+
+TEST_F(CachingBlockStore2Test, givenCachedBlock_whenLoadingShared_thenCountsAsHit) {
+  auto blockId = blockStore.create(DataFixture::generate(1024));
+  const uint64_t hitsBefore = blockStore.cacheStatistics().hits;
+  EXPECT_NE(boost::none, blockStore.loadShared(blockId));
+  EXPECT_EQ(hitsBefore + 1, blockStore.cacheStatistics().hits);
+}
+
+TEST_F(CachingBlockStore2Test, givenBlockOnlyInBaseStore_whenLoadingShared_thenIsCachedAfterwards) {
+  auto blockId = baseBlockStore->create(DataFixture::generate(1024));
+  shared_ptr<const Data> loaded1 = blockStore.loadShared(blockId).value();
+  shared_ptr<const Data> loaded2 = blockStore.loadShared(blockId).value();
+  EXPECT_EQ(loaded1.get(), loaded2.get());
+  EXPECT_EQ(DataFixture::generate(1024), *loaded2);
+}
+
+TEST_F(CachingBlockStore2Test, givenSharedData_whenEvicted_thenSharedDataIsUnchanged) {
+  auto blockId = blockStore.create(DataFixture::generate(1024));
+  shared_ptr<const Data> loaded = blockStore.loadShared(blockId).value();
+  blockStore.flush();
+  EXPECT_EQ(DataFixture::generate(1024), *loaded);
+  EXPECT_EQ(DataFixture::generate(1024), baseBlockStore->load(blockId).value());
+}
+
+TEST_F(CachingBlockStore2Test, givenLoadedHighLevelBlock_whenWriting_thenCachedDataOnlyChangesOnFlush) {
+  auto cachingBlockStore = make_unique_ref<CachingBlockStore2>(make_unique_ref<InMemoryBlockStore2>());
+  CachingBlockStore2 *cachingBlockStorePtr = cachingBlockStore.get();
+  LowToHighLevelBlockStore highLevelBlockStore(std::move(cachingBlockStore));
+  auto blockId = highLevelBlockStore.create(DataFixture::generate(1024))->blockId();
+  auto block = highLevelBlockStore.load(blockId).value();
+  shared_ptr<const Data> sharedBeforeWrite = cachingBlockStorePtr->loadShared(blockId).value();
+
+  Data written = DataFixture::generate(16, 1);
+  block->write(written.data(), 0, written.size());
+  EXPECT_EQ(0, std::memcmp(written.data(), block->data(), written.size()));
+  EXPECT_EQ(DataFixture::generate(1024), *sharedBeforeWrite);
+  EXPECT_EQ(DataFixture::generate(1024), *cachingBlockStorePtr->loadShared(blockId).value());
+
+  block->flush();
+  EXPECT_EQ(0, std::memcmp(written.data(), cachingBlockStorePtr->loadShared(blockId).value()->data(), written.size()));
+  EXPECT_EQ(DataFixture::generate(1024), *sharedBeforeWrite);
+}
+
+TEST_F(CachingBlockStore2Test, givenUncachedBlock_whenStoring_thenIsOnlyWrittenToBaseStoreOnWriteBack) {
+  auto blockId = baseBlockStore->create(DataFixture::generate(1024));
+  blockStore.store(blockId, DataFixture::generate(1024, 1));
+  EXPECT_EQ(DataFixture::generate(1024), baseBlockStore->load(blockId).value());
+  blockStore.writeBack();
+  EXPECT_EQ(DataFixture::generate(1024, 1), baseBlockStore->load(blockId).value());
+}
+
+TEST_F(CachingBlockStore2Test, givenDirtyBlock_whenWritingBack_thenStaysCached) {
+  auto blockId = blockStore.create(DataFixture::generate(1024));
+  blockStore.writeBack();
+  EXPECT_EQ(DataFixture::generate(1024), baseBlockStore->load(blockId).value());
+  const uint64_t hitsBefore = blockStore.cacheStatistics().hits;
+  EXPECT_EQ(DataFixture::generate(1024), blockStore.load(blockId).value());
+  EXPECT_EQ(hitsBefore + 1, blockStore.cacheStatistics().hits);
+}
+
+TEST_F(CachingBlockStore2Test, givenDirtyBlock_whenStoringSeveralTimes_thenOnlyWritesLastVersion) {
+  auto blockId = blockStore.create(DataFixture::generate(1024));
+  for (int i = 1; i <= 10; ++i) {
+    blockStore.store(blockId, DataFixture::generate(1024, i));
+  }
+  EXPECT_EQ(0u, baseBlockStore->numBlocks());
+  blockStore.flush();
+  EXPECT_EQ(DataFixture::generate(1024, 10), baseBlockStore->load(blockId).value());
+}
+
+TEST_F(CachingBlockStore2Test, givenCreatedBlock_whenRemovingBeforeWriteBack_thenNeverReachesBaseStore) {
+  auto blockId = blockStore.create(DataFixture::generate(1024));
+  EXPECT_TRUE(blockStore.remove(blockId));
+  blockStore.flush();
+  EXPECT_EQ(0u, baseBlockStore->numBlocks());
+  EXPECT_EQ(boost::none, blockStore.load(blockId));
+}
+
+TEST_F(CachingBlockStore2Test, givenBlockInBaseStore_whenRemoving_thenIsOnlyRemovedFromBaseStoreOnWriteBack) {
+  auto blockId = baseBlockStore->create(DataFixture::generate(1024));
+  EXPECT_NE(boost::none, blockStore.load(blockId));
+  EXPECT_TRUE(blockStore.remove(blockId));
+  EXPECT_NE(boost::none, baseBlockStore->load(blockId));
+  EXPECT_EQ(boost::none, blockStore.load(blockId));
+  EXPECT_FALSE(blockStore.remove(blockId));
+  blockStore.writeBack();
+  EXPECT_EQ(boost::none, baseBlockStore->load(blockId));
+}
+
+TEST_F(CachingBlockStore2Test, givenRemovedBlock_whenCreatingItAgain_thenHasNewData) {
+  auto blockId = baseBlockStore->create(DataFixture::generate(1024));
+  EXPECT_NE(boost::none, blockStore.load(blockId));
+  EXPECT_TRUE(blockStore.remove(blockId));
+  EXPECT_TRUE(blockStore.tryCreate(blockId, DataFixture::generate(1024, 1)));
+  EXPECT_EQ(DataFixture::generate(1024, 1), blockStore.load(blockId).value());
+  blockStore.flush();
+  EXPECT_EQ(DataFixture::generate(1024, 1), baseBlockStore->load(blockId).value());
+}
+
+TEST_F(CachingBlockStore2Test, givenPendingWrites_whenCountingBlocks_thenCountsThem) {
+  auto removedBlockId = baseBlockStore->create(DataFixture::generate(1024));
+  auto storedBlockId = baseBlockStore->create(DataFixture::generate(1024));
+  EXPECT_NE(boost::none, blockStore.load(removedBlockId));
+  EXPECT_TRUE(blockStore.remove(removedBlockId));
+  blockStore.store(storedBlockId, DataFixture::generate(1024, 1));
+  blockStore.create(DataFixture::generate(1024, 2));
+  EXPECT_EQ(2u, blockStore.numBlocks());
+}
+
+TEST_F(CachingBlockStore2Test, givenPendingWrites_whenCountingAndListingBlocks_thenDoesntWriteThemBack) {
+  auto removedBlockId = baseBlockStore->create(DataFixture::generate(1024));
+  auto storedBlockId = baseBlockStore->create(DataFixture::generate(1024));
+  auto newBlockId = blockStore.createBlockId();
+  EXPECT_NE(boost::none, blockStore.load(removedBlockId));
+  EXPECT_TRUE(blockStore.remove(removedBlockId));
+  blockStore.store(storedBlockId, DataFixture::generate(1024, 1));
+  blockStore.store(newBlockId, DataFixture::generate(1024, 2));
+  auto createdBlockId = blockStore.create(DataFixture::generate(1024, 3));
+
+  EXPECT_EQ(3u, blockStore.numBlocks());
+  std::unordered_set<blockstore::BlockId> listed;
+  blockStore.forEachBlock([&listed] (const blockstore::BlockId &blockId) {EXPECT_TRUE(listed.insert(blockId).second);});
+  EXPECT_EQ((std::unordered_set<blockstore::BlockId>{storedBlockId, newBlockId, createdBlockId}), listed);
+
+  EXPECT_EQ(2u, baseBlockStore->numBlocks());
+  EXPECT_NE(boost::none, baseBlockStore->load(removedBlockId));
+  EXPECT_EQ(DataFixture::generate(1024), baseBlockStore->load(storedBlockId).value());
+}
+
+TEST_F(CachingBlockStore2Test, givenDirtyBlock_whenMaxDirtyAgePassed_thenIsWrittenBackAndStaysCached) {
+  auto base = make_unique_ref<InMemoryBlockStore2>();
+  InMemoryBlockStore2 *basePtr = base.get();
+  CachingBlockStore2 store(std::move(base), CachingBlockStore2::DEFAULT_MAX_CACHE_SIZE_BYTES, 0.05);
+  auto blockId = store.create(DataFixture::generate(1024));
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  EXPECT_EQ(DataFixture::generate(1024), basePtr->load(blockId).value());
+  EXPECT_EQ(0u, store.cacheStatistics().evictions);
+}
+
+TEST_F(CachingBlockStore2Test, givenCleanBlock_whenNotAccessedForAWhile_thenStaysCached) {
+  auto blockId = baseBlockStore->create(DataFixture::generate(1024));
+  EXPECT_NE(boost::none, blockStore.load(blockId));
+  std::this_thread::sleep_for(std::chrono::seconds(2));
+  const uint64_t hitsBefore = blockStore.cacheStatistics().hits;
+  EXPECT_EQ(DataFixture::generate(1024), blockStore.load(blockId).value());
+  EXPECT_EQ(hitsBefore + 1, blockStore.cacheStatistics().hits);
+  EXPECT_EQ(0u, blockStore.cacheStatistics().evictions);
+}
+
+TEST_F(CachingBlockStore2Test, givenManyDirtyBlocks_whenExceedingMaxDirtyBytes_thenWritesBackOldestWithoutEvicting) {
+  auto base = make_unique_ref<InMemoryBlockStore2>();
+  InMemoryBlockStore2 *basePtr = base.get();
+  CachingBlockStore2 store(std::move(base), 4 * 1024 * 1024);
+  std::vector<blockstore::BlockId> blockIds;
+  for (int i = 0; i < 30; ++i) {
+    blockIds.push_back(store.create(DataFixture::generate(100 * 1024, i)));
+  }
+  EXPECT_LT(0u, basePtr->numBlocks());
+  EXPECT_NE(boost::none, basePtr->load(blockIds[0]));
+  EXPECT_EQ(boost::none, basePtr->load(blockIds.back()));
+  EXPECT_EQ(0u, store.cacheStatistics().evictions);
+}
+
+namespace {
+// Base store whose writes take a while, so tests can call into the caching store while a write back is in progress
+class SlowWritingBlockStore2 final: public blockstore::BlockStore2 {
+public:
+  SlowWritingBlockStore2(): _baseBlockStore(), _writeStarted(), _writeStartedSet(false) {}
+
+  std::future<void> writeStarted() {
+    return _writeStarted.get_future();
+  }
+
+  bool tryCreate(const blockstore::BlockId &blockId, const Data &data) override {
+    return _baseBlockStore.tryCreate(blockId, data);
+  }
+  bool remove(const blockstore::BlockId &blockId) override {
+    return _baseBlockStore.remove(blockId);
+  }
+  boost::optional<Data> load(const blockstore::BlockId &blockId) const override {
+    return _baseBlockStore.load(blockId);
+  }
+  void store(const blockstore::BlockId &blockId, const Data &data) override {
+    if (!_writeStartedSet.exchange(true)) {
+      _writeStarted.set_value();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    _baseBlockStore.store(blockId, data);
+  }
+  uint64_t numBlocks() const override {
+    return _baseBlockStore.numBlocks();
+  }
+  uint64_t estimateNumFreeBytes() const override {
+    return _baseBlockStore.estimateNumFreeBytes();
+  }
+  uint64_t blockSizeFromPhysicalBlockSize(uint64_t blockSize) const override {
+    return _baseBlockStore.blockSizeFromPhysicalBlockSize(blockSize);
+  }
+  void forEachBlock(std::function<void (const blockstore::BlockId &)> callback) const override {
+    _baseBlockStore.forEachBlock(std::move(callback));
+  }
+
+private:
+  InMemoryBlockStore2 _baseBlockStore;
+  std::promise<void> _writeStarted;
+  std::atomic<bool> _writeStartedSet;
+};
+}
+
+TEST_F(CachingBlockStore2Test, givenBlockBeingWrittenBackByTimer_whenWritingBack_thenWaitsUntilItIsInBaseStore) {
+  auto base = make_unique_ref<SlowWritingBlockStore2>();
+  SlowWritingBlockStore2 *basePtr = base.get();
+  auto writeStarted = basePtr->writeStarted();
+  CachingBlockStore2 store(std::move(base), CachingBlockStore2::DEFAULT_MAX_CACHE_SIZE_BYTES, 0.05);
+  auto blockId = store.create(DataFixture::generate(1024));
+  // The timer is now writing it back. This is what fsync does concurrently.
+  writeStarted.wait();
+  store.writeBack();
+  EXPECT_EQ(DataFixture::generate(1024), basePtr->load(blockId).value());
+}
+
+namespace {
+// Base store whose storeMany() throws the first time, and whose store() always throws for one block
+class FailingBlockStore2 final: public blockstore::BlockStore2 {
+public:
+  explicit FailingBlockStore2(const blockstore::BlockId &failingBlockId)
+    : _baseBlockStore(), _failingBlockId(failingBlockId), _storeManyFailed(false) {}
+
+  bool tryCreate(const blockstore::BlockId &blockId, const Data &data) override {
+    return _baseBlockStore.tryCreate(blockId, data);
+  }
+  bool remove(const blockstore::BlockId &blockId) override {
+    return _baseBlockStore.remove(blockId);
+  }
+  boost::optional<Data> load(const blockstore::BlockId &blockId) const override {
+    return _baseBlockStore.load(blockId);
+  }
+  void store(const blockstore::BlockId &blockId, const Data &data) override {
+    if (blockId == _failingBlockId) {
+      throw std::runtime_error("Writing the block failed");
+    }
+    _baseBlockStore.store(blockId, data);
+  }
+  void storeMany(std::vector<std::pair<blockstore::BlockId, Data>> blocks) override {
+    if (!_storeManyFailed.exchange(true)) {
+      throw std::runtime_error("Writing the blocks failed");
+    }
+    blockstore::BlockStore2::storeMany(std::move(blocks));
+  }
+  uint64_t numBlocks() const override {
+    return _baseBlockStore.numBlocks();
+  }
+  uint64_t estimateNumFreeBytes() const override {
+    return _baseBlockStore.estimateNumFreeBytes();
+  }
+  uint64_t blockSizeFromPhysicalBlockSize(uint64_t blockSize) const override {
+    return _baseBlockStore.blockSizeFromPhysicalBlockSize(blockSize);
+  }
+  void forEachBlock(std::function<void (const blockstore::BlockId &)> callback) const override {
+    _baseBlockStore.forEachBlock(std::move(callback));
+  }
+
+private:
+  InMemoryBlockStore2 _baseBlockStore;
+  blockstore::BlockId _failingBlockId;
+  std::atomic<bool> _storeManyFailed;
+};
+}
+
+TEST_F(CachingBlockStore2Test, givenEvictedBlocks_whenWritingThemBackTogetherFails_thenWritesThemBackOneByOne) {
+  auto base = make_unique_ref<FailingBlockStore2>(blockstore::BlockId::Random());
+  FailingBlockStore2 *basePtr = base.get();
+  CachingBlockStore2 store(std::move(base));
+  auto blockId1 = store.create(DataFixture::generate(1024, 1));
+  auto blockId2 = store.create(DataFixture::generate(1024, 2));
+  store.flush();
+  EXPECT_EQ(DataFixture::generate(1024, 1), basePtr->load(blockId1).value());
+  EXPECT_EQ(DataFixture::generate(1024, 2), basePtr->load(blockId2).value());
+  EXPECT_EQ(2u, store.numBlocks());
+}
+
+TEST_F(CachingBlockStore2Test, givenEvictedBlocks_whenWritingOneOfThemBackFails_thenThrowsAndWritesBackTheOthers) {
+  auto failingBlockId = blockstore::BlockId::Random();
+  auto base = make_unique_ref<FailingBlockStore2>(failingBlockId);
+  FailingBlockStore2 *basePtr = base.get();
+  CachingBlockStore2 store(std::move(base));
+  auto blockId = store.create(DataFixture::generate(1024, 1));
+  store.store(failingBlockId, DataFixture::generate(1024, 2));
+  EXPECT_ANY_THROW(store.flush());
+  // The failed block isn't dirty anymore, so flushing again doesn't try to write it again.
+  // This also writes back the other block if it was in a part of the cache that the first flush didn't get to.
+  store.flush();
+  EXPECT_EQ(DataFixture::generate(1024, 1), basePtr->load(blockId).value());
+  EXPECT_EQ(boost::none, basePtr->load(failingBlockId));
+}
+
+namespace {
+// Base store whose removeMany() waits until the test lets it continue
+class BlockingRemovingBlockStore2 final: public blockstore::BlockStore2 {
+public:
+  BlockingRemovingBlockStore2(): _baseBlockStore(), _removeStarted(), _removeStartedSet(false), _continueRemoving(), _continueRemovingFuture(_continueRemoving.get_future()) {}
+
+  std::future<void> removeStarted() {
+    return _removeStarted.get_future();
+  }
+  void continueRemoving() {
+    _continueRemoving.set_value();
+  }
+
+  bool tryCreate(const blockstore::BlockId &blockId, const Data &data) override {
+    return _baseBlockStore.tryCreate(blockId, data);
+  }
+  bool remove(const blockstore::BlockId &blockId) override {
+    return _baseBlockStore.remove(blockId);
+  }
+  uint64_t removeMany(const std::vector<blockstore::BlockId> &blockIds) override {
+    if (!_removeStartedSet.exchange(true)) {
+      _removeStarted.set_value();
+    }
+    _continueRemovingFuture.wait();
+    return _baseBlockStore.removeMany(blockIds);
+  }
+  boost::optional<Data> load(const blockstore::BlockId &blockId) const override {
+    return _baseBlockStore.load(blockId);
+  }
+  void store(const blockstore::BlockId &blockId, const Data &data) override {
+    _baseBlockStore.store(blockId, data);
+  }
+  uint64_t numBlocks() const override {
+    return _baseBlockStore.numBlocks();
+  }
+  uint64_t estimateNumFreeBytes() const override {
+    return _baseBlockStore.estimateNumFreeBytes();
+  }
+  uint64_t blockSizeFromPhysicalBlockSize(uint64_t blockSize) const override {
+    return _baseBlockStore.blockSizeFromPhysicalBlockSize(blockSize);
+  }
+  void forEachBlock(std::function<void (const blockstore::BlockId &)> callback) const override {
+    _baseBlockStore.forEachBlock(std::move(callback));
+  }
+
+private:
+  InMemoryBlockStore2 _baseBlockStore;
+  std::promise<void> _removeStarted;
+  std::atomic<bool> _removeStartedSet;
+  std::promise<void> _continueRemoving;
+  std::shared_future<void> _continueRemovingFuture;
+};
+}
+
+TEST_F(CachingBlockStore2Test, givenPendingRemovalsBeingRemovedFromBaseStore_whenUsingOtherBlocks_thenDoesntWait) {
+  auto base = make_unique_ref<BlockingRemovingBlockStore2>();
+  BlockingRemovingBlockStore2 *basePtr = base.get();
+  auto removeStarted = basePtr->removeStarted();
+  CachingBlockStore2 store(std::move(base));
+  auto removedBlockId = basePtr->create(DataFixture::generate(1024));
+  auto otherBlockId = basePtr->create(DataFixture::generate(1024, 1));
+  EXPECT_NE(boost::none, store.load(removedBlockId));
+  EXPECT_TRUE(store.remove(removedBlockId));
+  auto writingBack = std::async(std::launch::async, [&store] {
+    store.writeBack();
+  });
+  removeStarted.wait();
+
+  // The base store is removing the block right now. Other blocks can be used in the meantime.
+  auto usingOtherBlocks = std::async(std::launch::async, [&] {
+    EXPECT_EQ(DataFixture::generate(1024, 1), store.load(otherBlockId).value());
+    store.store(otherBlockId, DataFixture::generate(1024, 2));
+    auto createdBlockId = store.create(DataFixture::generate(1024, 3));
+    EXPECT_TRUE(store.remove(createdBlockId));
+    // The block being removed is already gone
+    EXPECT_EQ(boost::none, store.load(removedBlockId));
+    EXPECT_FALSE(store.remove(removedBlockId));
+  });
+  EXPECT_EQ(std::future_status::ready, usingOtherBlocks.wait_for(std::chrono::seconds(5)));
+
+  basePtr->continueRemoving();
+  writingBack.get();
+  usingOtherBlocks.get();
+  EXPECT_EQ(boost::none, basePtr->load(removedBlockId));
+  EXPECT_EQ(1u, store.numBlocks());
+}
+
+TEST_F(CachingBlockStore2Test, givenBlockBeingRemovedFromBaseStore_whenCreatingItAgain_thenWaitsUntilRemoved) {
+  auto base = make_unique_ref<BlockingRemovingBlockStore2>();
+  BlockingRemovingBlockStore2 *basePtr = base.get();
+  auto removeStarted = basePtr->removeStarted();
+  CachingBlockStore2 store(std::move(base));
+  auto blockId = basePtr->create(DataFixture::generate(1024));
+  auto removing = std::async(std::launch::async, [&store, &blockId] {
+    // Not cached, so it's removed from the base store right away
+    EXPECT_TRUE(store.remove(blockId));
+  });
+  removeStarted.wait();
+  auto creating = std::async(std::launch::async, [&store, &blockId] {
+    EXPECT_TRUE(store.tryCreate(blockId, DataFixture::generate(1024, 1)));
+  });
+  EXPECT_EQ(std::future_status::timeout, creating.wait_for(std::chrono::milliseconds(100)));
+  basePtr->continueRemoving();
+  removing.get();
+  creating.get();
+  store.flush();
+  EXPECT_EQ(DataFixture::generate(1024, 1), basePtr->load(blockId).value());
+}
+
 // TODO Add test cases that flushing the block store doesn't destroy things (i.e. all test cases from BlockStoreTest, but with flushes inbetween)
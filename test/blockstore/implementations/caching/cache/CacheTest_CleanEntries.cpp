@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include "blockstore/implementations/caching/cache/Cache.h"
+#include <boost/optional/optional_io.hpp>
+#include <chrono>
+#include <thread>
+
+using namespace blockstore::caching;
+
+// Odd values are dirty, even values are clean
+class CacheTest_CleanEntries: public ::testing::Test {
+public:
+    static constexpr unsigned int MAX_ENTRIES = 100;
+    using CacheType = Cache<int, int, MAX_ENTRIES>;
+
+    CacheTest_CleanEntries(): cache("test", [] (const int &value) {return value % 2 == 1;}) {}
+
+    static void sleepSeconds(double seconds) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(1000 * seconds)));
+    }
+
+    CacheType cache;
+};
+
+constexpr unsigned int CacheTest_CleanEntries::MAX_ENTRIES;
+
+TEST_F(CacheTest_CleanEntries, whenDirtyEntryIsOld_thenPurgesIt) {
+    cache.push(1, 3);
+    sleepSeconds(CacheType::MAX_LIFETIME_SEC * 2);
+    EXPECT_EQ(boost::none, cache.pop(1));
+}
+
+TEST_F(CacheTest_CleanEntries, whenCleanEntryIsOlderThanDirtyLifetime_thenKeepsIt) {
+    cache.push(1, 2);
+    sleepSeconds(CacheType::MAX_LIFETIME_SEC * 2);
+    EXPECT_EQ(2, cache.pop(1).value());
+}
+
+TEST_F(CacheTest_CleanEntries, givenOldCleanEntry_whenDirtyEntriesAfterItAreOld_thenOnlyPurgesDirtyEntries) {
+    cache.push(1, 2);
+    cache.push(2, 3);
+    cache.push(3, 4);
+    sleepSeconds(CacheType::MAX_LIFETIME_SEC * 2);
+    EXPECT_EQ(2u, cache.size());
+    EXPECT_EQ(2, cache.pop(1).value());
+    EXPECT_EQ(boost::none, cache.pop(2));
+    EXPECT_EQ(4, cache.pop(3).value());
+}
+
+TEST_F(CacheTest_CleanEntries, whenCleanEntryIsOlderThanCleanLifetime_thenPurgesIt) {
+    cache.push(1, 2);
+    sleepSeconds(CacheType::MAX_CLEAN_LIFETIME_SEC + CacheType::PURGE_INTERVAL);
+    EXPECT_EQ(boost::none, cache.pop(1));
+}
+
+TEST_F(CacheTest_CleanEntries, whenFlushing_thenPurgesCleanEntries) {
+    cache.push(1, 2);
+    cache.push(2, 3);
+    cache.flush();
+    EXPECT_EQ(0u, cache.size());
+}
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include "blockstore/implementations/caching/cache/FrequencySketch.h"
+
+using blockstore::caching::FrequencySketch;
+
+class FrequencySketchTest: public ::testing::Test {
+public:
+  FrequencySketchTest(): sketch(1024) {}
+
+  FrequencySketch sketch;
+};
+
+TEST_F(FrequencySketchTest, givenEmptySketch_thenFrequencyIsZero) {
+  EXPECT_EQ(0u, sketch.frequency(5));
+}
+
+TEST_F(FrequencySketchTest, givenIncrementedOnce_thenFrequencyIsOne) {
+  sketch.increment(5);
+  EXPECT_EQ(1u, sketch.frequency(5));
+}
+
+TEST_F(FrequencySketchTest, givenIncrementedSeveralTimes_thenCountsThem) {
+  for (int i = 0; i < 5; ++i) {
+    sketch.increment(5);
+  }
+  sketch.increment(6);
+  EXPECT_EQ(5u, sketch.frequency(5));
+  EXPECT_EQ(1u, sketch.frequency(6));
+}
+
+TEST_F(FrequencySketchTest, givenIncrementedVeryOften_thenSaturates) {
+  for (int i = 0; i < 100; ++i) {
+    sketch.increment(5);
+  }
+  EXPECT_EQ(FrequencySketch::MAX_FREQUENCY, sketch.frequency(5));
+}
+
+TEST_F(FrequencySketchTest, givenManyOtherKeysIncremented_thenOldFrequenciesDecay) {
+  for (int i = 0; i < 8; ++i) {
+    sketch.increment(5);
+  }
+  // Enough increments of other keys to trigger halving the counters.
+  // Without halving, collisions with the other keys would only make the frequency larger.
+  for (uint64_t key = 1000; key < 1000 + 10 * 1024; ++key) {
+    sketch.increment(key);
+  }
+  EXPECT_GT(8u, sketch.frequency(5));
+}
+
+TEST_F(FrequencySketchTest, givenManyKeys_thenFrequentKeysStandOut) {
+  for (uint64_t key = 0; key < 1024; ++key) {
+    sketch.increment(key);
+  }
+  for (int i = 0; i < 5; ++i) {
+    sketch.increment(5000);
+  }
+  EXPECT_LE(5u, sketch.frequency(5000));
+  uint32_t numOverestimated = 0;
+  for (uint64_t key = 0; key < 1024; ++key) {
+    if (sketch.frequency(key) > 1) {
+      ++numOverestimated;
+    }
+  }
+  EXPECT_GT(100u, numOverestimated);
+}
+
+TEST_F(FrequencySketchTest, whenGrowing_thenKeepsFrequencies) {
+  sketch.increment(5);
+  sketch.increment(5);
+  sketch.increment(6);
+  sketch.ensureCapacity(1024 * 1024);
+  EXPECT_EQ(2u, sketch.frequency(5));
+  EXPECT_EQ(1u, sketch.frequency(6));
+  sketch.increment(5);
+  EXPECT_EQ(3u, sketch.frequency(5));
+}
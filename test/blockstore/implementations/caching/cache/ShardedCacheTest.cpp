@@ -0,0 +1,310 @@
+#include <gtest/gtest.h>
+#include "blockstore/implementations/caching/cache/ShardedCache.h"
+#include <cpp-utils/lock/ConditionBarrier.h>
+#include <boost/optional/optional_io.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <thread>
+
+using namespace blockstore::caching;
+using cpputils::ConditionBarrier;
+using std::vector;
+
+// Values are their own size in bytes
+class ShardedCacheTest: public ::testing::Test {
+public:
+  using CacheType = ShardedCache<int, int>;
+
+  ShardedCacheTest(): evictedMutex(), evictedBatches() {}
+
+  std::unique_ptr<CacheType> createCache(uint64_t maxSizeBytes, uint32_t numShards = 1) {
+    return std::make_unique<CacheType>(maxSizeBytes, [] (const int &value) -> uint64_t {
+      return value;
+    }, [this] (vector<int> evicted) {
+      std::unique_lock<std::mutex> lock(evictedMutex);
+      evictedBatches.push_back(std::move(evicted));
+    }, numShards);
+  }
+
+  vector<int> allEvicted() {
+    std::unique_lock<std::mutex> lock(evictedMutex);
+    vector<int> result;
+    for (const auto &batch : evictedBatches) {
+      result.insert(result.end(), batch.begin(), batch.end());
+    }
+    return result;
+  }
+
+  // Pops the entry and pushes it back, like CachingBlockStore2 does when loading a block
+  void access(CacheType *cache, int key, int value) {
+    cache->pop(key);
+    cache->push(key, value);
+  }
+
+  std::mutex evictedMutex;
+  vector<vector<int>> evictedBatches;
+};
+
+TEST_F(ShardedCacheTest, givenEmptyCache_whenPopping_thenReturnsNone) {
+  auto cache = createCache(1000);
+  EXPECT_EQ(boost::none, cache->pop(1));
+}
+
+TEST_F(ShardedCacheTest, whenPushingAndPopping_thenReturnsValue) {
+  auto cache = createCache(1000);
+  cache->push(1, 10);
+  EXPECT_EQ(10, cache->pop(1).value());
+  EXPECT_EQ(boost::none, cache->pop(1));
+}
+
+TEST_F(ShardedCacheTest, whenPopping_thenReturnsValuePushedLast) {
+  auto cache = createCache(1000);
+  cache->push(1, 10);
+  cache->pop(1);
+  cache->push(1, 20);
+  EXPECT_EQ(20, cache->pop(1).value());
+}
+
+TEST_F(ShardedCacheTest, countsEntriesAndBytes) {
+  auto cache = createCache(1000);
+  cache->push(1, 10);
+  cache->push(2, 20);
+  EXPECT_EQ(2u, cache->size());
+  EXPECT_EQ(30u, cache->sizeBytes());
+  cache->pop(1);
+  EXPECT_EQ(1u, cache->size());
+  EXPECT_EQ(20u, cache->sizeBytes());
+}
+
+TEST_F(ShardedCacheTest, whenPushingMoreThanMaxSize_thenStaysWithinMaxSize) {
+  auto cache = createCache(1000);
+  for (int i = 0; i < 100; ++i) {
+    cache->push(i, 50);
+    EXPECT_GE(1000u, cache->sizeBytes());
+  }
+  EXPECT_EQ(100u, cache->size() + allEvicted().size());
+}
+
+TEST_F(ShardedCacheTest, whenPushingEntryLargerThanCache_thenEvictsIt) {
+  auto cache = createCache(1000);
+  cache->push(1, 2000);
+  EXPECT_EQ(vector<int>({2000}), allEvicted());
+  EXPECT_EQ(0u, cache->size());
+  EXPECT_EQ(boost::none, cache->pop(1));
+}
+
+TEST_F(ShardedCacheTest, givenFullCache_whenPushingManyNewEntries_thenEvictsSeveralAtOnce) {
+  auto cache = createCache(6400);
+  for (int key = 0; key < 20000; ++key) {
+    cache->push(key, 1);
+  }
+  size_t largestBatch = 0;
+  for (const auto &batch : evictedBatches) {
+    largestBatch = std::max(largestBatch, batch.size());
+  }
+  EXPECT_LT(10u, largestBatch);
+}
+
+TEST_F(ShardedCacheTest, givenFrequentlyUsedEntries_whenScanningManyOtherEntries_thenKeepsFrequentlyUsedEntries) {
+  auto cache = createCache(100);
+  for (int round = 0; round < 10; ++round) {
+    for (int key = 0; key < 20; ++key) {
+      access(cache.get(), key, 1);
+    }
+  }
+  // A plain LRU or FIFO cache would evict all entries from above while scanning these
+  for (int key = 1000; key < 2000; ++key) {
+    access(cache.get(), key, 1);
+  }
+  for (int key = 0; key < 20; ++key) {
+    EXPECT_NE(boost::none, cache->pop(key)) << "key " << key;
+  }
+}
+
+TEST_F(ShardedCacheTest, givenRecentlyUsedEntries_whenAccessingThemMoreOftenThanOldOnes_thenReplacesOldOnes) {
+  auto cache = createCache(100);
+  for (int key = 0; key < 90; ++key) {
+    access(cache.get(), key, 1);
+  }
+  for (int round = 0; round < 5; ++round) {
+    for (int key = 1000; key < 1090; ++key) {
+      access(cache.get(), key, 1);
+    }
+  }
+  uint32_t numNewEntriesInCache = 0;
+  for (int key = 1000; key < 1090; ++key) {
+    if (cache->pop(key) != boost::none) {
+      ++numNewEntriesInCache;
+    }
+  }
+  EXPECT_LT(80u, numNewEntriesInCache);
+}
+
+TEST_F(ShardedCacheTest, countsHitsMissesAndEvictions) {
+  auto cache = createCache(100);
+  cache->pop(1);
+  cache->push(1, 10);
+  cache->pop(1);
+  cache->pop(2);
+  cache->push(1, 10);
+  cache->push(2, 200);
+  CacheStatistics statistics = cache->statistics();
+  EXPECT_EQ(1u, statistics.hits);
+  EXPECT_EQ(2u, statistics.misses);
+  EXPECT_EQ(1u, statistics.evictions);
+}
+
+TEST_F(ShardedCacheTest, whenFlushing_thenEvictsAllEntriesInBatches) {
+  auto cache = createCache(100000);
+  for (int key = 0; key < 200; ++key) {
+    cache->push(key, 1);
+  }
+  cache->flush();
+  EXPECT_EQ(0u, cache->size());
+  EXPECT_EQ(0u, cache->sizeBytes());
+  EXPECT_EQ(200u, allEvicted().size());
+  for (const auto &batch : evictedBatches) {
+    EXPECT_GE(CacheType::Shard::EVICTION_BATCH_SIZE, batch.size());
+  }
+  EXPECT_EQ(200u, cache->statistics().evictions);
+}
+
+TEST_F(ShardedCacheTest, whenDestructing_thenEvictsAllEntries) {
+  auto cache = createCache(100000, 4);
+  for (int key = 0; key < 200; ++key) {
+    cache->push(key, 1);
+  }
+  cache.reset();
+  EXPECT_EQ(200u, allEvicted().size());
+}
+
+TEST_F(ShardedCacheTest, givenSeveralShards_thenDistributesEntries) {
+  auto cache = createCache(4000, 4);
+  EXPECT_EQ(4u, cache->numShards());
+  for (int key = 0; key < 100; ++key) {
+    cache->push(key, 1);
+  }
+  EXPECT_EQ(100u, cache->size());
+  for (int key = 0; key < 100; ++key) {
+    EXPECT_EQ(1, cache->pop(key).value());
+  }
+}
+
+TEST_F(ShardedCacheTest, whenEntriesAreOld_thenKeepsThem) {
+  auto cache = createCache(1000);
+  cache->push(1, 2);
+  std::this_thread::sleep_for(std::chrono::seconds(2));
+  EXPECT_EQ(vector<int>(), allEvicted());
+  EXPECT_EQ(2, cache->pop(1).value());
+}
+
+TEST_F(ShardedCacheTest, whenRemoving_thenReturnsValueWithoutCountingAsAccess) {
+  auto cache = createCache(1000);
+  cache->push(1, 10);
+  EXPECT_EQ(10, cache->remove(1).value());
+  EXPECT_EQ(0u, cache->size());
+  EXPECT_EQ(0u, cache->sizeBytes());
+  EXPECT_EQ(0u, cache->statistics().hits);
+  EXPECT_EQ(boost::none, cache->remove(1));
+  EXPECT_EQ(boost::none, cache->pop(1));
+}
+
+TEST_F(ShardedCacheTest, givenPoppedEntry_whenRemoving_thenForgetsIt) {
+  auto cache = createCache(1000);
+  cache->push(1, 10);
+  cache->pop(1);
+  EXPECT_EQ(boost::none, cache->remove(1));
+  cache->push(1, 20);
+  EXPECT_EQ(20, cache->pop(1).value());
+}
+
+TEST_F(ShardedCacheTest, givenEntryIsBeingEvicted_whenPoppingIt_thenBlocksUntilEvictorFinished) {
+  ConditionBarrier evictorStarted;
+  std::atomic<bool> evictorFinished(false);
+  CacheType cache(1000, [] (const int &value) -> uint64_t {return value;}, [&] (vector<int>) {
+    evictorStarted.release();
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    evictorFinished = true;
+  }, 1);
+  cache.push(1, 2);
+  auto flushing = std::async(std::launch::async, [&cache] {cache.flush();});
+  evictorStarted.wait();
+  EXPECT_FALSE(evictorFinished);
+  EXPECT_EQ(boost::none, cache.pop(1));
+  EXPECT_TRUE(evictorFinished);
+  flushing.wait();
+}
+
+TEST_F(ShardedCacheTest, whenUpdatingEntries_thenOnlyPassesCachedEntriesAndKeepsThemCached) {
+  auto cache = createCache(1000, 4);
+  cache->push(1, 10);
+  cache->push(2, 20);
+  vector<int> updated;
+  cache->updateEntries({1, 2, 3}, [&updated] (const vector<int*> &values) {
+    for (int *value : values) {
+      updated.push_back(*value);
+      *value += 1;
+    }
+  });
+  std::sort(updated.begin(), updated.end());
+  EXPECT_EQ(vector<int>({10, 20}), updated);
+  EXPECT_EQ(2u, cache->size());
+  EXPECT_EQ(32u, cache->sizeBytes());
+  EXPECT_EQ(11, cache->pop(1).value());
+  EXPECT_EQ(21, cache->pop(2).value());
+  EXPECT_EQ(boost::none, cache->pop(3));
+}
+
+TEST_F(ShardedCacheTest, givenUpdaterThrows_whenUpdatingEntries_thenKeepsEntriesCached) {
+  auto cache = createCache(1000);
+  cache->push(1, 10);
+  EXPECT_THROW(
+    cache->updateEntries({1}, [] (const vector<int*> &) {throw std::runtime_error("error");}),
+    std::runtime_error
+  );
+  EXPECT_EQ(10, cache->pop(1).value());
+}
+
+TEST_F(ShardedCacheTest, givenEntryIsBeingUpdated_whenPoppingIt_thenBlocksUntilUpdaterFinished) {
+  ConditionBarrier updaterStarted;
+  std::atomic<bool> updaterFinished(false);
+  auto cache = createCache(1000);
+  cache->push(1, 2);
+  auto updating = std::async(std::launch::async, [&] {
+    cache->updateEntries({1}, [&] (const vector<int*> &values) {
+      updaterStarted.release();
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+      *values[0] = 3;
+      updaterFinished = true;
+    });
+  });
+  updaterStarted.wait();
+  EXPECT_FALSE(updaterFinished);
+  EXPECT_EQ(3, cache->pop(1).value());
+  EXPECT_TRUE(updaterFinished);
+  updating.wait();
+}
+
+TEST_F(ShardedCacheTest, givenSmallCache_thenUsesOneShard) {
+  EXPECT_EQ(1u, CacheType::defaultNumShards(CacheType::MIN_SHARD_SIZE_BYTES));
+}
+
+TEST_F(ShardedCacheTest, givenSmallestShards_thenWindowAndEvictionSlackCanHoldALargeEntry) {
+  using Shard = CacheType::Shard;
+  EXPECT_LE(CacheType::MAX_ENTRY_SIZE_BYTES, CacheType::MIN_SHARD_SIZE_BYTES * Shard::WINDOW_PERCENT / 100);
+  EXPECT_LE(CacheType::MAX_ENTRY_SIZE_BYTES, CacheType::MIN_SHARD_SIZE_BYTES / Shard::EVICTION_SLACK_DIVISOR);
+}
+
+TEST_F(ShardedCacheTest, givenDefaultBlockCacheSize_thenShardsAreAtLeastMinSize) {
+  const uint64_t cacheSize = 32 * 1024 * 1024;
+  EXPECT_LE(CacheType::MIN_SHARD_SIZE_BYTES, cacheSize / CacheType::defaultNumShards(cacheSize));
+}
+
+TEST_F(ShardedCacheTest, givenLargeCache_thenUsesTwoShardsPerCore) {
+  const uint32_t numShards = CacheType::defaultNumShards(static_cast<uint64_t>(1024) * 1024 * 1024 * 1024);
+  EXPECT_LE(2 * std::max(1u, std::thread::hardware_concurrency()), numShards);
+  EXPECT_EQ(0u, numShards & (numShards - 1)); // power of two
+}
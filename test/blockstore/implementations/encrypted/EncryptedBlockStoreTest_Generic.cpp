@@ -63,3 +63,12 @@ private:
 INSTANTIATE_TYPED_TEST_SUITE_P(Encrypted_FakeCipher, BlockStore2Test, EncryptedBlockStore2TestFixture<FakeAuthenticatedCipher>);
 INSTANTIATE_TYPED_TEST_SUITE_P(Encrypted_AES256_GCM, BlockStore2Test, EncryptedBlockStore2TestFixture<AES256_GCM>);
 INSTANTIATE_TYPED_TEST_SUITE_P(Encrypted_AES256_CFB, BlockStore2Test, EncryptedBlockStore2TestFixture<AES256_CFB>);
+INSTANTIATE_TYPED_TEST_SUITE_P(Encrypted_FakeCipher, BlockStore2RemoveManyTest, EncryptedBlockStore2TestFixture<FakeAuthenticatedCipher>);
+INSTANTIATE_TYPED_TEST_SUITE_P(Encrypted_AES256_GCM, BlockStore2RemoveManyTest, EncryptedBlockStore2TestFixture<AES256_GCM>);
+INSTANTIATE_TYPED_TEST_SUITE_P(Encrypted_AES256_CFB, BlockStore2RemoveManyTest, EncryptedBlockStore2TestFixture<AES256_CFB>);
+INSTANTIATE_TYPED_TEST_SUITE_P(Encrypted_FakeCipher, BlockStore2StoreManyTest, EncryptedBlockStore2TestFixture<FakeAuthenticatedCipher>);
+INSTANTIATE_TYPED_TEST_SUITE_P(Encrypted_AES256_GCM, BlockStore2StoreManyTest, EncryptedBlockStore2TestFixture<AES256_GCM>);
+INSTANTIATE_TYPED_TEST_SUITE_P(Encrypted_AES256_CFB, BlockStore2StoreManyTest, EncryptedBlockStore2TestFixture<AES256_CFB>);
+INSTANTIATE_TYPED_TEST_SUITE_P(Encrypted_FakeCipher, BlockStore2LoadSharedTest, EncryptedBlockStore2TestFixture<FakeAuthenticatedCipher>);
+INSTANTIATE_TYPED_TEST_SUITE_P(Encrypted_AES256_GCM, BlockStore2LoadSharedTest, EncryptedBlockStore2TestFixture<AES256_GCM>);
+INSTANTIATE_TYPED_TEST_SUITE_P(Encrypted_AES256_CFB, BlockStore2LoadSharedTest, EncryptedBlockStore2TestFixture<AES256_CFB>);
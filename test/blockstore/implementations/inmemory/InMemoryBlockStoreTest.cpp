@@ -33,3 +33,6 @@ public:
 };
 
 INSTANTIATE_TYPED_TEST_SUITE_P(InMemory, BlockStore2Test, InMemoryBlockStore2TestFixture);
+INSTANTIATE_TYPED_TEST_SUITE_P(InMemory, BlockStore2RemoveManyTest, InMemoryBlockStore2TestFixture);
+INSTANTIATE_TYPED_TEST_SUITE_P(InMemory, BlockStore2StoreManyTest, InMemoryBlockStore2TestFixture);
+INSTANTIATE_TYPED_TEST_SUITE_P(InMemory, BlockStore2LoadSharedTest, InMemoryBlockStore2TestFixture);
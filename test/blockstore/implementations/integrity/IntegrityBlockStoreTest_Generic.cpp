@@ -60,3 +60,15 @@ INSTANTIATE_TYPED_TEST_SUITE_P(Integrity_multiclient, BlockStore2Test, Integrity
 INSTANTIATE_TYPED_TEST_SUITE_P(Integrity_singleclient, BlockStore2Test, IntegrityBlockStore2TestFixture_singleclient);
 INSTANTIATE_TYPED_TEST_SUITE_P(Integrity_multiclient_allowIntegrityViolations, BlockStore2Test, IntegrityBlockStore2TestFixture_multiclient_allowIntegrityViolations);
 INSTANTIATE_TYPED_TEST_SUITE_P(Integrity_singleclient_allowIntegrityViolations, BlockStore2Test, IntegrityBlockStore2TestFixture_singleclient_allowIntegrityViolations);
+INSTANTIATE_TYPED_TEST_SUITE_P(Integrity_multiclient, BlockStore2RemoveManyTest, IntegrityBlockStore2TestFixture_multiclient);
+INSTANTIATE_TYPED_TEST_SUITE_P(Integrity_singleclient, BlockStore2RemoveManyTest, IntegrityBlockStore2TestFixture_singleclient);
+INSTANTIATE_TYPED_TEST_SUITE_P(Integrity_multiclient_allowIntegrityViolations, BlockStore2RemoveManyTest, IntegrityBlockStore2TestFixture_multiclient_allowIntegrityViolations);
+INSTANTIATE_TYPED_TEST_SUITE_P(Integrity_singleclient_allowIntegrityViolations, BlockStore2RemoveManyTest, IntegrityBlockStore2TestFixture_singleclient_allowIntegrityViolations);
+INSTANTIATE_TYPED_TEST_SUITE_P(Integrity_multiclient, BlockStore2StoreManyTest, IntegrityBlockStore2TestFixture_multiclient);
+INSTANTIATE_TYPED_TEST_SUITE_P(Integrity_singleclient, BlockStore2StoreManyTest, IntegrityBlockStore2TestFixture_singleclient);
+INSTANTIATE_TYPED_TEST_SUITE_P(Integrity_multiclient_allowIntegrityViolations, BlockStore2StoreManyTest, IntegrityBlockStore2TestFixture_multiclient_allowIntegrityViolations);
+INSTANTIATE_TYPED_TEST_SUITE_P(Integrity_singleclient_allowIntegrityViolations, BlockStore2StoreManyTest, IntegrityBlockStore2TestFixture_singleclient_allowIntegrityViolations);
+INSTANTIATE_TYPED_TEST_SUITE_P(Integrity_multiclient, BlockStore2LoadSharedTest, IntegrityBlockStore2TestFixture_multiclient);
+INSTANTIATE_TYPED_TEST_SUITE_P(Integrity_singleclient, BlockStore2LoadSharedTest, IntegrityBlockStore2TestFixture_singleclient);
+INSTANTIATE_TYPED_TEST_SUITE_P(Integrity_multiclient_allowIntegrityViolations, BlockStore2LoadSharedTest, IntegrityBlockStore2TestFixture_multiclient_allowIntegrityViolations);
+INSTANTIATE_TYPED_TEST_SUITE_P(Integrity_singleclient_allowIntegrityViolations, BlockStore2LoadSharedTest, IntegrityBlockStore2TestFixture_singleclient_allowIntegrityViolations);
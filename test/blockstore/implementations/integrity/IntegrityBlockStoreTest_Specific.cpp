@@ -354,6 +354,97 @@ TEST_F(IntegrityBlockStoreTest_AllowIntegrityViolations, LoadingWithDifferentBlo
   EXPECT_FALSE(onIntegrityViolation.wasCalled());
 }
 
+namespace {
+// Forwards to a base store it doesn't own, but fails writes while crashing is set, like a crash in the middle of a write would
+class CrashingBlockStore2 final: public blockstore::BlockStore2 {
+public:
+  CrashingBlockStore2(blockstore::BlockStore2 *baseBlockStore, const bool *crashing): _baseBlockStore(baseBlockStore), _crashing(crashing) {}
+
+  bool tryCreate(const blockstore::BlockId &blockId, const Data &data) override {
+    _crashIfCrashing();
+    return _baseBlockStore->tryCreate(blockId, data);
+  }
+  bool remove(const blockstore::BlockId &blockId) override {
+    return _baseBlockStore->remove(blockId);
+  }
+  boost::optional<Data> load(const blockstore::BlockId &blockId) const override {
+    return _baseBlockStore->load(blockId);
+  }
+  void store(const blockstore::BlockId &blockId, const Data &data) override {
+    _crashIfCrashing();
+    _baseBlockStore->store(blockId, data);
+  }
+  void storeMany(std::vector<std::pair<blockstore::BlockId, Data>> blocks) override {
+    _crashIfCrashing();
+    _baseBlockStore->storeMany(std::move(blocks));
+  }
+  uint64_t numBlocks() const override {
+    return _baseBlockStore->numBlocks();
+  }
+  uint64_t estimateNumFreeBytes() const override {
+    return _baseBlockStore->estimateNumFreeBytes();
+  }
+  uint64_t blockSizeFromPhysicalBlockSize(uint64_t blockSize) const override {
+    return _baseBlockStore->blockSizeFromPhysicalBlockSize(blockSize);
+  }
+  void forEachBlock(std::function<void (const blockstore::BlockId &)> callback) const override {
+    _baseBlockStore->forEachBlock(std::move(callback));
+  }
+
+private:
+  void _crashIfCrashing() const {
+    if (*_crashing) {
+      throw std::runtime_error("Crashed while writing");
+    }
+  }
+
+  blockstore::BlockStore2 *_baseBlockStore;
+  const bool *_crashing;
+};
+}
+
+// Simulates a crash after the new version number of a block was determined, but before the block was written.
+// The state file must not know about the new version afterwards, otherwise the old block looks like a rollback.
+template<class StoreFunction>
+void testCrashWhileStoring(StoreFunction storeFunction) {
+  TempFile stateFile(false);
+  InMemoryBlockStore2 baseBlockStore;
+  FakeCallback onIntegrityViolation;
+  bool crashing = false;
+  auto createBlockStore = [&] {
+    return make_unique_ref<IntegrityBlockStore2>(make_unique_ref<CrashingBlockStore2>(&baseBlockStore, &crashing), stateFile.path(), 0x12345678, false, true, onIntegrityViolation.callback());
+  };
+
+  auto blockStore = createBlockStore();
+  auto blockId = blockStore->create(DataFixture::generate(1024));
+  crashing = true;
+  EXPECT_ANY_THROW(storeFunction(blockStore.get(), blockId, DataFixture::generate(1024, 1)));
+  cpputils::destruct(std::move(blockStore));
+
+  // Restart with the state file and blocks that the crash left behind
+  crashing = false;
+  blockStore = createBlockStore();
+  EXPECT_EQ(DataFixture::generate(1024), blockStore->load(blockId).value());
+  EXPECT_FALSE(onIntegrityViolation.wasCalled());
+  blockStore->store(blockId, DataFixture::generate(1024, 2));
+  EXPECT_EQ(DataFixture::generate(1024, 2), blockStore->load(blockId).value());
+  EXPECT_FALSE(onIntegrityViolation.wasCalled());
+}
+
+TEST(IntegrityBlockStoreTest_Crash, givenCrashWhileStoring_whenRestarting_thenOldBlockIsNoIntegrityViolation) {
+  testCrashWhileStoring([] (IntegrityBlockStore2 *blockStore, const blockstore::BlockId &blockId, const Data &data) {
+    blockStore->store(blockId, data);
+  });
+}
+
+TEST(IntegrityBlockStoreTest_Crash, givenCrashWhileStoringMany_whenRestarting_thenOldBlockIsNoIntegrityViolation) {
+  testCrashWhileStoring([] (IntegrityBlockStore2 *blockStore, const blockstore::BlockId &blockId, const Data &data) {
+    std::vector<std::pair<blockstore::BlockId, Data>> blocks;
+    blocks.emplace_back(blockId, data.copy());
+    blockStore->storeMany(std::move(blocks));
+  });
+}
+
 // TODO Test more integrity cases:
 //   - RollbackPrevention_DoesntAllowReintroducingDeletedBlocks with different client id (i.e. trying to re-introduce the newest block of a different client)
 //   - RollbackPrevention_AllowsReintroducingDeletedBlocksWithNewVersionNumber with different client id
@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+#include <blockstore/implementations/integrity/KnownBlockVersionsTable.h>
+#include <cpp-utils/tempfile/TempFile.h>
+#include <boost/filesystem.hpp>
+#include <cpp-utils/data/Data.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using blockstore::integrity::KnownBlockVersionsTable;
+using blockstore::BlockId;
+using cpputils::TempFile;
+using cpputils::Data;
+using boost::none;
+
+class KnownBlockVersionsTableTest : public ::testing::Test {
+public:
+    KnownBlockVersionsTableTest() :stateFile(false) {}
+
+    BlockId blockId = BlockId::FromString("1491BB4932A389EE14BC7090AC772972");
+    BlockId blockId2 = BlockId::FromString("C772972491BB4932A1389EE14BC7090A");
+    static constexpr uint32_t clientId = 0x23456789;
+    static constexpr uint32_t clientId2 = 0x34567890;
+
+    TempFile stateFile;
+};
+
+constexpr uint32_t KnownBlockVersionsTableTest::clientId;
+constexpr uint32_t KnownBlockVersionsTableTest::clientId2;
+
+TEST_F(KnownBlockVersionsTableTest, givenNoFile_whenOpening_thenCreatesEmptyTable) {
+    KnownBlockVersionsTable table(stateFile.path());
+    EXPECT_TRUE(boost::filesystem::exists(stateFile.path()));
+    EXPECT_TRUE(KnownBlockVersionsTable::IsTableFile(stateFile.path()));
+    EXPECT_EQ(0u, table.numEntries());
+    EXPECT_FALSE(table.integrityViolationOnPreviousRun());
+}
+
+TEST_F(KnownBlockVersionsTableTest, unknownEntries) {
+    KnownBlockVersionsTable table(stateFile.path());
+    EXPECT_EQ(none, table.version(clientId, blockId));
+    EXPECT_EQ(none, table.lastUpdateClientId(blockId));
+}
+
+TEST_F(KnownBlockVersionsTableTest, setAndGetVersion) {
+    KnownBlockVersionsTable table(stateFile.path());
+    table.setVersion(clientId, blockId, 5);
+    EXPECT_EQ(5u, table.version(clientId, blockId).value());
+    EXPECT_EQ(none, table.version(clientId2, blockId));
+    EXPECT_EQ(none, table.version(clientId, blockId2));
+    EXPECT_EQ(none, table.lastUpdateClientId(blockId));
+}
+
+TEST_F(KnownBlockVersionsTableTest, overwriteVersion) {
+    KnownBlockVersionsTable table(stateFile.path());
+    table.setVersion(clientId, blockId, 5);
+    table.setVersion(clientId, blockId, 7);
+    EXPECT_EQ(7u, table.version(clientId, blockId).value());
+    EXPECT_EQ(1u, table.numEntries());
+}
+
+TEST_F(KnownBlockVersionsTableTest, setAndGetLastUpdateClientId) {
+    KnownBlockVersionsTable table(stateFile.path());
+    table.setLastUpdateClientId(blockId, clientId);
+    table.setLastUpdateClientId(blockId, clientId2);
+    EXPECT_EQ(clientId2, table.lastUpdateClientId(blockId).value());
+    EXPECT_EQ(none, table.lastUpdateClientId(blockId2));
+    EXPECT_EQ(none, table.version(clientId2, blockId));
+}
+
+TEST_F(KnownBlockVersionsTableTest, forEachLastUpdateClientId) {
+    KnownBlockVersionsTable table(stateFile.path());
+    table.setVersion(clientId, blockId, 5);
+    table.setLastUpdateClientId(blockId, clientId);
+    table.setLastUpdateClientId(blockId2, clientId2);
+    std::unordered_map<BlockId, uint32_t> found;
+    table.forEachLastUpdateClientId([&found] (const BlockId &blockId, uint32_t clientId) {
+        EXPECT_TRUE(found.emplace(blockId, clientId).second);
+    });
+    EXPECT_EQ((std::unordered_map<BlockId, uint32_t>{{blockId, clientId}, {blockId2, clientId2}}), found);
+}
+
+TEST_F(KnownBlockVersionsTableTest, integrityViolationOnPreviousRun) {
+    KnownBlockVersionsTable table(stateFile.path());
+    table.setIntegrityViolationOnPreviousRun(true);
+    EXPECT_TRUE(table.integrityViolationOnPreviousRun());
+    table.setIntegrityViolationOnPreviousRun(false);
+    EXPECT_FALSE(table.integrityViolationOnPreviousRun());
+}
+
+TEST_F(KnownBlockVersionsTableTest, givenManyEntries_whenGrowing_thenKeepsAllEntries) {
+    KnownBlockVersionsTable table(stateFile.path());
+    std::vector<BlockId> blockIds;
+    for (uint64_t i = 0; i < 5000; ++i) {
+        blockIds.push_back(BlockId::Random());
+        table.setVersion(clientId, blockIds.back(), i + 1);
+        table.setLastUpdateClientId(blockIds.back(), clientId);
+    }
+    EXPECT_EQ(10000u, table.numEntries());
+    for (uint64_t i = 0; i < blockIds.size(); ++i) {
+        EXPECT_EQ(i + 1, table.version(clientId, blockIds[i]).value());
+        EXPECT_EQ(clientId, table.lastUpdateClientId(blockIds[i]).value());
+    }
+}
+
+TEST_F(KnownBlockVersionsTableTest, entriesArePersisted) {
+    std::vector<BlockId> blockIds;
+    {
+        KnownBlockVersionsTable table(stateFile.path());
+        for (uint64_t i = 0; i < 2000; ++i) {
+            blockIds.push_back(BlockId::Random());
+            table.setVersion(clientId, blockIds.back(), i + 1);
+        }
+        table.setLastUpdateClientId(blockId, clientId2);
+        table.setIntegrityViolationOnPreviousRun(true);
+    }
+
+    KnownBlockVersionsTable table(stateFile.path());
+    EXPECT_EQ(2001u, table.numEntries());
+    for (uint64_t i = 0; i < blockIds.size(); ++i) {
+        EXPECT_EQ(i + 1, table.version(clientId, blockIds[i]).value());
+    }
+    EXPECT_EQ(clientId2, table.lastUpdateClientId(blockId).value());
+    EXPECT_TRUE(table.integrityViolationOnPreviousRun());
+}
+
+TEST_F(KnownBlockVersionsTableTest, givenFileInOtherFormat_whenOpening_thenThrows) {
+    Data data(1000);
+    data.FillWithZeroes();
+    data.StoreToFile(stateFile.path());
+    EXPECT_FALSE(KnownBlockVersionsTable::IsTableFile(stateFile.path()));
+    EXPECT_ANY_THROW(
+        KnownBlockVersionsTable table(stateFile.path())
+    );
+}
+
+TEST_F(KnownBlockVersionsTableTest, givenTruncatedFile_whenOpening_thenThrows) {
+    {
+        KnownBlockVersionsTable table(stateFile.path());
+    }
+    boost::filesystem::resize_file(stateFile.path(), boost::filesystem::file_size(stateFile.path()) - 1);
+    EXPECT_ANY_THROW(
+        KnownBlockVersionsTable table(stateFile.path())
+    );
+}
+
+TEST_F(KnownBlockVersionsTableTest, givenManyThreads_whenInsertingDifferentBlocks_thenKeepsAllEntries) {
+    constexpr size_t NUM_THREADS = 8;
+    constexpr size_t NUM_BLOCKS_PER_THREAD = 2000;
+    KnownBlockVersionsTable table(stateFile.path());
+    std::vector<std::vector<BlockId>> blockIds(NUM_THREADS);
+    for (auto &threadBlockIds : blockIds) {
+        for (size_t i = 0; i < NUM_BLOCKS_PER_THREAD; ++i) {
+            threadBlockIds.push_back(BlockId::Random());
+        }
+    }
+
+    // This also grows the table several times while other threads insert
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < NUM_THREADS; ++thread) {
+        threads.emplace_back([&table, &blockIds, thread] {
+            for (size_t i = 0; i < NUM_BLOCKS_PER_THREAD; ++i) {
+                table.setVersion(clientId, blockIds[thread][i], i + 1);
+                table.setLastUpdateClientId(blockIds[thread][i], clientId);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(2 * NUM_THREADS * NUM_BLOCKS_PER_THREAD, table.numEntries());
+    for (size_t thread = 0; thread < NUM_THREADS; ++thread) {
+        for (size_t i = 0; i < NUM_BLOCKS_PER_THREAD; ++i) {
+            EXPECT_EQ(i + 1, table.version(clientId, blockIds[thread][i]).value());
+            EXPECT_EQ(clientId, table.lastUpdateClientId(blockIds[thread][i]).value());
+        }
+    }
+}
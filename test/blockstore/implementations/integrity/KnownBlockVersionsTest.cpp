@@ -1,10 +1,15 @@
 #include <gtest/gtest.h>
 #include <blockstore/implementations/integrity/KnownBlockVersions.h>
 #include <cpp-utils/tempfile/TempFile.h>
+#include <cpp-utils/data/Serializer.h>
+#include <set>
+#include <thread>
+#include <vector>
 
 using blockstore::integrity::KnownBlockVersions;
 using blockstore::BlockId;
 using cpputils::TempFile;
+using cpputils::Serializer;
 using std::unordered_set;
 
 class KnownBlockVersionsTest : public ::testing::Test {
@@ -26,6 +31,32 @@ public:
         }
     }
 
+    // Writes a state file in the format used before the state was stored in a KnownBlockVersionsTable
+    void writeSerializedStateFile(const boost::filesystem::path &path, const std::string &header, bool withIntegrityViolationFlag) {
+        Serializer serializer(Serializer::StringSize(header) + (withIntegrityViolationFlag ? Serializer::BoolSize() : 0)
+                              + sizeof(uint64_t) + 2 * (sizeof(uint32_t) + BlockId::BINARY_LENGTH + sizeof(uint64_t))
+                              + sizeof(uint64_t) + 2 * (BlockId::BINARY_LENGTH + sizeof(uint32_t)));
+        serializer.writeString(header);
+        if (withIntegrityViolationFlag) {
+            serializer.writeBool(true);
+        }
+        // known versions
+        serializer.writeUint64(2);
+        serializer.writeUint32(clientId);
+        serializer.writeFixedSizeData<BlockId::BINARY_LENGTH>(blockId.data());
+        serializer.writeUint64(100);
+        serializer.writeUint32(clientId2);
+        serializer.writeFixedSizeData<BlockId::BINARY_LENGTH>(blockId.data());
+        serializer.writeUint64(10);
+        // last update client ids
+        serializer.writeUint64(2);
+        serializer.writeFixedSizeData<BlockId::BINARY_LENGTH>(blockId.data());
+        serializer.writeUint32(clientId2);
+        serializer.writeFixedSizeData<BlockId::BINARY_LENGTH>(blockId2.data());
+        serializer.writeUint32(KnownBlockVersions::CLIENT_ID_FOR_DELETED_BLOCK);
+        serializer.finished().StoreToFile(path);
+    }
+
     void EXPECT_VERSION_IS(uint64_t version, KnownBlockVersions *testobj, blockstore::BlockId &blockId, uint32_t clientId) {
         EXPECT_FALSE(testobj->checkAndUpdateVersion(clientId, blockId, version-1));
         EXPECT_TRUE(testobj->checkAndUpdateVersion(clientId, blockId, version+1));
@@ -81,6 +112,43 @@ TEST_F(KnownBlockVersionsTest, incrementVersion_oldentry) {
     EXPECT_EQ(6u, testobj.getBlockVersion(testobj.myClientId(), blockId));
 }
 
+TEST_F(KnownBlockVersionsTest, reserveVersion_doesntChangeKnownVersion) {
+    setVersion(&testobj, testobj.myClientId(), blockId, 5);
+    auto version = testobj.reserveVersion(blockId);
+    EXPECT_EQ(6u, version);
+    EXPECT_EQ(5u, testobj.getBlockVersion(testobj.myClientId(), blockId));
+}
+
+TEST_F(KnownBlockVersionsTest, reserveVersion_twice_returnsNewVersionEachTime) {
+    EXPECT_EQ(1u, testobj.reserveVersion(blockId));
+    EXPECT_EQ(2u, testobj.reserveVersion(blockId));
+}
+
+TEST_F(KnownBlockVersionsTest, commitVersion_changesKnownVersion) {
+    setVersion(&testobj, testobj.myClientId(), blockId, 5);
+    auto version = testobj.reserveVersion(blockId);
+    testobj.commitVersion(blockId, version);
+    EXPECT_EQ(6u, testobj.getBlockVersion(testobj.myClientId(), blockId));
+    EXPECT_EQ(7u, testobj.incrementVersion(blockId));
+}
+
+TEST_F(KnownBlockVersionsTest, commitVersion_olderThanCommittedVersion_keepsCommittedVersion) {
+    auto version1 = testobj.reserveVersion(blockId);
+    auto version2 = testobj.reserveVersion(blockId);
+    testobj.commitVersion(blockId, version2);
+    testobj.commitVersion(blockId, version1);
+    EXPECT_EQ(version2, testobj.getBlockVersion(testobj.myClientId(), blockId));
+}
+
+TEST_F(KnownBlockVersionsTest, reserveVersion_afterNotCommittingVersion_doesntReturnItAgain) {
+    // e.g. writing the block failed
+    auto failedVersion = testobj.reserveVersion(blockId);
+    auto version = testobj.reserveVersion(blockId);
+    EXPECT_LT(failedVersion, version);
+    testobj.commitVersion(blockId, version);
+    EXPECT_LT(version, testobj.reserveVersion(blockId));
+}
+
 TEST_F(KnownBlockVersionsTest, checkAndUpdateVersion_newentry) {
     EXPECT_TRUE(testobj.checkAndUpdateVersion(clientId, blockId, 5));
     EXPECT_EQ(5u, testobj.getBlockVersion(clientId, blockId));
@@ -352,3 +420,111 @@ TEST_F(KnownBlockVersionsTest, existingBlocks_deletedEntries) {
     testobj.markBlockAsDeleted(blockId2);
     EXPECT_EQ(unordered_set<BlockId>({}), testobj.existingBlocks());
 }
+
+TEST_F(KnownBlockVersionsTest, givenSerializedStateFile_whenLoading_thenMigratesIt) {
+    TempFile stateFile(false);
+    writeSerializedStateFile(stateFile.path(), "cryfs.integritydata.knownblockversions;1", true);
+
+    KnownBlockVersions obj(stateFile.path(), myClientId);
+    EXPECT_EQ(100u, obj.getBlockVersion(clientId, blockId));
+    EXPECT_EQ(10u, obj.getBlockVersion(clientId2, blockId));
+    EXPECT_FALSE(obj.checkAndUpdateVersion(clientId, blockId, 100)); // superseded by clientId2
+    EXPECT_TRUE(obj.checkAndUpdateVersion(clientId2, blockId, 10));
+    EXPECT_TRUE(obj.blockShouldExist(blockId));
+    EXPECT_FALSE(obj.blockShouldExist(blockId2));
+    EXPECT_TRUE(obj.integrityViolationOnPreviousRun());
+}
+
+TEST_F(KnownBlockVersionsTest, givenSerializedStateFile_whenLoading_thenReplacesItWithTable) {
+    TempFile stateFile(false);
+    writeSerializedStateFile(stateFile.path(), "cryfs.integritydata.knownblockversions;1", true);
+    {
+        KnownBlockVersions obj(stateFile.path(), myClientId);
+    }
+    EXPECT_TRUE(blockstore::integrity::KnownBlockVersionsTable::IsTableFile(stateFile.path()));
+
+    KnownBlockVersions obj(stateFile.path(), myClientId);
+    EXPECT_EQ(100u, obj.getBlockVersion(clientId, blockId));
+}
+
+#ifndef CRYFS_NO_COMPATIBILITY
+TEST_F(KnownBlockVersionsTest, givenOldSerializedStateFile_whenLoading_thenMigratesIt) {
+    TempFile stateFile(false);
+    writeSerializedStateFile(stateFile.path(), "cryfs.integritydata.knownblockversions;0", false);
+
+    KnownBlockVersions obj(stateFile.path(), myClientId);
+    EXPECT_EQ(100u, obj.getBlockVersion(clientId, blockId));
+    EXPECT_EQ(10u, obj.getBlockVersion(clientId2, blockId));
+    EXPECT_FALSE(obj.integrityViolationOnPreviousRun());
+}
+#endif
+
+TEST_F(KnownBlockVersionsTest, givenStateFileWithInvalidHeader_whenLoading_thenThrows) {
+    TempFile stateFile(false);
+    writeSerializedStateFile(stateFile.path(), "cryfs.integritydata.knownblockversions;9", true);
+    EXPECT_ANY_THROW(
+        KnownBlockVersions(stateFile.path(), myClientId)
+    );
+}
+
+TEST_F(KnownBlockVersionsTest, integrityViolationOnPreviousRunIsStored) {
+    TempFile stateFile(false);
+    {
+        KnownBlockVersions obj(stateFile.path(), myClientId);
+        EXPECT_FALSE(obj.integrityViolationOnPreviousRun());
+        obj.setIntegrityViolationOnPreviousRun(true);
+    }
+    EXPECT_TRUE(KnownBlockVersions(stateFile.path(), myClientId).integrityViolationOnPreviousRun());
+}
+
+TEST_F(KnownBlockVersionsTest, incrementVersion_concurrentlyForSameBlock_returnsEachVersionOnce) {
+    constexpr size_t NUM_THREADS = 8;
+    constexpr size_t NUM_INCREMENTS_PER_THREAD = 1000;
+    std::vector<std::vector<uint64_t>> versions(NUM_THREADS);
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < NUM_THREADS; ++thread) {
+        threads.emplace_back([this, &versions, thread] {
+            for (size_t i = 0; i < NUM_INCREMENTS_PER_THREAD; ++i) {
+                versions[thread].push_back(testobj.incrementVersion(blockId));
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    std::set<uint64_t> allVersions;
+    for (const auto &threadVersions : versions) {
+        allVersions.insert(threadVersions.begin(), threadVersions.end());
+    }
+    EXPECT_EQ(NUM_THREADS * NUM_INCREMENTS_PER_THREAD, allVersions.size());
+    EXPECT_EQ(NUM_THREADS * NUM_INCREMENTS_PER_THREAD, testobj.getBlockVersion(myClientId, blockId));
+}
+
+TEST_F(KnownBlockVersionsTest, checkAndUpdate_concurrentlyForDifferentBlocks) {
+    constexpr size_t NUM_THREADS = 8;
+    constexpr uint64_t NUM_VERSIONS = 1000;
+    std::vector<BlockId> blockIds;
+    for (size_t thread = 0; thread < NUM_THREADS; ++thread) {
+        blockIds.push_back(BlockId::Random());
+    }
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < NUM_THREADS; ++thread) {
+        threads.emplace_back([this, &blockIds, thread] {
+            for (uint64_t version = 1; version <= NUM_VERSIONS; ++version) {
+                EXPECT_TRUE(testobj.checkAndUpdateVersion(clientId, blockIds[thread], version));
+                if (version > 1) {
+                    EXPECT_FALSE(testobj.checkAndUpdateVersion(clientId, blockIds[thread], version - 1));
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (const BlockId &blockId : blockIds) {
+        EXPECT_EQ(NUM_VERSIONS, testobj.getBlockVersion(clientId, blockId));
+    }
+    EXPECT_EQ(unordered_set<BlockId>(blockIds.begin(), blockIds.end()), testobj.existingBlocks());
+}
@@ -43,3 +43,6 @@ private:
 };
 
 INSTANTIATE_TYPED_TEST_SUITE_P(OnDisk, BlockStore2Test, OnDiskBlockStore2TestFixture);
+INSTANTIATE_TYPED_TEST_SUITE_P(OnDisk, BlockStore2RemoveManyTest, OnDiskBlockStore2TestFixture);
+INSTANTIATE_TYPED_TEST_SUITE_P(OnDisk, BlockStore2StoreManyTest, OnDiskBlockStore2TestFixture);
+INSTANTIATE_TYPED_TEST_SUITE_P(OnDisk, BlockStore2LoadSharedTest, OnDiskBlockStore2TestFixture);
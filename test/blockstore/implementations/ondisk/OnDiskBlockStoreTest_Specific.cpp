@@ -1,11 +1,18 @@
 #include <gtest/gtest.h>
 #include "blockstore/implementations/ondisk/OnDiskBlockStore2.h"
 #include <cpp-utils/tempfile/TempDir.h>
+#include <cpp-utils/tempfile/TempFile.h>
+#include <cpp-utils/data/DataFixture.h>
+#include <boost/filesystem.hpp>
+#include <atomic>
+#include <thread>
 
 using ::testing::Test;
 
 using cpputils::TempDir;
+using cpputils::TempFile;
 using cpputils::Data;
+using cpputils::DataFixture;
 using std::ifstream;
 using blockstore::BlockId;
 
@@ -65,3 +72,139 @@ TEST_F(OnDiskBlockStoreTest, NumBlocksIsCorrectAfterAddingTwoBlocksWithSameKeyPr
   EXPECT_TRUE(blockStore.tryCreate(key2, cpputils::Data(0)));
   EXPECT_EQ(2u, blockStore.numBlocks());
 }
+
+TEST_F(OnDiskBlockStoreTest, TryCreateExistingBlockDoesntOverwriteIt) {
+  const BlockId blockId = blockStore.create(DataFixture::generate(100, 0));
+  EXPECT_FALSE(blockStore.tryCreate(blockId, DataFixture::generate(100, 1)));
+  EXPECT_EQ(DataFixture::generate(100, 0), blockStore.load(blockId).value());
+  EXPECT_EQ(1u, blockStore.numBlocks());
+}
+
+TEST_F(OnDiskBlockStoreTest, ConcurrentTryCreateOfSameBlockSucceedsOnce) {
+  const BlockId blockId = BlockId::Random();
+  std::atomic<uint32_t> numSucceeded(0);
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < 10; ++i) {
+    threads.emplace_back([&, i] {
+      if (blockStore.tryCreate(blockId, DataFixture::generate(100, i))) {
+        ++numSucceeded;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(1u, numSucceeded.load());
+  EXPECT_EQ(1u, blockStore.numBlocks());
+}
+
+class OnDiskBlockStoreBlockCountTest: public Test {
+public:
+  OnDiskBlockStoreBlockCountTest(): baseDir(), blockCountFile(false) {}
+
+  TempDir baseDir;
+  TempFile blockCountFile;
+
+  static uint64_t countBlocksByWalking(const OnDiskBlockStore2 &blockStore) {
+    uint64_t count = 0;
+    blockStore.forEachBlock([&count] (const BlockId &) {++count;});
+    return count;
+  }
+
+  static std::vector<BlockId> createBlocks(OnDiskBlockStore2 *blockStore, uint32_t num) {
+    std::vector<BlockId> result;
+    for (uint32_t i = 0; i < num; ++i) {
+      result.push_back(blockStore->create(DataFixture::generate(100, i)));
+    }
+    return result;
+  }
+
+  // Adds a block file behind the block store's back, like a sync client would do.
+  void addBlockExternally() {
+    OnDiskBlockStore2 otherBlockStore(baseDir.path());
+    otherBlockStore.create(Data(0));
+  }
+};
+
+TEST_F(OnDiskBlockStoreBlockCountTest, NumBlocksMatchesFullWalk) {
+  OnDiskBlockStore2 blockStore(baseDir.path(), blockCountFile.path());
+  auto blockIds = createBlocks(&blockStore, 100);
+  for (uint32_t i = 0; i < 30; ++i) {
+    EXPECT_TRUE(blockStore.remove(blockIds[i]));
+  }
+  EXPECT_FALSE(blockStore.remove(blockIds[0]));
+  blockStore.store(blockIds[50], DataFixture::generate(100, 1000)); // overwrite existing block
+  blockStore.store(BlockId::Random(), DataFixture::generate(100, 1001)); // store new block
+  EXPECT_FALSE(blockStore.tryCreate(blockIds[60], Data(0)));
+  EXPECT_EQ(71u, blockStore.numBlocks());
+  EXPECT_EQ(countBlocksByWalking(blockStore), blockStore.numBlocks());
+}
+
+TEST_F(OnDiskBlockStoreBlockCountTest, NumBlocksMatchesFullWalk_WithoutBlockCountFile) {
+  OnDiskBlockStore2 blockStore(baseDir.path());
+  auto blockIds = createBlocks(&blockStore, 50);
+  EXPECT_EQ(50u, blockStore.numBlocks());
+  for (uint32_t i = 0; i < 20; ++i) {
+    EXPECT_TRUE(blockStore.remove(blockIds[i]));
+  }
+  createBlocks(&blockStore, 5);
+  EXPECT_EQ(35u, blockStore.numBlocks());
+  EXPECT_EQ(countBlocksByWalking(blockStore), blockStore.numBlocks());
+}
+
+TEST_F(OnDiskBlockStoreBlockCountTest, BlockCountIsLoadedFromFileWithoutWalking) {
+  {
+    OnDiskBlockStore2 blockStore(baseDir.path(), blockCountFile.path());
+    createBlocks(&blockStore, 10);
+    EXPECT_EQ(10u, blockStore.numBlocks());
+  }
+  EXPECT_TRUE(blockCountFile.exists());
+  addBlockExternally();
+  OnDiskBlockStore2 blockStore(baseDir.path(), blockCountFile.path());
+  // If the block store walked the directory, it would see the externally added block
+  EXPECT_EQ(10u, blockStore.numBlocks());
+  createBlocks(&blockStore, 2);
+  EXPECT_EQ(12u, blockStore.numBlocks());
+}
+
+TEST_F(OnDiskBlockStoreBlockCountTest, BlockCountIsRebuiltIfFileIsMissing) {
+  {
+    OnDiskBlockStore2 blockStore(baseDir.path(), blockCountFile.path());
+    createBlocks(&blockStore, 10);
+  }
+  blockCountFile.remove();
+  addBlockExternally();
+  OnDiskBlockStore2 blockStore(baseDir.path(), blockCountFile.path());
+  EXPECT_EQ(11u, blockStore.numBlocks());
+  EXPECT_EQ(countBlocksByWalking(blockStore), blockStore.numBlocks());
+}
+
+TEST_F(OnDiskBlockStoreBlockCountTest, BlockCountIsRebuiltIfFileWasNotCleanlyClosed) {
+  TempFile crashedState(false);
+  {
+    OnDiskBlockStore2 blockStore(baseDir.path(), blockCountFile.path());
+    createBlocks(&blockStore, 10);
+    EXPECT_EQ(10u, blockStore.numBlocks());
+    // Simulate a crash by keeping the state file as it is while the block store is still running
+    createBlocks(&blockStore, 3);
+    boost::filesystem::copy_file(blockCountFile.path(), crashedState.path());
+  }
+  boost::filesystem::remove(blockCountFile.path());
+  boost::filesystem::copy_file(crashedState.path(), blockCountFile.path());
+  addBlockExternally();
+  OnDiskBlockStore2 blockStore(baseDir.path(), blockCountFile.path());
+  // A block count that wasn't cleanly saved is only an estimate until the background rebuild finished
+  blockStore.waitForBlockCountRebuild();
+  EXPECT_EQ(14u, blockStore.numBlocks());
+  EXPECT_EQ(countBlocksByWalking(blockStore), blockStore.numBlocks());
+}
+
+TEST_F(OnDiskBlockStoreBlockCountTest, BlockCountIsRebuiltIfFileIsCorrupted) {
+  {
+    OnDiskBlockStore2 blockStore(baseDir.path(), blockCountFile.path());
+    createBlocks(&blockStore, 10);
+  }
+  DataFixture::generate(5).StoreToFile(blockCountFile.path());
+  OnDiskBlockStore2 blockStore(baseDir.path(), blockCountFile.path());
+  EXPECT_EQ(10u, blockStore.numBlocks());
+}
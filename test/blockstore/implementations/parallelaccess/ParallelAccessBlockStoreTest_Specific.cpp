@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 #include "blockstore/implementations/parallelaccess/ParallelAccessBlockStore.h"
 #include "blockstore/implementations/testfake/FakeBlockStore.h"
+#include <chrono>
+#include <thread>
 
 using ::testing::Test;
 
@@ -50,3 +52,17 @@ TEST_F(ParallelAccessBlockStoreTest, PhysicalBlockSize_positive) {
     auto base = baseBlockStore->load(blockId).value();
     EXPECT_EQ(10*1024u, blockStore.blockSizeFromPhysicalBlockSize(base->size()));
 }
+
+TEST_F(ParallelAccessBlockStoreTest, RemoveMany_WaitsForOpenedBlocks) {
+    auto openedBlockId = CreateBlockReturnKey(Data(10));
+    auto notOpenedBlockId = CreateBlockReturnKey(Data(10));
+    auto openedBlock = boost::make_optional(blockStore.load(openedBlockId).value());
+    std::thread releaser([&openedBlock] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        openedBlock = boost::none;
+    });
+    blockStore.removeMany({openedBlockId, notOpenedBlockId});
+    releaser.join();
+    EXPECT_EQ(boost::none, baseBlockStore->load(openedBlockId));
+    EXPECT_EQ(boost::none, baseBlockStore->load(notOpenedBlockId));
+}
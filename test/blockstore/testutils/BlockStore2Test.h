@@ -13,6 +13,9 @@ namespace boost {
 inline void PrintTo(const optional<cpputils::Data> &, ::std::ostream *os) {
   *os << "optional<Data>";
 }
+inline void PrintTo(const optional<std::shared_ptr<const cpputils::Data>> &, ::std::ostream *os) {
+  *os << "optional<shared_ptr<const Data>>";
+}
 }
 
 class BlockStore2TestFixture {
@@ -476,4 +479,173 @@ REGISTER_TYPED_TEST_SUITE_P(BlockStore2Test,
 );
 
 
+// Separate test suite, because gtest doesn't allow more than 50 tests in one typed test suite.
+template<class ConcreteBlockStoreTestFixture>
+class BlockStore2RemoveManyTest: public BlockStore2Test<ConcreteBlockStoreTestFixture> {
+};
+
+TYPED_TEST_SUITE_P(BlockStore2RemoveManyTest);
+
+TYPED_TEST_P(BlockStore2RemoveManyTest, givenEmptyList_whenRemovingMany_thenRemovesNothing) {
+  blockstore::BlockId blockId = this->blockStore->create(cpputils::Data(10));
+  EXPECT_EQ(0u, this->blockStore->removeMany({}));
+  EXPECT_NE(boost::none, this->blockStore->load(blockId));
+}
+
+TYPED_TEST_P(BlockStore2RemoveManyTest, givenExistingBlocks_whenRemovingMany_thenBlocksAreNotLoadableAnymore) {
+  std::vector<blockstore::BlockId> blockIds;
+  for (int i = 0; i < 50; ++i) {
+    blockIds.push_back(this->blockStore->create(cpputils::DataFixture::generate(100, i)));
+  }
+  EXPECT_EQ(50u, this->blockStore->removeMany(blockIds));
+  for (const auto &blockId : blockIds) {
+    EXPECT_EQ(boost::none, this->blockStore->load(blockId));
+  }
+}
+
+TYPED_TEST_P(BlockStore2RemoveManyTest, givenExistingBlocks_whenRemovingSomeOfThem_thenOthersStillExist) {
+  std::vector<blockstore::BlockId> toRemove;
+  std::vector<blockstore::BlockId> toKeep;
+  for (int i = 0; i < 20; ++i) {
+    toRemove.push_back(this->blockStore->create(cpputils::DataFixture::generate(100, i)));
+    toKeep.push_back(this->blockStore->create(cpputils::DataFixture::generate(100, 100 + i)));
+  }
+  EXPECT_EQ(20u, this->blockStore->removeMany(toRemove));
+  EXPECT_EQ(20u, this->blockStore->numBlocks());
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_EQ(cpputils::DataFixture::generate(100, 100 + i), this->blockStore->load(toKeep[i]).value());
+  }
+}
+
+TYPED_TEST_P(BlockStore2RemoveManyTest, givenNonexistingBlocks_whenRemovingMany_thenOnlyCountsExistingBlocks) {
+  blockstore::BlockId existing1 = this->blockStore->create(cpputils::Data(10));
+  blockstore::BlockId existing2 = this->blockStore->create(cpputils::Data(10));
+  blockstore::BlockId nonexisting = blockstore::BlockId::FromString("1491BB4932A389EE14BC7090AC772972");
+  EXPECT_EQ(2u, this->blockStore->removeMany({existing1, nonexisting, existing2}));
+  EXPECT_EQ(0u, this->blockStore->numBlocks());
+}
+
+REGISTER_TYPED_TEST_SUITE_P(BlockStore2RemoveManyTest,
+  givenEmptyList_whenRemovingMany_thenRemovesNothing,
+  givenExistingBlocks_whenRemovingMany_thenBlocksAreNotLoadableAnymore,
+  givenExistingBlocks_whenRemovingSomeOfThem_thenOthersStillExist,
+  givenNonexistingBlocks_whenRemovingMany_thenOnlyCountsExistingBlocks
+);
+
+
+template<class ConcreteBlockStoreTestFixture>
+class BlockStore2StoreManyTest: public BlockStore2Test<ConcreteBlockStoreTestFixture> {
+public:
+  std::vector<std::pair<blockstore::BlockId, cpputils::Data>> generateBlocks(const std::vector<blockstore::BlockId> &blockIds, int seed) {
+    std::vector<std::pair<blockstore::BlockId, cpputils::Data>> blocks;
+    for (size_t i = 0; i < blockIds.size(); ++i) {
+      blocks.emplace_back(blockIds[i], cpputils::DataFixture::generate(100, seed + i));
+    }
+    return blocks;
+  }
+};
+
+TYPED_TEST_SUITE_P(BlockStore2StoreManyTest);
+
+TYPED_TEST_P(BlockStore2StoreManyTest, givenEmptyList_whenStoringMany_thenStoresNothing) {
+  this->blockStore->storeMany({});
+  EXPECT_EQ(0u, this->blockStore->numBlocks());
+}
+
+TYPED_TEST_P(BlockStore2StoreManyTest, givenNonexistingBlocks_whenStoringMany_thenBlocksAreLoadable) {
+  std::vector<blockstore::BlockId> blockIds;
+  for (int i = 0; i < 50; ++i) {
+    blockIds.push_back(this->blockStore->createBlockId());
+  }
+  this->blockStore->storeMany(this->generateBlocks(blockIds, 0));
+  EXPECT_EQ(50u, this->blockStore->numBlocks());
+  for (size_t i = 0; i < blockIds.size(); ++i) {
+    EXPECT_EQ(cpputils::DataFixture::generate(100, i), this->blockStore->load(blockIds[i]).value());
+  }
+}
+
+TYPED_TEST_P(BlockStore2StoreManyTest, givenExistingBlocks_whenStoringMany_thenBlocksAreOverwritten) {
+  std::vector<blockstore::BlockId> blockIds;
+  for (int i = 0; i < 50; ++i) {
+    blockIds.push_back(this->blockStore->create(cpputils::DataFixture::generate(100, i)));
+  }
+  this->blockStore->storeMany(this->generateBlocks(blockIds, 1000));
+  EXPECT_EQ(50u, this->blockStore->numBlocks());
+  for (size_t i = 0; i < blockIds.size(); ++i) {
+    EXPECT_EQ(cpputils::DataFixture::generate(100, 1000 + i), this->blockStore->load(blockIds[i]).value());
+  }
+}
+
+TYPED_TEST_P(BlockStore2StoreManyTest, givenOneBlock_whenStoringMany_thenBlockIsLoadable) {
+  blockstore::BlockId blockId = this->blockStore->createBlockId();
+  this->blockStore->storeMany(this->generateBlocks({blockId}, 0));
+  EXPECT_EQ(cpputils::DataFixture::generate(100, 0), this->blockStore->load(blockId).value());
+}
+
+TYPED_TEST_P(BlockStore2StoreManyTest, givenOtherBlocks_whenStoringMany_thenOtherBlocksAreUnchanged) {
+  blockstore::BlockId other = this->blockStore->create(cpputils::DataFixture::generate(100, 5000));
+  std::vector<blockstore::BlockId> blockIds;
+  for (int i = 0; i < 10; ++i) {
+    blockIds.push_back(this->blockStore->createBlockId());
+  }
+  this->blockStore->storeMany(this->generateBlocks(blockIds, 0));
+  EXPECT_EQ(11u, this->blockStore->numBlocks());
+  EXPECT_EQ(cpputils::DataFixture::generate(100, 5000), this->blockStore->load(other).value());
+}
+
+REGISTER_TYPED_TEST_SUITE_P(BlockStore2StoreManyTest,
+  givenEmptyList_whenStoringMany_thenStoresNothing,
+  givenNonexistingBlocks_whenStoringMany_thenBlocksAreLoadable,
+  givenExistingBlocks_whenStoringMany_thenBlocksAreOverwritten,
+  givenOneBlock_whenStoringMany_thenBlockIsLoadable,
+  givenOtherBlocks_whenStoringMany_thenOtherBlocksAreUnchanged
+);
+
+
+
+template<class ConcreteBlockStoreTestFixture>
+class BlockStore2LoadSharedTest: public BlockStore2Test<ConcreteBlockStoreTestFixture> {
+};
+
+TYPED_TEST_SUITE_P(BlockStore2LoadSharedTest);
+
+TYPED_TEST_P(BlockStore2LoadSharedTest, givenNonexistingBlock_whenLoadingShared_thenFails) {
+  blockstore::BlockId blockId = blockstore::BlockId::FromString("1491BB4932A389EE14BC7090AC772972");
+  EXPECT_EQ(boost::none, this->blockStore->loadShared(blockId));
+}
+
+TYPED_TEST_P(BlockStore2LoadSharedTest, givenExistingBlock_whenLoadingShared_thenCorrectBlockLoads) {
+  blockstore::BlockId blockId = this->blockStore->create(cpputils::DataFixture::generate(1024, 1));
+  EXPECT_EQ(cpputils::DataFixture::generate(1024, 1), *this->blockStore->loadShared(blockId).value());
+}
+
+TYPED_TEST_P(BlockStore2LoadSharedTest, givenRemovedBlock_whenLoadingShared_thenFails) {
+  blockstore::BlockId blockId = this->blockStore->create(cpputils::DataFixture::generate(1024, 1));
+  EXPECT_TRUE(this->blockStore->remove(blockId));
+  EXPECT_EQ(boost::none, this->blockStore->loadShared(blockId));
+}
+
+TYPED_TEST_P(BlockStore2LoadSharedTest, givenSharedData_whenStoringBlock_thenSharedDataIsUnchanged) {
+  blockstore::BlockId blockId = this->blockStore->create(cpputils::DataFixture::generate(1024, 1));
+  std::shared_ptr<const cpputils::Data> loaded = this->blockStore->loadShared(blockId).value();
+  this->blockStore->store(blockId, cpputils::DataFixture::generate(1024, 2));
+  EXPECT_EQ(cpputils::DataFixture::generate(1024, 1), *loaded);
+  EXPECT_EQ(cpputils::DataFixture::generate(1024, 2), *this->blockStore->loadShared(blockId).value());
+}
+
+TYPED_TEST_P(BlockStore2LoadSharedTest, givenSharedData_whenRemovingBlock_thenSharedDataIsUnchanged) {
+  blockstore::BlockId blockId = this->blockStore->create(cpputils::DataFixture::generate(1024, 1));
+  std::shared_ptr<const cpputils::Data> loaded = this->blockStore->loadShared(blockId).value();
+  EXPECT_TRUE(this->blockStore->remove(blockId));
+  EXPECT_EQ(cpputils::DataFixture::generate(1024, 1), *loaded);
+}
+
+REGISTER_TYPED_TEST_SUITE_P(BlockStore2LoadSharedTest,
+  givenNonexistingBlock_whenLoadingShared_thenFails,
+  givenExistingBlock_whenLoadingShared_thenCorrectBlockLoads,
+  givenRemovedBlock_whenLoadingShared_thenFails,
+  givenSharedData_whenStoringBlock_thenSharedDataIsUnchanged,
+  givenSharedData_whenRemovingBlock_thenSharedDataIsUnchanged
+);
+
 #endif
@@ -6,6 +6,7 @@
 #include "cpp-utils/data/DataFixture.h"
 #include "cpp-utils/data/Data.h"
 #include <boost/optional/optional_io.hpp>
+#include <thread>
 
 using namespace cpputils;
 using std::string;
@@ -51,6 +52,14 @@ public:
     return Cipher::decrypt(static_cast<const CryptoPP::byte*>(ciphertext.data()), ciphertext.size(), this->encKey).value();
   }
 
+  static Data Encrypt(const Data &plaintext, const typename Cipher::EncryptionKey &key) {
+    return Cipher::encrypt(static_cast<const CryptoPP::byte*>(plaintext.data()), plaintext.size(), key);
+  }
+
+  static boost::optional<Data> Decrypt(const Data &ciphertext, const typename Cipher::EncryptionKey &key) {
+    return Cipher::decrypt(static_cast<const CryptoPP::byte*>(ciphertext.data()), ciphertext.size(), key);
+  }
+
   static Data CreateZeroes(unsigned int size) {
     return Data(size).FillWithZeroes();
   }
@@ -106,6 +115,16 @@ TYPED_TEST_P(CipherTest, EncryptedSize) {
   }
 }
 
+TYPED_TEST_P(CipherTest, EncryptWithHeadroom) {
+  for (auto size: SIZES) {
+    Data plaintext = this->CreateData(size);
+    Data ciphertext = TypeParam::encrypt(static_cast<const CryptoPP::byte*>(plaintext.data()), plaintext.size(), this->encKey, 10);
+    EXPECT_EQ(10u, ciphertext.headroom());
+    EXPECT_EQ(TypeParam::ciphertextSize(plaintext.size()), ciphertext.size());
+    EXPECT_EQ(plaintext, this->Decrypt(ciphertext));
+  }
+}
+
 TYPED_TEST_P(CipherTest, TryDecryptDataThatIsTooSmall) {
   Data tooSmallCiphertext(TypeParam::ciphertextSize(0) - 1);
   this->ExpectDoesntDecrypt(tooSmallCiphertext);
@@ -123,6 +142,39 @@ TYPED_TEST_P(CipherTest, TryDecryptDataThatIsMuchTooSmall_1) {
   this->ExpectDoesntDecrypt(tooSmallCiphertext);
 }
 
+TYPED_TEST_P(CipherTest, EncryptThenDecrypt_AlternatingKeys) {
+  auto key1 = this->createKeyFixture(1);
+  auto key2 = this->createKeyFixture(2);
+  Data plaintext = this->CreateData(1024);
+  Data ciphertext1 = this->Encrypt(plaintext, key1);
+  Data ciphertext2 = this->Encrypt(plaintext, key2);
+  EXPECT_EQ(plaintext, this->Decrypt(ciphertext1, key1).value());
+  EXPECT_EQ(plaintext, this->Decrypt(ciphertext2, key2).value());
+  EXPECT_EQ(plaintext, this->Decrypt(ciphertext1, key1).value());
+}
+
+TYPED_TEST_P(CipherTest, EncryptThenDecrypt_InDifferentThreads) {
+  Data plaintext = this->CreateData(1024);
+  Data ciphertext = this->Encrypt(plaintext);
+  boost::optional<Data> decrypted = boost::none;
+  std::thread thread([&] {
+    decrypted = this->Decrypt(ciphertext, this->encKey);
+  });
+  thread.join();
+  EXPECT_EQ(plaintext, decrypted.value());
+}
+
+TYPED_TEST_P(CipherTest, EncryptThenDecrypt_AfterOtherKeyWasDestructed) {
+  Data plaintext = this->CreateData(1024);
+  Data ciphertext = this->Encrypt(plaintext);
+  {
+    auto otherKey = this->createKeyFixture(1);
+    this->Encrypt(plaintext, otherKey);
+  }
+  EXPECT_EQ(plaintext, this->Decrypt(ciphertext));
+  EXPECT_EQ(plaintext, this->Decrypt(this->Encrypt(plaintext)));
+}
+
 REGISTER_TYPED_TEST_SUITE_P(CipherTest,
     Size,
     EncryptThenDecrypt_Zeroes,
@@ -130,11 +182,26 @@ REGISTER_TYPED_TEST_SUITE_P(CipherTest,
     EncryptIsIndeterministic_Zeroes,
     EncryptIsIndeterministic_Data,
     EncryptedSize,
+    EncryptWithHeadroom,
     TryDecryptDataThatIsTooSmall,
     TryDecryptDataThatIsMuchTooSmall_0,
-    TryDecryptDataThatIsMuchTooSmall_1
+    TryDecryptDataThatIsMuchTooSmall_1,
+    EncryptThenDecrypt_AlternatingKeys,
+    EncryptThenDecrypt_InDifferentThreads,
+    EncryptThenDecrypt_AfterOtherKeyWasDestructed
 );
 
+TEST(EncryptionKeyTest, DestructingLastCopyIncreasesDestructionGeneration) {
+  const uint64_t generationBefore = EncryptionKey::destructionGeneration();
+  boost::optional<EncryptionKey> key = EncryptionKey::Null(32);
+  {
+    EncryptionKey copy = *key; // NOLINT (intentional copy)
+  }
+  EXPECT_EQ(generationBefore, EncryptionKey::destructionGeneration());
+  key = boost::none;
+  EXPECT_LT(generationBefore, EncryptionKey::destructionGeneration());
+}
+
 template<class Cipher>
 class AuthenticatedCipherTest: public CipherTest<Cipher> {
 public:
@@ -210,6 +277,13 @@ TYPED_TEST_P(AuthenticatedCipherTest, TryDecryptRandomData) {
   this->ExpectDoesntDecrypt(this->plaintext2);
 }
 
+TYPED_TEST_P(AuthenticatedCipherTest, DecryptWithWrongKeyFailsButDoesntAffectCorrectKey) {
+  auto otherKey = this->createKeyFixture(1);
+  Data ciphertext = this->Encrypt(this->plaintext1);
+  EXPECT_FALSE(this->Decrypt(ciphertext, otherKey));
+  EXPECT_EQ(this->plaintext1, this->Decrypt(ciphertext));
+}
+
 REGISTER_TYPED_TEST_SUITE_P(AuthenticatedCipherTest,
   ModifyFirstByte_Zeroes_Size1,
   ModifyFirstByte_Zeroes,
@@ -220,7 +294,8 @@ REGISTER_TYPED_TEST_SUITE_P(AuthenticatedCipherTest,
   ModifyMiddleByte_Zeroes,
   ModifyMiddleByte_Data,
   TryDecryptZeroesData,
-  TryDecryptRandomData
+  TryDecryptRandomData,
+  DecryptWithWrongKeyFailsButDoesntAffectCorrectKey
 );
 
 
@@ -262,6 +337,11 @@ INSTANTIATE_TYPED_TEST_SUITE_P(Mars128_CFB, CipherTest, Mars128_CFB); //CFB mode
 INSTANTIATE_TYPED_TEST_SUITE_P(Mars128_GCM, CipherTest, Mars128_GCM);
 INSTANTIATE_TYPED_TEST_SUITE_P(Mars128_GCM, AuthenticatedCipherTest, Mars128_GCM);
 
+INSTANTIATE_TYPED_TEST_SUITE_P(ChaCha20_Poly1305, CipherTest, ChaCha20_Poly1305);
+INSTANTIATE_TYPED_TEST_SUITE_P(ChaCha20_Poly1305, AuthenticatedCipherTest, ChaCha20_Poly1305);
+INSTANTIATE_TYPED_TEST_SUITE_P(XChaCha20_Poly1305, CipherTest, XChaCha20_Poly1305);
+INSTANTIATE_TYPED_TEST_SUITE_P(XChaCha20_Poly1305, AuthenticatedCipherTest, XChaCha20_Poly1305);
+
 
 // Test cipher names
 TEST(CipherNameTest, TestCipherNames) {
@@ -290,4 +370,7 @@ TEST(CipherNameTest, TestCipherNames) {
   EXPECT_EQ("mars-256-cfb", string(Mars256_CFB::NAME));
   EXPECT_EQ("mars-128-gcm", string(Mars128_GCM::NAME));
   EXPECT_EQ("mars-128-cfb", string(Mars128_CFB::NAME));
+
+  EXPECT_EQ("chacha20-poly1305", string(ChaCha20_Poly1305::NAME));
+  EXPECT_EQ("xchacha20-poly1305", string(XChaCha20_Poly1305::NAME));
 }
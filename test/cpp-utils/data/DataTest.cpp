@@ -156,6 +156,53 @@ TEST_F(DataTest, MoveAssignment) {
   EXPECT_EQ(0u, original.size()); // NOLINT (intentional use-after-move)
 }
 
+TEST_F(DataTest, WithHeadroom) {
+  Data data = Data::WithHeadroom(1024, 16);
+  EXPECT_EQ(1024u, data.size());
+  EXPECT_EQ(16u, data.headroom());
+}
+
+TEST_F(DataTest, GrowIntoHeadroom) {
+  Data data = Data::WithHeadroom(1024, 16);
+  std::memcpy(data.data(), DataFixture::generate(1024).data(), 1024);
+  const void *oldData = data.data();
+  data.growIntoHeadroom(10);
+  EXPECT_EQ(1034u, data.size());
+  EXPECT_EQ(6u, data.headroom());
+  EXPECT_EQ(oldData, data.dataOffset(10));
+  EXPECT_EQ(0, std::memcmp(DataFixture::generate(1024).data(), data.dataOffset(10), 1024));
+}
+
+TEST_F(DataTest, RemovePrefix) {
+  Data data = DataFixture::generate(1024);
+  data.removePrefix(24);
+  EXPECT_EQ(1000u, data.size());
+  EXPECT_EQ(24u, data.headroom());
+  EXPECT_EQ(0, std::memcmp(DataFixture::generate(1024).dataOffset(24), data.data(), 1000));
+}
+
+TEST_F(DataTest, RemovePrefixAndGrowIntoHeadroomAgain) {
+  Data data = DataFixture::generate(1024);
+  data.removePrefix(24);
+  data.growIntoHeadroom(24);
+  EXPECT_EQ(DataFixture::generate(1024), data);
+}
+
+TEST_F(DataTest, MoveConstructorKeepsHeadroom) {
+  Data original = Data::WithHeadroom(1024, 16);
+  Data moved(std::move(original));
+  EXPECT_EQ(1024u, moved.size());
+  EXPECT_EQ(16u, moved.headroom());
+}
+
+TEST_F(DataTest, CopyDoesntCopyHeadroom) {
+  Data data = DataFixture::generate(1024);
+  data.removePrefix(24);
+  Data copy = data.copy();
+  EXPECT_EQ(data, copy);
+  EXPECT_EQ(0u, copy.headroom());
+}
+
 TEST_F(DataTest, Equality) {
   Data data1 = DataFixture::generate(1024);
   Data data2 = DataFixture::generate(1024);
@@ -255,6 +302,14 @@ TEST_F(DataTestWithMockAllocator, whenDestructingData_thenFreesItInAllocator) {
     EXPECT_CALL(*allocator_ptr, free(&ptr_target, 5)).Times(1);
 }
 
+TEST_F(DataTestWithMockAllocator, whenDestructingDataWithRemovedPrefix_thenFreesWholeAllocation) {
+    EXPECT_CALL(*allocator, allocate(5)).Times(1).WillOnce(Return(&ptr_target));
+    Data data(5, std::move(allocator));
+    data.removePrefix(2);
+
+    EXPECT_CALL(*allocator_ptr, free(&ptr_target, 5)).Times(1);
+}
+
 TEST_F(DataTestWithMockAllocator, whenMoveConstructing_thenOnlyFreesOnce) {
     EXPECT_CALL(*allocator, allocate(5)).Times(1).WillOnce(Return(&ptr_target));
 
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include "cpp-utils/data/PooledAllocator.h"
+#include "cpp-utils/data/Data.h"
+#include <thread>
+#include <vector>
+
+using cpputils::PooledAllocator;
+using cpputils::Data;
+
+class PooledAllocatorTest : public ::testing::Test {
+public:
+  PooledAllocator &allocator = PooledAllocator::singleton();
+};
+
+TEST_F(PooledAllocatorTest, whenFreeingAndAllocatingSameSize_thenReusesBuffer) {
+  void *ptr = allocator.allocate(32 * 1024);
+  allocator.free(ptr, 32 * 1024);
+  void *ptr2 = allocator.allocate(32 * 1024);
+  EXPECT_EQ(ptr, ptr2);
+  allocator.free(ptr2, 32 * 1024);
+}
+
+TEST_F(PooledAllocatorTest, whenFreeingAndAllocatingSameSizeClass_thenReusesBuffer) {
+  void *ptr = allocator.allocate(32 * 1024 + 10);
+  allocator.free(ptr, 32 * 1024 + 10);
+  void *ptr2 = allocator.allocate(32 * 1024 + 100);
+  EXPECT_EQ(ptr, ptr2);
+  allocator.free(ptr2, 32 * 1024 + 100);
+}
+
+TEST_F(PooledAllocatorTest, whenReusingBuffer_thenCountsPoolHit) {
+  void *ptr = allocator.allocate(16 * 1024);
+  allocator.free(ptr, 16 * 1024);
+  auto before = PooledAllocator::statistics();
+  ptr = allocator.allocate(16 * 1024);
+  auto after = PooledAllocator::statistics();
+  allocator.free(ptr, 16 * 1024);
+  EXPECT_LE(before.numPoolHits + 1, after.numPoolHits);
+}
+
+TEST_F(PooledAllocatorTest, whenAllocatingSmallSize_thenCountsUnpooledAllocation) {
+  auto before = PooledAllocator::statistics();
+  void *ptr = allocator.allocate(10);
+  auto after = PooledAllocator::statistics();
+  allocator.free(ptr, 10);
+  EXPECT_LE(before.numUnpooledAllocations + 1, after.numUnpooledAllocations);
+}
+
+TEST_F(PooledAllocatorTest, whenAllocatingZeroBytes_thenReturnsValidPointer) {
+  void *ptr = allocator.allocate(0);
+  EXPECT_NE(nullptr, ptr);
+  allocator.free(ptr, 0);
+}
+
+TEST_F(PooledAllocatorTest, whenAllocatingLargeSize_thenWorks) {
+  constexpr size_t size = PooledAllocator::MAX_POOLED_SIZE + 1;
+  void *ptr = allocator.allocate(size);
+  EXPECT_NE(nullptr, ptr);
+  std::memset(ptr, 0, size);
+  allocator.free(ptr, size);
+}
+
+TEST_F(PooledAllocatorTest, whenFreeingMoreThanCacheLimit_thenWorks) {
+  constexpr size_t size = PooledAllocator::MAX_POOLED_SIZE;
+  std::vector<void*> buffers;
+  for (size_t i = 0; i < 2 * PooledAllocator::MAX_CACHED_BYTES_PER_THREAD / size; ++i) {
+    buffers.push_back(allocator.allocate(size));
+  }
+  for (void *ptr : buffers) {
+    allocator.free(ptr, size);
+  }
+}
+
+TEST_F(PooledAllocatorTest, whenFreeingInDifferentThread_thenWorks) {
+  void *ptr = allocator.allocate(32 * 1024);
+  std::thread thread([&] {
+    allocator.free(ptr, 32 * 1024);
+  });
+  thread.join();
+}
+
+TEST_F(PooledAllocatorTest, whenDataIsDestructed_thenItsBufferIsReused) {
+  const void *ptr = nullptr;
+  {
+    Data data(32 * 1024);
+    ptr = data.data();
+  }
+  Data data2(32 * 1024);
+  EXPECT_EQ(ptr, data2.data());
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include <cpp-utils/system/keyring.h>
+#include <cpp-utils/data/DataFixture.h>
+#include <cpp-utils/random/Random.h>
+
+using cpputils::Data;
+using cpputils::DataFixture;
+using cpputils::Random;
+namespace keyring = cpputils::keyring;
+
+#if defined(__linux__)
+
+class KeyringTest : public ::testing::Test {
+public:
+    void SetUp() override {
+        if (!keyring::isSupported()) {
+            // e.g. in containers that forbid the keyring syscalls
+            GTEST_SKIP() << "The kernel keyring isn't usable here";
+        }
+    }
+
+    void TearDown() override {
+        keyring::remove(description);
+    }
+
+    // Random, so that tests running in parallel or an earlier crashed test run don't interfere
+    const std::string description = "cryfs-test:" + Random::PseudoRandom().getFixedSize<16>().ToString();
+};
+
+TEST_F(KeyringTest, givenNoEntry_whenLoading_thenReturnsFalse) {
+    Data target(32);
+    EXPECT_FALSE(keyring::load(description, target.data(), target.size()));
+}
+
+TEST_F(KeyringTest, givenStoredEntry_whenLoading_thenReturnsData) {
+    Data data = DataFixture::generate(32);
+    keyring::store(description, data.data(), data.size(), std::chrono::seconds(60));
+    Data target(32);
+    EXPECT_TRUE(keyring::load(description, target.data(), target.size()));
+    EXPECT_EQ(data, target);
+}
+
+TEST_F(KeyringTest, givenStoredEntry_whenStoringAgain_thenReplacesData) {
+    Data data1 = DataFixture::generate(32, 1);
+    Data data2 = DataFixture::generate(32, 2);
+    keyring::store(description, data1.data(), data1.size(), std::chrono::seconds(60));
+    keyring::store(description, data2.data(), data2.size(), std::chrono::seconds(60));
+    Data target(32);
+    EXPECT_TRUE(keyring::load(description, target.data(), target.size()));
+    EXPECT_EQ(data2, target);
+}
+
+TEST_F(KeyringTest, givenStoredEntry_whenLoadingWithDifferentSize_thenReturnsFalse) {
+    Data data = DataFixture::generate(32);
+    keyring::store(description, data.data(), data.size(), std::chrono::seconds(60));
+    Data smallerTarget(16);
+    EXPECT_FALSE(keyring::load(description, smallerTarget.data(), smallerTarget.size()));
+    Data largerTarget(64);
+    EXPECT_FALSE(keyring::load(description, largerTarget.data(), largerTarget.size()));
+}
+
+TEST_F(KeyringTest, givenRemovedEntry_whenLoading_thenReturnsFalse) {
+    Data data = DataFixture::generate(32);
+    keyring::store(description, data.data(), data.size(), std::chrono::seconds(60));
+    keyring::remove(description);
+    Data target(32);
+    EXPECT_FALSE(keyring::load(description, target.data(), target.size()));
+}
+
+TEST_F(KeyringTest, givenNoEntry_whenRemoving_thenDoesntCrash) {
+    keyring::remove(description);
+}
+
+TEST_F(KeyringTest, givenZeroTimeout_whenStoring_thenThrows) {
+    Data data = DataFixture::generate(32);
+    EXPECT_THROW(
+        keyring::store(description, data.data(), data.size(), std::chrono::seconds(0)),
+        std::invalid_argument
+    );
+}
+
+TEST_F(KeyringTest, givenTimeoutTooLongForKernel_whenStoring_thenStoresEntry) {
+    Data data = DataFixture::generate(32);
+    keyring::store(description, data.data(), data.size(), std::chrono::hours(24 * 365 * 200));
+    Data target(32);
+    EXPECT_TRUE(keyring::load(description, target.data(), target.size()));
+    EXPECT_EQ(data, target);
+}
+
+#else
+
+TEST(KeyringTest, isNotSupported) {
+    EXPECT_FALSE(keyring::isSupported());
+    Data data = DataFixture::generate(32);
+    EXPECT_FALSE(keyring::load("cryfs-test", data.data(), data.size()));
+    EXPECT_ANY_THROW(
+        keyring::store("cryfs-test", data.data(), data.size(), std::chrono::seconds(60))
+    );
+}
+
+#endif
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include <cpp-utils/system/mappedfile.h>
+#include <cpp-utils/tempfile/TempFile.h>
+#include <boost/filesystem.hpp>
+#include <cstring>
+
+using cpputils::MappedFile;
+using cpputils::TempFile;
+
+TEST(MappedFileTest, CreatesFileWithGivenSize) {
+    TempFile file(false);
+    MappedFile mapped(file.path(), 1024);
+    EXPECT_TRUE(boost::filesystem::exists(file.path()));
+    EXPECT_EQ(1024u, mapped.size());
+    EXPECT_EQ(1024u, boost::filesystem::file_size(file.path()));
+}
+
+TEST(MappedFileTest, NewFileIsZero) {
+    TempFile file(false);
+    MappedFile mapped(file.path(), 1024);
+    const char *data = static_cast<const char*>(mapped.data());
+    for (size_t i = 0; i < mapped.size(); ++i) {
+        EXPECT_EQ(0, data[i]);
+    }
+}
+
+TEST(MappedFileTest, ChangesAreStoredInFile) {
+    TempFile file(false);
+    {
+        MappedFile mapped(file.path(), 1024);
+        std::memcpy(static_cast<char*>(mapped.data()) + 100, "content", 7);
+    }
+    MappedFile mapped(file.path(), 0);
+    EXPECT_EQ(1024u, mapped.size());
+    EXPECT_EQ(0, std::memcmp(static_cast<const char*>(mapped.data()) + 100, "content", 7));
+}
+
+TEST(MappedFileTest, GrowingKeepsContent) {
+    TempFile file(false);
+    {
+        MappedFile mapped(file.path(), 16);
+        std::memcpy(mapped.data(), "content", 7);
+    }
+    MappedFile mapped(file.path(), 2048);
+    EXPECT_EQ(2048u, mapped.size());
+    EXPECT_EQ(0, std::memcmp(mapped.data(), "content", 7));
+}
+
+TEST(MappedFileTest, DoesntShrinkFile) {
+    TempFile file(false);
+    {
+        MappedFile mapped(file.path(), 1024);
+    }
+    MappedFile mapped(file.path(), 16);
+    EXPECT_EQ(1024u, mapped.size());
+}
+
+TEST(MappedFileTest, EmptyFileCantBeMapped) {
+    TempFile file(true);
+    EXPECT_ANY_THROW(
+        MappedFile(file.path(), 0)
+    );
+}
+
+TEST(MappedFileTest, MoveConstructorTakesOverMapping) {
+    TempFile file(false);
+    MappedFile source(file.path(), 1024);
+    void *data = source.data();
+    MappedFile target(std::move(source));
+    EXPECT_EQ(data, target.data());
+    EXPECT_EQ(1024u, target.size());
+}
+
+TEST(MappedFileTest, FlushDoesntCrash) {
+    TempFile file(false);
+    MappedFile mapped(file.path(), 1024);
+    std::memcpy(mapped.data(), "content", 7);
+    mapped.flush();
+}
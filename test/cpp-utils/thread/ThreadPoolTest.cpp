@@ -0,0 +1,113 @@
+#include <cpp-utils/thread/ThreadPool.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using cpputils::ThreadPool;
+using std::vector;
+using std::future;
+
+TEST(ThreadPoolTest, givenTask_whenRunning_thenReturnsResult) {
+  ThreadPool pool(2, "test");
+  auto result = pool.run([] {return 5;});
+  EXPECT_EQ(5, result.get());
+}
+
+TEST(ThreadPoolTest, givenVoidTask_whenRunning_thenRunsTask) {
+  ThreadPool pool(2, "test");
+  bool executed = false;
+  pool.run([&executed] {executed = true;}).get();
+  EXPECT_TRUE(executed);
+}
+
+TEST(ThreadPoolTest, givenThrowingTask_whenRunning_thenRethrowsOnGet) {
+  ThreadPool pool(2, "test");
+  auto result = pool.run([] () -> int {throw std::runtime_error("my error");});
+  EXPECT_THROW(result.get(), std::runtime_error);
+}
+
+TEST(ThreadPoolTest, givenThrowingTask_whenRunning_thenPoolStillWorks) {
+  ThreadPool pool(1, "test");
+  auto failing = pool.run([] () -> int {throw std::runtime_error("my error");});
+  auto succeeding = pool.run([] {return 5;});
+  EXPECT_THROW(failing.get(), std::runtime_error);
+  EXPECT_EQ(5, succeeding.get());
+}
+
+TEST(ThreadPoolTest, givenMoreTasksThanThreads_whenRunning_thenRunsAllTasks) {
+  ThreadPool pool(3, "test");
+  std::atomic<int> counter(0);
+  vector<future<int>> results;
+  for (int i = 0; i < 100; ++i) {
+    results.push_back(pool.run([i, &counter] {++counter; return i;}));
+  }
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(i, results[i].get());
+  }
+  EXPECT_EQ(100, counter.load());
+}
+
+TEST(ThreadPoolTest, givenTasks_whenRunning_thenRunsOnWorkerThreads) {
+  ThreadPool pool(2, "test");
+  auto threadId = pool.run([] {return std::this_thread::get_id();});
+  EXPECT_NE(std::this_thread::get_id(), threadId.get());
+}
+
+TEST(ThreadPoolTest, givenUnusedPool_whenDestructing_thenDoesntCrash) {
+  ThreadPool pool(2, "test");
+}
+
+TEST(ThreadPoolTest, givenDefaultNumThreads_thenIsAtLeastTwo) {
+  EXPECT_LE(2u, ThreadPool::defaultNumThreads());
+}
+
+TEST(ThreadPoolTest, givenItems_whenRunningSlices_thenProcessesEachItemExactlyOnce) {
+  ThreadPool pool(3, "test");
+  vector<std::atomic<int>> processed(100);
+  for (auto &item : processed) {
+    item = 0;
+  }
+  pool.runSlices(processed.size(), [&processed] (size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      ++processed[i];
+    }
+  });
+  for (const auto &item : processed) {
+    EXPECT_EQ(1, item.load());
+  }
+}
+
+TEST(ThreadPoolTest, givenFewerItemsThanThreads_whenRunningSlices_thenDoesntRunEmptySlices) {
+  ThreadPool pool(4, "test");
+  std::atomic<int> numSlices(0);
+  pool.runSlices(2, [&numSlices] (size_t begin, size_t end) {
+    EXPECT_EQ(begin + 1, end);
+    ++numSlices;
+  });
+  EXPECT_EQ(2, numSlices.load());
+}
+
+TEST(ThreadPoolTest, givenNoItems_whenRunningSlices_thenDoesntRunTask) {
+  ThreadPool pool(2, "test");
+  pool.runSlices(0, [] (size_t, size_t) {
+    EXPECT_TRUE(false);
+  });
+}
+
+TEST(ThreadPoolTest, givenThrowingSlice_whenRunningSlices_thenRethrowsAfterAllSlicesFinished) {
+  ThreadPool pool(2, "test");
+  std::atomic<int> numFinished(0);
+  EXPECT_THROW(
+    pool.runSlices(2, [&numFinished] (size_t begin, size_t) {
+      if (begin == 0) {
+        throw std::runtime_error("my error");
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      ++numFinished;
+    }),
+    std::runtime_error
+  );
+  EXPECT_EQ(1, numFinished.load());
+}
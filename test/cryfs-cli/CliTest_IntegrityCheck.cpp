@@ -4,7 +4,6 @@
 #include <cpp-utils/crypto/kdf/Scrypt.h>
 #include <cpp-utils/data/DataFixture.h>
 #include <cpp-utils/tempfile/TempDir.h>
-#include <blockstore/implementations/caching/CachingBlockStore2.h>
 #include <cryfs/impl/filesystem/cachingfsblobstore/CachingFsBlobStore.h>
 
 using std::vector;
@@ -139,7 +138,9 @@ TEST_F(CliTest_IntegrityCheck, givenFilesystemWithRolledBackBasedir_whenMounting
 }
 
 TEST_F(CliTest_IntegrityCheck, whenRollingBackBasedirWhileMounted_thenUnmounts) {
-  vector<string> args{basedir.string().c_str(), mountdir.string().c_str(), "--cipher", "aes-256-gcm", "-f"};
+  // The block cache keeps clean blocks until it needs the space, so make it too small to keep any block.
+  // Otherwise, reading the file after the roll back wouldn't load it from the base directory.
+  vector<string> args{basedir.string().c_str(), mountdir.string().c_str(), "--cipher", "aes-256-gcm", "--cache-size", "1", "-f"};
   //TODO Remove "-f" parameter, once EXPECT_RUN_SUCCESS/EXPECT_RUN_ERROR can handle that
 
   // create a filesystem with one file
@@ -156,8 +157,8 @@ TEST_F(CliTest_IntegrityCheck, whenRollingBackBasedirWhileMounted_thenUnmounts)
     writeFile(mountdir / "myfile", "hello world 2");
     ASSERT(readingFileIsSuccessful(mountdir / "myfile"), ""); // just to make sure reading usually works
 
-    // wait for cache timeout (i.e. flush file system to disk)
-    constexpr auto cache_timeout = blockstore::caching::CachingBlockStore2::MAX_LIFETIME_SEC + cryfs::cachingfsblobstore::CachingFsBlobStore::MAX_LIFETIME_SEC;
+    // wait for cache timeout (i.e. flush file system to disk and forget the cached blobs)
+    constexpr auto cache_timeout = cryfs::cachingfsblobstore::CachingFsBlobStore::MAX_CLEAN_LIFETIME_SEC;
     boost::this_thread::sleep_for(boost::chrono::seconds(static_cast<int>(std::ceil(cache_timeout * 3))));
 
     // roll back base directory
@@ -224,6 +224,48 @@ TEST_F(ProgramOptionsParserTest, BlocksizeNotGiven) {
     EXPECT_EQ(none, options.blocksizeBytes());
 }
 
+TEST_F(ProgramOptionsParserTest, CacheSizeGiven) {
+    ProgramOptions options = parse({"./myExecutable", basedir, "--cache-size", "4G", mountdir});
+    EXPECT_EQ(static_cast<uint64_t>(4) * 1024 * 1024 * 1024, options.cacheSizeBytes().value());
+}
+
+TEST_F(ProgramOptionsParserTest, CacheSizeNotGiven) {
+    ProgramOptions options = parse({"./myExecutable", basedir, mountdir});
+    EXPECT_EQ(none, options.cacheSizeBytes());
+}
+
+TEST_F(ProgramOptionsParserTest, InvalidCacheSize) {
+    try {
+      parse({"./myExecutable", basedir, "--cache-size", "4X", mountdir});
+      EXPECT_TRUE(false); // expect throw
+    } catch (const CryfsException& e) {
+      EXPECT_EQ(ErrorCode::InvalidArguments, e.errorCode());
+      EXPECT_THAT(e.what(), testing::MatchesRegex(".*Invalid cache size: 4X.*"));
+    }
+}
+
+#if defined(__linux__)
+TEST_F(ProgramOptionsParserTest, CacheKeyGiven) {
+    ProgramOptions options = parse({"./myExecutable", basedir, "--cache-key", "30", mountdir});
+    EXPECT_EQ(30, options.cacheKeyMinutes().value());
+}
+
+TEST_F(ProgramOptionsParserTest, InvalidCacheKey) {
+    try {
+      parse({"./myExecutable", basedir, "--cache-key", "0", mountdir});
+      EXPECT_TRUE(false); // expect throw
+    } catch (const CryfsException& e) {
+      EXPECT_EQ(ErrorCode::InvalidArguments, e.errorCode());
+      EXPECT_THAT(e.what(), testing::MatchesRegex(".*Invalid key cache duration.*"));
+    }
+}
+#endif
+
+TEST_F(ProgramOptionsParserTest, CacheKeyNotGiven) {
+    ProgramOptions options = parse({"./myExecutable", basedir, mountdir});
+    EXPECT_EQ(none, options.cacheKeyMinutes());
+}
+
 TEST_F(ProgramOptionsParserTest, MissingBlockIsIntegrityViolationGiven_True) {
     ProgramOptions options = parse({"./myExecutable", basedir, "--missing-block-is-integrity-violation", "true", mountdir});
     EXPECT_TRUE(options.missingBlockIsIntegrityViolation().value());
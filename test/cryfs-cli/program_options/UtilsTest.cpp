@@ -1,10 +1,12 @@
 #include "testutils/ProgramOptionsTestBase.h"
 #include <cryfs-cli/program_options/utils.h>
+#include <boost/optional/optional_io.hpp>
 
 using namespace cryfs_cli::program_options;
 using std::pair;
 using std::vector;
 using std::string;
+using boost::none;
 
 class ProgramOptionsUtilsTest: public ProgramOptionsTestBase {};
 
@@ -112,3 +114,35 @@ TEST_F(ProgramOptionsUtilsTest, SplitAtDoubleDash_RealisticCryfsOptions) {
     EXPECT_VECTOR_EQ({"./executableName", "rootDir", "mountDir"}, result.first);
     EXPECT_VECTOR_EQ({"-f"}, result.second);
 }
+
+TEST_F(ProgramOptionsUtilsTest, ParseByteSize_NoUnit) {
+    EXPECT_EQ(4096u, parseByteSize("4096").value());
+}
+
+TEST_F(ProgramOptionsUtilsTest, ParseByteSize_Units) {
+    EXPECT_EQ(512u * 1024, parseByteSize("512K").value());
+    EXPECT_EQ(64u * 1024 * 1024, parseByteSize("64M").value());
+    EXPECT_EQ(static_cast<uint64_t>(4) * 1024 * 1024 * 1024, parseByteSize("4G").value());
+    EXPECT_EQ(static_cast<uint64_t>(2) * 1024 * 1024 * 1024 * 1024, parseByteSize("2T").value());
+}
+
+TEST_F(ProgramOptionsUtilsTest, ParseByteSize_UnitVariants) {
+    EXPECT_EQ(100u, parseByteSize("100B").value());
+    EXPECT_EQ(64u * 1024 * 1024, parseByteSize("64m").value());
+    EXPECT_EQ(64u * 1024 * 1024, parseByteSize("64MB").value());
+    EXPECT_EQ(64u * 1024 * 1024, parseByteSize("64MiB").value());
+}
+
+TEST_F(ProgramOptionsUtilsTest, ParseByteSize_Invalid) {
+    EXPECT_EQ(none, parseByteSize(""));
+    EXPECT_EQ(none, parseByteSize("G"));
+    EXPECT_EQ(none, parseByteSize("-1"));
+    EXPECT_EQ(none, parseByteSize("4X"));
+    EXPECT_EQ(none, parseByteSize("4 G"));
+    EXPECT_EQ(none, parseByteSize("1.5G"));
+}
+
+TEST_F(ProgramOptionsUtilsTest, ParseByteSize_Overflow) {
+    EXPECT_EQ(none, parseByteSize("99999999999999999999"));
+    EXPECT_EQ(none, parseByteSize("99999999999T"));
+}
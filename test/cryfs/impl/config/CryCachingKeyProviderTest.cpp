@@ -0,0 +1,144 @@
+#include <cryfs/impl/config/CryCachingKeyProvider.h>
+#include <gmock/gmock.h>
+#include <cpp-utils/data/DataFixture.h>
+#include <cpp-utils/random/Random.h>
+
+using cpputils::unique_ref;
+using cpputils::make_unique_ref;
+using cpputils::EncryptionKey;
+using cpputils::Data;
+using cpputils::DataFixture;
+using cryfs::CryKeyProvider;
+using cryfs::CryCachingKeyProvider;
+using testing::Return;
+using testing::Invoke;
+using testing::Eq;
+using testing::Ref;
+using testing::_;
+
+#if defined(__linux__)
+
+namespace {
+class MockKeyProvider : public CryKeyProvider {
+public:
+  MOCK_METHOD(EncryptionKey, requestKeyForExistingFilesystem, (size_t keySize, const Data& kdfParameters), (override));
+  MOCK_METHOD(KeyResult, requestKeyForNewFilesystem, (size_t keySize), (override));
+};
+}
+
+class CryCachingKeyProviderTest : public ::testing::Test {
+public:
+  CryCachingKeyProviderTest()
+  : keyProvider_(make_unique_ref<MockKeyProvider>())
+  , keyProvider(keyProvider_.get())
+  , cachingKeyProvider(std::move(keyProvider_), std::chrono::seconds(60))
+  // Random parameters, so tests don't see cache entries from other tests or earlier test runs
+  , kdfParameters(cpputils::Random::PseudoRandom().get(100)) {}
+
+  ~CryCachingKeyProviderTest() override {
+    // Remove the cache entry, if the test created one
+    EXPECT_CALL(*keyProvider, requestKeyForExistingFilesystem(_, _)).WillRepeatedly(Return(EncryptionKey::Null(keySize)));
+    cachingKeyProvider.requestKeyForExistingFilesystem(keySize, kdfParameters);
+    cachingKeyProvider.keyWasWrong();
+  }
+
+  static constexpr size_t keySize = 32;
+  const EncryptionKey key = EncryptionKey::FromString(DataFixture::generate(keySize).ToString());
+
+  unique_ref<MockKeyProvider> keyProvider_;
+  MockKeyProvider* keyProvider;
+  CryCachingKeyProvider cachingKeyProvider;
+  Data kdfParameters;
+};
+
+constexpr size_t CryCachingKeyProviderTest::keySize;
+
+TEST_F(CryCachingKeyProviderTest, givenEmptyCache_whenRequestingKey_thenAsksUnderlyingProvider) {
+  EXPECT_CALL(*keyProvider, requestKeyForExistingFilesystem(Eq(keySize), Ref(kdfParameters))).Times(1).WillOnce(Return(key));
+  auto returnedKey = cachingKeyProvider.requestKeyForExistingFilesystem(keySize, kdfParameters);
+  EXPECT_EQ(key.ToString(), returnedKey.ToString());
+}
+
+TEST_F(CryCachingKeyProviderTest, givenCorrectKey_whenRequestingAgain_thenDoesntAskUnderlyingProvider) {
+  EXPECT_CALL(*keyProvider, requestKeyForExistingFilesystem(Eq(keySize), Ref(kdfParameters))).Times(1).WillOnce(Return(key));
+  cachingKeyProvider.requestKeyForExistingFilesystem(keySize, kdfParameters);
+  cachingKeyProvider.keyWasCorrect();
+  testing::Mock::VerifyAndClearExpectations(keyProvider);
+
+  EXPECT_CALL(*keyProvider, requestKeyForExistingFilesystem(_, _)).Times(0);
+  auto returnedKey = cachingKeyProvider.requestKeyForExistingFilesystem(keySize, kdfParameters);
+  EXPECT_EQ(key.ToString(), returnedKey.ToString());
+  testing::Mock::VerifyAndClearExpectations(keyProvider);
+}
+
+TEST_F(CryCachingKeyProviderTest, givenCorrectKey_whenUsingOtherProviderInstance_thenDoesntAskUnderlyingProvider) {
+  EXPECT_CALL(*keyProvider, requestKeyForExistingFilesystem(Eq(keySize), Ref(kdfParameters))).Times(1).WillOnce(Return(key));
+  cachingKeyProvider.requestKeyForExistingFilesystem(keySize, kdfParameters);
+  cachingKeyProvider.keyWasCorrect();
+
+  // This is what happens when the file system is mounted again
+  auto otherKeyProvider_ = make_unique_ref<MockKeyProvider>();
+  EXPECT_CALL(*otherKeyProvider_, requestKeyForExistingFilesystem(_, _)).Times(0);
+  CryCachingKeyProvider otherCachingKeyProvider(std::move(otherKeyProvider_), std::chrono::seconds(60));
+  auto returnedKey = otherCachingKeyProvider.requestKeyForExistingFilesystem(keySize, kdfParameters);
+  EXPECT_EQ(key.ToString(), returnedKey.ToString());
+}
+
+TEST_F(CryCachingKeyProviderTest, givenWrongKey_whenRequestingAgain_thenAsksUnderlyingProviderAgain) {
+  EXPECT_CALL(*keyProvider, requestKeyForExistingFilesystem(Eq(keySize), Ref(kdfParameters))).Times(2).WillRepeatedly(Return(key));
+  cachingKeyProvider.requestKeyForExistingFilesystem(keySize, kdfParameters);
+  cachingKeyProvider.keyWasWrong();
+  cachingKeyProvider.requestKeyForExistingFilesystem(keySize, kdfParameters);
+  testing::Mock::VerifyAndClearExpectations(keyProvider);
+}
+
+TEST_F(CryCachingKeyProviderTest, givenNotConfirmedKey_whenRequestingAgain_thenAsksUnderlyingProviderAgain) {
+  EXPECT_CALL(*keyProvider, requestKeyForExistingFilesystem(Eq(keySize), Ref(kdfParameters))).Times(2).WillRepeatedly(Return(key));
+  cachingKeyProvider.requestKeyForExistingFilesystem(keySize, kdfParameters);
+  cachingKeyProvider.requestKeyForExistingFilesystem(keySize, kdfParameters);
+  testing::Mock::VerifyAndClearExpectations(keyProvider);
+}
+
+TEST_F(CryCachingKeyProviderTest, givenCachedKeyTurnsOutWrong_whenRequestingAgain_thenAsksUnderlyingProviderAgain) {
+  EXPECT_CALL(*keyProvider, requestKeyForExistingFilesystem(Eq(keySize), Ref(kdfParameters))).Times(1).WillOnce(Return(key));
+  cachingKeyProvider.requestKeyForExistingFilesystem(keySize, kdfParameters);
+  cachingKeyProvider.keyWasCorrect();
+  cachingKeyProvider.requestKeyForExistingFilesystem(keySize, kdfParameters); // from cache
+  cachingKeyProvider.keyWasWrong();
+  testing::Mock::VerifyAndClearExpectations(keyProvider);
+
+  EXPECT_CALL(*keyProvider, requestKeyForExistingFilesystem(Eq(keySize), Ref(kdfParameters))).Times(1).WillOnce(Return(key));
+  cachingKeyProvider.requestKeyForExistingFilesystem(keySize, kdfParameters);
+  testing::Mock::VerifyAndClearExpectations(keyProvider);
+}
+
+TEST_F(CryCachingKeyProviderTest, givenOtherKdfParameters_whenRequestingKey_thenAsksUnderlyingProvider) {
+  EXPECT_CALL(*keyProvider, requestKeyForExistingFilesystem(Eq(keySize), Ref(kdfParameters))).Times(1).WillOnce(Return(key));
+  cachingKeyProvider.requestKeyForExistingFilesystem(keySize, kdfParameters);
+  cachingKeyProvider.keyWasCorrect();
+  testing::Mock::VerifyAndClearExpectations(keyProvider);
+
+  Data otherKdfParameters = kdfParameters.copy();
+  static_cast<uint8_t*>(otherKdfParameters.data())[0] ^= 1;
+  EXPECT_CALL(*keyProvider, requestKeyForExistingFilesystem(Eq(keySize), Ref(otherKdfParameters))).Times(1).WillOnce(Return(key));
+  cachingKeyProvider.requestKeyForExistingFilesystem(keySize, otherKdfParameters);
+  testing::Mock::VerifyAndClearExpectations(keyProvider);
+}
+
+TEST_F(CryCachingKeyProviderTest, givenNewFilesystem_whenKeyWasCorrect_thenCachesKey) {
+  EXPECT_CALL(*keyProvider, requestKeyForNewFilesystem(Eq(keySize))).Times(1).WillOnce(Invoke([&] (auto) {
+    return CryKeyProvider::KeyResult{key, kdfParameters.copy()};
+  }));
+  auto keyResult = cachingKeyProvider.requestKeyForNewFilesystem(keySize);
+  EXPECT_EQ(key.ToString(), keyResult.key.ToString());
+  EXPECT_EQ(kdfParameters, keyResult.kdfParameters);
+  cachingKeyProvider.keyWasCorrect();
+  testing::Mock::VerifyAndClearExpectations(keyProvider);
+
+  EXPECT_CALL(*keyProvider, requestKeyForExistingFilesystem(_, _)).Times(0);
+  auto returnedKey = cachingKeyProvider.requestKeyForExistingFilesystem(keySize, kdfParameters);
+  EXPECT_EQ(key.ToString(), returnedKey.ToString());
+  testing::Mock::VerifyAndClearExpectations(keyProvider);
+}
+
+#endif
@@ -78,7 +78,8 @@ TEST_F(CryCipherTest, FindsCorrectCipher) {
     "twofish-256-gcm", "twofish-256-cfb", "twofish-256-gcm", "twofish-256-cfb",
     "serpent-256-gcm", "serpent-256-cfb", "serpent-256-gcm", "serpent-256-cfb",
     "cast-256-gcm", "cast-256-cfb", "mars-448-gcm", "mars-448-cfb",
-    "mars-256-gcm", "mars-256-cfb", "mars-256-gcm", "mars-256-cfb"
+    "mars-256-gcm", "mars-256-cfb", "mars-256-gcm", "mars-256-cfb",
+    "chacha20-poly1305", "xchacha20-poly1305"
   });
 }
 
@@ -103,6 +104,8 @@ TEST_F(CryCipherTest, CreatesCorrectEncryptedBlockStore) {
     EXPECT_CREATES_CORRECT_ENCRYPTED_BLOCKSTORE<Mars256_CFB>("mars-256-cfb");
     EXPECT_CREATES_CORRECT_ENCRYPTED_BLOCKSTORE<Mars128_GCM>("mars-128-gcm");
     EXPECT_CREATES_CORRECT_ENCRYPTED_BLOCKSTORE<Mars128_CFB>("mars-128-cfb");
+    EXPECT_CREATES_CORRECT_ENCRYPTED_BLOCKSTORE<ChaCha20_Poly1305>("chacha20-poly1305");
+    EXPECT_CREATES_CORRECT_ENCRYPTED_BLOCKSTORE<XChaCha20_Poly1305>("xchacha20-poly1305");
 }
 
 TEST_F(CryCipherTest, SupportedCipherNamesContainsACipher) {
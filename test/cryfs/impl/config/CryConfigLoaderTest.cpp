@@ -162,15 +162,23 @@ public:
       cfg->save();
     }
 
+    void CreateWithoutFileSizesInDirEntries(const string &formatVersion, const string &password = "mypassword") {
+        auto cfg = loader(password, false).loadOrCreate(file.path(), false, false).right().configFile;
+        cfg->config()->SetVersion(formatVersion);
+        cfg->config()->SetFileSizesInDirEntries(false);
+        cfg->save();
+    }
+
+    // A format version that has to be migrated
     string olderVersion() {
-        auto versionInfo = gitversion::Parser::parse(CryConfig::FilesystemFormatVersion);
+        auto versionInfo = gitversion::Parser::parse(CryConfig::FilesystemFormatVersionWithoutFileSizesInDirEntries);
         string olderVersion;
         if (std::stol(versionInfo.minorVersion) > 0) {
             olderVersion = versionInfo.majorVersion + "." + std::to_string(std::stol(versionInfo.minorVersion) - 1) + ".9";
         } else {
             olderVersion = std::to_string(std::stol(versionInfo.majorVersion) - 1) + "." + versionInfo.minorVersion;
         }
-        assert(gitversion::VersionCompare::isOlderThan(olderVersion, CryConfig::FilesystemFormatVersion));
+        assert(gitversion::VersionCompare::isOlderThan(olderVersion, CryConfig::FilesystemFormatVersionWithoutFileSizesInDirEntries));
         return olderVersion;
     }
 
@@ -302,6 +310,27 @@ TEST_F(CryConfigLoaderTest, Version_Create) {
     EXPECT_EQ(gitversion::VersionString(), created->config()->CreatedWithVersion());
 }
 
+TEST_F(CryConfigLoaderTest, Version_Create_IsRefusedByVersionsWithoutFileSizesInDirEntries) {
+    // Older versions refuse file systems with a newer format version than their own (see CryConfigLoader::_checkVersion)
+    auto created = Create();
+    EXPECT_TRUE(created->config()->FileSizesInDirEntries());
+    EXPECT_TRUE(gitversion::VersionCompare::isOlderThan(CryConfig::FilesystemFormatVersionWithoutFileSizesInDirEntries, created->config()->Version()));
+}
+
+TEST_F(CryConfigLoaderTest, Version_LoadWithoutFileSizesInDirEntries_KeepsVersionReadableByOlderVersions) {
+    EXPECT_CALL(*console, askYesNo(HasSubstr("Do you want to attempt a migration now?"), _)).Times(0);
+    CreateWithoutFileSizesInDirEntries(CryConfig::FilesystemFormatVersionWithoutFileSizesInDirEntries);
+    auto loaded = LoadOrCreate().right();
+    EXPECT_FALSE(loaded->config()->FileSizesInDirEntries());
+    EXPECT_EQ(CryConfig::FilesystemFormatVersionWithoutFileSizesInDirEntries, loaded->config()->Version());
+}
+
+TEST_F(CryConfigLoaderTest, Version_MigrateWithoutFileSizesInDirEntries_GetsVersionReadableByOlderVersions) {
+    CreateWithoutFileSizesInDirEntries("0.9.6");
+    auto loaded = LoadOrCreate("mypassword", none, false, true).right();
+    EXPECT_EQ(CryConfig::FilesystemFormatVersionWithoutFileSizesInDirEntries, loaded->config()->Version());
+}
+
 TEST_F(CryConfigLoaderTest, FilesystemID_Load) {
     auto fixture = DataFixture::generateFixedSize<CryConfig::FilesystemID::BINARY_LENGTH>();
     CreateWithFilesystemID(fixture);
@@ -243,3 +243,19 @@ TEST_F(CryConfigTest, ExclusiveClientId_None_AfterSaveAndLoad) {
     CryConfig loaded = SaveAndLoad(std::move(cfg));
     EXPECT_EQ(none, loaded.ExclusiveClientId());
 }
+
+TEST_F(CryConfigTest, FileSizesInDirEntries_Init) {
+    EXPECT_TRUE(cfg.FileSizesInDirEntries());
+}
+
+TEST_F(CryConfigTest, FileSizesInDirEntries_False_AfterSaveAndLoad) {
+    cfg.SetFileSizesInDirEntries(false);
+    CryConfig loaded = SaveAndLoad(std::move(cfg));
+    EXPECT_FALSE(loaded.FileSizesInDirEntries());
+}
+
+TEST_F(CryConfigTest, FileSizesInDirEntries_True_AfterSaveAndLoad) {
+    cfg.SetFileSizesInDirEntries(true);
+    CryConfig loaded = SaveAndLoad(std::move(cfg));
+    EXPECT_TRUE(loaded.FileSizesInDirEntries());
+}
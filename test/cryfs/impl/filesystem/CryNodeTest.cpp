@@ -3,6 +3,11 @@
 #include <cryfs/impl/filesystem/CryDir.h>
 #include <cryfs/impl/filesystem/CryFile.h>
 #include <cryfs/impl/filesystem/CryOpenFile.h>
+#include <fspp/fs_interface/FuseErrnoException.h>
+#include <cpp-utils/system/time.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 using cpputils::unique_ref;
 using cpputils::dynamic_pointer_move;
@@ -41,6 +46,23 @@ public:
         auto createdSymlink = device().Load(path).value();
         return dynamic_pointer_move<CryNode>(createdSymlink).value();
     }
+
+    unique_ref<CryNode> LoadNode(const bf::path &path) {
+        auto node = device().Load(path).value();
+        return dynamic_pointer_move<CryNode>(node).value();
+    }
+
+    // Size stored in the dir entry of the node in its parent directory
+    boost::optional<fspp::num_bytes_t> StoredSize(const bf::path &path) {
+        auto parent = device().LoadDirBlobWithParent(path.parent_path()).blob;
+        return parent->GetChild(path.filename().string()).value().size();
+    }
+
+    // Modification time stored in the dir entry of the node in its parent directory
+    timespec StoredModificationTime(const bf::path &path) {
+        auto parent = device().LoadDirBlobWithParent(path.parent_path()).blob;
+        return parent->GetChild(path.filename().string()).value().lastModificationTime();
+    }
 };
 constexpr fspp::mode_t CryNodeTest::MODE_PUBLIC;
 
@@ -81,3 +103,191 @@ TEST_F(CryNodeTest, Rename_UpdatesParentPointers_Symlink) {
     node->rename("/mydir/newname");
     EXPECT_TRUE(node->checkParentPointer());
 }
+
+// The following test cases make sure that path lookups don't return stale results from the directory entry cache
+
+TEST_F(CryNodeTest, Load_AfterRenamingParentDir) {
+    this->CreateDir("/mydir");
+    this->CreateDir("/mydir/subdir");
+    this->CreateFile("/mydir/subdir/file");
+    EXPECT_TRUE(device().Load("/mydir/subdir/file") != boost::none);
+    auto dir = device().Load("/mydir").value();
+    dir->rename("/renameddir");
+    EXPECT_THROW(device().Load("/mydir/subdir/file"), fspp::fuse::FuseErrnoException);
+    auto file = this->LoadNode("/renameddir/subdir/file");
+    EXPECT_TRUE(file->checkParentPointer());
+}
+
+TEST_F(CryNodeTest, Load_AfterMovingDirToOtherParent) {
+    this->CreateDir("/dir1");
+    this->CreateDir("/dir2");
+    this->CreateDir("/dir1/subdir");
+    this->CreateFile("/dir1/subdir/file");
+    EXPECT_TRUE(device().Load("/dir1/subdir/file") != boost::none);
+    auto subdir = device().Load("/dir1/subdir").value();
+    subdir->rename("/dir2/subdir");
+    EXPECT_THROW(device().Load("/dir1/subdir/file"), fspp::fuse::FuseErrnoException);
+    auto file = this->LoadNode("/dir2/subdir/file");
+    EXPECT_TRUE(file->checkParentPointer());
+}
+
+TEST_F(CryNodeTest, Load_AfterRemovingAndRecreatingDir) {
+    this->CreateDir("/mydir");
+    EXPECT_TRUE(device().Load("/mydir") != boost::none);
+    device().Load("/mydir").value()->remove();
+    EXPECT_TRUE(device().Load("/mydir") == boost::none);
+    this->CreateDir("/mydir");
+    this->CreateFile("/mydir/file");
+    auto file = this->LoadNode("/mydir/file");
+    EXPECT_TRUE(file->checkParentPointer());
+}
+
+TEST_F(CryNodeTest, Load_AfterOverwritingDirWithRename) {
+    this->CreateDir("/dir1");
+    this->CreateDir("/dir2");
+    this->CreateFile("/dir1/file");
+    EXPECT_TRUE(device().Load("/dir2") != boost::none);
+    device().Load("/dir1").value()->rename("/dir2");
+    auto file = this->LoadNode("/dir2/file");
+    EXPECT_TRUE(file->checkParentPointer());
+}
+
+TEST_F(CryNodeTest, Load_BelowFile) {
+    this->CreateFile("/myfile");
+    try {
+        device().Load("/myfile/child/grandchild");
+        EXPECT_TRUE(false); // Expected to throw
+    } catch (const fspp::fuse::FuseErrnoException &e) {
+        EXPECT_EQ(ENOTDIR, e.getErrno());
+    }
+}
+
+TEST_F(CryNodeTest, StoredSize_AfterCreatingFile) {
+    this->CreateFile("/file");
+    EXPECT_EQ(fspp::num_bytes_t(0), StoredSize("/file"));
+}
+
+TEST_F(CryNodeTest, StoredSize_AfterWritingAndClosingFile) {
+    this->CreateFile("/file");
+    {
+        auto openFile = device().LoadFile("/file").value()->open(fspp::openflags_t::RDWR());
+        openFile->write("content", fspp::num_bytes_t(7), fspp::num_bytes_t(100));
+    }
+    EXPECT_EQ(fspp::num_bytes_t(107), StoredSize("/file"));
+    EXPECT_EQ(fspp::num_bytes_t(107), this->LoadNode("/file")->stat().size);
+}
+
+TEST_F(CryNodeTest, StoredSize_AfterFlushingFile) {
+    this->CreateFile("/file");
+    auto openFile = device().LoadFile("/file").value()->open(fspp::openflags_t::RDWR());
+    openFile->write("content", fspp::num_bytes_t(7), fspp::num_bytes_t(0));
+    openFile->flush();
+    EXPECT_EQ(fspp::num_bytes_t(7), StoredSize("/file"));
+}
+
+TEST_F(CryNodeTest, StoredSize_WhileFileIsOpen_StatReturnsCurrentSize) {
+    this->CreateFile("/file");
+    auto openFile = device().LoadFile("/file").value()->open(fspp::openflags_t::RDWR());
+    openFile->write("content", fspp::num_bytes_t(7), fspp::num_bytes_t(0));
+    EXPECT_EQ(boost::none, StoredSize("/file"));
+    EXPECT_EQ(fspp::num_bytes_t(7), this->LoadNode("/file")->stat().size);
+}
+
+TEST_F(CryNodeTest, StoredSize_WritingAfterFlushingFile_RemovesStoredSizeUntilNextFlush) {
+    this->CreateFile("/file");
+    auto openFile = device().LoadFile("/file").value()->open(fspp::openflags_t::RDWR());
+    openFile->write("content", fspp::num_bytes_t(7), fspp::num_bytes_t(0));
+    openFile->flush();
+    EXPECT_EQ(fspp::num_bytes_t(7), StoredSize("/file"));
+    openFile->write("content", fspp::num_bytes_t(7), fspp::num_bytes_t(7));
+    EXPECT_EQ(boost::none, StoredSize("/file"));
+    openFile->flush();
+    EXPECT_EQ(fspp::num_bytes_t(14), StoredSize("/file"));
+}
+
+TEST_F(CryNodeTest, StoredSize_TruncatingOpenFile_RemovesStoredSizeUntilClosed) {
+    this->CreateFile("/file");
+    {
+        auto openFile = device().LoadFile("/file").value()->open(fspp::openflags_t::RDWR());
+        openFile->truncate(fspp::num_bytes_t(50));
+        EXPECT_EQ(boost::none, StoredSize("/file"));
+        EXPECT_EQ(fspp::num_bytes_t(50), this->LoadNode("/file")->stat().size);
+    }
+    EXPECT_EQ(fspp::num_bytes_t(50), StoredSize("/file"));
+}
+
+TEST_F(CryNodeTest, StoredSize_AfterTruncatingFile) {
+    this->CreateFile("/file");
+    device().LoadFile("/file").value()->truncate(fspp::num_bytes_t(50));
+    EXPECT_EQ(fspp::num_bytes_t(50), StoredSize("/file"));
+    EXPECT_EQ(fspp::num_bytes_t(50), this->LoadNode("/file")->stat().size);
+}
+
+TEST_F(CryNodeTest, StoredSize_AfterRenamingFile) {
+    this->CreateDir("/dir");
+    this->CreateFile("/file");
+    device().LoadFile("/file").value()->truncate(fspp::num_bytes_t(50));
+    device().Load("/file").value()->rename("/dir/file");
+    EXPECT_EQ(fspp::num_bytes_t(50), StoredSize("/dir/file"));
+}
+
+TEST_F(CryNodeTest, StoredSize_AfterRenamingFileWithinDir) {
+    this->CreateFile("/file");
+    device().LoadFile("/file").value()->truncate(fspp::num_bytes_t(50));
+    device().Load("/file").value()->rename("/renamed");
+    EXPECT_EQ(fspp::num_bytes_t(50), StoredSize("/renamed"));
+}
+
+TEST_F(CryNodeTest, StoredSize_Symlink) {
+    this->CreateSymlink("/symlink");
+    EXPECT_EQ(fspp::num_bytes_t(7), StoredSize("/symlink")); // Length of "/target"
+}
+
+TEST_F(CryNodeTest, StoredSize_Dir) {
+    this->CreateDir("/dir");
+    EXPECT_EQ(boost::none, StoredSize("/dir"));
+    EXPECT_EQ(fspp::num_bytes_t(4096), this->LoadNode("/dir")->stat().size);
+}
+
+TEST_F(CryNodeTest, StoredModificationTime_WhileFileIsOpen_IsStoredByTimer) {
+    this->CreateFile("/file");
+    auto openFile = device().LoadFile("/file").value()->open(fspp::openflags_t::RDWR());
+    openFile->write("content", fspp::num_bytes_t(7), fspp::num_bytes_t(0));
+    // The first write is stored immediately, this one is only collected
+    openFile->write("content", fspp::num_bytes_t(7), fspp::num_bytes_t(0));
+    const timespec mtime = openFile->stat().mtime;
+    const auto deadline = std::chrono::steady_clock::now() + 3 * CryOpenFile::TIMESTAMP_UPDATE_MAX_DELAY;
+    while (StoredModificationTime("/file") != mtime && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(mtime, StoredModificationTime("/file"));
+}
+
+TEST_F(CryNodeTest, StoredModificationTime_AfterUtimensWhileFileIsOpen_IsTheOneSetByUtimens) {
+    this->CreateFile("/file");
+    {
+        auto openFile = device().LoadFile("/file").value()->open(fspp::openflags_t::RDWR());
+        openFile->write("content", fspp::num_bytes_t(7), fspp::num_bytes_t(0));
+        openFile->write("content", fspp::num_bytes_t(7), fspp::num_bytes_t(0));
+        device().Load("/file").value()->utimens(timespec{1000, 0}, timespec{2000, 0});
+    }
+    EXPECT_EQ((timespec{2000, 0}), StoredModificationTime("/file"));
+}
+
+TEST_F(CryNodeTest, StoredModificationTime_ClosingFilesWhileUtimensStoresTheirUpdates) {
+    this->CreateFile("/file");
+    std::atomic<bool> done(false);
+    // Opens, writes and closes the file over and over, while utimens stores the updates of its open files
+    std::thread openAndClose([&] {
+        while (!done) {
+            auto openFile = device().LoadFile("/file").value()->open(fspp::openflags_t::RDWR());
+            openFile->write("content", fspp::num_bytes_t(7), fspp::num_bytes_t(0));
+            openFile->write("content", fspp::num_bytes_t(7), fspp::num_bytes_t(0));
+        }
+    });
+    for (int i = 0; i < 100; ++i) {
+        device().Load("/file").value()->utimens(timespec{1000, 0}, timespec{2000 + i, 0});
+    }
+    done = true;
+    openAndClose.join();
+}
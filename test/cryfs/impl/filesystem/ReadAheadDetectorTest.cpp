@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include "cryfs/impl/filesystem/ReadAheadDetector.h"
+
+using cryfs::ReadAheadDetector;
+
+class ReadAheadDetectorTest : public ::testing::Test {
+public:
+  static constexpr uint64_t INITIAL_WINDOW = 100;
+  static constexpr uint64_t MAX_WINDOW = 400;
+
+  ReadAheadDetector detector{INITIAL_WINDOW, MAX_WINDOW};
+};
+
+constexpr uint64_t ReadAheadDetectorTest::INITIAL_WINDOW;
+constexpr uint64_t ReadAheadDetectorTest::MAX_WINDOW;
+
+TEST_F(ReadAheadDetectorTest, FirstReadAtBeginningReadsAheadInitialWindow) {
+  auto decision = detector.onRead(0, 10);
+  EXPECT_TRUE(decision.isSequential);
+  EXPECT_FALSE(decision.isHit);
+  EXPECT_EQ(10u, decision.readAheadOffset);
+  EXPECT_EQ(INITIAL_WINDOW, decision.readAheadSize);
+}
+
+TEST_F(ReadAheadDetectorTest, RandomReadDoesntReadAhead) {
+  auto decision = detector.onRead(500, 10);
+  EXPECT_FALSE(decision.isSequential);
+  EXPECT_EQ(0u, decision.readAheadSize);
+}
+
+TEST_F(ReadAheadDetectorTest, SequentialReadsWithinWindowAreHits) {
+  detector.onRead(0, 10);
+  auto decision = detector.onRead(10, 10);
+  EXPECT_TRUE(decision.isSequential);
+  EXPECT_TRUE(decision.isHit);
+  EXPECT_EQ(0u, decision.readAheadSize);
+}
+
+TEST_F(ReadAheadDetectorTest, WindowGrowsWhenReaderCatchesUp) {
+  detector.onRead(0, 10); // reads ahead [10, 110)
+  auto decision = detector.onRead(10, 60); // reader is at 70, less than half a window before 110
+  EXPECT_TRUE(decision.isHit);
+  EXPECT_EQ(110u, decision.readAheadOffset);
+  EXPECT_EQ(70u + 2 * INITIAL_WINDOW - 110u, decision.readAheadSize);
+}
+
+TEST_F(ReadAheadDetectorTest, WindowDoesntGrowBeyondMaximum) {
+  uint64_t offset = 0;
+  uint64_t readAheadEnd = 0;
+  for (int i = 0; i < 100; ++i) {
+    auto decision = detector.onRead(offset, 50);
+    offset += 50;
+    if (decision.readAheadSize != 0) {
+      EXPECT_LE(decision.readAheadOffset + decision.readAheadSize, offset + MAX_WINDOW);
+      readAheadEnd = decision.readAheadOffset + decision.readAheadSize;
+    }
+    EXPECT_LE(offset, readAheadEnd);
+  }
+}
+
+TEST_F(ReadAheadDetectorTest, ReadAheadRangesAreContiguous) {
+  uint64_t offset = 0;
+  uint64_t readAheadEnd = 10;
+  for (int i = 0; i < 100; ++i) {
+    auto decision = detector.onRead(offset, 10);
+    offset += 10;
+    if (decision.readAheadSize != 0) {
+      EXPECT_EQ(readAheadEnd, decision.readAheadOffset);
+      readAheadEnd = decision.readAheadOffset + decision.readAheadSize;
+    }
+  }
+}
+
+TEST_F(ReadAheadDetectorTest, SequentialReadsAfterStartAreAllHits) {
+  detector.onRead(0, 10);
+  for (uint64_t offset = 10; offset < 10000; offset += 10) {
+    EXPECT_TRUE(detector.onRead(offset, 10).isHit);
+  }
+}
+
+TEST_F(ReadAheadDetectorTest, RandomReadResetsWindow) {
+  detector.onRead(0, 10);
+  detector.onRead(10, 60);
+  EXPECT_FALSE(detector.onRead(5000, 10).isSequential);
+  auto decision = detector.onRead(5010, 10);
+  EXPECT_TRUE(decision.isSequential);
+  EXPECT_FALSE(decision.isHit);
+  EXPECT_EQ(5020u, decision.readAheadOffset);
+  EXPECT_EQ(INITIAL_WINDOW, decision.readAheadSize);
+}
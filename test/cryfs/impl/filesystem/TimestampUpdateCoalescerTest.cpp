@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include "cryfs/impl/filesystem/TimestampUpdateCoalescer.h"
+
+using cryfs::TimestampUpdateCoalescer;
+using boost::none;
+
+class TimestampUpdateCoalescerTest : public ::testing::Test {
+public:
+  TimestampUpdateCoalescer coalescer{std::chrono::seconds(1)};
+
+  static timespec at(time_t sec, long nsec = 0) {
+    return timespec{sec, nsec};
+  }
+
+  static fspp::stat_info statWithTimestamps(timespec atime, timespec mtime, timespec ctime) {
+    fspp::stat_info result;
+    result.atime = atime;
+    result.mtime = mtime;
+    result.ctime = ctime;
+    return result;
+  }
+};
+
+TEST_F(TimestampUpdateCoalescerTest, FirstAccessIsStoredImmediately) {
+  EXPECT_TRUE(coalescer.onWrite(at(100)));
+}
+
+TEST_F(TimestampUpdateCoalescerTest, AccessesWithinMaxDelayAreCollected) {
+  coalescer.onWrite(at(100));
+  coalescer.takeUpdates(at(100));
+  EXPECT_FALSE(coalescer.onWrite(at(100, 500000000)));
+  EXPECT_FALSE(coalescer.onRead(at(100, 999999999)));
+}
+
+TEST_F(TimestampUpdateCoalescerTest, AccessAfterMaxDelayIsStored) {
+  coalescer.onWrite(at(100));
+  coalescer.takeUpdates(at(100));
+  coalescer.onWrite(at(100, 500000000));
+  EXPECT_TRUE(coalescer.onRead(at(101)));
+}
+
+TEST_F(TimestampUpdateCoalescerTest, TakeUpdatesReturnsLastAccesses) {
+  coalescer.onRead(at(100));
+  coalescer.onWrite(at(101));
+  coalescer.onRead(at(102));
+  auto updates = coalescer.takeUpdates(at(103));
+  EXPECT_EQ(at(102), *updates.lastAccessTime);
+  EXPECT_EQ(at(101), *updates.lastModificationTime);
+}
+
+TEST_F(TimestampUpdateCoalescerTest, TakeUpdatesForgetsUpdates) {
+  coalescer.onRead(at(100));
+  coalescer.onWrite(at(101));
+  coalescer.takeUpdates(at(102));
+  auto updates = coalescer.takeUpdates(at(103));
+  EXPECT_EQ(none, updates.lastAccessTime);
+  EXPECT_EQ(none, updates.lastModificationTime);
+}
+
+TEST_F(TimestampUpdateCoalescerTest, ApplyToShowsWrite) {
+  coalescer.onWrite(at(101));
+  auto stat = statWithTimestamps(at(50), at(50), at(50));
+  coalescer.applyTo(&stat, fspp::noatime());
+  EXPECT_EQ(at(50), stat.atime);
+  EXPECT_EQ(at(101), stat.mtime);
+  EXPECT_EQ(at(101), stat.ctime);
+}
+
+TEST_F(TimestampUpdateCoalescerTest, ApplyToShowsReadIfTimestampUpdateBehaviorSaysSo) {
+  coalescer.onRead(at(101));
+  auto stat = statWithTimestamps(at(50), at(50), at(50));
+  coalescer.applyTo(&stat, fspp::strictatime());
+  EXPECT_EQ(at(101), stat.atime);
+  EXPECT_EQ(at(50), stat.mtime);
+  EXPECT_EQ(at(50), stat.ctime);
+}
+
+TEST_F(TimestampUpdateCoalescerTest, ApplyToDoesntShowReadIfTimestampUpdateBehaviorSaysNo) {
+  coalescer.onRead(at(101));
+  auto stat = statWithTimestamps(at(50), at(50), at(50));
+  coalescer.applyTo(&stat, fspp::noatime());
+  EXPECT_EQ(at(50), stat.atime);
+}
+
+TEST_F(TimestampUpdateCoalescerTest, ApplyToShowsWriteBeforeLaterMetadataChange) {
+  // e.g. chmod after writing. CryNode::utimens stores the updates before setting the timestamps explicitly.
+  coalescer.onWrite(at(101));
+  auto stat = statWithTimestamps(at(10), at(20), at(102));
+  coalescer.applyTo(&stat, fspp::noatime());
+  EXPECT_EQ(at(10), stat.atime);
+  EXPECT_EQ(at(101), stat.mtime);
+  EXPECT_EQ(at(102), stat.ctime);
+}
+
+TEST_F(TimestampUpdateCoalescerTest, HasNoUpdatesInitially) {
+  EXPECT_FALSE(coalescer.hasUpdates());
+}
+
+TEST_F(TimestampUpdateCoalescerTest, HasUpdatesAfterAccess) {
+  coalescer.onRead(at(100));
+  EXPECT_TRUE(coalescer.hasUpdates());
+}
+
+TEST_F(TimestampUpdateCoalescerTest, HasNoUpdatesAfterTakingThem) {
+  coalescer.onWrite(at(100));
+  coalescer.takeUpdates(at(100));
+  EXPECT_FALSE(coalescer.hasUpdates());
+}
@@ -0,0 +1,254 @@
+#include <gtest/gtest.h>
+#include "cryfs/impl/filesystem/fsblobstore/FsBlobStore.h"
+#include <blobstore/implementations/onblocks/BlobStoreOnBlocks.h>
+#include <blockstore/implementations/inmemory/InMemoryBlockStore2.h>
+#include <blockstore/implementations/low2highlevel/LowToHighLevelBlockStore.h>
+#include <cpp-utils/pointer/cast.h>
+#include <cstring>
+
+using cpputils::unique_ref;
+using cpputils::make_unique_ref;
+using cpputils::dynamic_pointer_move;
+using cpputils::Data;
+using blockstore::BlockId;
+using blockstore::inmemory::InMemoryBlockStore2;
+using blockstore::lowtohighlevel::LowToHighLevelBlockStore;
+using blobstore::onblocks::BlobStoreOnBlocks;
+using cryfs::fsblobstore::FsBlobStore;
+using cryfs::fsblobstore::DirBlob;
+using std::string;
+
+// DirBlob only writes the byte ranges of the serialized entries that changed when flushing.
+// These test cases check that the directory reads back exactly as it was before, after all kinds of changes.
+class DirBlobTest : public ::testing::Test {
+public:
+  // Small blocks, so that directories span several leaves
+  static constexpr uint64_t BLOCKSIZE_BYTES = 512;
+
+  DirBlobTest()
+    : fsBlobStore(make_unique_ref<BlobStoreOnBlocks>(make_unique_ref<LowToHighLevelBlockStore>(make_unique_ref<InMemoryBlockStore2>()), BLOCKSIZE_BYTES)),
+      dir(fsBlobStore.createDirBlob(BlockId::Null())) {
+  }
+
+  FsBlobStore fsBlobStore;
+  unique_ref<DirBlob> dir;
+
+  static BlockId ChildId(uint8_t index) {
+    string hex = "0000000000000000000000000000000" + string(1, "0123456789ABCDEF"[index % 16]);
+    hex[30] = "0123456789ABCDEF"[index / 16];
+    return BlockId::FromString(hex);
+  }
+
+  void AddFile(const string &name, const BlockId &blockId) {
+    dir->AddChildFile(name, blockId, fspp::mode_t().addFileFlag(), fspp::uid_t(0), fspp::gid_t(0), timespec{100, 0}, timespec{200, 0});
+  }
+
+  void AddFiles(uint8_t num) {
+    for (uint8_t i = 0; i < num; ++i) {
+      AddFile("file" + std::to_string(i), ChildId(i));
+    }
+  }
+
+  // Serialized form of all entries as the DirBlob sees them
+  static Data Entries(const DirBlob &dirBlob) {
+    std::vector<fspp::Dir::Entry> children;
+    dirBlob.AppendChildrenTo(&children);
+    std::vector<Data> serializedEntries;
+    size_t size = 0;
+    for (const auto &child : children) {
+      const auto &entry = dirBlob.GetChild(child.name).value();
+      serializedEntries.emplace_back(entry.serializedSize());
+      entry.serialize(static_cast<uint8_t*>(serializedEntries.back().data()));
+      size += entry.serializedSize();
+    }
+    Data result(size);
+    size_t offset = 0;
+    for (const auto &serializedEntry : serializedEntries) {
+      std::memcpy(result.dataOffset(offset), serializedEntry.data(), serializedEntry.size());
+      offset += serializedEntry.size();
+    }
+    return result;
+  }
+
+  void Reload() {
+    const BlockId blockId = dir->blockId();
+    dir->flush();
+    cpputils::destruct(std::move(dir));
+    auto loaded = fsBlobStore.load(blockId).value();
+    dir = dynamic_pointer_move<DirBlob>(loaded).value();
+  }
+
+  // Flushes the directory and checks that loading it again gives the same entries
+  void ExpectReloadsUnchanged() {
+    const Data expected = Entries(*dir);
+    Reload();
+    EXPECT_EQ(expected, Entries(*dir));
+  }
+};
+
+constexpr uint64_t DirBlobTest::BLOCKSIZE_BYTES;
+
+TEST_F(DirBlobTest, Empty) {
+  ExpectReloadsUnchanged();
+  EXPECT_EQ(0u, dir->NumChildren());
+}
+
+TEST_F(DirBlobTest, AddChildren) {
+  AddFiles(20);
+  ExpectReloadsUnchanged();
+  EXPECT_EQ(20u, dir->NumChildren());
+}
+
+TEST_F(DirBlobTest, ChangeFirstEntry) {
+  AddFiles(20);
+  Reload();
+  dir->chownChild(ChildId(0), fspp::uid_t(1000), fspp::gid_t(1000));
+  ExpectReloadsUnchanged();
+  EXPECT_EQ(fspp::uid_t(1000), dir->GetChild(ChildId(0))->uid());
+}
+
+TEST_F(DirBlobTest, ChangeLastEntry) {
+  AddFiles(20);
+  Reload();
+  dir->chownChild(ChildId(19), fspp::uid_t(1000), fspp::gid_t(1000));
+  ExpectReloadsUnchanged();
+  EXPECT_EQ(fspp::uid_t(1000), dir->GetChild(ChildId(19))->uid());
+}
+
+TEST_F(DirBlobTest, ChangeSeveralEntries) {
+  AddFiles(20);
+  Reload();
+  for (uint8_t i = 0; i < 20; i += 3) {
+    dir->utimensChild(ChildId(i), timespec{1000 + i, 500}, timespec{2000 + i, 600});
+  }
+  ExpectReloadsUnchanged();
+  for (uint8_t i = 0; i < 20; i += 3) {
+    EXPECT_EQ(2000 + i, dir->GetChild(ChildId(i))->lastModificationTime().tv_sec);
+  }
+}
+
+TEST_F(DirBlobTest, ChangeEntriesSeparatedByUnchangedRegionsAroundMinUnchangedRegionSize) {
+  // The entry in the middle doesn't change. Its name length controls the size of the unchanged region between the
+  // changes to the entries before and after it. The range of name lengths makes that unchanged region go from clearly
+  // shorter to clearly longer than MIN_UNCHANGED_REGION_SIZE (256 bytes), so both the merged and the split writes are hit.
+  for (size_t middleNameLength = 120; middleNameLength < 240; ++middleNameLength) {
+    dir = fsBlobStore.createDirBlob(BlockId::Null());
+    AddFile("before", ChildId(0));
+    AddFile(string(middleNameLength, 'a'), ChildId(1));
+    AddFile("after", ChildId(2));
+    Reload();
+    dir->chownChild(ChildId(0), fspp::uid_t(1000), fspp::gid_t(1000));
+    dir->chownChild(ChildId(2), fspp::uid_t(2000), fspp::gid_t(2000));
+    ExpectReloadsUnchanged();
+    EXPECT_EQ(fspp::uid_t(1000), dir->GetChild(ChildId(0))->uid());
+    EXPECT_EQ(fspp::uid_t(0), dir->GetChild(ChildId(1))->uid());
+    EXPECT_EQ(fspp::uid_t(2000), dir->GetChild(ChildId(2))->uid());
+  }
+}
+
+TEST_F(DirBlobTest, InsertEntryAtBeginning) {
+  for (uint8_t i = 1; i < 20; ++i) {
+    AddFile("file" + std::to_string(i), ChildId(i));
+  }
+  Reload();
+  AddFile("file0", ChildId(0));
+  ExpectReloadsUnchanged();
+  EXPECT_EQ(20u, dir->NumChildren());
+}
+
+TEST_F(DirBlobTest, InsertEntryInTheMiddle) {
+  for (uint8_t i = 0; i < 20; ++i) {
+    if (i != 10) {
+      AddFile("file" + std::to_string(i), ChildId(i));
+    }
+  }
+  Reload();
+  AddFile("file10", ChildId(10));
+  ExpectReloadsUnchanged();
+  EXPECT_EQ(20u, dir->NumChildren());
+}
+
+TEST_F(DirBlobTest, InsertEntryAtEnd) {
+  AddFiles(19);
+  Reload();
+  AddFile("file19", ChildId(19));
+  ExpectReloadsUnchanged();
+  EXPECT_EQ(20u, dir->NumChildren());
+}
+
+TEST_F(DirBlobTest, RemoveEntryAtBeginning) {
+  AddFiles(20);
+  Reload();
+  dir->RemoveChild(ChildId(0));
+  ExpectReloadsUnchanged();
+  EXPECT_EQ(19u, dir->NumChildren());
+  EXPECT_EQ(boost::none, dir->GetChild("file0"));
+}
+
+TEST_F(DirBlobTest, RemoveEntryInTheMiddle) {
+  AddFiles(20);
+  Reload();
+  dir->RemoveChild(ChildId(10));
+  ExpectReloadsUnchanged();
+  EXPECT_EQ(19u, dir->NumChildren());
+  EXPECT_EQ(boost::none, dir->GetChild("file10"));
+}
+
+TEST_F(DirBlobTest, RemoveEntryAtEnd) {
+  AddFiles(20);
+  Reload();
+  dir->RemoveChild(ChildId(19));
+  ExpectReloadsUnchanged();
+  EXPECT_EQ(19u, dir->NumChildren());
+  EXPECT_EQ(boost::none, dir->GetChild("file19"));
+}
+
+TEST_F(DirBlobTest, RemoveAllEntries) {
+  AddFiles(20);
+  Reload();
+  for (uint8_t i = 0; i < 20; ++i) {
+    dir->RemoveChild(ChildId(i));
+  }
+  ExpectReloadsUnchanged();
+  EXPECT_EQ(0u, dir->NumChildren());
+}
+
+TEST_F(DirBlobTest, RenameEntryToLongerName) {
+  AddFiles(20);
+  Reload();
+  dir->RenameChild(ChildId(5), "a_much_longer_name_than_before", [] (const BlockId &) {});
+  ExpectReloadsUnchanged();
+  EXPECT_EQ(ChildId(5), dir->GetChild("a_much_longer_name_than_before")->blockId());
+}
+
+TEST_F(DirBlobTest, RenameEntryToShorterName) {
+  AddFiles(20);
+  Reload();
+  dir->RenameChild(ChildId(5), "a", [] (const BlockId &) {});
+  ExpectReloadsUnchanged();
+  EXPECT_EQ(ChildId(5), dir->GetChild("a")->blockId());
+}
+
+TEST_F(DirBlobTest, SetSizeOfChild) {
+  // Storing a size makes the entry longer
+  AddFiles(20);
+  Reload();
+  dir->setSizeOfChild(ChildId(5), fspp::num_bytes_t(1234));
+  ExpectReloadsUnchanged();
+  EXPECT_EQ(fspp::num_bytes_t(1234), dir->GetChild(ChildId(5))->size().value());
+}
+
+TEST_F(DirBlobTest, SeveralFlushesWithChangesInBetween) {
+  AddFiles(20);
+  Reload();
+  dir->chownChild(ChildId(3), fspp::uid_t(1000), fspp::gid_t(1000));
+  dir->flush();
+  dir->RemoveChild(ChildId(4));
+  dir->flush();
+  AddFile("newfile", ChildId(50));
+  dir->flush();
+  dir->RenameChild(ChildId(6), "renamed", [] (const BlockId &) {});
+  dir->chownChild(ChildId(7), fspp::uid_t(1000), fspp::gid_t(1000));
+  ExpectReloadsUnchanged();
+  EXPECT_EQ(20u, dir->NumChildren());
+}
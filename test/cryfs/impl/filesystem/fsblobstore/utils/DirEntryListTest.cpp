@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+#include "cryfs/impl/filesystem/fsblobstore/utils/DirEntryList.h"
+#include <cpp-utils/system/time.h>
+#include <fspp/fs_interface/FuseErrnoException.h>
+#include <map>
+
+using cryfs::fsblobstore::DirEntryList;
+using blockstore::BlockId;
+using std::string;
+
+// Names are looked up through a name index and block ids through a binary search on the entries ordered by block id.
+// These test cases check that both stay consistent with the entries.
+class DirEntryListTest : public ::testing::Test {
+public:
+  DirEntryList list;
+  // Expected content of the list
+  std::map<string, BlockId> entries;
+
+  void Add(const string &name, const BlockId &blockId) {
+    list.add(name, blockId, fspp::Dir::EntryType::FILE, fspp::mode_t().addFileFlag(), fspp::uid_t(0), fspp::gid_t(0), cpputils::time::now(), cpputils::time::now());
+    entries.emplace(name, blockId);
+  }
+
+  void AddOrOverwrite(const string &name, const BlockId &blockId) {
+    list.addOrOverwrite(name, blockId, fspp::Dir::EntryType::FILE, fspp::mode_t().addFileFlag(), fspp::uid_t(0), fspp::gid_t(0), cpputils::time::now(), cpputils::time::now(), boost::none, [] (const BlockId &) {});
+    entries.erase(name);
+    entries.emplace(name, blockId);
+  }
+
+  void AddEntries(uint32_t num) {
+    for (uint32_t i = 0; i < num; ++i) {
+      Add("entry" + std::to_string(i), BlockId::Random());
+    }
+  }
+
+  void ExpectConsistent() {
+    EXPECT_EQ(entries.size(), list.size());
+    for (const auto &entry : entries) {
+      auto foundByName = list.get(entry.first);
+      ASSERT_NE(boost::none, foundByName) << "Didn't find " << entry.first;
+      EXPECT_EQ(entry.second, foundByName->blockId());
+      auto foundById = list.get(entry.second);
+      ASSERT_NE(boost::none, foundById) << "Didn't find " << entry.first;
+      EXPECT_EQ(entry.first, foundById->name());
+    }
+    for (auto iter = list.begin(); iter != list.end(); ++iter) {
+      if (iter != list.begin()) {
+        EXPECT_TRUE(std::less<BlockId>()((iter-1)->blockId(), iter->blockId()));
+      }
+    }
+  }
+};
+
+TEST_F(DirEntryListTest, Empty) {
+  ExpectConsistent();
+  EXPECT_EQ(boost::none, list.get("notexisting"));
+  EXPECT_EQ(boost::none, list.get(BlockId::Random()));
+}
+
+TEST_F(DirEntryListTest, Add) {
+  AddEntries(100);
+  ExpectConsistent();
+  EXPECT_EQ(boost::none, list.get("notexisting"));
+  EXPECT_EQ(boost::none, list.get(BlockId::Random()));
+}
+
+TEST_F(DirEntryListTest, Add_ExistingName) {
+  AddEntries(10);
+  EXPECT_THROW(
+    list.add("entry5", BlockId::Random(), fspp::Dir::EntryType::FILE, fspp::mode_t().addFileFlag(), fspp::uid_t(0), fspp::gid_t(0), cpputils::time::now(), cpputils::time::now()),
+    fspp::fuse::FuseErrnoException
+  );
+  ExpectConsistent();
+}
+
+TEST_F(DirEntryListTest, AddOrOverwrite_NewName) {
+  AddEntries(10);
+  AddOrOverwrite("newentry", BlockId::Random());
+  ExpectConsistent();
+}
+
+TEST_F(DirEntryListTest, AddOrOverwrite_ExistingName) {
+  AddEntries(10);
+  const BlockId oldBlockId = entries.at("entry5");
+  AddOrOverwrite("entry5", BlockId::Random());
+  ExpectConsistent();
+  EXPECT_EQ(boost::none, list.get(oldBlockId));
+}
+
+TEST_F(DirEntryListTest, Rename) {
+  AddEntries(10);
+  const BlockId blockId = entries.at("entry5");
+  list.rename(blockId, "renamed", [] (const BlockId &) {});
+  entries.erase("entry5");
+  entries.emplace("renamed", blockId);
+  ExpectConsistent();
+  EXPECT_EQ(boost::none, list.get("entry5"));
+}
+
+TEST_F(DirEntryListTest, Rename_ToExistingName) {
+  AddEntries(10);
+  const BlockId blockId = entries.at("entry5");
+  const BlockId overwrittenBlockId = entries.at("entry6");
+  list.rename(blockId, "entry6", [] (const BlockId &) {});
+  entries.erase("entry5");
+  entries.erase("entry6");
+  entries.emplace("entry6", blockId);
+  ExpectConsistent();
+  EXPECT_EQ(boost::none, list.get("entry5"));
+  EXPECT_EQ(boost::none, list.get(overwrittenBlockId));
+}
+
+TEST_F(DirEntryListTest, Rename_ToSameName) {
+  AddEntries(10);
+  list.rename(entries.at("entry5"), "entry5", [] (const BlockId &) {});
+  ExpectConsistent();
+}
+
+TEST_F(DirEntryListTest, RemoveByName) {
+  AddEntries(10);
+  list.remove("entry5");
+  entries.erase("entry5");
+  ExpectConsistent();
+  EXPECT_EQ(boost::none, list.get("entry5"));
+}
+
+TEST_F(DirEntryListTest, RemoveByBlockId) {
+  AddEntries(10);
+  list.remove(entries.at("entry5"));
+  entries.erase("entry5");
+  ExpectConsistent();
+  EXPECT_EQ(boost::none, list.get("entry5"));
+}
+
+TEST_F(DirEntryListTest, RemoveAndAddAgain) {
+  AddEntries(10);
+  list.remove("entry5");
+  entries.erase("entry5");
+  Add("entry5", BlockId::Random());
+  ExpectConsistent();
+}
+
+TEST_F(DirEntryListTest, Deserialize) {
+  AddEntries(100);
+  auto serialized = list.serialize();
+  list.deserializeFrom(serialized.data(), serialized.size());
+  ExpectConsistent();
+}
+
+TEST_F(DirEntryListTest, Deserialize_ThenModify) {
+  AddEntries(10);
+  auto serialized = list.serialize();
+  list.deserializeFrom(serialized.data(), serialized.size());
+  list.remove("entry3");
+  entries.erase("entry3");
+  AddOrOverwrite("entry4", BlockId::Random());
+  Add("newentry", BlockId::Random());
+  ExpectConsistent();
+}
+
+TEST_F(DirEntryListTest, Deserialize_ReplacesOldEntries) {
+  AddEntries(10);
+  auto serialized = list.serialize();
+  Add("removedbydeserializing", BlockId::Random());
+  list.deserializeFrom(serialized.data(), serialized.size());
+  entries.erase("removedbydeserializing");
+  ExpectConsistent();
+  EXPECT_EQ(boost::none, list.get("removedbydeserializing"));
+}
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include "fspp/fuse/InodeTable.h"
+#include "fspp/fs_interface/FuseErrnoException.h"
+
+using fspp::fuse::InodeTable;
+using fspp::fuse::FuseErrnoException;
+
+class InodeTableTest : public ::testing::Test {
+public:
+  InodeTable table;
+
+  static constexpr uint64_t ROOT = InodeTable::ROOT_INODE;
+
+  void EXPECT_ERRNO(int expectedErrno, uint64_t inode) {
+    try {
+      table.path(inode);
+      EXPECT_TRUE(false); // expected exception
+    } catch (const FuseErrnoException &e) {
+      EXPECT_EQ(expectedErrno, e.getErrno());
+    }
+  }
+};
+
+constexpr uint64_t InodeTableTest::ROOT;
+
+TEST_F(InodeTableTest, RootPath) {
+  EXPECT_EQ("/", table.path(ROOT));
+  EXPECT_EQ(1u, table.size());
+}
+
+TEST_F(InodeTableTest, LookupAssignsNewInode) {
+  auto inode = table.lookup(ROOT, "file");
+  EXPECT_NE(ROOT, inode.number);
+  EXPECT_EQ("/file", table.path(inode.number));
+  EXPECT_EQ(2u, table.size());
+}
+
+TEST_F(InodeTableTest, LookupAgainReturnsSameInode) {
+  auto inode1 = table.lookup(ROOT, "file");
+  auto inode2 = table.lookup(ROOT, "file");
+  EXPECT_EQ(inode1.number, inode2.number);
+  EXPECT_EQ(inode1.generation, inode2.generation);
+}
+
+TEST_F(InodeTableTest, DifferentChildrenGetDifferentInodes) {
+  auto inode1 = table.lookup(ROOT, "file1");
+  auto inode2 = table.lookup(ROOT, "file2");
+  EXPECT_NE(inode1.number, inode2.number);
+}
+
+TEST_F(InodeTableTest, NestedPath) {
+  auto dir = table.lookup(ROOT, "dir");
+  auto subdir = table.lookup(dir.number, "subdir");
+  auto file = table.lookup(subdir.number, "file");
+  EXPECT_EQ("/dir/subdir/file", table.path(file.number));
+  EXPECT_EQ("/dir/subdir/other", table.childPath(subdir.number, "other"));
+  EXPECT_EQ("/other", table.childPath(ROOT, "other"));
+}
+
+TEST_F(InodeTableTest, ForgetKeepsInodeWhileThereAreLookupsLeft) {
+  auto inode = table.lookup(ROOT, "file");
+  table.lookup(ROOT, "file");
+  table.forget(inode.number, 1);
+  EXPECT_EQ("/file", table.path(inode.number));
+}
+
+TEST_F(InodeTableTest, ForgetFreesInode) {
+  auto inode = table.lookup(ROOT, "file");
+  table.lookup(ROOT, "file");
+  table.forget(inode.number, 2);
+  EXPECT_EQ(1u, table.size());
+  EXPECT_ERRNO(ESTALE, inode.number);
+}
+
+TEST_F(InodeTableTest, ForgetRootDoesNothing) {
+  table.forget(ROOT, 1);
+  EXPECT_EQ("/", table.path(ROOT));
+}
+
+TEST_F(InodeTableTest, ReusedInodeGetsNewGeneration) {
+  auto inode1 = table.lookup(ROOT, "file1");
+  table.forget(inode1.number, 1);
+  auto inode2 = table.lookup(ROOT, "file2");
+  EXPECT_EQ(inode1.number, inode2.number);
+  EXPECT_NE(inode1.generation, inode2.generation);
+  EXPECT_EQ("/file2", table.path(inode2.number));
+}
+
+TEST_F(InodeTableTest, LookupAfterForgetGivesSameChildANewInode) {
+  auto inode1 = table.lookup(ROOT, "file");
+  table.forget(inode1.number, 1);
+  auto inode2 = table.lookup(ROOT, "file");
+  EXPECT_FALSE(inode1.number == inode2.number && inode1.generation == inode2.generation);
+}
+
+TEST_F(InodeTableTest, RenameChangesPath) {
+  auto dir = table.lookup(ROOT, "dir");
+  auto file = table.lookup(ROOT, "file");
+  table.rename(ROOT, "file", dir.number, "renamed");
+  EXPECT_EQ("/dir/renamed", table.path(file.number));
+  EXPECT_EQ(file.number, table.lookup(dir.number, "renamed").number);
+}
+
+TEST_F(InodeTableTest, RenameDirChangesPathOfChildren) {
+  auto dir = table.lookup(ROOT, "dir");
+  auto file = table.lookup(dir.number, "file");
+  table.rename(ROOT, "dir", ROOT, "renamed");
+  EXPECT_EQ("/renamed/file", table.path(file.number));
+}
+
+TEST_F(InodeTableTest, RenameToItselfKeepsPath) {
+  auto file = table.lookup(ROOT, "file");
+  table.rename(ROOT, "file", ROOT, "file");
+  EXPECT_EQ("/file", table.path(file.number));
+}
+
+TEST_F(InodeTableTest, RenameOverwriteDetachesTarget) {
+  auto file1 = table.lookup(ROOT, "file1");
+  auto file2 = table.lookup(ROOT, "file2");
+  table.rename(ROOT, "file1", ROOT, "file2");
+  EXPECT_EQ("/file2", table.path(file1.number));
+  EXPECT_ERRNO(ENOENT, file2.number);
+}
+
+TEST_F(InodeTableTest, RenameOfUnknownNodeDetachesTarget) {
+  auto file2 = table.lookup(ROOT, "file2");
+  table.rename(ROOT, "file1", ROOT, "file2");
+  EXPECT_ERRNO(ENOENT, file2.number);
+  EXPECT_NE(file2.number, table.lookup(ROOT, "file2").number);
+}
+
+TEST_F(InodeTableTest, RemoveDetachesNode) {
+  auto file = table.lookup(ROOT, "file");
+  table.remove(ROOT, "file");
+  EXPECT_ERRNO(ENOENT, file.number);
+  EXPECT_EQ(2u, table.size()); // The kernel didn't forget it yet
+  table.forget(file.number, 1);
+  EXPECT_EQ(1u, table.size());
+}
+
+TEST_F(InodeTableTest, LookupAfterRemoveGivesNewInode) {
+  auto file1 = table.lookup(ROOT, "file");
+  table.remove(ROOT, "file");
+  auto file2 = table.lookup(ROOT, "file");
+  EXPECT_NE(file1.number, file2.number);
+  EXPECT_EQ("/file", table.path(file2.number));
+}
@@ -0,0 +1,144 @@
+#if defined(FSPP_HAVE_FUSE3_LOWLEVEL)
+
+#include "../testutils/FuseTest.h"
+#include <dirent.h>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+
+using ::testing::_;
+using ::testing::Eq;
+using ::testing::Return;
+using ::testing::AtLeast;
+using ::testing::Truly;
+using ::testing::Invoke;
+using std::vector;
+using std::string;
+
+namespace bf = boost::filesystem;
+
+// The other fuse tests run against LowlevelFuse as well if fspp is built with it. These test cases cover what only
+// LowlevelFuse does, i.e. keeping track of the inodes the kernel knows and building paths from them.
+class LowlevelFuseTest: public FuseTest {
+public:
+  static void Stat(const bf::path &path) {
+    struct stat stbuf{};
+    EXPECT_EQ(0, ::lstat(path.string().c_str(), &stbuf)) << "Stat failed with errno " << errno;
+  }
+
+  static vector<string> ReadDir(const bf::path &path) {
+    DIR *dir = ::opendir(path.string().c_str());
+    EXPECT_NE(nullptr, dir) << "Opening directory failed";
+    vector<string> result;
+    for (struct dirent *entry = ::readdir(dir); entry != nullptr; entry = ::readdir(dir)) {
+      result.push_back(entry->d_name);
+    }
+    EXPECT_EQ(0, ::closedir(dir));
+    return result;
+  }
+
+  // Lets the kernel forget all nodes it doesn't use right now. Only works for root.
+  static bool DropKernelCaches() {
+    std::ofstream dropCaches("/proc/sys/vm/drop_caches");
+    dropCaches << "2" << std::flush;
+    return dropCaches.good();
+  }
+
+  static ::testing::Action<vector<fspp::Dir::Entry>(const bf::path&)> ReturnFileEntries(const vector<string> &names) {
+    vector<fspp::Dir::Entry> entries;
+    for (const string &name : names) {
+      entries.emplace_back(fspp::Dir::EntryType::FILE, name);
+    }
+    return Return(entries);
+  }
+};
+
+TEST_F(LowlevelFuseTest, Lookup_Nested_CallsLstatWithFullPath) {
+  ReturnIsDirOnLstat("/mydir");
+  ReturnIsDirOnLstat("/mydir/mysubdir");
+  EXPECT_CALL(*fsimpl, lstat(Eq("/mydir/mysubdir/myfile"), _)).Times(AtLeast(1)).WillRepeatedly(ReturnIsFile);
+
+  auto fs = TestFS();
+  Stat(fs->mountDir() / "mydir/mysubdir/myfile");
+}
+
+TEST_F(LowlevelFuseTest, Getattr_AfterRename_CallsLstatWithNewPath) {
+  ReturnIsDirOnLstat("/mydir");
+  ReturnIsFileOnLstat("/myfile");
+  ReturnDoesntExistOnLstat("/mydir/myrenamedfile");
+  EXPECT_CALL(*fsimpl, rename(Eq("/myfile"), Eq("/mydir/myrenamedfile"))).Times(1).WillOnce(Return());
+
+  // attr_timeout=0 makes the kernel ask for the attributes of the renamed inode again
+  auto fs = TestFS({"-o", "attr_timeout=0"});
+  Stat(fs->mountDir() / "myfile");
+  EXPECT_EQ(0, ::rename((fs->mountDir() / "myfile").string().c_str(), (fs->mountDir() / "mydir/myrenamedfile").string().c_str()));
+
+  EXPECT_CALL(*fsimpl, lstat(Eq("/myfile"), _)).Times(0);
+  EXPECT_CALL(*fsimpl, lstat(Eq("/mydir/myrenamedfile"), _)).Times(AtLeast(1)).WillRepeatedly(ReturnIsFile);
+  Stat(fs->mountDir() / "mydir/myrenamedfile");
+}
+
+TEST_F(LowlevelFuseTest, Lookup_AfterKernelForgotNode_CallsLstatWithSamePath) {
+  ReturnIsDirOnLstat("/mydir");
+  EXPECT_CALL(*fsimpl, lstat(Eq("/mydir/myfile"), _)).Times(AtLeast(2)).WillRepeatedly(ReturnIsFile);
+
+  auto fs = TestFS({"-o", "attr_timeout=0,entry_timeout=0"});
+  Stat(fs->mountDir() / "mydir/myfile");
+  if (!DropKernelCaches()) {
+    // Satisfy the expectation so the test doesn't fail when skipped
+    Stat(fs->mountDir() / "mydir/myfile");
+    GTEST_SKIP() << "Needs root to make the kernel forget nodes";
+  }
+  Stat(fs->mountDir() / "mydir/myfile");
+}
+
+TEST_F(LowlevelFuseTest, Readdirplus_ReturnsAttributesOfEntries) {
+  ReturnIsDirOnLstat("/mydir");
+  EXPECT_CALL(*fsimpl, readDir(Eq("/mydir"))).Times(AtLeast(1)).WillRepeatedly(ReturnFileEntries({"file1", "file2"}));
+  // The attributes are looked up while listing the directory, not by a stat() afterwards
+  EXPECT_CALL(*fsimpl, lstat(Eq("/mydir/file1"), _)).Times(AtLeast(1)).WillRepeatedly(ReturnIsFile);
+  EXPECT_CALL(*fsimpl, lstat(Eq("/mydir/file2"), _)).Times(AtLeast(1)).WillRepeatedly(ReturnIsFile);
+
+  auto fs = TestFS();
+  auto entries = ReadDir(fs->mountDir() / "mydir");
+  EXPECT_NE(entries.end(), std::find(entries.begin(), entries.end(), "file1"));
+  EXPECT_NE(entries.end(), std::find(entries.begin(), entries.end(), "file2"));
+}
+
+TEST_F(LowlevelFuseTest, WritebackCache_OpenWriteOnly_OpensForReadingAndWriting) {
+  ReturnIsFileOnLstat(FILENAME);
+  // The kernel reads pages of the file to fill them before writing parts of them
+  EXPECT_CALL(*fsimpl, openFile(Eq(FILENAME), Truly([] (int flags) {return (flags & O_ACCMODE) == O_RDWR;})))
+    .Times(1).WillOnce(Return(0));
+
+  auto fs = TestFS({"-o", "writeback_cache"});
+  int fd = ::open((fs->mountDir() / FILENAME).string().c_str(), O_WRONLY);
+  EXPECT_LE(0, fd) << "Opening file failed with errno " << errno;
+  EXPECT_EQ(0, ::close(fd));
+}
+
+TEST_F(LowlevelFuseTest, WritebackCache_Write_WritesDataWhenClosing) {
+  ReturnIsFileOnLstatWithSize(FILENAME, fspp::num_bytes_t(0));
+  ReturnIsFileOnFstatWithSize(0, fspp::num_bytes_t(0));
+  OnOpenReturnFileDescriptor(FILENAME, 0);
+  // The kernel updates the timestamps itself and tells us about them
+  EXPECT_CALL(*fsimpl, utimens(Eq(FILENAME), _, _)).WillRepeatedly(Return());
+  string written;
+  EXPECT_CALL(*fsimpl, write(0, _, _, _)).Times(AtLeast(1)).WillRepeatedly(Invoke(
+    [&written] (int, const void *buf, fspp::num_bytes_t count, fspp::num_bytes_t offset) {
+      written.resize(std::max(written.size(), static_cast<size_t>((offset + count).value())));
+      std::memcpy(&written[offset.value()], buf, count.value());
+    }));
+
+  auto fs = TestFS({"-o", "writeback_cache"});
+  int fd = ::open((fs->mountDir() / FILENAME).string().c_str(), O_WRONLY);
+  EXPECT_LE(0, fd) << "Opening file failed with errno " << errno;
+  EXPECT_EQ(5, ::write(fd, "hello", 5));
+  EXPECT_EQ(5, ::write(fd, "world", 5));
+  EXPECT_EQ(0, ::close(fd));
+  EXPECT_EQ("helloworld", written);
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "FuseTest.h"
+#include <algorithm>
 
 using ::testing::Eq;
 using ::testing::_;
@@ -62,9 +63,18 @@ unique_ref<FuseTest::TempTestFS> FuseTest::TestFS(const std::vector<std::string>
 
 FuseTest::TempTestFS::TempTestFS(shared_ptr<MockFilesystem> fsimpl, const std::vector<std::string>& fuseOptions)
  :_mountDir(),
-  _fuse([fsimpl] (Fuse*) {return fsimpl;}, []{}, "fusetest", boost::none), _fuse_thread(&_fuse) {
-
-  _fuse_thread.start(_mountDir.path(), fuseOptions);
+  _fuse([fsimpl] (FuseFrontend*) {return fsimpl;}, []{}, "fusetest", boost::none), _fuse_thread(&_fuse) {
+
+  std::vector<std::string> options = fuseOptions;
+#if defined(FSPP_HAVE_FUSE3_LOWLEVEL)
+  // The tests check which file system calls a syscall causes. With the writeback cache, the kernel caches writes and
+  // timestamps and reads from files opened write-only, so only use it in tests that ask for it.
+  if (std::find(options.begin(), options.end(), "writeback_cache") == options.end()) {
+    options.push_back("-o");
+    options.push_back("no_writeback_cache");
+  }
+#endif
+  _fuse_thread.start(_mountDir.path(), options);
 }
 
 FuseTest::TempTestFS::~TempTestFS() {
@@ -8,6 +8,9 @@
 #include "fspp/fuse/Filesystem.h"
 #include "fspp/fs_interface/FuseErrnoException.h"
 #include "fspp/fuse/Fuse.h"
+#if defined(FSPP_HAVE_FUSE3_LOWLEVEL)
+#include "fspp/fuse/LowlevelFuse.h"
+#endif
 #include "fspp/fs_interface/Dir.h"
 
 #include <boost/filesystem.hpp>
@@ -61,7 +64,7 @@ public:
     const boost::filesystem::path &mountDir() const;
   private:
     cpputils::TempDir _mountDir;
-    fspp::fuse::Fuse _fuse;
+    FuseFrontend _fuse;
     FuseThread _fuse_thread;
   };
 
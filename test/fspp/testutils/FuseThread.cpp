@@ -3,6 +3,9 @@
 #include <csignal>
 #include <cpp-utils/assert/assert.h>
 #include "fspp/fuse/Fuse.h"
+#if defined(FSPP_HAVE_FUSE3_LOWLEVEL)
+#include "fspp/fuse/LowlevelFuse.h"
+#endif
 
 using boost::thread;
 using boost::chrono::seconds;
@@ -10,9 +13,7 @@ using std::string;
 using std::vector;
 namespace bf = boost::filesystem;
 
-using fspp::fuse::Fuse;
-
-FuseThread::FuseThread(Fuse *fuse)
+FuseThread::FuseThread(FuseFrontend *fuse)
   :_fuse(fuse), _child() {
 }
 
@@ -10,17 +10,25 @@
 namespace fspp {
 namespace fuse {
   class Fuse;
+  class LowlevelFuse;
 }
 }
 
+// The fuse tests run against the frontend that file systems are mounted with
+#if defined(FSPP_HAVE_FUSE3_LOWLEVEL)
+using FuseFrontend = fspp::fuse::LowlevelFuse;
+#else
+using FuseFrontend = fspp::fuse::Fuse;
+#endif
+
 class FuseThread {
 public:
-  FuseThread(fspp::fuse::Fuse *fuse);
+  FuseThread(FuseFrontend *fuse);
   void start(const boost::filesystem::path &mountDir, const std::vector<std::string> &fuseOptions);
   void stop();
 
 private:
-  fspp::fuse::Fuse *_fuse;
+  FuseFrontend *_fuse;
   boost::thread _child;
 
   DISALLOW_COPY_AND_ASSIGN(FuseThread);
@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+#include "parallelaccessstore/ParallelAccessStore.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+
+using blockstore::BlockId;
+using cpputils::unique_ref;
+using cpputils::make_unique_ref;
+using parallelaccessstore::ParallelAccessStore;
+using parallelaccessstore::ParallelAccessBaseStore;
+
+namespace {
+
+struct Resource final {
+  Resource(const BlockId &key_, int value_): key(key_), value(value_) {}
+  BlockId key;
+  int value;
+};
+
+class ResourceRef final : public ParallelAccessStore<Resource, ResourceRef, BlockId>::ResourceRefBase {
+public:
+  explicit ResourceRef(Resource *resource): _resource(resource) {}
+  Resource *resource() {
+    return _resource;
+  }
+private:
+  Resource *_resource;
+};
+
+class FakeBaseStore final : public ParallelAccessBaseStore<Resource, BlockId> {
+public:
+  FakeBaseStore(std::unordered_map<BlockId, int> *values, std::function<void (const BlockId &)> onLoad, std::function<void (const BlockId &)> onRemove)
+  : _values(values), _onLoad(std::move(onLoad)), _onRemove(std::move(onRemove)) {}
+
+  boost::optional<unique_ref<Resource>> loadFromBaseStore(const BlockId &blockId) override {
+    _onLoad(blockId);
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto found = _values->find(blockId);
+    if (found == _values->end()) {
+      return boost::none;
+    }
+    return make_unique_ref<Resource>(blockId, found->second);
+  }
+
+  void removeFromBaseStore(unique_ref<Resource> resource) override {
+    removeFromBaseStore(resource->key);
+  }
+
+  void removeFromBaseStore(const BlockId &blockId) override {
+    _onRemove(blockId);
+    std::lock_guard<std::mutex> lock(_mutex);
+    _values->erase(blockId);
+  }
+
+private:
+  std::mutex _mutex;
+  std::unordered_map<BlockId, int> *_values;
+  std::function<void (const BlockId &)> _onLoad;
+  std::function<void (const BlockId &)> _onRemove;
+};
+
+}
+
+class ParallelAccessStoreTest : public ::testing::Test {
+public:
+  ParallelAccessStoreTest()
+  : key1(BlockId::FromString("1491BB4932A389EE14BC7090AC772972")), key2(BlockId::FromString("272EE5517627CFA147A971A8E6E747E0")),
+    values{{key1, 1}, {key2, 2}}, onLoad([] (const BlockId &) {}), onRemove([] (const BlockId &) {}),
+    store(make_unique_ref<FakeBaseStore>(&values, [this] (const BlockId &blockId) {onLoad(blockId);}, [this] (const BlockId &blockId) {onRemove(blockId);})) {
+  }
+
+  static constexpr std::chrono::seconds TIMEOUT = std::chrono::seconds(5);
+
+  const BlockId key1;
+  const BlockId key2;
+  std::unordered_map<BlockId, int> values;
+  std::function<void (const BlockId &)> onLoad;
+  std::function<void (const BlockId &)> onRemove;
+  ParallelAccessStore<Resource, ResourceRef, BlockId> store;
+};
+
+constexpr std::chrono::seconds ParallelAccessStoreTest::TIMEOUT;
+
+TEST_F(ParallelAccessStoreTest, Load) {
+  EXPECT_EQ(1, store.load(key1).value()->resource()->value);
+}
+
+TEST_F(ParallelAccessStoreTest, Load_NotExisting) {
+  EXPECT_EQ(boost::none, store.load(BlockId::Random()));
+}
+
+TEST_F(ParallelAccessStoreTest, Load_DifferentResourcesInParallel) {
+  std::promise<void> key2LoadStarted;
+  std::atomic<bool> loadedInParallel(false);
+  std::promise<void> key1LoadStarted;
+  onLoad = [&] (const BlockId &blockId) {
+    if (blockId == key1) {
+      key1LoadStarted.set_value();
+      // Only returns early if the other load can start while this one is still running
+      loadedInParallel = (std::future_status::ready == key2LoadStarted.get_future().wait_for(TIMEOUT));
+    } else {
+      key2LoadStarted.set_value();
+    }
+  };
+  auto loadKey1 = std::async(std::launch::async, [&] {
+    return store.load(key1).value()->resource()->value;
+  });
+  key1LoadStarted.get_future().wait();
+  EXPECT_EQ(2, store.load(key2).value()->resource()->value);
+  EXPECT_EQ(1, loadKey1.get());
+  EXPECT_TRUE(loadedInParallel);
+}
+
+TEST_F(ParallelAccessStoreTest, Load_SameResourceInParallel_LoadsFromBaseStoreOnce) {
+  std::atomic<int> numLoads(0);
+  onLoad = [&] (const BlockId &) {
+    ++numLoads;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  };
+  auto ref1 = std::async(std::launch::async, [&] {return store.load(key1).value();});
+  auto ref2 = std::async(std::launch::async, [&] {return store.load(key1).value();});
+  auto loaded1 = ref1.get();
+  auto loaded2 = ref2.get();
+  EXPECT_EQ(loaded1->resource(), loaded2->resource());
+  EXPECT_EQ(1, numLoads.load());
+}
+
+TEST_F(ParallelAccessStoreTest, Load_AfterLoadingFromBaseStoreThrew) {
+  onLoad = [] (const BlockId &) {
+    throw std::runtime_error("error");
+  };
+  EXPECT_ANY_THROW(store.load(key1));
+  onLoad = [] (const BlockId &) {};
+  EXPECT_EQ(1, store.load(key1).value()->resource()->value);
+}
+
+
+TEST_F(ParallelAccessStoreTest, RemoveMany_DoesntBlockLoadingOtherResources) {
+  std::promise<void> removeStarted;
+  std::promise<void> key2Loaded;
+  std::atomic<bool> loadedInParallel(false);
+  auto removing = std::async(std::launch::async, [&] {
+    store.removeMany({key1}, [&] (const std::vector<BlockId> &notOpened) {
+      removeStarted.set_value();
+      // Only returns early if the other resource can be loaded while this one is being removed
+      loadedInParallel = (std::future_status::ready == key2Loaded.get_future().wait_for(TIMEOUT));
+      for (const BlockId &key : notOpened) {
+        values.erase(key);
+      }
+    });
+  });
+  removeStarted.get_future().wait();
+  EXPECT_EQ(2, store.load(key2).value()->resource()->value);
+  key2Loaded.set_value();
+  removing.get();
+  EXPECT_TRUE(loadedInParallel);
+}
+
+TEST_F(ParallelAccessStoreTest, Load_WhileRemovingMany_WaitsUntilRemoved) {
+  std::promise<void> removeStarted;
+  auto removing = std::async(std::launch::async, [&] {
+    store.removeMany({key1}, [&] (const std::vector<BlockId> &notOpened) {
+      removeStarted.set_value();
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      for (const BlockId &key : notOpened) {
+        values.erase(key);
+      }
+    });
+  });
+  removeStarted.get_future().wait();
+  EXPECT_EQ(boost::none, store.load(key1));
+  removing.get();
+}
+
+TEST_F(ParallelAccessStoreTest, Load_WhileRemoving_WaitsUntilRemoved) {
+  std::promise<void> removeStarted;
+  onRemove = [&] (const BlockId &) {
+    removeStarted.set_value();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  };
+  auto removing = std::async(std::launch::async, [&] {
+    store.remove(key1);
+  });
+  removeStarted.get_future().wait();
+  EXPECT_EQ(boost::none, store.load(key1));
+  removing.get();
+}
+
+TEST_F(ParallelAccessStoreTest, Remove_OpenedResource_WaitsUntilReleased) {
+  auto loaded = store.load(key1).value();
+  auto removing = std::async(std::launch::async, [&] {
+    store.remove(key1);
+  });
+  EXPECT_EQ(std::future_status::timeout, removing.wait_for(std::chrono::milliseconds(100)));
+  cpputils::destruct(std::move(loaded));
+  removing.get();
+  EXPECT_EQ(boost::none, store.load(key1));
+}